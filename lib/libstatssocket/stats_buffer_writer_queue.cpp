@@ -17,128 +17,191 @@
 #include "stats_buffer_writer_queue.h"
 
 #include <private/android_filesystem_config.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
-#include <queue>
-#include <thread>
 
 #include "stats_buffer_writer_impl.h"
 #include "stats_buffer_writer_queue_impl.h"
 #include "utils.h"
 
-BufferWriterQueue::BufferWriterQueue() : mWorkThread(&BufferWriterQueue::processCommands, this) {
+namespace {
+
+constexpr size_t kRecordHeaderSize = 2 * sizeof(uint32_t);  // size, then atom id
+
+static_assert((BufferWriterQueue::kQueueMaxSizeBytes &
+               (BufferWriterQueue::kQueueMaxSizeBytes - 1)) == 0,
+              "the ring size must be a power of 2");
+
+size_t getRecordSize(size_t bufferSize) {
+    return kRecordHeaderSize + ((bufferSize + 7) & ~(size_t)7);
+}
+
+size_t getRingOffset(uint64_t position) {
+    return position & (BufferWriterQueue::kQueueMaxSizeBytes - 1);
+}
+
+}  // namespace
+
+BufferWriterQueue::BufferWriterQueue()
+    : mRing(new uint64_t[kQueueMaxSizeBytes / sizeof(uint64_t)]()),
+      mWorkThread(&BufferWriterQueue::processCommands, this) {
     pthread_setname_np(mWorkThread.native_handle(), "socket_writer_queue");
 }
 
 BufferWriterQueue::~BufferWriterQueue() {
     terminate();
-    // at this stage there can be N elements in the queue for which memory needs to be freed
-    // explicitly
     drainQueue();
 }
 
 bool BufferWriterQueue::write(const uint8_t* buffer, size_t size, uint32_t atomId) {
-    Cmd cmd = createWriteBufferCmd(buffer, size, atomId);
-    if (cmd.buffer == NULL) {
+    if (size == 0 || size > kMaxBufferSize) {
+        return false;
+    }
+    if (mQueueSize.fetch_add(1, std::memory_order_relaxed) >= kQueueMaxSizeLimit) {
+        mQueueSize.fetch_sub(1, std::memory_order_relaxed);
         return false;
     }
-    return pushToQueue(cmd);
-}
-
-size_t BufferWriterQueue::getQueueSize() const {
-    std::unique_lock<std::mutex> lock(mMutex);
-    return mCmdQueue.size();
-}
 
-bool BufferWriterQueue::pushToQueue(const Cmd& cmd) {
-    {
-        std::unique_lock<std::mutex> lock(mMutex);
-        if (mCmdQueue.size() >= kQueueMaxSizeLimit) {
-            // TODO (b/258003151): add logging info about internal queue overflow with appropriate
-            // error code
+    // Reserve the bytes of the record. The caller notes the atom loss if the ring is full.
+    const size_t recordSize = getRecordSize(size);
+    uint64_t position = mTail.load(std::memory_order_relaxed);
+    do {
+        // Acquire the bytes cleared by the worker.
+        if (position + recordSize - mHead.load(std::memory_order_acquire) > kQueueMaxSizeBytes) {
+            mQueueSize.fetch_sub(1, std::memory_order_relaxed);
             return false;
         }
-        mCmdQueue.push(cmd);
+    } while (!mTail.compare_exchange_weak(position, position + recordSize,
+                                          std::memory_order_relaxed));
+
+    // Headers are 8 byte aligned, so that they never wrap around the end of the ring.
+    uint8_t* header = getRingBytes() + getRingOffset(position);
+    memcpy(header + sizeof(uint32_t), &atomId, sizeof(atomId));
+    copyToRing(position + kRecordHeaderSize, buffer, size);
+
+    // Commit the record, then wake up the worker if it is waiting for records. The worker
+    // checks for records after setting mWaiting, so that one of the two sees the other.
+    __atomic_store_n(reinterpret_cast<uint32_t*>(header), (uint32_t)size, __ATOMIC_SEQ_CST);
+    if (mWaiting.load() && mWaiting.exchange(false)) {
+        wakeUp();
     }
-    mCondition.notify_one();
     return true;
 }
 
-BufferWriterQueue::Cmd BufferWriterQueue::createWriteBufferCmd(const uint8_t* buffer, size_t size,
-                                                               uint32_t atomId) {
-    BufferWriterQueue::Cmd writeCmd;
-    writeCmd.atomId = atomId;
-    writeCmd.buffer = (uint8_t*)malloc(size);
-    if (writeCmd.buffer == NULL) {
-        return writeCmd;
+size_t BufferWriterQueue::getQueueSize() const {
+    return mQueueSize;
+}
+
+uint8_t* BufferWriterQueue::getRingBytes() const {
+    return reinterpret_cast<uint8_t*>(mRing.get());
+}
+
+uint32_t BufferWriterQueue::getCommittedSize(uint64_t position) const {
+    return __atomic_load_n(reinterpret_cast<uint32_t*>(getRingBytes() + getRingOffset(position)),
+                           __ATOMIC_SEQ_CST);
+}
+
+BufferWriterQueue::Cmd BufferWriterQueue::getCommand(uint64_t position, uint32_t size) {
+    const uint8_t* header = getRingBytes() + getRingOffset(position);
+    Cmd cmd;
+    uint32_t atomId;
+    memcpy(&atomId, header + sizeof(uint32_t), sizeof(atomId));
+    cmd.atomId = atomId;
+    cmd.size = size;
+
+    const size_t offset = getRingOffset(position + kRecordHeaderSize);
+    if (offset + size <= kQueueMaxSizeBytes) {
+        cmd.buffer = getRingBytes() + offset;
+    } else {
+        const size_t firstSize = kQueueMaxSizeBytes - offset;
+        memcpy(mWrappedBuffer, getRingBytes() + offset, firstSize);
+        memcpy(mWrappedBuffer + firstSize, getRingBytes(), size - firstSize);
+        cmd.buffer = mWrappedBuffer;
     }
-    memcpy(writeCmd.buffer, buffer, size);
-    writeCmd.size = size;
-    return writeCmd;
+    return cmd;
+}
+
+void BufferWriterQueue::popLocked(uint64_t position, uint32_t size) {
+    // Any 8 byte aligned word of the record may be the header of a later record, so all its
+    // bytes are cleared before it is handed back to the writers.
+    const size_t recordSize = getRecordSize(size);
+    const size_t offset = getRingOffset(position);
+    const size_t firstSize = std::min(recordSize, kQueueMaxSizeBytes - offset);
+    memset(getRingBytes() + offset, 0, firstSize);
+    memset(getRingBytes(), 0, recordSize - firstSize);
+    mHead.store(position + recordSize, std::memory_order_release);
+    mQueueSize--;
+}
+
+void BufferWriterQueue::copyToRing(uint64_t position, const void* data, size_t size) {
+    const size_t offset = getRingOffset(position);
+    const size_t firstSize = std::min(size, kQueueMaxSizeBytes - offset);
+    memcpy(getRingBytes() + offset, data, firstSize);
+    memcpy(getRingBytes(), static_cast<const uint8_t*>(data) + firstSize, size - firstSize);
+}
+
+void BufferWriterQueue::wakeUp() {
+    // Locking orders the notification after the worker checked mWaiting, or before.
+    { std::lock_guard<std::mutex> lock(mMutex); }
+    mCondition.notify_one();
 }
 
 void BufferWriterQueue::terminate() {
     if (mWorkThread.joinable()) {
         mDoTerminate = true;
-        Cmd terminateCmd;
-        terminateCmd.buffer = NULL;
-        pushToQueue(terminateCmd);
+        mWaiting = false;
+        wakeUp();
         mWorkThread.join();
     }
 }
 
 void BufferWriterQueue::drainQueue() {
-    std::unique_lock<std::mutex> lock(mMutex);
-    while (!mCmdQueue.empty()) {
-        free(mCmdQueue.front().buffer);
-        mCmdQueue.pop();
+    std::lock_guard<std::mutex> lock(mReadMutex);
+    uint64_t position = mHead.load(std::memory_order_relaxed);
+    while (const uint32_t size = getCommittedSize(position)) {
+        popLocked(position, size);
+        position = mHead.load(std::memory_order_relaxed);
     }
 }
 
 void BufferWriterQueue::processCommands() {
-    while (true) {
-        // temporary local thread copy
-        Cmd cmd;
+    while (!mDoTerminate) {
+        // Write the committed records back to back.
+        bool writeSuccess = true;
         {
-            std::unique_lock<std::mutex> lock(mMutex);
-            if (mCmdQueue.empty()) {
-                mCondition.wait(lock, [this] { return !this->mCmdQueue.empty(); });
-            }
-            cmd = mCmdQueue.front();
-        }
-
-        if (cmd.buffer == NULL) {
-            // null buffer ptr used as a marker of the termination request
-            return;
-        }
-
-        const bool writeSuccess = handleCommand(cmd);
-        if (writeSuccess) {
-            // no event drop is observed otherwise command remains in the queue
-            // and worker thread will try to log later on
-
-            // call free() explicitly here to free memory before the mutex lock
-            free(cmd.buffer);
-            {
-                std::unique_lock<std::mutex> lock(mMutex);
-                // this will lead to Cmd destructor call which will be no-op since now the
-                // buffer is NULL
-                mCmdQueue.pop();
+            std::lock_guard<std::mutex> lock(mReadMutex);
+            uint64_t position = mHead.load(std::memory_order_relaxed);
+            uint32_t size;
+            while (!mDoTerminate && (size = getCommittedSize(position)) != 0) {
+                writeSuccess = handleCommand(getCommand(position, size));
+                if (!writeSuccess) {
+                    // the record remains in the queue and the worker thread will try to log it
+                    // later on
+                    break;
+                }
+                popLocked(position, size);
+                position = mHead.load(std::memory_order_relaxed);
             }
         }
         // TODO (b/258003151): add logging info about retry count
 
-        if (mDoTerminate) {
-            return;
-        }
-
-        // attempt to enforce the logging frequency constraints
-        // in case of failed write due to socket overflow the sleep can be longer
-        // to not overload socket continuously
         if (!writeSuccess) {
+            // attempt to enforce the logging frequency constraints
+            // in case of failed write due to socket overflow the sleep can be longer
+            // to not overload socket continuously
             std::this_thread::sleep_for(std::chrono::milliseconds(kDelayOnFailedWriteMs));
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWaiting = true;
+        if (getCommittedSize(mHead.load(std::memory_order_relaxed)) == 0) {
+            mCondition.wait(lock, [this] { return !mWaiting || mDoTerminate; });
         }
+        mWaiting = false;
     }
 }
 
@@ -19,17 +19,37 @@
 #include <stddef.h>
 #include <stdint.h>
 
-#include <queue>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <thread>
 
+/**
+ * Queue of atoms written to the statsd socket by a worker thread.
+ *
+ * The atoms are copied into a preallocated ring of bytes as variable length records, so that
+ * writing threads never lock nor allocate: they reserve the bytes of a record by advancing the
+ * tail with a compare-and-swap, copy the atom, then commit the record by storing its size in its
+ * header. The worker writes the committed records to the socket back to back, and clears their
+ * bytes before handing them back to the writers by advancing the head.
+ */
 class BufferWriterQueue {
 public:
     constexpr static int kDelayOnFailedWriteMs = 5;
     constexpr static int kQueueMaxSizeLimit = 4800;  // 2X max_dgram_qlen
 
+    // Size of the ring, a power of 2. Atoms are written to it rounded up to 8 bytes, after an
+    // 8 byte header.
+    constexpr static size_t kQueueMaxSizeBytes = 256 * 1024;
+
+    // Size of the largest atom accepted, the max payload of a socket write.
+    constexpr static size_t kMaxBufferSize = 4068;
+
     BufferWriterQueue();
     virtual ~BufferWriterQueue();
 
+    // Returns false if the queue is full. Thread-safe, and does not block.
     bool write(const uint8_t* buffer, size_t size, uint32_t atomId);
 
     size_t getQueueSize() const;
@@ -45,15 +65,46 @@ public:
     virtual bool handleCommand(const Cmd& cmd) const;
 
 private:
+    // The bytes of the ring, zeroed where no record has been reserved.
+    std::unique_ptr<uint64_t[]> mRing;
+
+    // Positions in the ring, modulo kQueueMaxSizeBytes, of the first byte not reserved and of
+    // the first record not written to the socket.
+    alignas(64) std::atomic_uint64_t mTail = 0;
+    alignas(64) std::atomic_uint64_t mHead = 0;
+
+    // Number of records reserved and not yet written.
+    alignas(64) std::atomic_int mQueueSize = 0;
+
+    // Guards the reads of records and mHead updates, by the worker and drainQueue().
+    std::mutex mReadMutex;
+
+    // Copy of a record wrapping around the end of the ring, to write it in one piece.
+    uint8_t mWrappedBuffer[kMaxBufferSize];
+
+    // mWaiting is set by the worker before waiting on mCondition for records, and cleared by
+    // the one writer that wakes it up.
     std::condition_variable mCondition;
-    mutable std::mutex mMutex;
-    std::queue<Cmd> mCmdQueue;
+    std::mutex mMutex;
+    std::atomic_bool mWaiting = false;
+
     std::atomic_bool mDoTerminate = false;
     std::thread mWorkThread;
 
-    static Cmd createWriteBufferCmd(const uint8_t* buffer, size_t size, uint32_t atomId);
+    uint8_t* getRingBytes() const;
+
+    // Returns the size of the committed record at position, or 0 if it is not committed yet.
+    uint32_t getCommittedSize(uint64_t position) const;
+
+    // Returns the atom of the committed record at position, for the worker to write.
+    Cmd getCommand(uint64_t position, uint32_t size);
+
+    // Clears the bytes of the committed record at position and hands them back to the writers.
+    void popLocked(uint64_t position, uint32_t size);
+
+    void copyToRing(uint64_t position, const void* data, size_t size);
 
-    bool pushToQueue(const Cmd& cmd);
+    void wakeUp();
 
     void terminate();
 
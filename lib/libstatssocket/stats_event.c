@@ -16,6 +16,7 @@
 
 #include "include/stats_event.h"
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -83,16 +84,42 @@ struct AStatsEvent {
     size_t bufSize;
 };
 
+// Each thread keeps the last event it released, to be returned by its next AStatsEvent_obtain()
+// without allocating. Only events whose buffer did not grow are kept, so that a thread holds at
+// most one push event worth of memory. The kept event is freed when the thread exits.
+static pthread_key_t cached_event_key;
+static pthread_once_t cached_event_key_once = PTHREAD_ONCE_INIT;
+static bool cached_event_key_created = false;
+
+static void free_event(void* event) {
+    free(((AStatsEvent*)event)->buf);
+    free(event);
+}
+
+static void create_cached_event_key() {
+    cached_event_key_created = pthread_key_create(&cached_event_key, free_event) == 0;
+}
+
 AStatsEvent* AStatsEvent_obtain() {
-    AStatsEvent* event = malloc(sizeof(AStatsEvent));
+    pthread_once(&cached_event_key_once, create_cached_event_key);
+    AStatsEvent* event = NULL;
+    if (cached_event_key_created) {
+        event = (AStatsEvent*)pthread_getspecific(cached_event_key);
+    }
+    if (event != NULL) {
+        pthread_setspecific(cached_event_key, NULL);
+    } else {
+        event = malloc(sizeof(AStatsEvent));
+        event->bufSize = MAX_PUSH_EVENT_PAYLOAD;
+        // Bytes are never read before being written, so the buffer is not zeroed.
+        event->buf = (uint8_t*)malloc(event->bufSize);
+    }
     event->lastFieldPos = 0;
     event->numBytesWritten = 2;  // reserve first 2 bytes for root event type and number of elements
     event->numElements = 0;
     event->atomId = 0;
     event->errors = 0;
     event->built = false;
-    event->bufSize = MAX_PUSH_EVENT_PAYLOAD;
-    event->buf = (uint8_t*)calloc(event->bufSize, 1);
 
     event->buf[0] = OBJECT_TYPE;
     AStatsEvent_writeInt64(event, get_elapsed_realtime_ns());  // write the timestamp
@@ -101,8 +128,12 @@ AStatsEvent* AStatsEvent_obtain() {
 }
 
 void AStatsEvent_release(AStatsEvent* event) {
-    free(event->buf);
-    free(event);
+    if (cached_event_key_created && event->bufSize == MAX_PUSH_EVENT_PAYLOAD &&
+        pthread_getspecific(cached_event_key) == NULL &&
+        pthread_setspecific(cached_event_key, event) == 0) {
+        return;
+    }
+    free_event(event);
 }
 
 void AStatsEvent_setAtomId(AStatsEvent* event, uint32_t atomId) {
@@ -395,6 +426,8 @@ static void build_internal(AStatsEvent* event, const bool push) {
         event->numElements = 2;
         // Reset number of atom-level annotations to 0.
         event->buf[POS_ATOM_ID] = INT32_TYPE;
+        // The atom id may not have been written.
+        memcpy(&event->buf[POS_ATOM_ID + sizeof(uint8_t)], &event->atomId, sizeof(event->atomId));
         // Now, write errors to the buffer immediately after the atom id.
         event->numBytesWritten = POS_ATOM_ID + sizeof(uint8_t) + sizeof(uint32_t);
         start_field(event, ERROR_TYPE);
@@ -18,6 +18,9 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "stats_buffer_writer_queue_impl.h"
 #include "stats_event.h"
@@ -49,6 +52,29 @@ public:
 
 typedef StrictMock<BasicBufferWriterQueueMock> BufferWriterQueueMock;
 
+// Returns a buffer of the given size starting with value, followed by bytes derived from it.
+static std::vector<uint8_t> generateTestBuffer(uint32_t value, size_t size) {
+    std::vector<uint8_t> buffer(size);
+    for (size_t i = 0; i < size; i++) {
+        buffer[i] = i < sizeof(value) ? (value >> (i * 8)) & 0xff : (value + i) & 0xff;
+    }
+    return buffer;
+}
+
+static uint32_t readTestBufferValue(const BufferWriterQueue::Cmd& cmd) {
+    uint32_t value = 0;
+    memcpy(&value, cmd.buffer, std::min((size_t)cmd.size, sizeof(value)));
+    return value;
+}
+
+// Writes the buffer, waiting for the worker to make room in the queue if needed.
+static void writeUntilQueued(BufferWriterQueue& queue, const std::vector<uint8_t>& buffer,
+                             uint32_t atomId) {
+    while (!queue.write(buffer.data(), buffer.size(), atomId)) {
+        std::this_thread::yield();
+    }
+}
+
 }  // namespace
 
 TEST(StatsBufferWriterQueueTest, TestWriteSuccess) {
@@ -168,3 +194,91 @@ TEST(StatsBufferWriterQueueTest, TestTerminateNonEmptyQueue) {
     queue.drainQueue();
     EXPECT_EQ(queue.getQueueSize(), 0);
 }
+
+TEST(StatsBufferWriterQueueTest, TestWriteWrapsAroundQueueBuffer) {
+    // Sizes that are not multiples of 8, so that records and buffers wrap at various offsets.
+    const std::vector<size_t> sizes = {5, 21, 300, 4068, 1001};
+    const int writeCount = 4 * BufferWriterQueueMock::kQueueMaxSizeBytes / 1000;
+
+    std::vector<std::vector<uint8_t>> handled;
+    BufferWriterQueueMock queue;
+    EXPECT_CALL(queue, handleCommand(_))
+            .WillRepeatedly([&handled](const BufferWriterQueue::Cmd& cmd) {
+                EXPECT_EQ(cmd.atomId, 100);
+                handled.emplace_back(cmd.buffer, cmd.buffer + cmd.size);
+                return true;
+            });
+
+    for (int i = 0; i < writeCount; i++) {
+        writeUntilQueued(queue, generateTestBuffer(i, sizes[i % sizes.size()]), /*atomId=*/100);
+    }
+    while (queue.getQueueSize() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    ASSERT_EQ(handled.size(), writeCount);
+    for (int i = 0; i < writeCount; i++) {
+        EXPECT_EQ(handled[i], generateTestBuffer(i, sizes[i % sizes.size()]));
+    }
+}
+
+TEST(StatsBufferWriterQueueTest, TestWriteFromSeveralThreads) {
+    const int threadCount = 4;
+    const int writeCount = BufferWriterQueueMock::kQueueMaxSizeLimit;
+
+    std::mutex mutex;
+    std::vector<std::vector<uint32_t>> handledValues(threadCount);
+    BufferWriterQueueMock queue;
+    EXPECT_CALL(queue, handleCommand(_))
+            .WillRepeatedly([&](const BufferWriterQueue::Cmd& cmd) {
+                std::lock_guard<std::mutex> lock(mutex);
+                handledValues[cmd.atomId].push_back(readTestBufferValue(cmd));
+                return true;
+            });
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&queue, t] {
+            for (int i = 0; i < writeCount; i++) {
+                writeUntilQueued(queue, generateTestBuffer(i, 20 + i % 50), /*atomId=*/t);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    while (queue.getQueueSize() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The atoms of each thread are written in order.
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int t = 0; t < threadCount; t++) {
+        ASSERT_EQ(handledValues[t].size(), writeCount);
+        for (int i = 0; i < writeCount; i++) {
+            EXPECT_EQ(handledValues[t][i], i);
+        }
+    }
+}
+
+TEST(StatsBufferWriterQueueTest, TestWriteBytesOverflow) {
+    const std::vector<uint8_t> buffer = generateTestBuffer(1, 4000);
+
+    BufferWriterQueueMock queue;
+    EXPECT_CALL(queue, handleCommand(_)).WillRepeatedly(Return(false));
+    // simulate failed write to stats socket until the queue buffer is full
+    int writeCount = 0;
+    while (queue.write(buffer.data(), buffer.size(), /*atomId=*/100)) {
+        writeCount++;
+    }
+    EXPECT_EQ(writeCount, BufferWriterQueueMock::kQueueMaxSizeBytes / (buffer.size() + 8));
+    EXPECT_EQ(queue.getQueueSize(), writeCount);
+
+    // too large to be written to the socket
+    const std::vector<uint8_t> largeBuffer(BufferWriterQueueMock::kMaxBufferSize + 1);
+    queue.drainQueue();
+    EXPECT_FALSE(queue.write(largeBuffer.data(), largeBuffer.size(), /*atomId=*/100));
+    EXPECT_TRUE(queue.write(buffer.data(), buffer.size(), /*atomId=*/100));
+    queue.drainQueue();
+    EXPECT_EQ(queue.getQueueSize(), 0);
+}
@@ -18,6 +18,8 @@
 #include <gtest/gtest.h>
 #include <utils/SystemClock.h>
 
+#include <thread>
+
 // Keep in sync with stats_event.c. Consider moving to separate header file to avoid duplication.
 /* ERRORS */
 #define ERROR_NO_TIMESTAMP 0x1
@@ -708,3 +710,105 @@ TEST(StatsEventTest, TestListTooLongError) {
     uint32_t errors = AStatsEvent_getErrors(event);
     EXPECT_EQ(errors & ERROR_LIST_TOO_LONG, ERROR_LIST_TOO_LONG);
 }
+
+TEST(StatsEventTest, TestReusedEvent) {
+    const uint32_t atomId = 100;
+    const string str(1000, 'A');
+
+    // Released events are reused by the next events obtained on the thread.
+    AStatsEvent* event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, atomId);
+    AStatsEvent_writeString(event, str.c_str());
+    AStatsEvent_writeString(event, str.c_str());
+    AStatsEvent_build(event);
+    AStatsEvent_release(event);
+
+    int64_t startTime = android::elapsedRealtimeNano();
+    event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, atomId);
+    AStatsEvent_writeInt32(event, 5);
+    AStatsEvent_build(event);
+    int64_t endTime = android::elapsedRealtimeNano();
+
+    size_t bufferSize;
+    uint8_t* buffer = AStatsEvent_getBuffer(event, &bufferSize);
+    uint8_t* bufferEnd = buffer + bufferSize;
+    checkMetadata(&buffer, /*numElements=*/1, startTime, endTime, atomId);
+    checkTypeHeader(&buffer, INT32_TYPE);
+    checkScalar(&buffer, 5);
+    EXPECT_EQ(buffer, bufferEnd);
+    EXPECT_EQ(AStatsEvent_getErrors(event), 0);
+    AStatsEvent_release(event);
+
+    // Nothing from the previous events is left in the error event, including the atom id.
+    startTime = android::elapsedRealtimeNano();
+    event = AStatsEvent_obtain();
+    AStatsEvent_build(event);
+    endTime = android::elapsedRealtimeNano();
+
+    buffer = AStatsEvent_getBuffer(event, &bufferSize);
+    bufferEnd = buffer + bufferSize;
+    checkMetadata(&buffer, /*numElements=*/1, startTime, endTime, /*atomId=*/0);
+    checkTypeHeader(&buffer, ERROR_TYPE);
+    checkScalar(&buffer, static_cast<int32_t>(ERROR_NO_ATOM_ID));
+    EXPECT_EQ(buffer, bufferEnd);
+    AStatsEvent_release(event);
+}
+
+TEST(StatsEventTest, TestReusedEventAfterLargePull) {
+    const uint32_t atomId = 100;
+    const string str(4064, 'A');  // Grows the buffer past the push event limit.
+
+    AStatsEvent* event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, atomId);
+    AStatsEvent_writeString(event, str.c_str());
+    AStatsEvent_build(event);
+    EXPECT_EQ(AStatsEvent_getErrors(event), 0);
+    AStatsEvent_release(event);
+
+    // A push event still overflows at the push event limit.
+    event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, atomId);
+    AStatsEvent_writeString(event, str.c_str());
+    AStatsEvent_write(event);
+    EXPECT_EQ(AStatsEvent_getErrors(event) & ERROR_OVERFLOW, ERROR_OVERFLOW);
+    AStatsEvent_release(event);
+}
+
+TEST(StatsEventTest, TestEventsOnSeveralThreads) {
+    const uint32_t atomId = 100;
+    const int threadCount = 4;
+    const int eventCount = 1000;
+
+    vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < eventCount; i++) {
+                // More events than the thread keeps are alive at once.
+                AStatsEvent* events[2];
+                for (int j = 0; j < 2; j++) {
+                    events[j] = AStatsEvent_obtain();
+                    AStatsEvent_setAtomId(events[j], atomId);
+                    AStatsEvent_writeInt32(events[j], t);
+                    AStatsEvent_writeInt32(events[j], i * 2 + j);
+                    AStatsEvent_build(events[j]);
+                }
+                for (int j = 0; j < 2; j++) {
+                    size_t bufferSize;
+                    uint8_t* buffer = AStatsEvent_getBuffer(events[j], &bufferSize);
+                    uint8_t* bufferEnd = buffer + bufferSize;
+                    checkMetadata(&buffer, /*numElements=*/2, 0, INT64_MAX, atomId);
+                    checkTypeHeader(&buffer, INT32_TYPE);
+                    checkScalar(&buffer, t);
+                    checkTypeHeader(&buffer, INT32_TYPE);
+                    checkScalar(&buffer, i * 2 + j);
+                    EXPECT_EQ(buffer, bufferEnd);
+                    AStatsEvent_release(events[j]);
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "tests/statsd_test_util.h"
+
+using namespace std;
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+StatsdConfig CreateDispatchConfig() {
+    StatsdConfig config;
+    auto wakelockAcquireMatcher = CreateAcquireWakelockAtomMatcher();
+    *config.add_atom_matcher() = wakelockAcquireMatcher;
+    *config.add_atom_matcher() = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = CreateScreenTurnedOffAtomMatcher();
+    auto screenIsOnPredicate = CreateScreenIsOnPredicate();
+    *config.add_predicate() = screenIsOnPredicate;
+
+    // Enough sliced metrics per config for the dispatch work to outweigh the scheduling cost.
+    for (int i = 0; i < 20; i++) {
+        CountMetric* metric = config.add_count_metric();
+        *metric = createCountMetric("Count" + to_string(i), wakelockAcquireMatcher.id(),
+                                    screenIsOnPredicate.id(), /* states */ {});
+        *metric->mutable_dimensions_in_what() =
+                CreateAttributionUidDimensions(util::WAKELOCK_STATE_CHANGED, {Position::FIRST});
+    }
+    return config;
+}
+
+}  // namespace
+
+// Dispatches events to a growing number of identical configs. The second argument is the number of
+// worker threads used for parallel per config dispatch, 0 being serial dispatch.
+static void BM_ConfigDispatch(benchmark::State& state) {
+    const int configCount = state.range(0);
+    const size_t threadCount = state.range(1);
+    const StatsdConfig config = CreateDispatchConfig();
+
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, config, ConfigKey(0, 0));
+    for (int i = 1; i < configCount; i++) {
+        processor->OnConfigUpdated(1, ConfigKey(0, i), config);
+    }
+    processor->enableParallelConfigDispatch(threadCount);
+
+    std::vector<std::unique_ptr<LogEvent>> events;
+    events.push_back(CreateScreenStateChangedEvent(2, android::view::DISPLAY_STATE_ON));
+    for (int i = 1; i <= 10; i++) {
+        events.push_back(CreateAcquireWakelockEvent(2 + i, {1000 + i}, {"App" + to_string(i)},
+                                                    "wl" + to_string(i)));
+    }
+
+    for (auto _ : state) {
+        for (const auto& event : events) {
+            processor->OnLogEvent(event.get());
+        }
+    }
+}
+BENCHMARK(BM_ConfigDispatch)->ArgsProduct({{1, 4, 16, 32}, {0, 3}});
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -67,6 +67,44 @@ static void BM_FilterValue(benchmark::State& state) {
 
 BENCHMARK(BM_FilterValue);
 
+// Dimensions on every uid of a long attribution chain and a few more fields, as used by configs
+// slicing by attribution.
+static void BM_FilterValueWideEvent(benchmark::State& state) {
+    const int nodeCount = state.range(0);
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, 1);
+    AStatsEvent_overwriteTimestamp(statsEvent, 100000);
+    std::vector<int> attributionUids(nodeCount, 100);
+    std::vector<string> attributionTags(nodeCount, "LOCATION");
+    writeAttribution(statsEvent, attributionUids, attributionTags);
+    AStatsEvent_writeFloat(statsEvent, 3.2f);
+    AStatsEvent_writeString(statsEvent, "LOCATION");
+    AStatsEvent_writeInt64(statsEvent, 990);
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    parseStatsEventToLogEvent(statsEvent, &event);
+
+    FieldMatcher field_matcher;
+    field_matcher.set_field(1);
+    for (const Position position : {FIRST, LAST, ALL}) {
+        auto child = field_matcher.add_child();
+        child->set_field(1);
+        child->set_position(position);
+        child->add_child()->set_field(1);
+    }
+    field_matcher.add_child()->set_field(3);
+    field_matcher.add_child()->set_field(4);
+
+    std::vector<Matcher> matchers;
+    translateFieldMatcher(field_matcher, &matchers);
+
+    while (state.KeepRunning()) {
+        HashableDimensionKey output;
+        filterValues(matchers, event.getValues(), &output);
+    }
+}
+
+BENCHMARK(BM_FilterValueWideEvent)->Arg(2)->Arg(8)->Arg(32);
+
 }  //  namespace statsd
 }  //  namespace os
 }  //  namespace android
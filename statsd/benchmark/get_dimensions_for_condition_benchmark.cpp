@@ -71,6 +71,46 @@ static void BM_GetDimensionInCondition(benchmark::State& state) {
 
 BENCHMARK(BM_GetDimensionInCondition);
 
+// Links on the first and last uids of a long attribution chain and the remaining fields.
+static void BM_GetDimensionInConditionWideEvent(benchmark::State& state) {
+    const int nodeCount = state.range(0);
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, 1);
+    AStatsEvent_overwriteTimestamp(statsEvent, 100000);
+    std::vector<int> attributionUids(nodeCount, 100);
+    std::vector<string> attributionTags(nodeCount, "LOCATION");
+    writeAttribution(statsEvent, attributionUids, attributionTags);
+    AStatsEvent_writeFloat(statsEvent, 3.2f);
+    AStatsEvent_writeString(statsEvent, "LOCATION");
+    AStatsEvent_writeInt64(statsEvent, 990);
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    parseStatsEventToLogEvent(statsEvent, &event);
+
+    Metric2Condition link;
+    link.conditionId = 1;
+    FieldMatcher field_matcher;
+    field_matcher.set_field(event.GetTagId());
+    for (const Position position : {FIRST, LAST}) {
+        auto child = field_matcher.add_child();
+        child->set_field(1);
+        child->set_position(position);
+        child->add_child()->set_field(1);
+    }
+    field_matcher.add_child()->set_field(2);
+    field_matcher.add_child()->set_field(3);
+    field_matcher.add_child()->set_field(4);
+    translateFieldMatcher(field_matcher, &link.metricFields);
+    field_matcher.set_field(event.GetTagId() + 1);
+    translateFieldMatcher(field_matcher, &link.conditionFields);
+
+    while (state.KeepRunning()) {
+        HashableDimensionKey output;
+        getDimensionForCondition(event.getValues(), link, &output);
+    }
+}
+
+BENCHMARK(BM_GetDimensionInConditionWideEvent)->Arg(2)->Arg(8)->Arg(32);
+
 
 }  //  namespace statsd
 }  //  namespace os
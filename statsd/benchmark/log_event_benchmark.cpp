@@ -55,6 +55,23 @@ static size_t createStatsEventExtraLarge(uint8_t* msg) {
     return createStatsEvent(msg, 20);
 }
 
+// Atom with many long strings, as logged with package and component names.
+static size_t createStatsEventWide(uint8_t* msg) {
+    AStatsEvent* event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, 100);
+    for (int i = 0; i < 30; i++) {
+        AStatsEvent_writeInt32(event, i);
+        AStatsEvent_writeString(event, "com.android.demo.package.DemoComponentName");
+    }
+    AStatsEvent_build(event);
+
+    size_t size;
+    uint8_t* buf = AStatsEvent_getBuffer(event, &size);
+    memcpy(msg, buf, size);
+    AStatsEvent_release(event);
+    return size;
+}
+
 static void BM_LogEventCreation(benchmark::State& state) {
     uint8_t msg[LOGGER_ENTRY_MAX_PAYLOAD];
     const size_t size = createStatsEvent(msg);
@@ -156,6 +173,19 @@ static void BM_LogEventCreationLargeWithPrefetch(benchmark::State& state) {
 }
 BENCHMARK(BM_LogEventCreationLargeWithPrefetch);
 
+static void BM_LogEventCreationLargeWithLazyBody(benchmark::State& state) {
+    uint8_t msg[LOGGER_ENTRY_MAX_PAYLOAD];
+    const size_t size = createStatsEventLarge(msg);
+    while (state.KeepRunning()) {
+        LogEvent event(/*uid=*/1000, /*pid=*/1001);
+        const LogEvent::BodyBufferInfo header = event.parseHeader(msg, size);
+
+        // strings are only indexed, not decoded
+        benchmark::DoNotOptimize(event.parseBodyLazy(header));
+    }
+}
+BENCHMARK(BM_LogEventCreationLargeWithLazyBody);
+
 static void BM_LogEventCreationLargeWithPrefetchOnly(benchmark::State& state) {
     uint8_t msg[LOGGER_ENTRY_MAX_PAYLOAD];
     const size_t size = createStatsEventLarge(msg);
@@ -206,6 +236,54 @@ static void BM_LogEventCreationExtraLargeWithPrefetchOnly(benchmark::State& stat
 }
 BENCHMARK(BM_LogEventCreationExtraLargeWithPrefetchOnly);
 
+static void BM_LogEventCreationExtraLargeWithLazyBody(benchmark::State& state) {
+    uint8_t msg[LOGGER_ENTRY_MAX_PAYLOAD];
+    const size_t size = createStatsEventExtraLarge(msg);
+    while (state.KeepRunning()) {
+        LogEvent event(/*uid=*/1000, /*pid=*/1001);
+        const LogEvent::BodyBufferInfo header = event.parseHeader(msg, size);
+
+        // strings are only indexed, not decoded
+        benchmark::DoNotOptimize(event.parseBodyLazy(header));
+    }
+}
+BENCHMARK(BM_LogEventCreationExtraLargeWithLazyBody);
+
+static void BM_LogEventCreationWideWithPrefetch(benchmark::State& state) {
+    uint8_t msg[LOGGER_ENTRY_MAX_PAYLOAD];
+    const size_t size = createStatsEventWide(msg);
+    while (state.KeepRunning()) {
+        LogEvent event(/*uid=*/1000, /*pid=*/1001);
+        const LogEvent::BodyBufferInfo header = event.parseHeader(msg, size);
+        benchmark::DoNotOptimize(event.parseBody(header));
+    }
+}
+BENCHMARK(BM_LogEventCreationWideWithPrefetch);
+
+static void BM_LogEventCreationWideWithLazyBody(benchmark::State& state) {
+    uint8_t msg[LOGGER_ENTRY_MAX_PAYLOAD];
+    const size_t size = createStatsEventWide(msg);
+    while (state.KeepRunning()) {
+        LogEvent event(/*uid=*/1000, /*pid=*/1001);
+        const LogEvent::BodyBufferInfo header = event.parseHeader(msg, size);
+        benchmark::DoNotOptimize(event.parseBodyLazy(header));
+    }
+}
+BENCHMARK(BM_LogEventCreationWideWithLazyBody);
+
+// Lazy parsing followed by decoding all the values, the worst case for lazy parsing.
+static void BM_LogEventCreationWideWithLazyBodyMaterialized(benchmark::State& state) {
+    uint8_t msg[LOGGER_ENTRY_MAX_PAYLOAD];
+    const size_t size = createStatsEventWide(msg);
+    while (state.KeepRunning()) {
+        LogEvent event(/*uid=*/1000, /*pid=*/1001);
+        const LogEvent::BodyBufferInfo header = event.parseHeader(msg, size);
+        event.parseBodyLazy(header);
+        benchmark::DoNotOptimize(event.getValues().data());
+    }
+}
+BENCHMARK(BM_LogEventCreationWideWithLazyBodyMaterialized);
+
 }  //  namespace statsd
 }  //  namespace os
 }  //  namespace android
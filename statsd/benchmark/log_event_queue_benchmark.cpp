@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "logd/LogEventQueue.h"
+#include "stats_log_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+constexpr int kEventsPerProducer = 20000;
+
+// Mutex/condition variable based queue that LogEventQueue used to be, kept as a baseline.
+class MutexLogEventQueue {
+public:
+    explicit MutexLogEventQueue(size_t maxSize) : mQueueLimit(maxSize) {
+    }
+
+    std::unique_ptr<LogEvent> waitPop() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this] { return !mQueue.empty(); });
+        std::unique_ptr<LogEvent> item = std::move(mQueue.front());
+        mQueue.pop();
+        return item;
+    }
+
+    size_t waitPopN(std::vector<std::unique_ptr<LogEvent>>& events, size_t maxCount) {
+        // The baseline has no batched read, pop one event per wakeup.
+        events.push_back(waitPop());
+        return 1;
+    }
+
+    LogEventQueue::Result push(std::unique_ptr<LogEvent> item) {
+        LogEventQueue::Result result;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            if (mQueue.size() < mQueueLimit) {
+                mQueue.push(std::move(item));
+                result.success = true;
+            } else {
+                result.oldestTimestampNs = mQueue.front()->GetElapsedTimestampNs();
+            }
+            result.size = mQueue.size();
+        }
+        mCondition.notify_one();
+        return result;
+    }
+
+private:
+    const size_t mQueueLimit;
+    std::condition_variable mCondition;
+    std::mutex mMutex;
+    std::queue<std::unique_ptr<LogEvent>> mQueue;
+};
+
+// Runs state.range(0) producers against one consumer popping up to state.range(1) events per
+// call. Each event carries its push time so that the consumer can compute the queueing latency.
+// The queue is sized to hold every event so that both implementations process the same load.
+template <typename Queue>
+void runProducersConsumer(benchmark::State& state) {
+    const int producerCount = state.range(0);
+    const size_t batchSize = state.range(1);
+    const int64_t totalEvents = (int64_t)producerCount * kEventsPerProducer;
+
+    std::vector<int64_t> latenciesNs;
+    latenciesNs.reserve(totalEvents);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        Queue queue(totalEvents);
+        latenciesNs.clear();
+        state.ResumeTiming();
+
+        std::vector<std::thread> producers;
+        for (int p = 0; p < producerCount; p++) {
+            producers.emplace_back([&queue] {
+                for (int i = 0; i < kEventsPerProducer; i++) {
+                    std::unique_ptr<LogEvent> event =
+                            std::make_unique<LogEvent>(/*uid=*/0, /*pid=*/0);
+                    event->setElapsedTimestampNs(getElapsedRealtimeNs());
+                    benchmark::DoNotOptimize(queue.push(std::move(event)));
+                }
+            });
+        }
+
+        std::vector<std::unique_ptr<LogEvent>> events;
+        int64_t consumed = 0;
+        while (consumed < totalEvents) {
+            events.clear();
+            queue.waitPopN(events, batchSize);
+            const int64_t nowNs = getElapsedRealtimeNs();
+            for (const auto& event : events) {
+                latenciesNs.push_back(nowNs - event->GetElapsedTimestampNs());
+            }
+            consumed += events.size();
+        }
+
+        for (auto& producer : producers) {
+            producer.join();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * totalEvents);
+    if (!latenciesNs.empty()) {
+        std::sort(latenciesNs.begin(), latenciesNs.end());
+        state.counters["p50_latency_ns"] = latenciesNs[latenciesNs.size() / 2];
+        state.counters["p99_latency_ns"] = latenciesNs[latenciesNs.size() * 99 / 100];
+        state.counters["max_latency_ns"] = latenciesNs.back();
+    }
+}
+
+}  // namespace
+
+static void BM_MutexLogEventQueue(benchmark::State& state) {
+    runProducersConsumer<MutexLogEventQueue>(state);
+}
+BENCHMARK(BM_MutexLogEventQueue)
+        ->ArgsProduct({{1, 2, 4}, {1}})
+        ->UseRealTime()
+        ->Unit(benchmark::kMillisecond);
+
+static void BM_LogEventQueue(benchmark::State& state) {
+    runProducersConsumer<LogEventQueue>(state);
+}
+BENCHMARK(BM_LogEventQueue)
+        ->ArgsProduct({{1, 2, 4}, {1, 64}})
+        ->UseRealTime()
+        ->Unit(benchmark::kMillisecond);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "matchers/matcher_util.h"
+#include "tests/statsd_test_util.h"
+
+using namespace std;
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+constexpr int kEventCount = 100;
+
+// Matches sync events of uids below 20000 on any attribution node, with one of stringCount sync
+// names and in state ON.
+SimpleAtomMatcher createSyncMatcher(int stringCount) {
+    SimpleAtomMatcher matcher;
+    matcher.set_atom_id(util::SYNC_STATE_CHANGED);
+
+    FieldValueMatcher* attributionMatcher = matcher.add_field_value_matcher();
+    attributionMatcher->set_field(1);  // attribution_node
+    attributionMatcher->set_position(Position::ANY);
+    FieldValueMatcher* uidMatcher =
+            attributionMatcher->mutable_matches_tuple()->add_field_value_matcher();
+    uidMatcher->set_field(1);  // uid
+    uidMatcher->set_lt_int(20000);
+
+    FieldValueMatcher* nameMatcher = matcher.add_field_value_matcher();
+    nameMatcher->set_field(2);  // sync_name
+    for (int i = 0; i < stringCount; i++) {
+        nameMatcher->mutable_eq_any_string()->add_str_value("sync" + to_string(i * 2));
+    }
+
+    FieldValueMatcher* stateMatcher = matcher.add_field_value_matcher();
+    stateMatcher->set_field(3);  // state
+    stateMatcher->set_eq_int(SyncStateChanged::ON);
+    return matcher;
+}
+
+vector<unique_ptr<LogEvent>> createSyncEvents() {
+    vector<unique_ptr<LogEvent>> events;
+    for (int i = 0; i < kEventCount; i++) {
+        const int uid = 10000 + i % 7;
+        events.push_back(CreateSyncStartEvent(i * NS_PER_SEC, {uid, uid + 1}, {"tag1", "tag2"},
+                                              "sync" + to_string(i % 40)));
+    }
+    return events;
+}
+
+}  // anonymous namespace
+
+// Compiles the matcher for every event, which is what matchesSimple() does.
+static void BM_MatchesSimple(benchmark::State& state) {
+    const sp<UidMap> uidMap = new UidMap();
+    const SimpleAtomMatcher matcher = createSyncMatcher(state.range(0));
+    const vector<unique_ptr<LogEvent>> events = createSyncEvents();
+    for (auto _ : state) {
+        for (const unique_ptr<LogEvent>& event : events) {
+            benchmark::DoNotOptimize(matchesSimple(uidMap, matcher, *event).matched);
+        }
+    }
+}
+BENCHMARK(BM_MatchesSimple)->Arg(1)->Arg(10)->Arg(50);
+
+static void BM_SimpleAtomMatcherProgram(benchmark::State& state) {
+    const sp<UidMap> uidMap = new UidMap();
+    const SimpleAtomMatcherProgram program(createSyncMatcher(state.range(0)));
+    const vector<unique_ptr<LogEvent>> events = createSyncEvents();
+    for (auto _ : state) {
+        for (const unique_ptr<LogEvent>& event : events) {
+            benchmark::DoNotOptimize(program.match(uidMap, *event).matched);
+        }
+    }
+}
+BENCHMARK(BM_SimpleAtomMatcherProgram)->Arg(1)->Arg(10)->Arg(50);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -14,14 +14,53 @@
  * limitations under the License.
  */
 
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
 #include "benchmark/benchmark.h"
 #include "tests/statsd_test_util.h"
 
+namespace {
+
+// Counts heap allocations done through operator new so that benchmarks can report the number of
+// allocations per processed event.
+std::atomic<int64_t> gAllocationCount = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        abort();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
 using namespace std;
 namespace android {
 namespace os {
 namespace statsd {
 
+namespace {
+
+void reportAllocationsPerEvent(benchmark::State& state, int64_t allocationCount,
+                               size_t eventCount) {
+    state.counters["allocs_per_event"] =
+            (double)allocationCount / (double)(state.iterations() * eventCount);
+}
+
+}  // namespace
+
 static void BM_OnLogEvent(benchmark::State& state) {
     StatsdConfig config;
     auto wakelockAcquireMatcher = CreateAcquireWakelockAtomMatcher();
@@ -48,14 +87,67 @@ static void BM_OnLogEvent(benchmark::State& state) {
 
     sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, config, cfgKey);
 
+    const int64_t allocationCountBefore = gAllocationCount.load();
     for (auto _ : state) {
         for (const auto& event : events) {
             processor->OnLogEvent(event.get());
         }
     }
+    reportAllocationsPerEvent(state, gAllocationCount.load() - allocationCountBefore,
+                              events.size());
 }
 BENCHMARK(BM_OnLogEvent);
 
+// Config with many matchers and conditions so that the per event scratch state is large.
+static void BM_OnLogEventManyConditions(benchmark::State& state) {
+    StatsdConfig config;
+    auto wakelockAcquireMatcher = CreateAcquireWakelockAtomMatcher();
+    *config.add_atom_matcher() = wakelockAcquireMatcher;
+    *config.add_atom_matcher() = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = CreateScreenTurnedOffAtomMatcher();
+    auto screenIsOnPredicate = CreateScreenIsOnPredicate();
+    *config.add_predicate() = screenIsOnPredicate;
+
+    for (int atomId = 1000; atomId < 1500; atomId++) {
+        auto startMatcher = CreateSimpleAtomMatcher("start" + to_string(atomId), atomId);
+        auto stopMatcher = CreateSimpleAtomMatcher("stop" + to_string(atomId), atomId + 1000);
+        *config.add_atom_matcher() = startMatcher;
+        *config.add_atom_matcher() = stopMatcher;
+        Predicate predicate;
+        predicate.set_id(StringToId("predicate" + to_string(atomId)));
+        predicate.mutable_simple_predicate()->set_start(startMatcher.id());
+        predicate.mutable_simple_predicate()->set_stop(stopMatcher.id());
+        *config.add_predicate() = predicate;
+        *config.add_count_metric() =
+                createCountMetric("Count" + to_string(atomId), wakelockAcquireMatcher.id(),
+                                  predicate.id(), /* states */ {});
+    }
+    *config.add_count_metric() =
+            createCountMetric("CountWhileScreenOn", wakelockAcquireMatcher.id(),
+                              screenIsOnPredicate.id(), /* states */ {});
+
+    ConfigKey cfgKey;
+    std::vector<std::unique_ptr<LogEvent>> events;
+    vector<int> attributionUids = {111};
+    vector<string> attributionTags = {"App1"};
+    for (int i = 1; i <= 10; i++) {
+        events.push_back(CreateAcquireWakelockEvent(2 + i, attributionUids, attributionTags,
+                                                    "wl" + to_string(i)));
+    }
+
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, config, cfgKey);
+
+    const int64_t allocationCountBefore = gAllocationCount.load();
+    for (auto _ : state) {
+        for (const auto& event : events) {
+            processor->OnLogEvent(event.get());
+        }
+    }
+    reportAllocationsPerEvent(state, gAllocationCount.load() - allocationCountBefore,
+                              events.size());
+}
+BENCHMARK(BM_OnLogEventManyConditions);
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <private/android_logger.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+// Same layout as the buffers of StatsSocketListener, so that both benchmarks only differ by the
+// number of system calls made to drain the socket.
+constexpr int kMaxMessagesPerRead = 16;
+constexpr size_t kMessageBufferSize = sizeof(android_log_header_t) + LOGGER_ENTRY_MAX_PAYLOAD + 1;
+
+struct ReadBuffers {
+    ReadBuffers() {
+        for (int i = 0; i < kMaxMessagesPerRead; i++) {
+            iovs[i] = {messages[i], kMessageBufferSize - 1};
+            headers[i].msg_hdr = {
+                    NULL, 0, &iovs[i], 1, controls[i], sizeof(controls[i]), 0,
+            };
+        }
+    }
+
+    char messages[kMaxMessagesPerRead][kMessageBufferSize];
+    alignas(struct cmsghdr) char controls[kMaxMessagesPerRead][CMSG_SPACE(sizeof(struct ucred))];
+    struct iovec iovs[kMaxMessagesPerRead];
+    struct mmsghdr headers[kMaxMessagesPerRead];
+};
+
+// Writes messageCount datagrams of the size of a typical atom.
+void writeMessages(int socket, int messageCount) {
+    static const std::vector<uint8_t> message(200, 1);
+    for (int i = 0; i < messageCount; i++) {
+        send(socket, message.data(), message.size(), 0);
+    }
+}
+
+// One recvmsg call per datagram, as StatsSocketListener used to read the socket.
+int readOneByOne(int socket, ReadBuffers& buffers) {
+    int count = 0;
+    struct msghdr& hdr = buffers.headers[0].msg_hdr;
+    while (true) {
+        hdr.msg_controllen = sizeof(buffers.controls[0]);
+        if (recvmsg(socket, &hdr, MSG_DONTWAIT) <= 0) {
+            return count;
+        }
+        count++;
+    }
+}
+
+// Up to kMaxMessagesPerRead datagrams per recvmmsg call, as StatsSocketListener reads the socket.
+int readBatches(int socket, ReadBuffers& buffers) {
+    int count = 0;
+    int batchCount = 0;
+    do {
+        for (int i = 0; i < kMaxMessagesPerRead; i++) {
+            buffers.headers[i].msg_hdr.msg_controllen = sizeof(buffers.controls[i]);
+        }
+        batchCount = recvmmsg(socket, buffers.headers, kMaxMessagesPerRead, MSG_DONTWAIT, NULL);
+        count += std::max(batchCount, 0);
+    } while (batchCount == kMaxMessagesPerRead);
+    return count;
+}
+
+template <int (*read)(int, ReadBuffers&)>
+void benchmarkSocketRead(benchmark::State& state) {
+    const int messageCount = state.range(0);
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) != 0) {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    int on = 1;
+    setsockopt(fds[0], SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));
+    auto buffers = std::make_unique<ReadBuffers>();
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        writeMessages(fds[1], messageCount);
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(read(fds[0], *buffers));
+    }
+    state.SetItemsProcessed(state.iterations() * messageCount);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+}  // anonymous namespace
+
+static void BM_SocketReadOneByOne(benchmark::State& state) {
+    benchmarkSocketRead<readOneByOne>(state);
+}
+BENCHMARK(BM_SocketReadOneByOne)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+static void BM_SocketReadBatches(benchmark::State& state) {
+    benchmarkSocketRead<readBatches>(state);
+}
+BENCHMARK(BM_SocketReadBatches)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -28,7 +28,22 @@ static void BM_StatsEventObtain(benchmark::State& state) {
         AStatsEvent_release(event);
     }
 }
-BENCHMARK(BM_StatsEventObtain);
+BENCHMARK(BM_StatsEventObtain)->ThreadRange(1, 4);
+
+static void BM_StatsEventBuild(benchmark::State& state) {
+    int32_t value = 0;
+    while (state.KeepRunning()) {
+        AStatsEvent* event = AStatsEvent_obtain();
+        AStatsEvent_setAtomId(event, util::ISOLATED_UID_CHANGED);
+        AStatsEvent_writeInt32(event, 0);
+        AStatsEvent_writeInt32(event, 100);
+        AStatsEvent_writeInt32(event, value++);
+        AStatsEvent_build(event);
+        benchmark::DoNotOptimize(event);
+        AStatsEvent_release(event);
+    }
+}
+BENCHMARK(BM_StatsEventBuild)->ThreadRange(1, 4);
 
 static void BM_StatsWrite(benchmark::State& state) {
     int32_t parent_uid = 0;
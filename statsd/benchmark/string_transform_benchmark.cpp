@@ -19,10 +19,13 @@
 #include <string>
 
 #include "benchmark/benchmark.h"
+#include "matchers/matcher_util.h"
 // #include "re2/re2.h"
+#include "tests/statsd_test_util.h"
 #include "utils/Regex.h"
 
-using android::os::statsd::Regex;
+using android::sp;
+using namespace android::os::statsd;
 using namespace std;
 
 static void removeTrailingCharacters(string& str, const string& characters) {
@@ -90,6 +93,52 @@ static void BM_RemoveTrailingNumbersCRegex(benchmark::State& state) {
 }
 BENCHMARK(BM_RemoveTrailingNumbersCRegex)->RangeMultiplier(2)->RangePair(0, 20, 0, 20);
 
+// Compiles the regex for every string, as matchers did before compiling it at config load.
+static void BM_RemoveTrailingNumbersCRegexCreatePerString(benchmark::State& state) {
+    const string prefix(state.range(0), 'a' + rand() % 26);
+    const string suffix(state.range(1), '0' + rand() % 10);
+    const string input = prefix + suffix;
+    for (auto _ : state) {
+        unique_ptr<Regex> re = Regex::create(R"([0-9]+$)");
+        string str = input;
+        benchmark::DoNotOptimize(re->replace(str, ""));
+    }
+}
+BENCHMARK(BM_RemoveTrailingNumbersCRegexCreatePerString)
+        ->RangeMultiplier(2)
+        ->RangePair(0, 20, 0, 20);
+
+// Matches a lazily parsed event with a matcher removing the trailing digits of its attribution
+// tags. Transforming the tags does not decode the rest of the event.
+static void BM_StringReplaceMatcher(benchmark::State& state) {
+    const sp<UidMap> uidMap = new UidMap();
+
+    SimpleAtomMatcher matcher;
+    matcher.set_atom_id(android::util::SYNC_STATE_CHANGED);
+    FieldValueMatcher* attributionMatcher = matcher.add_field_value_matcher();
+    attributionMatcher->set_field(1);  // attribution_node
+    attributionMatcher->set_position(Position::ALL);
+    FieldValueMatcher* tagMatcher =
+            attributionMatcher->mutable_matches_tuple()->add_field_value_matcher();
+    tagMatcher->set_field(2);  // tag
+    tagMatcher->mutable_replace_string()->set_regex(R"([0-9]+$)");
+    tagMatcher->mutable_replace_string()->set_replacement("");
+    const SimpleAtomMatcherProgram program(matcher);
+
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, android::util::SYNC_STATE_CHANGED);
+    writeAttribution(statsEvent, {10001, 10002, 10003}, {"tag123", "tag456", "tag"});
+    AStatsEvent_writeString(statsEvent, string(state.range(0), 'a').c_str());
+    AStatsEvent_writeInt32(statsEvent, 1);
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    parseStatsEventToLogEventLazily(statsEvent, &event);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(program.match(uidMap, event));
+    }
+}
+BENCHMARK(BM_StringReplaceMatcher)->Arg(16)->Arg(256)->Arg(2048);
+
 // To run RE2 benchmark locally, libregex_re2 under external/regex_re2 needs to be made visible to
 // statsd_benchmark.
 // static void BM_RemoveTrailingNumbersRe2(benchmark::State& state) {
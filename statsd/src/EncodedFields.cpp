@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "EncodedFields.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::vector;
+
+namespace {
+
+// Number of fields compared at once.
+constexpr size_t kLanes = 4;
+
+static_assert(EncodedFields::kMaxFields % 64 == 0);
+
+// Returns a 4 bit mask of the fields in fields[0..3] for which (field & mask) == target or
+// (field & allMask) == target.
+inline uint64_t matchLanes(const int32_t* fields, int32_t mask, int32_t allMask, int32_t target) {
+#if defined(__SSE2__)
+    const __m128i f = _mm_load_si128(reinterpret_cast<const __m128i*>(fields));
+    const __m128i t = _mm_set1_epi32(target);
+    const __m128i eq = _mm_or_si128(_mm_cmpeq_epi32(_mm_and_si128(f, _mm_set1_epi32(mask)), t),
+                                    _mm_cmpeq_epi32(_mm_and_si128(f, _mm_set1_epi32(allMask)), t));
+    return _mm_movemask_ps(_mm_castsi128_ps(eq));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const int32x4_t f = vld1q_s32(fields);
+    const int32x4_t t = vdupq_n_s32(target);
+    const uint32x4_t eq = vorrq_u32(vceqq_s32(vandq_s32(f, vdupq_n_s32(mask)), t),
+                                    vceqq_s32(vandq_s32(f, vdupq_n_s32(allMask)), t));
+    const uint32x4_t laneBits = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(eq, laneBits));
+#else
+    uint64_t bits = 0;
+    for (size_t i = 0; i < kLanes; i++) {
+        if ((fields[i] & mask) == target || (fields[i] & allMask) == target) {
+            bits |= 1ULL << i;
+        }
+    }
+    return bits;
+#endif
+}
+
+}  // anonymous namespace
+
+bool EncodedFields::init(const vector<FieldValue>& values) {
+    if (values.empty() || values.size() > kMaxFields) {
+        return false;
+    }
+    mTag = values[0].mField.getTag();
+    for (size_t i = 0; i < values.size(); i++) {
+        if (values[i].mField.getTag() != mTag) {
+            return false;
+        }
+        mFields[i] = values[i].mField.getField();
+    }
+    mSize = values.size();
+    const size_t paddedSize = (mSize + kLanes - 1) / kLanes * kLanes;
+    for (size_t i = mSize; i < paddedSize; i++) {
+        mFields[i] = 0;
+    }
+    return true;
+}
+
+void EncodedFields::match(const Matcher& matcher, uint64_t* bitmap) const {
+    memset(bitmap, 0, kBitmapWords * sizeof(uint64_t));
+    if (matcher.mMatcher.getTag() != mTag) {
+        return;
+    }
+
+    // See Field::matches(). Without an ALL position, the second comparison repeats the first.
+    const int32_t mask = matcher.mMask;
+    const int32_t allMask =
+            matcher.hasAllPositionMatcher() ? mask & kClearAllPositionMatcherMask : mask;
+    const int32_t target = matcher.mMatcher.getField();
+    for (size_t i = 0; i < mSize; i += kLanes) {
+        bitmap[i / 64] |= matchLanes(&mFields[i], mask, allMask, target) << (i % 64);
+    }
+    if (mSize % 64 != 0) {
+        bitmap[mSize / 64] &= (1ULL << (mSize % 64)) - 1;
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "FieldValue.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Struct-of-arrays view of the encoded fields of a vector<FieldValue> sharing one atom tag, as
+ * the values of a LogEvent do.
+ *
+ * The fields are stored contiguously so that a Matcher is evaluated against all of them at
+ * once with SIMD instructions (SSE2 on x86, NEON on arm64, scalar code elsewhere), producing a
+ * bitmap of the matching values. Matching many Matchers against the same values then costs
+ * about one vector compare per Matcher and per 4 values, instead of a Field::matches() call per
+ * pair.
+ */
+class EncodedFields {
+public:
+    // Largest number of values that can be viewed.
+    static constexpr size_t kMaxFields = 256;
+
+    // Number of 64 bit words of a bitmap of kMaxFields values.
+    static constexpr size_t kBitmapWords = kMaxFields / 64;
+
+    EncodedFields() : mSize(0), mTag(0) {
+    }
+
+    /**
+     * Copies the fields of the values. Returns false if the values cannot be viewed, because
+     * there are none, more than kMaxFields, or more than one tag. Callers then fall back to
+     * Field::matches().
+     */
+    bool init(const std::vector<FieldValue>& values);
+
+    /**
+     * Sets bit i of bitmap, which has kBitmapWords words, if field i matches the matcher the same
+     * way Field::matches() does. Other bits are cleared.
+     */
+    void match(const Matcher& matcher, uint64_t* bitmap) const;
+
+    inline size_t size() const {
+        return mSize;
+    }
+
+    inline size_t getBitmapWordCount() const {
+        return (mSize + 63) / 64;
+    }
+
+private:
+    // Padded to a whole number of vectors. Padding lanes are cleared from the bitmaps.
+    alignas(16) int32_t mFields[kMaxFields];
+    size_t mSize;
+    int32_t mTag;
+};
+
+/**
+ * Returns true if matching the given numbers of matchers and values is likely cheaper through
+ * EncodedFields than with Field::matches(). Copying the fields does not pay off for few pairs.
+ */
+inline bool shouldUseEncodedFields(size_t matcherCount, size_t valueCount) {
+    return matcherCount * valueCount >= 16 && valueCount <= EncodedFields::kMaxFields;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
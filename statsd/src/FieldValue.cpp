@@ -23,6 +23,10 @@
 #include "hash.h"
 #include "math.h"
 
+#include <string.h>
+
+#include <new>
+
 namespace android {
 namespace os {
 namespace statsd {
@@ -155,32 +159,57 @@ bool isPrimitiveRepeatedField(const Field& field) {
     return field.getDepth() == 1;
 }
 
-Value::Value(const Value& from) {
-    type = from.getType();
-    switch (type) {
-        case INT:
-            int_value = from.int_value;
-            break;
-        case LONG:
-            long_value = from.long_value;
-            break;
-        case FLOAT:
-            float_value = from.float_value;
-            break;
-        case DOUBLE:
-            double_value = from.double_value;
-            break;
-        case STRING:
-            str_value = from.str_value;
-            break;
-        case STORAGE:
-            storage_value = from.storage_value;
-            break;
-        default:
-            break;
+Value::Value(const Value& from) : type(from.type) {
+    copyBytesFrom(from);
+}
+
+Value::Value(Value&& from) noexcept : type(from.type) {
+    // Steals the shared buffer, if any.
+    memcpy(mInlineBytes, from.mInlineBytes, sizeof(mInlineBytes));
+    mSize = from.mSize;
+    from.type = UNKNOWN;
+    from.mSize = 0;
+}
+
+void Value::copyBytesFrom(const Value& from) {
+    // The union only holds trivially copyable data.
+    memcpy(mInlineBytes, from.mInlineBytes, sizeof(mInlineBytes));
+    mSize = from.mSize;
+    if (hasSharedBytes()) {
+        mSharedBytes->refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Value::releaseSharedBytes() {
+    if (mSharedBytes->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        mSharedBytes->~SharedBytes();
+        ::operator delete(mSharedBytes);
     }
 }
 
+void Value::setString(std::string_view v) {
+    assignBytes(STRING, v.data(), v.size());
+}
+
+void Value::setStorage(const uint8_t* data, size_t size) {
+    assignBytes(STORAGE, reinterpret_cast<const char*>(data), size);
+}
+
+void Value::assignBytes(Type newType, const char* data, size_t size) {
+    // data may point into the current contents, which are released once copied.
+    Value previous(std::move(*this));
+    type = newType;
+    mSize = size;
+    char* bytes = mInlineBytes;
+    if (hasSharedBytes()) {
+        void* buffer = ::operator new(sizeof(SharedBytes) + size + 1);
+        mSharedBytes = new (buffer) SharedBytes{{1}};
+        bytes = mSharedBytes->data();
+    }
+    memmove(bytes, data, size);
+    bytes[size] = '\0';
+}
+
 std::string Value::toString() const {
     switch (type) {
         case INT:
@@ -192,9 +221,9 @@ std::string Value::toString() const {
         case DOUBLE:
             return std::to_string(double_value) + "[D]";
         case STRING:
-            return str_value + "[S]";
+            return std::string(getString()) + "[S]";
         case STORAGE:
-            return "bytes of size " + std::to_string(storage_value.size()) + "[ST]";
+            return "bytes of size " + std::to_string(mSize) + "[ST]";
         default:
             return "[UNKNOWN]";
     }
@@ -211,9 +240,8 @@ bool Value::isZero() const {
         case DOUBLE:
             return fabs(double_value) <= std::numeric_limits<double>::epsilon();
         case STRING:
-            return str_value.size() == 0;
         case STORAGE:
-            return storage_value.size() == 0;
+            return mSize == 0;
         default:
             return false;
     }
@@ -232,9 +260,8 @@ bool Value::operator==(const Value& that) const {
         case DOUBLE:
             return double_value == that.double_value;
         case STRING:
-            return str_value == that.str_value;
         case STORAGE:
-            return storage_value == that.storage_value;
+            return getString() == that.getString();
         default:
             return false;
     }
@@ -252,9 +279,8 @@ bool Value::operator!=(const Value& that) const {
         case DOUBLE:
             return double_value != that.double_value;
         case STRING:
-            return str_value != that.str_value;
         case STORAGE:
-            return storage_value != that.storage_value;
+            return getString() != that.getString();
         default:
             return false;
     }
@@ -273,9 +299,8 @@ bool Value::operator<(const Value& that) const {
         case DOUBLE:
             return double_value < that.double_value;
         case STRING:
-            return str_value < that.str_value;
         case STORAGE:
-            return storage_value < that.storage_value;
+            return getString() < that.getString();
         default:
             return false;
     }
@@ -294,9 +319,8 @@ bool Value::operator>(const Value& that) const {
         case DOUBLE:
             return double_value > that.double_value;
         case STRING:
-            return str_value > that.str_value;
         case STORAGE:
-            return storage_value > that.storage_value;
+            return getString() > that.getString();
         default:
             return false;
     }
@@ -315,9 +339,8 @@ bool Value::operator>=(const Value& that) const {
         case DOUBLE:
             return double_value >= that.double_value;
         case STRING:
-            return str_value >= that.str_value;
         case STORAGE:
-            return storage_value >= that.storage_value;
+            return getString() >= that.getString();
         default:
             return false;
     }
@@ -360,29 +383,21 @@ Value Value::operator-(const Value& that) const {
 
 Value& Value::operator=(const Value& that) {
     if (this != &that) {
+        releaseBytes();
         type = that.type;
-        switch (type) {
-            case INT:
-                int_value = that.int_value;
-                break;
-            case LONG:
-                long_value = that.long_value;
-                break;
-            case FLOAT:
-                float_value = that.float_value;
-                break;
-            case DOUBLE:
-                double_value = that.double_value;
-                break;
-            case STRING:
-                str_value = that.str_value;
-                break;
-            case STORAGE:
-                storage_value = that.storage_value;
-                break;
-            default:
-                break;
-        }
+        copyBytesFrom(that);
+    }
+    return *this;
+}
+
+Value& Value::operator=(Value&& that) noexcept {
+    if (this != &that) {
+        releaseBytes();
+        type = that.type;
+        memcpy(mInlineBytes, that.mInlineBytes, sizeof(mInlineBytes));
+        mSize = that.mSize;
+        that.type = UNKNOWN;
+        that.mSize = 0;
     }
     return *this;
 }
@@ -451,10 +466,8 @@ size_t Value::getSize() const {
             size = sizeof(double);
             break;
         case STRING:
-            size = sizeof(char) * str_value.length();
-            break;
         case STORAGE:
-            size = sizeof(uint8_t) * storage_value.size();
+            size = mSize;
             break;
         default:
             break;
@@ -598,12 +611,11 @@ bool shouldKeepSample(const FieldValue& sampleFieldValue, int shardOffset, int s
                                sizeof(sampleFieldValue.mValue.double_value));
             break;
         case STRING:
-            hashValue = Hash32(sampleFieldValue.mValue.str_value);
-            break;
-        case STORAGE:
-            hashValue = Hash32((const char*)sampleFieldValue.mValue.storage_value.data(),
-                               sampleFieldValue.mValue.storage_value.size());
+        case STORAGE: {
+            const std::string_view bytes = sampleFieldValue.mValue.getString();
+            hashValue = Hash32(bytes.data(), bytes.size());
             break;
+        }
         default:
             return true;
     }
@@ -15,6 +15,11 @@
  */
 #pragma once
 
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include "src/statsd_config.pb.h"
 
 namespace android {
@@ -278,6 +283,9 @@ inline Matcher getFirstUidMatcher(int32_t atomId) {
 /**
  * A wrapper for a union type to contain multiple types of values.
  *
+ * STRING and STORAGE contents of up to kMaxInlineBytes bytes are stored inline. Longer contents
+ * are stored in an immutable heap buffer shared by all copies of the value, so that copying a
+ * Value never copies bytes.
  */
 struct Value {
     Value() : type(UNKNOWN) {}
@@ -302,44 +310,94 @@ struct Value {
         type = DOUBLE;
     }
 
-    Value(const std::string& v) {
-        str_value = v;
-        type = STRING;
+    Value(std::string_view v) : type(UNKNOWN) {
+        setString(v);
+    }
+
+    Value(const std::vector<uint8_t>& v) : type(UNKNOWN) {
+        setStorage(v.data(), v.size());
     }
 
-    Value(const std::vector<uint8_t>& v) {
-        storage_value = v;
-        type = STORAGE;
+    ~Value() {
+        releaseBytes();
     }
 
     void setInt(int32_t v) {
+        releaseBytes();
         int_value = v;
         type = INT;
     }
 
     void setLong(int64_t v) {
+        releaseBytes();
         long_value = v;
         type = LONG;
     }
 
     void setFloat(float v) {
+        releaseBytes();
         float_value = v;
         type = FLOAT;
     }
 
     void setDouble(double v) {
+        releaseBytes();
         double_value = v;
         type = DOUBLE;
     }
 
+    void setString(std::string_view v);
+
+    void setStorage(const uint8_t* data, size_t size);
+
+    // Contents of a STRING value.
+    std::string_view getString() const {
+        return std::string_view(getBytes(), mSize);
+    }
+
+    // Contents of a STRING value, null terminated.
+    const char* getCString() const {
+        return getBytes();
+    }
+
+    // Contents of a STORAGE value.
+    const uint8_t* getStorageData() const {
+        return reinterpret_cast<const uint8_t*>(getBytes());
+    }
+
+    size_t getStorageSize() const {
+        return mSize;
+    }
+
+    std::vector<uint8_t> getStorage() const {
+        return std::vector<uint8_t>(getStorageData(), getStorageData() + mSize);
+    }
+
+    static constexpr size_t kMaxInlineBytes = 15;
+
+    // Heap buffer of STRING and STORAGE contents longer than kMaxInlineBytes.
+    struct SharedBytes {
+        std::atomic<int32_t> refCount;
+
+        // The contents follow the header.
+        char* data() {
+            return reinterpret_cast<char*>(this + 1);
+        }
+    };
+
     union {
         int32_t int_value;
         int64_t long_value;
         float float_value;
         double double_value;
+
+        // STRING and STORAGE contents, followed by a null character. Use the accessors above.
+        char mInlineBytes[kMaxInlineBytes + 1];
+        SharedBytes* mSharedBytes;
     };
-    std::string str_value;
-    std::vector<uint8_t> storage_value;
+
+    // Size of the STRING or STORAGE contents.
+    uint32_t mSize = 0;
 
     Type type;
 
@@ -356,6 +414,7 @@ struct Value {
     size_t getSize() const;
 
     Value(const Value& from);
+    Value(Value&& from) noexcept;
 
     bool operator==(const Value& that) const;
     bool operator!=(const Value& that) const;
@@ -366,6 +425,31 @@ struct Value {
     Value operator-(const Value& that) const;
     Value& operator+=(const Value& that);
     Value& operator=(const Value& that);
+    Value& operator=(Value&& that) noexcept;
+
+private:
+    inline bool hasSharedBytes() const {
+        return (type == STRING || type == STORAGE) && mSize > kMaxInlineBytes;
+    }
+
+    inline const char* getBytes() const {
+        return hasSharedBytes() ? mSharedBytes->data() : mInlineBytes;
+    }
+
+    // Drops the reference to the shared buffer, if any.
+    inline void releaseBytes() {
+        if (hasSharedBytes()) {
+            releaseSharedBytes();
+        }
+        mSize = 0;
+    }
+
+    void releaseSharedBytes();
+
+    // Copies the union and the size, taking a reference to the shared buffer, if any.
+    void copyBytesFrom(const Value& from);
+
+    void assignBytes(Type newType, const char* data, size_t size);
 };
 
 class Annotations {
@@ -426,6 +510,8 @@ struct FieldValue {
     FieldValue() {}
     FieldValue(const Field& field, const Value& value) : mField(field), mValue(value) {
     }
+    FieldValue(const Field& field, Value&& value) : mField(field), mValue(std::move(value)) {
+    }
     bool operator==(const FieldValue& that) const {
         return mField == that.mField && mValue == that.mValue;
     }
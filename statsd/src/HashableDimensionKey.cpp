@@ -17,6 +17,7 @@
 #include "Log.h"
 
 #include "HashableDimensionKey.h"
+#include "EncodedFields.h"
 #include "FieldValue.h"
 
 namespace android {
@@ -70,7 +71,7 @@ static void populateStatsDimensionsValueParcelChildren(StatsDimensionsValueParce
                     break;
                 case STRING:
                     child.valueType = STATS_DIMENSIONS_VALUE_STRING_TYPE;
-                    child.stringValue = dim.mValue.str_value;
+                    child.stringValue = dim.mValue.getString();
                     break;
                 default:
                     ALOGE("Encountered FieldValue with unsupported value type.");
@@ -95,25 +96,49 @@ static void populateStatsDimensionsValueParcelChildren(StatsDimensionsValueParce
 
 StatsDimensionsValueParcel HashableDimensionKey::toStatsDimensionsValueParcel() const {
     StatsDimensionsValueParcel root;
-    if (mValues.size() == 0) {
+    if (getValues().size() == 0) {
         return root;
     }
 
-    root.field = mValues[0].mField.getTag();
+    root.field = getValues()[0].mField.getTag();
     root.valueType = STATS_DIMENSIONS_VALUE_TUPLE_TYPE;
 
     // Children of the root correspond to top-level (depth = 0) FieldValues.
     int childDepth = 0;
     int childPrefix = 0;
     size_t index = 0;
-    populateStatsDimensionsValueParcelChildren(root, childDepth, childPrefix, mValues, index);
+    populateStatsDimensionsValueParcelChildren(root, childDepth, childPrefix, getValues(),
+                                               index);
 
     return root;
 }
 
-android::hash_t hashDimension(const HashableDimensionKey& value) {
+const vector<FieldValue> HashableDimensionKey::kEmptyValues;
+
+HashableDimensionKey::HashableDimensionKey(const vector<FieldValue>& values) {
+    if (!values.empty()) {
+        mData = std::make_shared<Data>();
+        mData->values = values;
+    }
+}
+
+HashableDimensionKey::Data* HashableDimensionKey::mutableData() {
+    if (mData == nullptr) {
+        mData = std::make_shared<Data>();
+    } else if (mData.use_count() > 1) {
+        // Other copies only read the values, leave them untouched.
+        std::shared_ptr<Data> data = std::make_shared<Data>();
+        data->values = mData->values;
+        mData = std::move(data);
+    } else {
+        mData->hash.store(0, std::memory_order_relaxed);
+    }
+    return mData.get();
+}
+
+static android::hash_t computeHash(const vector<FieldValue>& values) {
     android::hash_t hash = 0;
-    for (const auto& fieldValue : value.getValues()) {
+    for (const auto& fieldValue : values) {
         hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getField()));
         hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getTag()));
         hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mValue.getType()));
@@ -127,8 +152,9 @@ android::hash_t hashDimension(const HashableDimensionKey& value) {
                                                android::hash_type(fieldValue.mValue.long_value));
                 break;
             case STRING:
-                hash = android::JenkinsHashMix(hash, static_cast<uint32_t>(std::hash<std::string>()(
-                                                             fieldValue.mValue.str_value)));
+                hash = android::JenkinsHashMix(
+                        hash, static_cast<uint32_t>(std::hash<std::string_view>()(
+                                      fieldValue.mValue.getString())));
                 break;
             case FLOAT: {
                 hash = android::JenkinsHashMix(hash,
@@ -141,8 +167,8 @@ android::hash_t hashDimension(const HashableDimensionKey& value) {
                 break;
             }
             case STORAGE: {
-                hash = android::JenkinsHashMixBytes(hash, fieldValue.mValue.storage_value.data(),
-                                                    fieldValue.mValue.storage_value.size());
+                hash = android::JenkinsHashMixBytes(hash, fieldValue.mValue.getStorageData(),
+                                                    fieldValue.mValue.getStorageSize());
                 break;
             }
             default:
@@ -152,6 +178,23 @@ android::hash_t hashDimension(const HashableDimensionKey& value) {
     return JenkinsHashWhiten(hash);
 }
 
+android::hash_t HashableDimensionKey::getHash() const {
+    if (mData == nullptr) {
+        return computeHash(kEmptyValues);
+    }
+    // Racing readers compute the same hash.
+    uint64_t hash = mData->hash.load(std::memory_order_relaxed);
+    if (hash == 0) {
+        hash = kHashComputed | computeHash(mData->values);
+        mData->hash.store(hash, std::memory_order_relaxed);
+    }
+    return static_cast<android::hash_t>(hash);
+}
+
+android::hash_t hashDimension(const HashableDimensionKey& value) {
+    return value.getHash();
+}
+
 bool filterValues(const Matcher& matcherField, const vector<FieldValue>& values,
                   FieldValue* output) {
     if (matcherField.hasAllPositionMatcher()) {
@@ -166,21 +209,60 @@ bool filterValues(const Matcher& matcherField, const vector<FieldValue>& values,
     return false;
 }
 
-bool filterValues(const vector<Matcher>& matcherFields, const vector<FieldValue>& values,
-                  HashableDimensionKey* output) {
-    size_t num_matches = 0;
-    for (const auto& value : values) {
-        for (size_t i = 0; i < matcherFields.size(); ++i) {
-            const auto& matcher = matcherFields[i];
-            if (value.mField.matches(matcher)) {
-                output->addValue(value);
-                output->mutableValue(num_matches)->mField.setTag(value.mField.getTag());
-                output->mutableValue(num_matches)->mField.setField(
-                    value.mField.getField() & matcher.mMask);
-                num_matches++;
+// Largest number of matchers matched through EncodedFields at once.
+static constexpr size_t kMaxEncodedFieldsMatchers = 16;
+
+/**
+ * Calls onMatch(valueIndex, matcherIndex) for every value matching a matcher, ordered by value
+ * and then by matcher.
+ */
+template <typename OnMatch>
+static void forEachMatch(const vector<Matcher>& matchers, const vector<FieldValue>& values,
+                         OnMatch&& onMatch) {
+    EncodedFields fields;
+    if (matchers.size() <= kMaxEncodedFieldsMatchers &&
+        shouldUseEncodedFields(matchers.size(), values.size()) && fields.init(values)) {
+        uint64_t bitmaps[kMaxEncodedFieldsMatchers][EncodedFields::kBitmapWords];
+        uint64_t matched[EncodedFields::kBitmapWords] = {};
+        for (size_t j = 0; j < matchers.size(); j++) {
+            fields.match(matchers[j], bitmaps[j]);
+            for (size_t w = 0; w < EncodedFields::kBitmapWords; w++) {
+                matched[w] |= bitmaps[j][w];
             }
         }
+        for (size_t w = 0; w < fields.getBitmapWordCount(); w++) {
+            for (uint64_t bits = matched[w]; bits != 0; bits &= bits - 1) {
+                const size_t bit = __builtin_ctzll(bits);
+                for (size_t j = 0; j < matchers.size(); j++) {
+                    if ((bitmaps[j][w] >> bit) & 1) {
+                        onMatch(w * 64 + bit, j);
+                    }
+                }
+            }
+        }
+        return;
     }
+
+    for (size_t i = 0; i < values.size(); i++) {
+        for (size_t j = 0; j < matchers.size(); j++) {
+            if (values[i].mField.matches(matchers[j])) {
+                onMatch(i, j);
+            }
+        }
+    }
+}
+
+bool filterValues(const vector<Matcher>& matcherFields, const vector<FieldValue>& values,
+                  HashableDimensionKey* output) {
+    size_t num_matches = 0;
+    forEachMatch(matcherFields, values, [&](size_t valueIndex, size_t matcherIndex) {
+        const FieldValue& value = values[valueIndex];
+        output->addValue(value);
+        output->mutableValue(num_matches)->mField.setTag(value.mField.getTag());
+        output->mutableValue(num_matches)
+                ->mField.setField(value.mField.getField() & matcherFields[matcherIndex].mMask);
+        num_matches++;
+    });
     return num_matches > 0;
 }
 
@@ -189,24 +271,21 @@ bool filterValues(const vector<Matcher>& dimKeyMatcherFields,
                   HashableDimensionKey& key, vector<int>& valueIndices) {
     size_t key_num_matches = 0;
     size_t value_num_matches = 0;
-    for (size_t i = 0; i < values.size(); ++i) {
-        const FieldValue& value = values[i];
-        for (const auto& matcher : dimKeyMatcherFields) {
-            if (value.mField.matches(matcher)) {
-                key.addValue(value);
-                key.mutableValue(key_num_matches)->mField.setTag(value.mField.getTag());
-                key.mutableValue(key_num_matches)
-                        ->mField.setField(value.mField.getField() & matcher.mMask);
-                key_num_matches++;
-            }
-        }
-        for (size_t j = 0; j < valueMatcherFields.size(); ++j) {
-            if (valueIndices[j] == -1 && value.mField.matches(valueMatcherFields[j])) {
-                valueIndices[j] = i;
-                value_num_matches++;
-            }
+    forEachMatch(dimKeyMatcherFields, values, [&](size_t valueIndex, size_t matcherIndex) {
+        const FieldValue& value = values[valueIndex];
+        key.addValue(value);
+        key.mutableValue(key_num_matches)->mField.setTag(value.mField.getTag());
+        key.mutableValue(key_num_matches)
+                ->mField.setField(value.mField.getField() &
+                                  dimKeyMatcherFields[matcherIndex].mMask);
+        key_num_matches++;
+    });
+    forEachMatch(valueMatcherFields, values, [&](size_t valueIndex, size_t matcherIndex) {
+        if (valueIndices[matcherIndex] == -1) {
+            valueIndices[matcherIndex] = valueIndex;
+            value_num_matches++;
         }
-    }
+    });
     return value_num_matches == valueMatcherFields.size();
 }
 
@@ -229,6 +308,20 @@ bool filterPrimaryKey(const std::vector<FieldValue>& values, HashableDimensionKe
 
 void filterGaugeValues(const std::vector<Matcher>& matcherFields,
                        const std::vector<FieldValue>& values, std::vector<FieldValue>* output) {
+    EncodedFields fields;
+    if (shouldUseEncodedFields(matcherFields.size(), values.size()) && fields.init(values)) {
+        uint64_t bitmap[EncodedFields::kBitmapWords];
+        for (const auto& field : matcherFields) {
+            fields.match(field, bitmap);
+            for (size_t w = 0; w < fields.getBitmapWordCount(); w++) {
+                for (uint64_t bits = bitmap[w]; bits != 0; bits &= bits - 1) {
+                    output->push_back(values[w * 64 + __builtin_ctzll(bits)]);
+                }
+            }
+        }
+        return;
+    }
+
     for (const auto& field : matcherFields) {
         for (const auto& value : values) {
             if (value.mField.matches(field)) {
@@ -337,8 +430,17 @@ bool HashableDimensionKey::operator!=(const HashableDimensionKey& that) const {
 }
 
 bool HashableDimensionKey::operator==(const HashableDimensionKey& that) const {
+    if (mData == that.mData) {
+        return true;
+    }
+    const uint64_t hash = mData != nullptr ? mData->hash.load(std::memory_order_relaxed) : 0;
+    const uint64_t thatHash =
+            that.mData != nullptr ? that.mData->hash.load(std::memory_order_relaxed) : 0;
+    if (hash != 0 && thatHash != 0 && hash != thatHash) {
+        return false;
+    }
     // according to http://go/cppref/cpp/container/vector/operator_cmp
-    return mValues == that.mValues;
+    return getValues() == that.getValues();
 };
 
 bool HashableDimensionKey::operator<(const HashableDimensionKey& that) const {
@@ -346,17 +448,17 @@ bool HashableDimensionKey::operator<(const HashableDimensionKey& that) const {
 };
 
 bool HashableDimensionKey::contains(const HashableDimensionKey& that) const {
-    if (mValues.size() < that.getValues().size()) {
+    if (getValues().size() < that.getValues().size()) {
         return false;
     }
 
-    if (mValues.size() == that.getValues().size()) {
+    if (getValues().size() == that.getValues().size()) {
         return (*this) == that;
     }
 
     for (const auto& value : that.getValues()) {
         bool found = false;
-        for (const auto& myValue : mValues) {
+        for (const auto& myValue : getValues()) {
             if (value.mField == myValue.mField && value.mValue == myValue.mValue) {
                 found = true;
                 break;
@@ -372,13 +474,47 @@ bool HashableDimensionKey::contains(const HashableDimensionKey& that) const {
 
 string HashableDimensionKey::toString() const {
     std::string output;
-    for (const auto& value : mValues) {
+    for (const auto& value : getValues()) {
         output += StringPrintf("(%d)%#x->%s ", value.mField.getTag(), value.mField.getField(),
                                value.mValue.toString().c_str());
     }
     return output;
 }
 
+HashableDimensionKey HashableDimensionKeyPool::intern(const HashableDimensionKey& key) {
+    if (key.mData == nullptr) {
+        return key;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto [it, inserted] = mKeys.insert(key);
+    if (inserted && mKeys.size() >= 2 * mSizeAfterPrune + 64) {
+        pruneLocked();
+    }
+    return *it;
+}
+
+void HashableDimensionKeyPool::prune() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    pruneLocked();
+}
+
+void HashableDimensionKeyPool::pruneLocked() {
+    for (auto it = mKeys.begin(); it != mKeys.end();) {
+        // Keys of the pool are only copied under mMutex, so the count cannot go up concurrently.
+        if (it->mData.use_count() == 1) {
+            it = mKeys.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    mSizeAfterPrune = mKeys.size();
+}
+
+size_t HashableDimensionKeyPool::size() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mKeys.size();
+}
+
 bool MetricDimensionKey::operator==(const MetricDimensionKey& that) const {
     return mDimensionKeyInWhat == that.getDimensionKeyInWhat() &&
            mStateValuesKey == that.getStateValuesKey();
@@ -18,7 +18,13 @@
 
 #include <aidl/android/os/StatsDimensionsValueParcel.h>
 #include <utils/JenkinsHash.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
 #include <vector>
+
 #include "android-base/stringprintf.h"
 #include "FieldValue.h"
 #include "logd/LogEvent.h"
@@ -50,35 +56,39 @@ struct Metric2State {
     std::vector<Matcher> stateFields;
 };
 
+/**
+ * The field values of a dimension.
+ *
+ * Copies of a key share their values, which are only copied when one of the copies is modified.
+ * The hash of the values is computed once and cached until then.
+ */
 class HashableDimensionKey {
 public:
-    explicit HashableDimensionKey(const std::vector<FieldValue>& values) {
-        mValues = values;
-    }
+    explicit HashableDimensionKey(const std::vector<FieldValue>& values);
 
     HashableDimensionKey() {};
 
-    HashableDimensionKey(const HashableDimensionKey& that) : mValues(that.getValues()){};
-
     inline void addValue(const FieldValue& value) {
-        mValues.push_back(value);
+        mutableData()->values.push_back(value);
     }
 
     inline const std::vector<FieldValue>& getValues() const {
-        return mValues;
+        return mData != nullptr ? mData->values : kEmptyValues;
     }
 
     inline std::vector<FieldValue>* mutableValues() {
-        return &mValues;
+        return &mutableData()->values;
     }
 
     inline FieldValue* mutableValue(size_t i) {
-        if (i >= 0 && i < mValues.size()) {
-            return &(mValues[i]);
+        if (i < getValues().size()) {
+            return &(mutableData()->values[i]);
         }
         return nullptr;
     }
 
+    android::hash_t getHash() const;
+
     StatsDimensionsValueParcel toStatsDimensionsValueParcel() const;
 
     std::string toString() const;
@@ -91,8 +101,66 @@ public:
 
     bool contains(const HashableDimensionKey& that) const;
 
+    // Returns true if both keys share the same values.
+    inline bool sharesValuesWith(const HashableDimensionKey& that) const {
+        return mData == that.mData;
+    }
+
+private:
+    struct Data {
+        std::vector<FieldValue> values;
+
+        // kHashComputed | hash once the hash is computed, 0 before.
+        mutable std::atomic<uint64_t> hash{0};
+    };
+
+    static constexpr uint64_t kHashComputed = 1ULL << 32;
+
+    static const std::vector<FieldValue> kEmptyValues;
+
+    // Returns values owned by this key only, dropping the cached hash.
+    Data* mutableData();
+
+    // Null for a key without values.
+    std::shared_ptr<Data> mData;
+
+    friend class HashableDimensionKeyPool;
+};
+
+/**
+ * Holds one copy of each distinct dimension key, so that the keys held by the metrics of a config
+ * share their values and cached hash. Thread-safe.
+ */
+class HashableDimensionKeyPool {
+public:
+    /**
+     * Returns the key of the pool equal to the given key, adding the key to the pool if there is
+     * none.
+     */
+    HashableDimensionKey intern(const HashableDimensionKey& key);
+
+    /**
+     * Drops the keys that are not held outside of the pool anymore.
+     */
+    void prune();
+
+    size_t size() const;
+
 private:
-    std::vector<FieldValue> mValues;
+    struct KeyHash {
+        size_t operator()(const HashableDimensionKey& key) const {
+            return key.getHash();
+        }
+    };
+
+    void pruneLocked();
+
+    mutable std::mutex mMutex;
+
+    std::unordered_set<HashableDimensionKey, KeyHash> mKeys;
+
+    // Pool size after the last prune. The pool is pruned when it doubles.
+    size_t mSizeAfterPrune = 0;
 };
 
 class MetricDimensionKey {
@@ -274,15 +342,15 @@ bool linked(const std::vector<Metric2State>& stateLinks, const int32_t stateAtom
 template <>
 struct std::hash<android::os::statsd::HashableDimensionKey> {
     std::size_t operator()(const android::os::statsd::HashableDimensionKey& key) const {
-        return hashDimension(key);
+        return key.getHash();
     }
 };
 
 template <>
 struct std::hash<android::os::statsd::MetricDimensionKey> {
     std::size_t operator()(const android::os::statsd::MetricDimensionKey& key) const {
-        android::hash_t hash = hashDimension(key.getDimensionKeyInWhat());
-        hash = android::JenkinsHashMix(hash, hashDimension(key.getStateValuesKey()));
+        android::hash_t hash = key.getDimensionKeyInWhat().getHash();
+        hash = android::JenkinsHashMix(hash, key.getStateValuesKey().getHash());
         return android::JenkinsHashWhiten(hash);
     }
 };
@@ -290,7 +358,7 @@ struct std::hash<android::os::statsd::MetricDimensionKey> {
 template <>
 struct std::hash<android::os::statsd::AtomDimensionKey> {
     std::size_t operator()(const android::os::statsd::AtomDimensionKey& key) const {
-        android::hash_t hash = hashDimension(key.getAtomFieldValues());
+        android::hash_t hash = key.getAtomFieldValues().getHash();
         hash = android::JenkinsHashMix(hash, key.getAtomTag());
         return android::JenkinsHashWhiten(hash);
     }
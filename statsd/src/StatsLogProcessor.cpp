@@ -153,7 +153,8 @@ void StatsLogProcessor::onPeriodicAlarmFired(
 
 void StatsLogProcessor::mapIsolatedUidToHostUidIfNecessaryLocked(LogEvent* event) const {
     if (std::pair<size_t, size_t> indexRange; event->hasAttributionChain(&indexRange)) {
-        vector<FieldValue>* const fieldValues = event->getMutableValues();
+        // Only uids are modified, no need to decode lazily parsed strings.
+        vector<FieldValue>* const fieldValues = event->getMutableLazyValues();
         for (size_t i = indexRange.first; i <= indexRange.second; i++) {
             FieldValue& fieldValue = fieldValues->at(i);
             if (isAttributionUidField(fieldValue)) {
@@ -397,6 +398,39 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event) {
 void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
     std::lock_guard<std::mutex> lock(mMetricsMutex);
 
+    if (!preprocessLogEventLocked(event)) {
+        return;
+    }
+    onPeriodicHousekeepingLocked(elapsedRealtimeNs);
+    dispatchLogEventLocked(event, elapsedRealtimeNs);
+}
+
+void StatsLogProcessor::OnLogEvents(const std::vector<std::unique_ptr<LogEvent>>& events) {
+    ATRACE_CALL();
+    OnLogEvents(events, getElapsedRealtimeNs());
+}
+
+void StatsLogProcessor::OnLogEvents(const std::vector<std::unique_ptr<LogEvent>>& events,
+                                    int64_t elapsedRealtimeNs) {
+    std::lock_guard<std::mutex> lock(mMetricsMutex);
+
+    // The housekeeping only depends on the current time, so it is done once for the whole batch,
+    // right before the first event that reaches the metrics managers. For a batch of one event
+    // this is identical to OnLogEvent().
+    bool housekeepingDone = false;
+    for (const std::unique_ptr<LogEvent>& event : events) {
+        if (!preprocessLogEventLocked(event.get())) {
+            continue;
+        }
+        if (!housekeepingDone) {
+            onPeriodicHousekeepingLocked(elapsedRealtimeNs);
+            housekeepingDone = true;
+        }
+        dispatchLogEventLocked(event.get(), elapsedRealtimeNs);
+    }
+}
+
+bool StatsLogProcessor::preprocessLogEventLocked(LogEvent* event) {
     // Tell StatsdStats about new event
     const int64_t eventElapsedTimeNs = event->GetElapsedTimestampNs();
     const int atomId = event->GetTagId();
@@ -404,7 +438,7 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
                                               event->isParsedHeaderOnly());
     if (!event->isValid()) {
         StatsdStats::getInstance().noteAtomError(atomId);
-        return;
+        return false;
     }
 
     // Hard-coded logic to update train info on disk and fill in any information
@@ -435,10 +469,10 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
 
     StateManager::getInstance().onLogEvent(*event);
 
-    if (mMetricsManagers.empty()) {
-        return;
-    }
+    return !mMetricsManagers.empty();
+}
 
+void StatsLogProcessor::onPeriodicHousekeepingLocked(int64_t elapsedRealtimeNs) {
     bool fireAlarm = false;
     {
         std::lock_guard<std::mutex> anomalyLock(mAnomalyAlarmMutex);
@@ -462,7 +496,9 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
     flushRestrictedDataIfNecessaryLocked(elapsedRealtimeNs);
     enforceDataTtlsIfNecessaryLocked(getWallClockNs(), elapsedRealtimeNs);
     enforceDbGuardrailsIfNecessaryLocked(getWallClockNs(), elapsedRealtimeNs);
+}
 
+void StatsLogProcessor::dispatchLogEventLocked(LogEvent* event, int64_t elapsedRealtimeNs) {
     if (!validateAppBreadcrumbEvent(*event)) {
         return;
     }
@@ -470,16 +506,18 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
     std::unordered_set<int> uidsWithActiveConfigsChanged;
     std::unordered_map<int, std::vector<int64_t>> activeConfigsPerUid;
 
-    // pass the event to metrics managers.
+    mDispatchTargets.clear();
     for (auto& pair : mMetricsManagers) {
         if (event->isRestricted() && !pair.second->hasRestrictedMetricsDelegate()) {
             continue;
         }
-        int uid = pair.first.GetUid();
-        int64_t configId = pair.first.GetId();
-        bool isPrevActive = pair.second->isActive();
-        pair.second->onLogEvent(*event);
-        bool isCurActive = pair.second->isActive();
+        mDispatchTargets.push_back({&pair.first, pair.second.get(), pair.second->isActive()});
+    }
+
+    const auto onEventDispatched = [&](const DispatchTarget& target) {
+        int uid = target.key->GetUid();
+        int64_t configId = target.key->GetId();
+        bool isCurActive = target.metricsManager->isActive();
         // Map all active configs by uid.
         if (isCurActive) {
             auto activeConfigs = activeConfigsPerUid.find(uid);
@@ -492,13 +530,38 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
             }
         }
         // The activation state of this config changed.
-        if (isPrevActive != isCurActive) {
+        if (target.wasActive != isCurActive) {
             VLOG("Active status changed for uid  %d", uid);
             uidsWithActiveConfigsChanged.insert(uid);
-            StatsdStats::getInstance().noteActiveStatusChanged(pair.first, isCurActive);
+            StatsdStats::getInstance().noteActiveStatusChanged(*target.key, isCurActive);
+        }
+        flushIfNecessaryLocked(*target.key, *target.metricsManager);
+    };
+
+    // pass the event to metrics managers.
+    if (mConfigDispatchPool != nullptr && mDispatchTargets.size() > 1) {
+        // MetricsManagers do not share state with each other. What they share is thread safe:
+        // - StatsdStats, UidMap, StatsPullerManager, AlarmMonitor and SubscriberReporter lock
+        //   internally.
+        // - StateManager is only read. It is only modified while holding mMetricsMutex, either
+        //   before dispatching or outside of event processing.
+        // - The event is only read. Its lazily parsed values are decoded upfront since decoding
+        //   is not thread safe.
+        // Everything else touching processor state runs serially once all of them are done.
+        event->materializeValues();
+        mConfigDispatchPool->parallelFor(mDispatchTargets.size(), [this, event](size_t i) {
+            mDispatchTargets[i].metricsManager->onLogEvent(*event);
+        });
+        for (const DispatchTarget& target : mDispatchTargets) {
+            onEventDispatched(target);
+        }
+    } else {
+        for (const DispatchTarget& target : mDispatchTargets) {
+            target.metricsManager->onLogEvent(*event);
+            onEventDispatched(target);
         }
-        flushIfNecessaryLocked(pair.first, *(pair.second));
     }
+    mDispatchTargets.clear();
 
     // Don't use the event timestamp for the guardrail.
     for (int uid : uidsWithActiveConfigsChanged) {
@@ -528,6 +591,15 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
     }
 }
 
+void StatsLogProcessor::enableParallelConfigDispatch(const size_t threadCount) {
+    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    if (threadCount == 0) {
+        mConfigDispatchPool = nullptr;
+    } else {
+        mConfigDispatchPool = std::make_unique<WorkerPool>(threadCount);
+    }
+}
+
 void StatsLogProcessor::GetActiveConfigs(const int uid, vector<int64_t>& outActiveConfigs) {
     std::lock_guard<std::mutex> lock(mMetricsMutex);
     GetActiveConfigsLocked(uid, outActiveConfigs);
@@ -662,58 +734,75 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
                                      const bool include_current_partial_bucket,
                                      const bool erase_data, const DumpReportReason dumpReportReason,
                                      const DumpLatency dumpLatency, ProtoOutputStream* proto) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    ConfigMetricsReportWriter reportWriter;
+    bool persistLocalHistory = false;
+    int32_t reportNumber;
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
 
-    auto it = mMetricsManagers.find(key);
-    if (it != mMetricsManagers.end() && it->second->hasRestrictedMetricsDelegate()) {
-        VLOG("Unexpected call to StatsLogProcessor::onDumpReport for restricted metrics.");
-        return;
-    }
+        auto it = mMetricsManagers.find(key);
+        if (it != mMetricsManagers.end() && it->second->hasRestrictedMetricsDelegate()) {
+            VLOG("Unexpected call to StatsLogProcessor::onDumpReport for restricted metrics.");
+            return;
+        }
 
-    // Start of ConfigKey.
-    uint64_t configKeyToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_ID_CONFIG_KEY);
-    proto->write(FIELD_TYPE_INT32 | FIELD_ID_UID, key.GetUid());
-    proto->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)key.GetId());
-    proto->end(configKeyToken);
-    // End of ConfigKey.
+        // Start of ConfigKey.
+        uint64_t configKeyToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_ID_CONFIG_KEY);
+        proto->write(FIELD_TYPE_INT32 | FIELD_ID_UID, key.GetUid());
+        proto->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)key.GetId());
+        proto->end(configKeyToken);
+        // End of ConfigKey.
 
-    bool keepFile = false;
-    if (it != mMetricsManagers.end() && it->second->shouldPersistLocalHistory()) {
-        keepFile = true;
-    }
+        bool keepFile = false;
+        if (it != mMetricsManagers.end() && it->second->shouldPersistLocalHistory()) {
+            keepFile = true;
+        }
 
-    // Then, check stats-data directory to see there's any file containing
-    // ConfigMetricsReport from previous shutdowns to concatenate to reports.
-    StorageManager::appendConfigMetricsReport(
-            key, proto, erase_data && !keepFile /* should remove file after appending it */,
-            dumpReportReason == ADB_DUMP /*if caller is adb*/);
+        // Then, check stats-data directory to see there's any file containing
+        // ConfigMetricsReport from previous shutdowns to concatenate to reports.
+        StorageManager::appendConfigMetricsReport(
+                key, proto, erase_data && !keepFile /* should remove file after appending it */,
+                dumpReportReason == ADB_DUMP /*if caller is adb*/);
+
+        if (it != mMetricsManagers.end()) {
+            // This allows another broadcast to be sent within the rate-limit period if we get
+            // close to filling the buffer again soon.
+            mLastBroadcastTimes.erase(key);
+
+            reportWriter = takeConfigMetricsReportLocked(
+                    key, dumpTimeStampNs, wallClockNs, include_current_partial_bucket, erase_data,
+                    dumpReportReason, dumpLatency,
+                    false /* is this data going to be saved on disk */, &persistLocalHistory);
+        } else {
+            ALOGW("Config source %s does not exist", key.ToString().c_str());
+        }
 
-    if (it != mMetricsManagers.end()) {
-        // This allows another broadcast to be sent within the rate-limit period if we get close to
-        // filling the buffer again soon.
-        mLastBroadcastTimes.erase(key);
+        if (erase_data) {
+            ++mDumpReportNumbers[key];
+        }
+        reportNumber = mDumpReportNumbers[key];
+    }
 
+    // The report is encoded without mMetricsMutex, so that large reports do not hold up the
+    // events.
+    if (reportWriter) {
         vector<uint8_t> buffer;
-        onConfigMetricsReportLocked(key, dumpTimeStampNs, wallClockNs,
-                                    include_current_partial_bucket, erase_data, dumpReportReason,
-                                    dumpLatency, false /* is this data going to be saved on disk */,
-                                    &buffer);
+        reportWriter(&buffer);
+        if (persistLocalHistory) {
+            // Other dumps read and remove the history files under mMetricsMutex.
+            std::lock_guard<std::mutex> lock(mMetricsMutex);
+            writeLocalHistoryLocked(key, buffer);
+        }
         proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
                      reinterpret_cast<char*>(buffer.data()), buffer.size());
-    } else {
-        ALOGW("Config source %s does not exist", key.ToString().c_str());
     }
 
-    if (erase_data) {
-        ++mDumpReportNumbers[key];
-    }
-    proto->write(FIELD_TYPE_INT32 | FIELD_ID_REPORT_NUMBER, mDumpReportNumbers[key]);
+    proto->write(FIELD_TYPE_INT32 | FIELD_ID_REPORT_NUMBER, reportNumber);
 
     proto->write(FIELD_TYPE_INT32 | FIELD_ID_STATSD_STATS_ID,
                  StatsdStats::getInstance().getStatsdStatsId());
     if (erase_data) {
-        StatsdStats::getInstance().noteMetricsReportSent(key, proto->size(),
-                                                         mDumpReportNumbers[key]);
+        StatsdStats::getInstance().noteMetricsReportSent(key, proto->size(), reportNumber);
     }
 }
 
@@ -755,76 +844,115 @@ void StatsLogProcessor::onConfigMetricsReportLocked(
         const bool include_current_partial_bucket, const bool erase_data,
         const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
         const bool dataSavedOnDisk, vector<uint8_t>* buffer) {
+    bool persistLocalHistory = false;
+    ConfigMetricsReportWriter reportWriter = takeConfigMetricsReportLocked(
+            key, dumpTimeStampNs, wallClockNs, include_current_partial_bucket, erase_data,
+            dumpReportReason, dumpLatency, dataSavedOnDisk, &persistLocalHistory);
+    if (reportWriter) {
+        reportWriter(buffer);
+        if (persistLocalHistory) {
+            writeLocalHistoryLocked(key, *buffer);
+        }
+    }
+}
+
+void StatsLogProcessor::writeLocalHistoryLocked(const ConfigKey& key,
+                                                const vector<uint8_t>& buffer) {
+    VLOG("save history to disk");
+    string file_name = StorageManager::getDataHistoryFileName((long)getWallClockSec(),
+                                                              key.GetUid(), key.GetId());
+    StorageManager::writeFile(file_name.c_str(), buffer.data(), buffer.size());
+}
+
+StatsLogProcessor::ConfigMetricsReportWriter StatsLogProcessor::takeConfigMetricsReportLocked(
+        const ConfigKey& key, const int64_t dumpTimeStampNs, const int64_t wallClockNs,
+        const bool include_current_partial_bucket, const bool erase_data,
+        const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
+        const bool dataSavedOnDisk, bool* persistLocalHistory) {
     // We already checked whether key exists in mMetricsManagers in
     // WriteDataToDisk.
     auto it = mMetricsManagers.find(key);
     if (it == mMetricsManagers.end()) {
-        return;
+        return nullptr;
     }
     if (it->second->hasRestrictedMetricsDelegate()) {
         VLOG("Unexpected call to StatsLogProcessor::onConfigMetricsReportLocked for restricted "
              "metrics.");
         // Do not call onDumpReport for restricted metrics.
-        return;
+        return nullptr;
     }
-    int64_t lastReportTimeNs = it->second->getLastReportTimeNs();
-    int64_t lastReportWallClockNs = it->second->getLastReportWallClockNs();
+    const sp<MetricsManager>& metricsManager = it->second;
+    int64_t lastReportTimeNs = metricsManager->getLastReportTimeNs();
+    int64_t lastReportWallClockNs = metricsManager->getLastReportWallClockNs();
 
-    std::set<string> str_set;
+    // Filled by the UidMap and the writers of the StatsLogReports.
+    auto str_set = std::make_shared<std::set<string>>();
 
-    int64_t totalSize = it->second->byteSize();
+    int64_t totalSize = metricsManager->byteSize();
 
-    ProtoOutputStream tempProto;
-    // First, fill in ConfigMetricsReport using current data on memory, which
-    // starts from filling in StatsLogReport's.
-    it->second->onDumpReport(dumpTimeStampNs, wallClockNs, include_current_partial_bucket,
-                             erase_data, dumpLatency, &str_set, &tempProto);
+    // First, take the data of the StatsLogReport's of ConfigMetricsReport.
+    MetricsManager::DumpReportWriter metricsWriter =
+            metricsManager->takeDumpReport(dumpTimeStampNs, wallClockNs,
+                                           include_current_partial_bucket, erase_data,
+                                           dumpLatency, str_set.get());
 
-    // Fill in UidMap if there is at least one metric to report.
+    // The UidMap is only filled if there is at least one metric to report.
     // This skips the uid map if it's an empty config.
-    if (it->second->getNumMetrics() > 0) {
-        uint64_t uidMapToken = tempProto.start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
-        mUidMap->appendUidMap(dumpTimeStampNs, key, it->second->versionStringsInReport(),
-                              it->second->installerInReport(),
-                              it->second->packageCertificateHashSizeBytes(),
-                              it->second->omitSystemUidsInUidMap(),
-                              it->second->hashStringInReport() ? &str_set : nullptr, &tempProto);
-        tempProto.end(uidMapToken);
-    }
-
-    // Fill in the timestamps.
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
-                    (long long)lastReportTimeNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
-                    (long long)dumpTimeStampNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
-                    (long long)lastReportWallClockNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
-                    (long long)wallClockNs);
-    // Dump report reason
-    tempProto.write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
-
-    for (const auto& str : str_set) {
-        tempProto.write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
-    }
+    // It is encoded under mMetricsMutex, as it moves the last update time of the config forward
+    // and concurrent dumps must do so in order.
+    const bool hasUidMap = metricsManager->getNumMetrics() > 0;
+    auto uidMapBuffer = std::make_shared<vector<uint8_t>>();
+    if (hasUidMap) {
+        ProtoOutputStream uidMapProto;
+        mUidMap->appendUidMap(dumpTimeStampNs, key, metricsManager->versionStringsInReport(),
+                              metricsManager->installerInReport(),
+                              metricsManager->packageCertificateHashSizeBytes(),
+                              metricsManager->omitSystemUidsInUidMap(),
+                              metricsManager->hashStringInReport() ? str_set.get() : nullptr,
+                              &uidMapProto);
+        flushProtoToBuffer(uidMapProto, uidMapBuffer.get());
+    }
+    *persistLocalHistory =
+            erase_data && !dataSavedOnDisk && metricsManager->shouldPersistLocalHistory();
+
+    return [=](vector<uint8_t>* buffer) {
+        ProtoOutputStream tempProto;
+        // First, fill in ConfigMetricsReport using current data on memory, which
+        // starts from filling in StatsLogReport's.
+        metricsWriter(&tempProto);
+
+        // Fill in UidMap if there is at least one metric to report.
+        if (hasUidMap) {
+            tempProto.write(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP,
+                            reinterpret_cast<char*>(uidMapBuffer->data()), uidMapBuffer->size());
+        }
 
-    // Data corrupted reason
-    writeDataCorruptedReasons(tempProto, FIELD_ID_DATA_CORRUPTED_REASON,
-                              StatsdStats::getInstance().hasEventQueueOverflow(),
-                              StatsdStats::getInstance().hasSocketLoss());
+        // Fill in the timestamps.
+        tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
+                        (long long)lastReportTimeNs);
+        tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
+                        (long long)dumpTimeStampNs);
+        tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
+                        (long long)lastReportWallClockNs);
+        tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
+                        (long long)wallClockNs);
+        // Dump report reason
+        tempProto.write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
+
+        for (const auto& str : *str_set) {
+            tempProto.write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
+        }
 
-    // Estimated memory bytes
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_ESTIMATED_DATA_BYTES, totalSize);
+        // Data corrupted reason
+        writeDataCorruptedReasons(tempProto, FIELD_ID_DATA_CORRUPTED_REASON,
+                                  StatsdStats::getInstance().hasEventQueueOverflow(),
+                                  StatsdStats::getInstance().hasSocketLoss());
 
-    flushProtoToBuffer(tempProto, buffer);
+        // Estimated memory bytes
+        tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_ESTIMATED_DATA_BYTES, totalSize);
 
-    // save buffer to disk if needed
-    if (erase_data && !dataSavedOnDisk && it->second->shouldPersistLocalHistory()) {
-        VLOG("save history to disk");
-        string file_name = StorageManager::getDataHistoryFileName((long)getWallClockSec(),
-                                                                  key.GetUid(), key.GetId());
-        StorageManager::writeFile(file_name.c_str(), buffer->data(), buffer->size());
-    }
+        flushProtoToBuffer(tempProto, buffer);
+    };
 }
 
 void StatsLogProcessor::resetConfigsLocked(const int64_t timestampNs,
@@ -876,7 +1004,6 @@ void StatsLogProcessor::OnConfigRemoved(const ConfigKey& key) {
     StatsdStats::getInstance().noteConfigRemoved(key);
 
     mLastBroadcastTimes.erase(key);
-    mLastByteSizeTimes.erase(key);
     mDumpReportNumbers.erase(key);
 
     int uid = key.GetUid();
@@ -1114,20 +1241,11 @@ void StatsLogProcessor::flushRestrictedDataLocked(const int64_t elapsedRealtimeN
 void StatsLogProcessor::flushIfNecessaryLocked(const ConfigKey& key,
                                                MetricsManager& metricsManager) {
     int64_t elapsedRealtimeNs = getElapsedRealtimeNs();
-    auto lastCheckTime = mLastByteSizeTimes.find(key);
-    int64_t minCheckPeriodNs = metricsManager.useV2SoftMemoryCalculation()
-                                       ? StatsdStats::kMinByteSizeV2CheckPeriodNs
-                                       : StatsdStats::kMinByteSizeCheckPeriodNs;
-    if (lastCheckTime != mLastByteSizeTimes.end()) {
-        if (elapsedRealtimeNs - lastCheckTime->second < minCheckPeriodNs) {
-            return;
-        }
-    }
 
-    // We suspect that the byteSize() computation is expensive, so we set a rate limit.
+    // The metrics keep their byte sizes as their buckets are added and read them without locking,
+    // so the size is checked on every flush.
     size_t totalBytes = metricsManager.byteSize();
 
-    mLastByteSizeTimes[key] = elapsedRealtimeNs;
     const size_t kBytesPerConfig = metricsManager.hasRestrictedMetricsDelegate()
                                            ? StatsdStats::kBytesPerRestrictedConfigTriggerFlush
                                            : metricsManager.getTriggerGetDataBytes();
@@ -1169,22 +1287,25 @@ void StatsLogProcessor::flushIfNecessaryLocked(const ConfigKey& key,
     }
 }
 
-void StatsLogProcessor::WriteDataToDiskLocked(const ConfigKey& key, const int64_t timestampNs,
-                                              const int64_t wallClockNs,
-                                              const DumpReportReason dumpReportReason,
-                                              const DumpLatency dumpLatency) {
-    if (mMetricsManagers.find(key) == mMetricsManagers.end() ||
-        !mMetricsManagers.find(key)->second->shouldWriteToDisk()) {
-        return;
+StatsLogProcessor::ConfigMetricsReportWriter StatsLogProcessor::takeDiskReportLocked(
+        const ConfigKey& key, const int64_t timestampNs, const int64_t wallClockNs,
+        const DumpReportReason dumpReportReason, const DumpLatency dumpLatency) {
+    auto it = mMetricsManagers.find(key);
+    if (it == mMetricsManagers.end() || !it->second->shouldWriteToDisk()) {
+        return nullptr;
     }
-    if (mMetricsManagers.find(key)->second->hasRestrictedMetricsDelegate()) {
-        mMetricsManagers.find(key)->second->flushRestrictedData();
-        return;
+    if (it->second->hasRestrictedMetricsDelegate()) {
+        it->second->flushRestrictedData();
+        return nullptr;
     }
-    vector<uint8_t> buffer;
-    onConfigMetricsReportLocked(key, timestampNs, wallClockNs,
-                                true /* include_current_partial_bucket*/, true /* erase_data */,
-                                dumpReportReason, dumpLatency, true, &buffer);
+    bool persistLocalHistory = false;
+    return takeConfigMetricsReportLocked(key, timestampNs, wallClockNs,
+                                         true /* include_current_partial_bucket*/,
+                                         true /* erase_data */, dumpReportReason, dumpLatency,
+                                         true, &persistLocalHistory);
+}
+
+void StatsLogProcessor::writeDataFileLocked(const ConfigKey& key, const vector<uint8_t>& buffer) {
     string file_name =
             StorageManager::getDataFileName((long)getWallClockSec(), key.GetUid(), key.GetId());
     StorageManager::writeFile(file_name.c_str(), buffer.data(), buffer.size());
@@ -1193,6 +1314,19 @@ void StatsLogProcessor::WriteDataToDiskLocked(const ConfigKey& key, const int64_
     mOnDiskDataConfigs.insert(key);
 }
 
+void StatsLogProcessor::WriteDataToDiskLocked(const ConfigKey& key, const int64_t timestampNs,
+                                              const int64_t wallClockNs,
+                                              const DumpReportReason dumpReportReason,
+                                              const DumpLatency dumpLatency) {
+    ConfigMetricsReportWriter reportWriter =
+            takeDiskReportLocked(key, timestampNs, wallClockNs, dumpReportReason, dumpLatency);
+    if (reportWriter) {
+        vector<uint8_t> buffer;
+        reportWriter(&buffer);
+        writeDataFileLocked(key, buffer);
+    }
+}
+
 void StatsLogProcessor::SaveActiveConfigsToDisk(int64_t currentTimeNs) {
     std::lock_guard<std::mutex> lock(mMetricsMutex);
     const int64_t timeNs = getElapsedRealtimeNs();
@@ -1391,10 +1525,12 @@ void StatsLogProcessor::SetConfigsActiveStateLocked(const ActiveConfigList& acti
     VLOG("Successfully loaded %d active configs.", activeConfigList.config_size());
 }
 
-void StatsLogProcessor::WriteDataToDiskLocked(const DumpReportReason dumpReportReason,
-                                              const DumpLatency dumpLatency,
-                                              const int64_t elapsedRealtimeNs,
-                                              const int64_t wallClockNs) {
+vector<std::pair<ConfigKey, StatsLogProcessor::ConfigMetricsReportWriter>>
+StatsLogProcessor::takeDiskReportsLocked(const DumpReportReason dumpReportReason,
+                                         const DumpLatency dumpLatency,
+                                         const int64_t elapsedRealtimeNs,
+                                         const int64_t wallClockNs) {
+    vector<std::pair<ConfigKey, ConfigMetricsReportWriter>> reports;
     // Do not write to disk if we already have in the last few seconds.
     // This is to avoid overwriting files that would have the same name if we
     //   write twice in the same second.
@@ -1402,12 +1538,28 @@ void StatsLogProcessor::WriteDataToDiskLocked(const DumpReportReason dumpReportR
         mLastWriteTimeNs + WRITE_DATA_COOL_DOWN_SEC * NS_PER_SEC) {
         ALOGI("Statsd skipping writing data to disk. Already wrote data in last %d seconds",
                 WRITE_DATA_COOL_DOWN_SEC);
-        return;
+        return reports;
     }
     mLastWriteTimeNs = elapsedRealtimeNs;
     for (auto& pair : mMetricsManagers) {
-        WriteDataToDiskLocked(pair.first, elapsedRealtimeNs, wallClockNs, dumpReportReason,
-                              dumpLatency);
+        ConfigMetricsReportWriter reportWriter = takeDiskReportLocked(
+                pair.first, elapsedRealtimeNs, wallClockNs, dumpReportReason, dumpLatency);
+        if (reportWriter) {
+            reports.emplace_back(pair.first, std::move(reportWriter));
+        }
+    }
+    return reports;
+}
+
+void StatsLogProcessor::WriteDataToDiskLocked(const DumpReportReason dumpReportReason,
+                                              const DumpLatency dumpLatency,
+                                              const int64_t elapsedRealtimeNs,
+                                              const int64_t wallClockNs) {
+    for (const auto& [key, reportWriter] :
+         takeDiskReportsLocked(dumpReportReason, dumpLatency, elapsedRealtimeNs, wallClockNs)) {
+        vector<uint8_t> buffer;
+        reportWriter(&buffer);
+        writeDataFileLocked(key, buffer);
     }
 }
 
@@ -1415,8 +1567,22 @@ void StatsLogProcessor::WriteDataToDisk(const DumpReportReason dumpReportReason,
                                         const DumpLatency dumpLatency,
                                         const int64_t elapsedRealtimeNs,
                                         const int64_t wallClockNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
-    WriteDataToDiskLocked(dumpReportReason, dumpLatency, elapsedRealtimeNs, wallClockNs);
+    vector<std::pair<ConfigKey, ConfigMetricsReportWriter>> reports;
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        reports = takeDiskReportsLocked(dumpReportReason, dumpLatency, elapsedRealtimeNs,
+                                        wallClockNs);
+    }
+
+    // The reports are encoded without mMetricsMutex, so that large reports do not hold up the
+    // events.
+    for (const auto& [key, reportWriter] : reports) {
+        vector<uint8_t> buffer;
+        reportWriter(&buffer);
+        // Dumps read and remove the data files under mMetricsMutex.
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        writeDataFileLocked(key, buffer);
+    }
 }
 
 void StatsLogProcessor::informPullAlarmFired(const int64_t timestampNs) {
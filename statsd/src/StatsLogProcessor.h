@@ -20,6 +20,7 @@
 #include <gtest/gtest_prod.h>
 #include <stdio.h>
 
+#include <functional>
 #include <unordered_map>
 
 #include "config/ConfigListener.h"
@@ -28,6 +29,7 @@
 #include "metrics/MetricsManager.h"
 #include "packages/UidMap.h"
 #include "socket/LogEventFilter.h"
+#include "utils/WorkerPool.h"
 #include "src/statsd_config.pb.h"
 #include "src/statsd_metadata.pb.h"
 
@@ -51,6 +53,21 @@ public:
 
     void OnLogEvent(LogEvent* event);
 
+    /**
+     * Processes a batch of events in order, taking mMetricsMutex once for the whole batch.
+     * Time based housekeeping (anomaly alarms, puller cache, restricted data flush, TTL and db
+     * guardrails) runs once per batch instead of once per event.
+     */
+    void OnLogEvents(const std::vector<std::unique_ptr<LogEvent>>& events);
+
+    /**
+     * Lets independent MetricsManagers process an event in parallel on a pool of threadCount
+     * worker threads, in addition to the thread processing events. Activation broadcasts and
+     * flushes still run serially once all MetricsManagers processed the event, so the output is
+     * identical to serial dispatch. A threadCount of 0 restores serial dispatch.
+     */
+    void enableParallelConfigDispatch(size_t threadCount);
+
     void OnConfigUpdated(const int64_t timestampNs, int64_t wallClockNs, const ConfigKey& key,
                          const StatsdConfig& config, bool modularUpdate = true);
     // For testing only.
@@ -196,8 +213,18 @@ private:
     // Last time we sent a broadcast to this uid that the active configs had changed.
     std::unordered_map<int, int64_t> mLastActivationBroadcastTimes;
 
-    // Tracks when we last checked the bytes consumed for each config key.
-    std::unordered_map<ConfigKey, int64_t> mLastByteSizeTimes;
+    // Workers for parallel config dispatch. Null when events are dispatched serially.
+    std::unique_ptr<WorkerPool> mConfigDispatchPool;
+
+    // A MetricsManager an event is dispatched to, and whether it was active before the event.
+    struct DispatchTarget {
+        const ConfigKey* key;
+        MetricsManager* metricsManager;
+        bool wasActive;
+    };
+
+    // Only used by dispatchLogEventLocked, kept to avoid allocating per event.
+    std::vector<DispatchTarget> mDispatchTargets;
 
     // Tracks the number of times a config with a specified config key has been dumped.
     std::unordered_map<ConfigKey, int32_t> mDumpReportNumbers;
@@ -226,6 +253,19 @@ private:
 
     void OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs);
 
+    void OnLogEvents(const std::vector<std::unique_ptr<LogEvent>>& events,
+                     int64_t elapsedRealtimeNs);
+
+    // Per event bookkeeping done before the event reaches the metrics managers. Returns false if
+    // the event should not be dispatched.
+    bool preprocessLogEventLocked(LogEvent* event);
+
+    // Time based checks that only depend on the current time and not on the event.
+    void onPeriodicHousekeepingLocked(int64_t elapsedRealtimeNs);
+
+    // Passes the event to the metrics managers and sends activation broadcasts if needed.
+    void dispatchLogEventLocked(LogEvent* event, int64_t elapsedRealtimeNs);
+
     void resetIfConfigTtlExpiredLocked(const int64_t eventTimeNs);
 
     void OnConfigUpdatedLocked(const int64_t currentTimestampNs, const ConfigKey& key,
@@ -263,6 +303,37 @@ private:
              (e.g., before reboot). So no need to further persist local history.*/
             const bool dataSavedToDisk, vector<uint8_t>* proto);
 
+    // Writes a serialized ConfigMetricsReport to [buffer].
+    using ConfigMetricsReportWriter = std::function<void(vector<uint8_t>* buffer)>;
+
+    // Takes the data of the report of onConfigMetricsReportLocked, and returns a writer that
+    // encodes it without holding mMetricsMutex. Returns an empty writer if there is no report.
+    // Sets persistLocalHistory if the encoded report must be passed to writeLocalHistoryLocked.
+    ConfigMetricsReportWriter takeConfigMetricsReportLocked(
+            const ConfigKey& key, int64_t dumpTimeStampNs, int64_t wallClockNs,
+            const bool include_current_partial_bucket, const bool erase_data,
+            const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
+            const bool dataSavedToDisk, bool* persistLocalHistory);
+
+    // Saves an encoded report of the config to its local history on disk.
+    void writeLocalHistoryLocked(const ConfigKey& key, const vector<uint8_t>& buffer);
+
+    // Takes the report of the config that WriteDataToDiskLocked saves to disk. Returns an empty
+    // writer if the config does not write its data to disk.
+    ConfigMetricsReportWriter takeDiskReportLocked(const ConfigKey& key, int64_t timestampNs,
+                                                   int64_t wallClockNs,
+                                                   const DumpReportReason dumpReportReason,
+                                                   const DumpLatency dumpLatency);
+
+    // Takes the reports of all configs that WriteDataToDiskLocked saves to disk, unless data was
+    // written in the last few seconds.
+    vector<std::pair<ConfigKey, ConfigMetricsReportWriter>> takeDiskReportsLocked(
+            const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
+            int64_t elapsedRealtimeNs, int64_t wallClockNs);
+
+    // Saves an encoded report of the config to disk, for the next collection of its data.
+    void writeDataFileLocked(const ConfigKey& key, const vector<uint8_t>& buffer);
+
     /* Check if it is time enforce data ttls for restricted metrics, and if it is, enforce ttls
      * on all restricted metrics. */
     void enforceDataTtlsIfNecessaryLocked(const int64_t wallClockNs,
@@ -368,7 +439,7 @@ private:
 
     friend class StatsLogProcessorTestRestricted;
     FRIEND_TEST(StatsLogProcessorTest, TestOutOfOrderLogs);
-    FRIEND_TEST(StatsLogProcessorTest, TestRateLimitByteSize);
+    FRIEND_TEST(StatsLogProcessorTest, TestCheckByteSizeOnEveryFlush);
     FRIEND_TEST(StatsLogProcessorTest, TestRateLimitBroadcast);
     FRIEND_TEST(StatsLogProcessorTest, TestDropWhenByteSizeTooLarge);
     FRIEND_TEST(StatsLogProcessorTest, InvalidConfigRemoved);
@@ -386,8 +457,8 @@ private:
     FRIEND_TEST(StatsLogProcessorTestRestricted, TestInconsistentRestrictedMetricsConfigUpdate);
     FRIEND_TEST(StatsLogProcessorTestRestricted, TestRestrictedLogEventPassed);
     FRIEND_TEST(StatsLogProcessorTestRestricted, TestRestrictedLogEventNotPassed);
-    FRIEND_TEST(StatsLogProcessorTestRestricted, RestrictedMetricsManagerOnDumpReportNotCalled);
-    FRIEND_TEST(StatsLogProcessorTestRestricted, NonRestrictedMetricsManagerOnDumpReportCalled);
+    FRIEND_TEST(StatsLogProcessorTestRestricted, RestrictedMetricsManagerTakeDumpReportNotCalled);
+    FRIEND_TEST(StatsLogProcessorTestRestricted, NonRestrictedMetricsManagerTakeDumpReportCalled);
     FRIEND_TEST(StatsLogProcessorTestRestricted, RestrictedMetricOnDumpReportEmpty);
     FRIEND_TEST(StatsLogProcessorTestRestricted, NonRestrictedMetricOnDumpReportNotEmpty);
     FRIEND_TEST(StatsLogProcessorTestRestricted, RestrictedMetricNotWriteToDisk);
@@ -20,6 +20,7 @@
 #include "StatsService.h"
 
 #include <android-base/file.h>
+#include <android-base/parseint.h>
 #include <android-base/strings.h>
 #include <android/binder_ibinder_platform.h>
 #include <cutils/multiuser.h>
@@ -221,6 +222,12 @@ StatsService::StatsService(const sp<UidMap>& uidMap, shared_ptr<LogEventQueue> q
                                                                delegateUids, restrictedMetrics);
             },
             logEventFilter);
+    if (FlagProvider::getInstance().getBootFlagBool(PARALLEL_CONFIG_DISPATCH_FLAG, FLAG_FALSE)) {
+        mProcessor->enableParallelConfigDispatch(kConfigDispatchThreads);
+    }
+    if (FlagProvider::getInstance().getBootFlagBool(CONCURRENT_PULLS_FLAG, FLAG_FALSE)) {
+        mPullerManager->enableConcurrentPulls(getPullThreads());
+    }
 
     mUidMap->setListener(mProcessor);
     mConfigManager->AddListener(mProcessor);
@@ -237,26 +244,42 @@ StatsService::~StatsService() {
     }
 }
 
+size_t StatsService::getPullThreads() {
+    const string value = FlagProvider::getInstance().getBootFlagString(
+            CONCURRENT_PULL_THREADS_FLAG, std::to_string(kDefaultPullThreads));
+    size_t pullThreads;
+    if (!android::base::ParseUint(value, &pullThreads, kMaxPullThreads) || pullThreads == 0) {
+        ALOGW("Invalid %s value %s", CONCURRENT_PULL_THREADS_FLAG.c_str(), value.c_str());
+        return kDefaultPullThreads;
+    }
+    return pullThreads;
+}
+
 /* Runs on a dedicated thread to process pushed events. */
 void StatsService::readLogs() {
+    std::vector<std::unique_ptr<LogEvent>> events;
+    events.reserve(kMaxLogEventBatchSize);
     // Read forever..... long live statsd
     while (1) {
-        // Block until an event is available.
-        auto event = mEventQueue->waitPop();
+        // Block until at least one event is available, then drain what is ready.
+        events.clear();
+        mEventQueue->waitPopN(events, kMaxLogEventBatchSize);
 
         // Below flag will be set when statsd is exiting and log event will be pushed to break
-        // out of waitPop.
+        // out of waitPopN.
         if (mIsStopRequested) {
             break;
         }
 
-        // Pass it to StatsLogProcess to all configs/metrics
+        // Pass them to StatsLogProcess to all configs/metrics
         // At this point, the LogEventQueue is not blocked, so that the socketListener
         // can read events from the socket and write to buffer to avoid data drop.
-        mProcessor->OnLogEvent(event.get());
+        mProcessor->OnLogEvents(events);
         // The ShellSubscriber is only used by shell for local debugging.
         if (mShellSubscriber != nullptr) {
-            mShellSubscriber->onLogEvent(*event);
+            for (const std::unique_ptr<LogEvent>& event : events) {
+                mShellSubscriber->onLogEvent(*event);
+            }
         }
     }
 }
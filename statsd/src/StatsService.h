@@ -470,6 +470,21 @@ private:
     shared_ptr<LogEventQueue> mEventQueue;
     std::shared_ptr<LogEventFilter> mLogEventFilter;
 
+    // Max number of events drained from mEventQueue and processed under one metrics lock
+    // acquisition.
+    static constexpr size_t kMaxLogEventBatchSize = 256;
+
+    // Number of worker threads used when PARALLEL_CONFIG_DISPATCH_FLAG is enabled.
+    static constexpr size_t kConfigDispatchThreads = 3;
+
+    // Number of worker threads used when CONCURRENT_PULLS_FLAG is enabled, unless
+    // CONCURRENT_PULL_THREADS_FLAG sets another number up to kMaxPullThreads.
+    static constexpr size_t kDefaultPullThreads = 3;
+    static constexpr size_t kMaxPullThreads = 16;
+
+    // Returns the number of pull threads set by CONCURRENT_PULL_THREADS_FLAG.
+    static size_t getPullThreads();
+
     std::unique_ptr<std::thread> mLogsReaderThread;
 
     std::condition_variable mStatsdInitCompletedHandlerTerminationFlag;
@@ -77,6 +77,10 @@ public:
         return nullptr;
     }
 
+    const std::vector<int>& getChildren() const override {
+        return mChildren;
+    }
+
     bool IsSimpleCondition() const  override { return false; }
 
     bool IsChangedDimensionTrackable() const  override {
@@ -87,7 +91,7 @@ public:
         const std::vector<sp<ConditionTracker>>& allConditions,
         const vector<Matcher>& dimensions) const override;
 
-    const std::map<HashableDimensionKey, int>* getSlicedDimensionMap(
+    const std::unordered_map<HashableDimensionKey, int>* getSlicedDimensionMap(
             const std::vector<sp<ConditionTracker>>& allConditions) const override {
         if (mSlicedChildren.size() == 1) {
             return allConditions[mSlicedChildren.front()]->getSlicedDimensionMap(allConditions);
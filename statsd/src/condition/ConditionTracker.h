@@ -116,6 +116,12 @@ public:
         return mTrackerIndex;
     }
 
+    // return the list of child ConditionTracker indices that are evaluated by this tracker.
+    virtual const std::vector<int>& getChildren() const {
+        static const std::vector<int> kNoChildren;
+        return kNoChildren;
+    }
+
     virtual void setSliced(bool sliced) {
         mSliced = mSliced | sliced;
     }
@@ -137,7 +143,7 @@ public:
         return mProtoHash;
     }
 
-    virtual const std::map<HashableDimensionKey, int>* getSlicedDimensionMap(
+    virtual const std::unordered_map<HashableDimensionKey, int>* getSlicedDimensionMap(
             const std::vector<sp<ConditionTracker>>& allConditions) const = 0;
 
     virtual bool IsChangedDimensionTrackable() const = 0;
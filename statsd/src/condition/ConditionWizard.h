@@ -54,7 +54,8 @@ public:
         return mAllConditions[index]->getUnSlicedPartConditionState();
     }
 
-    const std::map<HashableDimensionKey, int>* getSlicedDimensionMap(const int index) const {
+    const std::unordered_map<HashableDimensionKey, int>* getSlicedDimensionMap(
+            const int index) const {
         return mAllConditions[index]->getSlicedDimensionMap(mAllConditions);
     }
 
@@ -18,6 +18,9 @@
 #include "Log.h"
 
 #include "SimpleConditionTracker.h"
+
+#include <algorithm>
+
 #include "guardrail/StatsdStats.h"
 
 namespace android {
@@ -161,6 +164,9 @@ void SimpleConditionTracker::handleStopAll(std::vector<ConditionState>& conditio
     // After StopAll, we know everything has stopped. From now on, default condition is false.
     mInitialValue = ConditionState::kFalse;
     mSlicedConditionState.clear();
+    for (PartialLinkIndex& index : mPartialLinkIndexes) {
+        index.sliceCounts.clear();
+    }
     conditionCache[mIndex] = ConditionState::kFalse;
 }
 
@@ -200,12 +206,14 @@ void SimpleConditionTracker::handleConditionEvent(const HashableDimensionKey& ou
         newCondition = matchStart ? ConditionState::kTrue : ConditionState::kFalse;
         if (matchStart && mInitialValue != ConditionState::kTrue) {
             mSlicedConditionState[outputKey] = 1;
+            updatePartialLinkIndexes(outputKey, /*slicesDelta=*/1, /*trueDelta=*/1);
             changed = true;
             mLastChangedToTrueDimensions.insert(outputKey);
         } else if (mInitialValue != ConditionState::kFalse) {
             // it's a stop and we don't have history about it.
             // If the default condition is not false, it means this stop is valuable to us.
             mSlicedConditionState[outputKey] = 0;
+            updatePartialLinkIndexes(outputKey, /*slicesDelta=*/1, /*trueDelta=*/0);
             mLastChangedToFalseDimensions.insert(outputKey);
             changed = true;
         }
@@ -217,6 +225,7 @@ void SimpleConditionTracker::handleConditionEvent(const HashableDimensionKey& ou
         if (matchStart) {
             if (startedCount == 0) {
                 mLastChangedToTrueDimensions.insert(outputKey);
+                updatePartialLinkIndexes(outputKey, /*slicesDelta=*/0, /*trueDelta=*/1);
                 // This condition for this output key will change from false -> true
                 changed = true;
             }
@@ -241,12 +250,14 @@ void SimpleConditionTracker::handleConditionEvent(const HashableDimensionKey& ou
                 // if everything has stopped for this output key, condition true -> false;
                 if (startedCount == 0) {
                     mLastChangedToFalseDimensions.insert(outputKey);
+                    updatePartialLinkIndexes(outputKey, /*slicesDelta=*/0, /*trueDelta=*/-1);
                     changed = true;
                 }
             }
 
             // if default condition is false, it means we don't need to keep the false values.
             if (mInitialValue == ConditionState::kFalse && startedCount == 0) {
+                updatePartialLinkIndexes(outputKey, /*slicesDelta=*/-1, /*trueDelta=*/0);
                 mSlicedConditionState.erase(outputIt);
                 VLOG("erase key %s", outputKey.toString().c_str());
             }
@@ -350,6 +361,100 @@ void SimpleConditionTracker::evaluateCondition(const LogEvent& event,
     conditionChangedCache[mIndex] = overallChanged;
 }
 
+// Finds the positions of the fields in the slice. Returns false if the slice does not have all the
+// fields.
+static bool findFieldPositions(const HashableDimensionKey& slice, const vector<Field>& fields,
+                               vector<size_t>* positions) {
+    const vector<FieldValue>& sliceValues = slice.getValues();
+    positions->clear();
+    positions->reserve(fields.size());
+    for (const Field& field : fields) {
+        const auto it = std::find_if(
+                sliceValues.begin(), sliceValues.end(),
+                [&field](const FieldValue& sliceValue) { return sliceValue.mField == field; });
+        if (it == sliceValues.end()) {
+            return false;
+        }
+        positions->push_back(it - sliceValues.begin());
+    }
+    return true;
+}
+
+// Gets the values of the fields in the slice, in the order of the fields. Returns false if the
+// slice does not have all the fields, in which case it does not contain any key with them.
+// The slices are all filtered by the same dimensions, so the values are read at the [positions]
+// found in the first slice having all the fields. Only a slice missing some other field has its
+// values laid out differently, and is searched again.
+static bool getPartialLinkKey(const HashableDimensionKey& slice, const vector<Field>& fields,
+                              vector<size_t>* positions, HashableDimensionKey* key) {
+    if (positions->size() != fields.size() && !findFieldPositions(slice, fields, positions)) {
+        return false;
+    }
+    const vector<FieldValue>& sliceValues = slice.getValues();
+    vector<FieldValue>* values = key->mutableValues();
+    values->reserve(fields.size());
+    for (size_t i = 0; i < fields.size(); i++) {
+        const size_t position = (*positions)[i];
+        if (position >= sliceValues.size() || sliceValues[position].mField != fields[i]) {
+            vector<size_t> slicePositions;
+            if (!findFieldPositions(slice, fields, &slicePositions)) {
+                return false;
+            }
+            values->clear();
+            for (const size_t slicePosition : slicePositions) {
+                values->push_back(sliceValues[slicePosition]);
+            }
+            return true;
+        }
+        values->push_back(sliceValues[position]);
+    }
+    return true;
+}
+
+const SimpleConditionTracker::PartialLinkIndex& SimpleConditionTracker::getPartialLinkIndex(
+        const HashableDimensionKey& key) const {
+    const vector<FieldValue>& keyValues = key.getValues();
+    for (const PartialLinkIndex& index : mPartialLinkIndexes) {
+        if (std::equal(index.fields.begin(), index.fields.end(), keyValues.begin(),
+                       keyValues.end(), [](const Field& field, const FieldValue& keyValue) {
+                           return field == keyValue.mField;
+                       })) {
+            return index;
+        }
+    }
+
+    PartialLinkIndex& index = mPartialLinkIndexes.emplace_back();
+    index.fields.reserve(keyValues.size());
+    for (const FieldValue& value : keyValues) {
+        index.fields.push_back(value.mField);
+    }
+    for (const auto& [slice, startedCount] : mSlicedConditionState) {
+        HashableDimensionKey linkKey;
+        if (getPartialLinkKey(slice, index.fields, &index.positions, &linkKey)) {
+            SliceCounts& counts = index.sliceCounts[linkKey];
+            counts.slices++;
+            counts.trueSlices += startedCount > 0;
+        }
+    }
+    return index;
+}
+
+void SimpleConditionTracker::updatePartialLinkIndexes(const HashableDimensionKey& slice,
+                                                      int slicesDelta, int trueDelta) {
+    for (PartialLinkIndex& index : mPartialLinkIndexes) {
+        HashableDimensionKey linkKey;
+        if (!getPartialLinkKey(slice, index.fields, &index.positions, &linkKey)) {
+            continue;
+        }
+        SliceCounts& counts = index.sliceCounts[linkKey];
+        counts.slices += slicesDelta;
+        counts.trueSlices += trueDelta;
+        if (counts.slices == 0) {
+            index.sliceCounts.erase(linkKey);
+        }
+    }
+}
+
 void SimpleConditionTracker::isConditionMet(
         const ConditionKey& conditionParameters, const vector<sp<ConditionTracker>>& allConditions,
         const bool isPartialLink,
@@ -384,12 +489,12 @@ void SimpleConditionTracker::isConditionMet(
         // For unseen key, check whether the require dimensions are subset of sliced condition
         // output.
         conditionState = conditionState | mInitialValue;
-        for (const auto& slice : mSlicedConditionState) {
-            ConditionState sliceState =
-                slice.second > 0 ? ConditionState::kTrue : ConditionState::kFalse;
-            if (slice.first.contains(key)) {
-                conditionState = conditionState | sliceState;
-            }
+        const PartialLinkIndex& index = getPartialLinkIndex(key);
+        const auto countsIt = index.sliceCounts.find(key);
+        if (countsIt != index.sliceCounts.end()) {
+            ConditionState sliceState = countsIt->second.trueSlices > 0 ? ConditionState::kTrue
+                                                                         : ConditionState::kFalse;
+            conditionState = conditionState | sliceState;
         }
     } else {
         auto startedCountIt = mSlicedConditionState.find(key);
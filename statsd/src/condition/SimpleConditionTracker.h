@@ -76,7 +76,7 @@ public:
         }
     }
 
-    const std::map<HashableDimensionKey, int>* getSlicedDimensionMap(
+    const std::unordered_map<HashableDimensionKey, int>* getSlicedDimensionMap(
             const std::vector<sp<ConditionTracker>>& allConditions) const override {
         return &mSlicedConditionState;
     }
@@ -118,7 +118,34 @@ private:
     std::set<HashableDimensionKey> mLastChangedToTrueDimensions;
     std::set<HashableDimensionKey> mLastChangedToFalseDimensions;
 
-    std::map<HashableDimensionKey, int> mSlicedConditionState;
+    std::unordered_map<HashableDimensionKey, int> mSlicedConditionState;
+
+    // The number of slices in mSlicedConditionState sharing some values, and how many are true.
+    struct SliceCounts {
+        int slices = 0;
+        int trueSlices = 0;
+    };
+
+    // mSlicedConditionState indexed by the values of the fields queried by a partial link, so
+    // that isConditionMet() finds the slices containing a key without scanning all of them.
+    struct PartialLinkIndex {
+        std::vector<Field> fields;
+        // The positions of the fields in the slices, found in the first slice having them all.
+        std::vector<size_t> positions;
+        std::unordered_map<HashableDimensionKey, SliceCounts> sliceCounts;
+    };
+
+    // One index per distinct set of fields queried, built on the first query and then updated
+    // with mSlicedConditionState.
+    mutable std::vector<PartialLinkIndex> mPartialLinkIndexes;
+
+    // Returns the index of the slices by the fields of key, building it if needed.
+    const PartialLinkIndex& getPartialLinkIndex(const HashableDimensionKey& key) const;
+
+    // Notes that the slice was added (slicesDelta 1) or removed (-1), or became true (trueDelta
+    // 1) or false (-1).
+    void updatePartialLinkIndexes(const HashableDimensionKey& slice, int slicesDelta,
+                                  int trueDelta);
 
     void setMatcherIndices(const SimplePredicate& predicate,
                            const std::unordered_map<int64_t, int>& logTrackerMap);
@@ -135,6 +162,7 @@ private:
 
     FRIEND_TEST(SimpleConditionTrackerTest, TestSlicedCondition);
     FRIEND_TEST(SimpleConditionTrackerTest, TestSlicedWithNoOutputDim);
+    FRIEND_TEST(SimpleConditionTrackerTest, TestSlicedPartialLink);
     FRIEND_TEST(SimpleConditionTrackerTest, TestStopAll);
     FRIEND_TEST(SimpleConditionTrackerTest, TestGuardrailNotHitWhenDefaultFalse);
     FRIEND_TEST(SimpleConditionTrackerTest, TestGuardrailHitWhenDefaultUnknown);
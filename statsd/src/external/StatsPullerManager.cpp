@@ -25,6 +25,8 @@
 
 #include <algorithm>
 #include <iostream>
+#include <optional>
+#include <set>
 
 #include "../StatsService.h"
 #include "../logd/LogEvent.h"
@@ -34,6 +36,7 @@
 #include "TrainInfoPuller.h"
 #include "statslog_statsd.h"
 
+using std::optional;
 using std::shared_ptr;
 using std::vector;
 
@@ -69,6 +72,26 @@ bool StatsPullerManager::Pull(int tagId, const vector<int32_t>& uids, const int6
 bool StatsPullerManager::PullLocked(int tagId, const ConfigKey& configKey,
                                     const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data) {
     vector<int32_t> uids;
+    if (!getPullAtomUidsLocked(tagId, configKey, &uids)) {
+        return false;
+    }
+    return PullLocked(tagId, uids, eventTimeNs, data);
+}
+
+bool StatsPullerManager::PullLocked(int tagId, const vector<int32_t>& uids,
+                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data) {
+    VLOG("Initiating pulling %d", tagId);
+    const PullerIterator pullerIt = findPullerLocked(tagId, uids);
+    if (pullerIt == kAllPullAtomInfo.end()) {
+        return false;  // Return early since we don't know what to pull.
+    }
+    PullErrorCode status = pullerIt->second->Pull(eventTimeNs, data);
+    VLOG("pulled %zu items", data->size());
+    return onPullFinishedLocked(tagId, pullerIt, status);
+}
+
+bool StatsPullerManager::getPullAtomUidsLocked(int tagId, const ConfigKey& configKey,
+                                               vector<int32_t>* uids) {
     const auto& uidProviderIt = mPullUidProviders.find(configKey);
     if (uidProviderIt == mPullUidProviders.end()) {
         ALOGE("Error pulling tag %d. No pull uid provider for config key %s", tagId,
@@ -83,36 +106,38 @@ bool StatsPullerManager::PullLocked(int tagId, const ConfigKey& configKey,
         StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
         return false;
     }
-    uids = pullUidProvider->getPullAtomUids(tagId);
-    return PullLocked(tagId, uids, eventTimeNs, data);
+    *uids = pullUidProvider->getPullAtomUids(tagId);
+    return true;
 }
 
-bool StatsPullerManager::PullLocked(int tagId, const vector<int32_t>& uids,
-                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data) {
-    VLOG("Initiating pulling %d", tagId);
+StatsPullerManager::PullerIterator StatsPullerManager::findPullerLocked(
+        int tagId, const vector<int32_t>& uids) {
     for (int32_t uid : uids) {
         PullerKey key = {.uid = uid, .atomTag = tagId};
         auto pullerIt = kAllPullAtomInfo.find(key);
         if (pullerIt != kAllPullAtomInfo.end()) {
-            PullErrorCode status = pullerIt->second->Pull(eventTimeNs, data);
-            VLOG("pulled %zu items", data->size());
-            if (status != PULL_SUCCESS) {
-                StatsdStats::getInstance().notePullFailed(tagId);
-            }
-            // If we received a dead object exception, it means the client process has died.
-            // We can remove the puller from the map.
-            if (status == PULL_DEAD_OBJECT) {
-                StatsdStats::getInstance().notePullerCallbackRegistrationChanged(
-                        tagId,
-                        /*registered=*/false);
-                kAllPullAtomInfo.erase(pullerIt);
-            }
-            return status == PULL_SUCCESS;
+            return pullerIt;
         }
     }
     StatsdStats::getInstance().notePullerNotFound(tagId);
     ALOGW("StatsPullerManager: Unknown tagId %d", tagId);
-    return false;  // Return early since we don't know what to pull.
+    return kAllPullAtomInfo.end();
+}
+
+bool StatsPullerManager::onPullFinishedLocked(int tagId, PullerIterator pullerIt,
+                                              PullErrorCode status) {
+    if (status != PULL_SUCCESS) {
+        StatsdStats::getInstance().notePullFailed(tagId);
+    }
+    // If we received a dead object exception, it means the client process has died.
+    // We can remove the puller from the map.
+    if (status == PULL_DEAD_OBJECT) {
+        StatsdStats::getInstance().notePullerCallbackRegistrationChanged(
+                tagId,
+                /*registered=*/false);
+        kAllPullAtomInfo.erase(pullerIt);
+    }
+    return status == PULL_SUCCESS;
 }
 
 bool StatsPullerManager::PullerForMatcherExists(int tagId) const {
@@ -253,12 +278,55 @@ void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
             }
         }
     }
-    for (const auto& pullInfo : needToPull) {
+
+    // With mPullPool, the first pull of every puller runs concurrently with the others. The
+    // results are then handled in order, exactly as sequential pulls would be: the following
+    // pulls of a puller are served from its cache, and see it removed if its process died.
+    struct ConcurrentPull {
+        PullerIterator pullerIt;
+        PullErrorCode status;
         vector<shared_ptr<LogEvent>> data;
+    };
+    vector<ConcurrentPull> concurrentPulls;
+    vector<optional<size_t>> concurrentPullIndices(needToPull.size());
+    vector<bool> hasPuller(needToPull.size(), true);
+    if (mPullPool != nullptr) {
+        std::set<PullerKey> pulledKeys;
+        for (size_t i = 0; i < needToPull.size(); i++) {
+            const ReceiverKey& receiverKey = *needToPull[i].first;
+            vector<int32_t> uids;
+            PullerIterator pullerIt = kAllPullAtomInfo.end();
+            if (getPullAtomUidsLocked(receiverKey.atomTag, receiverKey.configKey, &uids)) {
+                pullerIt = findPullerLocked(receiverKey.atomTag, uids);
+            }
+            if (pullerIt == kAllPullAtomInfo.end()) {
+                hasPuller[i] = false;
+            } else if (pulledKeys.insert(pullerIt->first).second) {
+                concurrentPullIndices[i] = concurrentPulls.size();
+                concurrentPulls.push_back({pullerIt, PULL_FAIL, {}});
+            }
+        }
+        mPullPool->parallelFor(concurrentPulls.size(), [&concurrentPulls, elapsedTimeNs](size_t i) {
+            ConcurrentPull& pull = concurrentPulls[i];
+            pull.status = pull.pullerIt->second->Pull(elapsedTimeNs, &pull.data);
+        });
+    }
+
+    for (size_t i = 0; i < needToPull.size(); i++) {
+        const auto& pullInfo = needToPull[i];
+        const int tagId = pullInfo.first->atomTag;
+        vector<shared_ptr<LogEvent>> data;
+        bool pullSucceeded = false;
+        if (concurrentPullIndices[i].has_value()) {
+            ConcurrentPull& pull = concurrentPulls[*concurrentPullIndices[i]];
+            VLOG("pulled %zu items", pull.data.size());
+            data = std::move(pull.data);
+            pullSucceeded = onPullFinishedLocked(tagId, pull.pullerIt, pull.status);
+        } else if (hasPuller[i]) {
+            pullSucceeded = PullLocked(tagId, pullInfo.first->configKey, elapsedTimeNs, &data);
+        }
         PullResult pullResult =
-                PullLocked(pullInfo.first->atomTag, pullInfo.first->configKey, elapsedTimeNs, &data)
-                        ? PullResult::PULL_RESULT_SUCCESS
-                        : PullResult::PULL_RESULT_FAIL;
+                pullSucceeded ? PullResult::PULL_RESULT_SUCCESS : PullResult::PULL_RESULT_FAIL;
         if (pullResult == PullResult::PULL_RESULT_FAIL) {
             VLOG("pull failed at %lld, will try again later", (long long)elapsedTimeNs);
         }
@@ -296,6 +364,15 @@ void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
     updateAlarmLocked();
 }
 
+void StatsPullerManager::enableConcurrentPulls(const size_t threadCount) {
+    std::lock_guard<std::mutex> _l(mLock);
+    if (threadCount == 0) {
+        mPullPool = nullptr;
+    } else {
+        mPullPool = std::make_unique<WorkerPool>(threadCount);
+    }
+}
+
 int StatsPullerManager::ForceClearPullerCache() {
     ATRACE_CALL();
     std::lock_guard<std::mutex> _l(mLock);
@@ -21,6 +21,7 @@
 #include <utils/RefBase.h>
 
 #include <list>
+#include <memory>
 #include <vector>
 
 #include "PullDataReceiver.h"
@@ -29,6 +30,7 @@
 #include "guardrail/StatsdStats.h"
 #include "logd/LogEvent.h"
 #include "packages/UidMap.h"
+#include "utils/WorkerPool.h"
 
 using aidl::android::os::IPullAtomCallback;
 using aidl::android::os::IStatsCompanionService;
@@ -91,6 +93,11 @@ public:
 
     void OnAlarmFired(int64_t elapsedTimeNs);
 
+    // Lets OnAlarmFired() run up to threadCount + 1 pulls at the same time, each on a different
+    // atom. Receivers are still given the pulled data one at a time, in the same order as with
+    // sequential pulls. A threadCount of 0 pulls sequentially, which is the default.
+    void enableConcurrentPulls(size_t threadCount);
+
     // Pulls the most recent data.
     // The data may be served from cache if consecutive pulls come within
     // mCoolDownNs.
@@ -130,6 +137,8 @@ private:
     const static int64_t kMaxTimeoutNs = 10 * NS_PER_SEC;
     shared_ptr<IStatsCompanionService> mStatsCompanionService = nullptr;
 
+    typedef std::map<const PullerKey, sp<StatsPuller>>::iterator PullerIterator;
+
     // A struct containing an atom id and a Config Key
     typedef struct ReceiverKey {
         const int atomTag;
@@ -158,6 +167,16 @@ private:
     bool PullLocked(int tagId, const vector<int32_t>& uids, int64_t eventTimeNs,
                     vector<std::shared_ptr<LogEvent>>* data);
 
+    // Gets the uids to pull tagId from for configKey. Returns false if there is no provider.
+    bool getPullAtomUidsLocked(int tagId, const ConfigKey& configKey, vector<int32_t>* uids);
+
+    // Returns the puller of tagId registered by the first of uids having one.
+    PullerIterator findPullerLocked(int tagId, const vector<int32_t>& uids);
+
+    // Accounts for the status of a pull made with the puller at pullerIt, which is removed if
+    // its process died. Returns true if the pull succeeded.
+    bool onPullFinishedLocked(int tagId, PullerIterator pullerIt, PullErrorCode status);
+
     // locks for data receiver and StatsCompanionService changes
     std::mutex mLock;
 
@@ -165,6 +184,9 @@ private:
 
     int64_t mNextPullTimeNs;
 
+    // Runs the pulls of OnAlarmFired(). Sequential pulls if null.
+    std::unique_ptr<WorkerPool> mPullPool;
+
     FRIEND_TEST(GaugeMetricE2ePulledTest, TestFirstNSamplesPulledNoTrigger);
     FRIEND_TEST(GaugeMetricE2ePulledTest, TestFirstNSamplesPulledNoTriggerWithActivation);
     FRIEND_TEST(GaugeMetricE2ePulledTest, TestRandomSamplePulledEvents);
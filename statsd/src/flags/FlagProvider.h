@@ -42,6 +42,15 @@ const std::string FLAG_TRUE = "true";
 const std::string FLAG_FALSE = "false";
 const std::string FLAG_EMPTY = "";
 
+// Boot flag. Lets MetricsManagers process an event in parallel.
+const std::string PARALLEL_CONFIG_DISPATCH_FLAG = "parallel_config_dispatch";
+
+// Boot flag. Lets the pulls of a pull alarm run concurrently.
+const std::string CONCURRENT_PULLS_FLAG = "concurrent_pulls";
+
+// Boot flag. Number of threads running the pulls when CONCURRENT_PULLS_FLAG is enabled.
+const std::string CONCURRENT_PULL_THREADS_FLAG = "concurrent_pull_threads";
+
 class FlagProvider {
 public:
     static FlagProvider& getInstance();
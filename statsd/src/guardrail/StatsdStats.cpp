@@ -40,6 +40,7 @@ using android::util::FIELD_TYPE_MESSAGE;
 using android::util::FIELD_TYPE_STRING;
 using android::util::FIELD_TYPE_UINT32;
 using android::util::ProtoOutputStream;
+using std::atomic;
 using std::lock_guard;
 using std::shared_ptr;
 using std::string;
@@ -194,6 +195,7 @@ const int FIELD_ID_RESTRICTED_STATS_CATEGORY_CHANGED_COUNT = 6;
 
 const int FIELD_ID_SUBSCRIPTION_STATS_PER_SUBSCRIPTION_STATS = 1;
 const int FIELD_ID_SUBSCRIPTION_STATS_PULL_THREAD_WAKEUP_COUNT = 2;
+const int FIELD_ID_SUBSCRIPTION_STATS_DROPPED_ATOM_COUNT = 3;
 
 const int FIELD_ID_PER_SUBSCRIPTION_STATS_ID = 1;
 const int FIELD_ID_PER_SUBSCRIPTION_STATS_PUSHED_ATOM_COUNT = 2;
@@ -225,8 +227,9 @@ const std::map<int, std::pair<size_t, size_t>> StatsdStats::kAtomDimensionKeySiz
 };
 
 StatsdStats::StatsdStats()
-    : mStatsdStatsId(rand()), mSocketBatchReadHistogram(kNumBinsInSocketBatchReadHistogram) {
-    mPushedAtomStats.resize(kMaxPushedAtomId + 1);
+    : mStatsdStatsId(rand()),
+      mPushedAtomStats(kMaxPushedAtomId + 1),
+      mSocketBatchReadHistogram(kNumBinsInSocketBatchReadHistogram) {
     mStartTimeSec = getWallClockSec();
 }
 
@@ -633,15 +636,30 @@ void StatsdStats::noteConditionDimensionSize(const ConfigKey& key, const int64_t
 }
 
 void StatsdStats::noteMetricDimensionSize(const ConfigKey& key, const int64_t id, int size) {
+    shared_ptr<atomic<int>> stat = getMetricDimensionSizeStat(key, id);
+    if (stat != nullptr) {
+        noteMaxValue(*stat, size);
+    }
+}
+
+shared_ptr<atomic<int>> StatsdStats::getMetricDimensionSizeStat(const ConfigKey& key,
+                                                                const int64_t id) {
     lock_guard<std::mutex> lock(mLock);
-    // if name doesn't exist before, it will create the key with count 0.
     auto statsIt = mConfigStats.find(key);
     if (statsIt == mConfigStats.end()) {
-        return;
+        return nullptr;
     }
-    auto& metricsDimensionMap = statsIt->second->metric_stats;
-    if (size > metricsDimensionMap[id]) {
-        metricsDimensionMap[id] = size;
+    shared_ptr<atomic<int>>& stat = statsIt->second->metric_stats[id];
+    if (stat == nullptr) {
+        stat = std::make_shared<atomic<int>>(0);
+    }
+    return stat;
+}
+
+void StatsdStats::noteMaxValue(atomic<int>& stat, int value) {
+    int current = stat.load(std::memory_order_relaxed);
+    while (value > current &&
+           !stat.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
     }
 }
 
@@ -660,13 +678,23 @@ void StatsdStats::noteMetricDimensionInConditionSize(const ConfigKey& key, const
 }
 
 void StatsdStats::noteMatcherMatched(const ConfigKey& key, const int64_t id) {
-    lock_guard<std::mutex> lock(mLock);
+    shared_ptr<atomic<int>> stat = getMatcherMatchedStat(key, id);
+    if (stat != nullptr) {
+        stat->fetch_add(1, std::memory_order_relaxed);
+    }
+}
 
+shared_ptr<atomic<int>> StatsdStats::getMatcherMatchedStat(const ConfigKey& key, const int64_t id) {
+    lock_guard<std::mutex> lock(mLock);
     auto statsIt = mConfigStats.find(key);
     if (statsIt == mConfigStats.end()) {
-        return;
+        return nullptr;
+    }
+    shared_ptr<atomic<int>>& stat = statsIt->second->matcher_stats[id];
+    if (stat == nullptr) {
+        stat = std::make_shared<atomic<int>>(0);
     }
-    statsIt->second->matcher_stats[id]++;
+    return stat;
 }
 
 void StatsdStats::noteAnomalyDeclared(const ConfigKey& key, const int64_t id) {
@@ -748,15 +776,27 @@ void StatsdStats::notePullExceedMaxDelay(int pullAtomId) {
 }
 
 void StatsdStats::noteAtomLogged(int atomId, int32_t /*timeSec*/, bool isSkipped) {
+    // Platform atoms are counted lock-free, this is called for every event.
+    if (atomId >= 0 && atomId <= kMaxPushedAtomId) {
+        notePlatformAtomLogged(atomId, isSkipped);
+        return;
+    }
     lock_guard<std::mutex> lock(mLock);
 
     noteAtomLoggedLocked(atomId, isSkipped);
 }
 
+void StatsdStats::notePlatformAtomLogged(int atomId, bool isSkipped) {
+    PushedAtomStats& stats = mPushedAtomStats[atomId];
+    stats.logCount.fetch_add(1, std::memory_order_relaxed);
+    if (isSkipped) {
+        stats.skipCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
 void StatsdStats::noteAtomLoggedLocked(int atomId, bool isSkipped) {
     if (atomId >= 0 && atomId <= kMaxPushedAtomId) {
-        mPushedAtomStats[atomId].logCount++;
-        mPushedAtomStats[atomId].skipCount += isSkipped;
+        notePlatformAtomLogged(atomId, isSkipped);
     } else {
         if (atomId < 0) {
             android_errorWriteLog(0x534e4554, "187957589");
@@ -1088,6 +1128,11 @@ void StatsdStats::noteSubscriptionPullThreadWakeup() {
     mSubscriptionPullThreadWakeupCount++;
 }
 
+void StatsdStats::noteSubscriptionAtomDropped() {
+    lock_guard<std::mutex> lock(mLock);
+    mSubscriptionAtomDroppedCount++;
+}
+
 StatsdStats::AtomMetricStats& StatsdStats::getAtomMetricStats(int64_t metricId) {
     auto atomMetricStatsIter = mAtomMetricStats.find(metricId);
     if (atomMetricStatsIter != mAtomMetricStats.end()) {
@@ -1106,7 +1151,10 @@ void StatsdStats::resetInternalLocked() {
     // Reset the historical data, but keep the active ConfigStats
     mStartTimeSec = getWallClockSec();
     mIceBox.clear();
-    std::fill(mPushedAtomStats.begin(), mPushedAtomStats.end(), PushedAtomStats());
+    for (PushedAtomStats& stats : mPushedAtomStats) {
+        stats.logCount.store(0, std::memory_order_relaxed);
+        stats.skipCount.store(0, std::memory_order_relaxed);
+    }
     mNonPlatformPushedAtomStats.clear();
     mAnomalyAlarmRegisteredStats = 0;
     mPeriodicAlarmRegisteredStats = 0;
@@ -1125,9 +1173,15 @@ void StatsdStats::resetInternalLocked() {
         config.second->data_drop_bytes.clear();
         config.second->dump_report_stats.clear();
         config.second->annotations.clear();
-        config.second->matcher_stats.clear();
+        // The matcher and metric counters may be cached by their owners, so zero them instead of
+        // dropping them. Zero entries are not reported.
+        for (auto& stat : config.second->matcher_stats) {
+            stat.second->store(0, std::memory_order_relaxed);
+        }
         config.second->condition_stats.clear();
-        config.second->metric_stats.clear();
+        for (auto& stat : config.second->metric_stats) {
+            stat.second->store(0, std::memory_order_relaxed);
+        }
         config.second->metric_dimension_in_condition_stats.clear();
         config.second->alert_stats.clear();
         config.second->restricted_metric_stats.clear();
@@ -1174,6 +1228,7 @@ void StatsdStats::resetInternalLocked() {
     mPushedAtomDropsStats.clear();
     mRestrictedMetricQueryStats.clear();
     mSubscriptionPullThreadWakeupCount = 0;
+    mSubscriptionAtomDroppedCount = 0;
     std::fill(mSocketBatchReadHistogram.begin(), mSocketBatchReadHistogram.end(), 0);
     mLargeBatchSocketReadStats.clear();
 
@@ -1387,7 +1442,11 @@ void StatsdStats::dumpStats(int out) const {
         }
 
         for (const auto& stats : pair.second->matcher_stats) {
-            dprintf(out, "matcher %lld matched %d times\n", (long long)stats.first, stats.second);
+            const int matchedTimes = stats.second->load(std::memory_order_relaxed);
+            if (matchedTimes > 0) {
+                dprintf(out, "matcher %lld matched %d times\n", (long long)stats.first,
+                        matchedTimes);
+            }
         }
 
         for (const auto& stats : pair.second->condition_stats) {
@@ -1433,17 +1492,19 @@ void StatsdStats::dumpStats(int out) const {
     dprintf(out, "********Pushed Atom stats***********\n");
     const size_t atomCounts = mPushedAtomStats.size();
     for (size_t i = 2; i < atomCounts; i++) {
-        if (mPushedAtomStats[i].logCount > 0) {
+        const int logCount = mPushedAtomStats[i].logCount.load(std::memory_order_relaxed);
+        if (logCount > 0) {
             dprintf(out,
                     "Atom %zu->(total count)%d, (error count)%d, (drop count)%d, (skip count)%d\n",
-                    i, mPushedAtomStats[i].logCount, getPushedAtomErrorsLocked((int)i),
-                    getPushedAtomDropsLocked((int)i), mPushedAtomStats[i].skipCount);
+                    i, logCount, getPushedAtomErrorsLocked((int)i),
+                    getPushedAtomDropsLocked((int)i),
+                    mPushedAtomStats[i].skipCount.load(std::memory_order_relaxed));
         }
     }
     for (const auto& pair : mNonPlatformPushedAtomStats) {
         dprintf(out, "Atom %d->(total count)%d, (error count)%d, (drop count)%d, (skip count)%d\n",
-                pair.first, pair.second.logCount, getPushedAtomErrorsLocked(pair.first),
-                getPushedAtomDropsLocked((int)pair.first), pair.second.skipCount);
+                pair.first, pair.second.logCount.load(), getPushedAtomErrorsLocked(pair.first),
+                getPushedAtomDropsLocked((int)pair.first), pair.second.skipCount.load());
     }
 
     dprintf(out, "********Pulled Atom stats***********\n");
@@ -1595,6 +1656,7 @@ void StatsdStats::dumpStats(int out) const {
 
     dprintf(out, "********Atom Subscription stats***********\n");
     dprintf(out, "Pull thread wakeup count: %d\n", mSubscriptionPullThreadWakeupCount);
+    dprintf(out, "Dropped atom count: %d\n", mSubscriptionAtomDroppedCount);
     for (const auto& [id, subStats] : mSubscriptionStats) {
         dprintf(out,
                 "Subscription %d: pushed_atom_count=%d, pulled_atom_count=%d, flush_count=%d\n", id,
@@ -1742,10 +1804,14 @@ void addConfigStatsToProto(const ConfigStats& configStats, ProtoOutputStream* pr
     }
 
     for (const auto& pair : configStats.matcher_stats) {
+        const int matchedTimes = pair.second->load(std::memory_order_relaxed);
+        if (matchedTimes <= 0) {
+            continue;
+        }
         uint64_t tmpToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
                                           FIELD_ID_CONFIG_STATS_MATCHER_STATS);
         proto->write(FIELD_TYPE_INT64 | FIELD_ID_MATCHER_STATS_ID, (long long)pair.first);
-        proto->write(FIELD_TYPE_INT32 | FIELD_ID_MATCHER_STATS_COUNT, pair.second);
+        proto->write(FIELD_TYPE_INT32 | FIELD_ID_MATCHER_STATS_COUNT, matchedTimes);
         proto->end(tmpToken);
     }
 
@@ -1758,10 +1824,14 @@ void addConfigStatsToProto(const ConfigStats& configStats, ProtoOutputStream* pr
     }
 
     for (const auto& pair : configStats.metric_stats) {
+        const int maxTupleCounts = pair.second->load(std::memory_order_relaxed);
+        if (maxTupleCounts <= 0) {
+            continue;
+        }
         uint64_t tmpToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
                                           FIELD_ID_CONFIG_STATS_METRIC_STATS);
         proto->write(FIELD_TYPE_INT64 | FIELD_ID_METRIC_STATS_ID, (long long)pair.first);
-        proto->write(FIELD_TYPE_INT32 | FIELD_ID_METRIC_STATS_COUNT, pair.second);
+        proto->write(FIELD_TYPE_INT32 | FIELD_ID_METRIC_STATS_COUNT, maxTupleCounts);
         proto->end(tmpToken);
     }
     for (const auto& pair : configStats.metric_dimension_in_condition_stats) {
@@ -1856,11 +1926,12 @@ void StatsdStats::dumpStats(vector<uint8_t>* output, bool reset) {
 
     const size_t atomCounts = mPushedAtomStats.size();
     for (size_t i = 2; i < atomCounts; i++) {
-        if (mPushedAtomStats[i].logCount > 0) {
+        const int logCount = mPushedAtomStats[i].logCount.load(std::memory_order_relaxed);
+        if (logCount > 0) {
             uint64_t token =
                     proto.start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM_STATS | FIELD_COUNT_REPEATED);
             proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_TAG, (int32_t)i);
-            proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_COUNT, mPushedAtomStats[i].logCount);
+            proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_COUNT, logCount);
             const int errors = getPushedAtomErrorsLocked(i);
             writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_ERROR_COUNT, errors,
                                      &proto);
@@ -1868,7 +1939,8 @@ void StatsdStats::dumpStats(vector<uint8_t>* output, bool reset) {
             writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_DROPS_COUNT, drops,
                                      &proto);
             writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_SKIP_COUNT,
-                                     mPushedAtomStats[i].skipCount, &proto);
+                                     mPushedAtomStats[i].skipCount.load(std::memory_order_relaxed),
+                                     &proto);
             proto.end(token);
         }
     }
@@ -1877,14 +1949,14 @@ void StatsdStats::dumpStats(vector<uint8_t>* output, bool reset) {
         uint64_t token =
                 proto.start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM_STATS | FIELD_COUNT_REPEATED);
         proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_TAG, pair.first);
-        proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_COUNT, pair.second.logCount);
+        proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_COUNT, pair.second.logCount.load());
         const int errors = getPushedAtomErrorsLocked(pair.first);
         writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_ERROR_COUNT, errors,
                                  &proto);
         const int drops = getPushedAtomDropsLocked(pair.first);
         writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_DROPS_COUNT, drops, &proto);
         writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_SKIP_COUNT,
-                                 pair.second.skipCount, &proto);
+                                 pair.second.skipCount.load(), &proto);
         proto.end(token);
     }
 
@@ -2026,6 +2098,8 @@ void StatsdStats::dumpStats(vector<uint8_t>* output, bool reset) {
     writeNonZeroStatToStream(
             FIELD_TYPE_INT32 | FIELD_ID_SUBSCRIPTION_STATS_PULL_THREAD_WAKEUP_COUNT,
             mSubscriptionPullThreadWakeupCount, &proto);
+    writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_SUBSCRIPTION_STATS_DROPPED_ATOM_COUNT,
+                             mSubscriptionAtomDroppedCount, &proto);
     proto.end(token);
 
     // libstatssocket specific stats
@@ -19,7 +19,9 @@
 #include <log/log_time.h>
 #include <src/guardrail/stats_log_enums.pb.h>
 
+#include <atomic>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -112,7 +114,9 @@ struct ConfigStats {
     std::list<DumpReportStats> dump_report_stats;
 
     // Stores how many times a matcher have been matched. The map size is capped by kMaxConfigCount.
-    std::map<const int64_t, int> matcher_stats;
+    // The counters are shared with the MetricsManager of the config, which increments them without
+    // holding StatsdStats::mLock. See StatsdStats::getMatcherMatchedStat().
+    std::map<const int64_t, std::shared_ptr<std::atomic<int>>> matcher_stats;
 
     // Stores the number of output tuple of condition trackers when it's bigger than
     // kDimensionKeySizeSoftLimit. When you see the number is kDimensionKeySizeHardLimit +1,
@@ -122,7 +126,9 @@ struct ConfigStats {
     // Stores the number of output tuple of metric producers when it's bigger than
     // kDimensionKeySizeSoftLimit. When you see the number is kDimensionKeySizeHardLimit +1,
     // it means some data has been dropped. The map size is capped by kMaxConfigCount.
-    std::map<const int64_t, int> metric_stats;
+    // The values are shared with the metric producers, which update them without holding
+    // StatsdStats::mLock. See StatsdStats::getMetricDimensionSizeStat().
+    std::map<const int64_t, std::shared_ptr<std::atomic<int>>> metric_stats;
 
     // Stores the max number of output tuple of dimensions in condition across dimensions in what
     // when it's bigger than kDimensionKeySizeSoftLimit. When you see the number is
@@ -235,13 +241,6 @@ public:
     /* Minimum period between two broadcasts in nanoseconds. */
     static const int64_t kMinBroadcastPeriodNs = 60 * NS_PER_SEC;
 
-    /* Min period between two checks of byte size per config key in nanoseconds. */
-    static const int64_t kMinByteSizeCheckPeriodNs = 1 * 60 * NS_PER_SEC;
-
-    // Min period between two checks of byte size per config key in nanoseconds for V2 memory
-    // calculations.
-    static const int64_t kMinByteSizeV2CheckPeriodNs = 5 * 60 * NS_PER_SEC;
-
     /* Min period between two checks of restricted metrics TTLs. */
     static const int64_t kMinTtlCheckPeriodNs = 60 * 60 * NS_PER_SEC;
 
@@ -445,6 +444,34 @@ public:
      */
     void noteMatcherMatched(const ConfigKey& key, int64_t id);
 
+    /**
+     * Returns the counter of how many times a matcher has been matched, creating it if needed.
+     * The caller may cache the counter and increment it directly, without going through
+     * StatsdStats. Returns nullptr if there is no valid config for the key.
+     *
+     * The counter is tied to the ConfigStats of the config at the time of the call. Callers must
+     * fetch it again after noteConfigReceived() is called for the same key.
+     *
+     * [key]: The config key that this matcher belongs to.
+     * [id]: The id of the matcher.
+     */
+    std::shared_ptr<std::atomic<int>> getMatcherMatchedStat(const ConfigKey& key, int64_t id);
+
+    /**
+     * Returns the max output tuple size of a metric, creating it if needed. The caller may cache
+     * it and update it with noteMaxValue(). Returns nullptr if there is no valid config for the
+     * key. The same lifetime rules as getMatcherMatchedStat() apply.
+     *
+     * [key]: The config key that this metric belongs to.
+     * [id]: The id of the metric.
+     */
+    std::shared_ptr<std::atomic<int>> getMetricDimensionSizeStat(const ConfigKey& key, int64_t id);
+
+    /**
+     * Raises stat to value if value is bigger, without taking any lock.
+     */
+    static void noteMaxValue(std::atomic<int>& stat, int value);
+
     /**
      * Report that an anomaly detection alert has been declared.
      *
@@ -722,6 +749,12 @@ public:
      */
     void noteSubscriptionPullThreadWakeup();
 
+    /**
+     * Report an atom was dropped because a file descriptor subscription did not read its data
+     * fast enough.
+     */
+    void noteSubscriptionAtomDropped();
+
     void noteBatchSocketRead(int32_t size, int64_t lastReadTimeNs, int64_t currReadTimeNs,
                              int64_t minAtomReadTimeNs, int64_t maxAtomReadTimeNs,
                              const std::unordered_map<int32_t, int32_t>& atomCounts);
@@ -856,9 +889,11 @@ private:
     // The size of the vector is the largest pushed atom id in atoms.proto + 1. Atoms
     // out of that range will be put in mNonPlatformPushedAtomStats.
     // This is a vector, not a map because it will be accessed A LOT -- for each stats log.
+    // The counters in the vector are updated without holding mLock; the entries of
+    // mNonPlatformPushedAtomStats are only touched under mLock.
     struct PushedAtomStats {
-        int logCount = 0;
-        int skipCount = 0;
+        std::atomic<int> logCount{0};
+        std::atomic<int> skipCount{0};
     };
 
     std::vector<PushedAtomStats> mPushedAtomStats;
@@ -1023,6 +1058,8 @@ private:
 
     int32_t mSubscriptionPullThreadWakeupCount = 0;
 
+    int32_t mSubscriptionAtomDroppedCount = 0;
+
     // Maps Subscription ID to the corresponding SubscriptionStats struct object.
     // Size of this map is capped by ShellSubscriber::kMaxSubscriptions.
     std::map<int32_t, SubscriptionStats> mSubscriptionStats;
@@ -1042,6 +1079,9 @@ private:
 
     void noteAtomLoggedLocked(int atomId, bool isSkipped);
 
+    // Lock-free. atomId must be in [0, kMaxPushedAtomId].
+    void notePlatformAtomLogged(int atomId, bool isSkipped);
+
     void noteAtomDroppedLocked(int atomId);
 
     void noteDataDropped(const ConfigKey& key, const size_t totalBytes, int32_t timeSec);
@@ -1096,6 +1136,7 @@ private:
     FRIEND_TEST(StatsdStatsTest, TestSocketLossStats);
     FRIEND_TEST(StatsdStatsTest, TestSocketLossStatsOverflowCounter);
     FRIEND_TEST(StatsdStatsTest, TestSubStats);
+    FRIEND_TEST(StatsdStatsTest, TestSubscriptionAtomDropped);
     FRIEND_TEST(StatsdStatsTest, TestSubscriptionAtomPulled);
     FRIEND_TEST(StatsdStatsTest, TestSubscriptionEnded);
     FRIEND_TEST(StatsdStatsTest, TestSubscriptionFlushed);
@@ -19,6 +19,8 @@
 
 #include "logd/LogEvent.h"
 
+#include <algorithm>
+
 #include <android-base/stringprintf.h>
 #include <android/binder_ibinder.h>
 #include <private/android_filesystem_config.h>
@@ -111,10 +113,9 @@ void LogEvent::parseString(int32_t* pos, int32_t depth, bool* last, uint8_t numA
         return;
     }
 
-    string value = string((char*)mBuf, numBytes);
+    addBytesToValues(pos, depth, last, STRING, numBytes);
     mBuf += numBytes;
     mRemainingLen -= numBytes;
-    addToValues(pos, depth, value, last);
     parseAnnotations(numAnnotations);
 }
 
@@ -138,10 +139,9 @@ void LogEvent::parseByteArray(int32_t* pos, int32_t depth, bool* last, uint8_t n
         return;
     }
 
-    vector<uint8_t> value(mBuf, mBuf + numBytes);
+    addBytesToValues(pos, depth, last, STORAGE, numBytes);
     mBuf += numBytes;
     mRemainingLen -= numBytes;
-    addToValues(pos, depth, value, last);
     parseAnnotations(numAnnotations);
 }
 
@@ -534,6 +534,13 @@ LogEvent::BodyBufferInfo LogEvent::parseHeader(const uint8_t* buf, size_t len) {
     return bodyInfo;
 }
 
+bool LogEvent::parseBodyLazy(const BodyBufferInfo& bodyInfo) {
+    mLazyBody = &bodyInfo;
+    const bool valid = parseBody(bodyInfo);
+    mLazyBody = nullptr;
+    return valid;
+}
+
 bool LogEvent::parseBody(const BodyBufferInfo& bodyInfo) {
     mParsedHeaderOnly = false;
 
@@ -618,7 +625,7 @@ bool LogEvent::parseBuffer(const uint8_t* buf, size_t len) {
 int64_t LogEvent::GetLong(size_t key, status_t* err) const {
     // TODO(b/110561208): encapsulate the magical operations in Field struct as static functions
     int field = getSimpleField(key);
-    for (const auto& value : mValues) {
+    for (const auto& value : getValues()) {
         if (value.mField.getField() == field) {
             if (value.mValue.getType() == LONG) {
                 return value.mValue.long_value;
@@ -640,7 +647,7 @@ int64_t LogEvent::GetLong(size_t key, status_t* err) const {
 
 int LogEvent::GetInt(size_t key, status_t* err) const {
     int field = getSimpleField(key);
-    for (const auto& value : mValues) {
+    for (const auto& value : getValues()) {
         if (value.mField.getField() == field) {
             if (value.mValue.getType() == INT) {
                 return value.mValue.int_value;
@@ -660,10 +667,10 @@ int LogEvent::GetInt(size_t key, status_t* err) const {
 
 const char* LogEvent::GetString(size_t key, status_t* err) const {
     int field = getSimpleField(key);
-    for (const auto& value : mValues) {
+    for (const auto& value : getValues()) {
         if (value.mField.getField() == field) {
             if (value.mValue.getType() == STRING) {
-                return value.mValue.str_value.c_str();
+                return value.mValue.getCString();
             } else {
                 *err = BAD_TYPE;
                 return 0;
@@ -680,7 +687,7 @@ const char* LogEvent::GetString(size_t key, status_t* err) const {
 
 bool LogEvent::GetBool(size_t key, status_t* err) const {
     int field = getSimpleField(key);
-    for (const auto& value : mValues) {
+    for (const auto& value : getValues()) {
         if (value.mField.getField() == field) {
             if (value.mValue.getType() == INT) {
                 return value.mValue.int_value != 0;
@@ -702,7 +709,7 @@ bool LogEvent::GetBool(size_t key, status_t* err) const {
 
 float LogEvent::GetFloat(size_t key, status_t* err) const {
     int field = getSimpleField(key);
-    for (const auto& value : mValues) {
+    for (const auto& value : getValues()) {
         if (value.mField.getField() == field) {
             if (value.mValue.getType() == FLOAT) {
                 return value.mValue.float_value;
@@ -722,10 +729,10 @@ float LogEvent::GetFloat(size_t key, status_t* err) const {
 
 std::vector<uint8_t> LogEvent::GetStorage(size_t key, status_t* err) const {
     int field = getSimpleField(key);
-    for (const auto& value : mValues) {
+    for (const auto& value : getValues()) {
         if (value.mField.getField() == field) {
             if (value.mValue.getType() == STORAGE) {
-                return value.mValue.storage_value;
+                return value.mValue.getStorage();
             } else {
                 *err = BAD_TYPE;
                 return vector<uint8_t>();
@@ -760,7 +767,7 @@ string LogEvent::ToString() const {
         return result;
     }
 
-    for (const auto& value : mValues) {
+    for (const auto& value : getValues()) {
         result += StringPrintf("%#x", value.mField.getField()) + "->" + value.mValue.toString();
         result += value.mAnnotations.toString() + " ";
     }
@@ -772,6 +779,43 @@ void LogEvent::ToProto(ProtoOutputStream& protoOutput) const {
     writeFieldValueTreeToStream(mTagId, getValues(), &protoOutput);
 }
 
+std::string_view LogEvent::getStringValue(size_t index) const {
+    const auto it = std::lower_bound(
+            mLazyValues.begin(), mLazyValues.end(), index,
+            [](const LazyValue& lazyValue, size_t i) { return lazyValue.index < i; });
+    if (it != mLazyValues.end() && it->index == index) {
+        return std::string_view((const char*)mPayload->data() + it->offset, it->size);
+    }
+    return mValues[index].mValue.getString();
+}
+
+void LogEvent::setStringValue(size_t index, std::string_view str) {
+    mValues[index].mValue.setString(str);
+    const auto it = std::lower_bound(
+            mLazyValues.begin(), mLazyValues.end(), index,
+            [](const LazyValue& lazyValue, size_t i) { return lazyValue.index < i; });
+    if (it != mLazyValues.end() && it->index == index) {
+        mLazyValues.erase(it);
+        if (mLazyValues.empty()) {
+            mPayload.reset();
+        }
+    }
+}
+
+void LogEvent::decodeLazyValues() const {
+    for (const LazyValue& lazyValue : mLazyValues) {
+        Value& value = mValues[lazyValue.index].mValue;
+        const uint8_t* bytes = mPayload->data() + lazyValue.offset;
+        if (value.getType() == STRING) {
+            value.setString(std::string_view((const char*)bytes, lazyValue.size));
+        } else {
+            value.setStorage(bytes, lazyValue.size);
+        }
+    }
+    mLazyValues.clear();
+    mPayload.reset();
+}
+
 bool LogEvent::hasAttributionChain(std::pair<size_t, size_t>* indexRange) const {
     if (!mAttributionChainStartIndex || !mAttributionChainEndIndex) {
         return false;
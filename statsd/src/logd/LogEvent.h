@@ -19,8 +19,10 @@
 #include <android/util/ProtoOutputStream.h>
 #include <private/android_logger.h>
 
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "FieldValue.h"
@@ -115,6 +117,16 @@ public:
      */
     bool parseBody(const BodyBufferInfo& bodyInfo);
 
+    /**
+     * @brief Same as parseBody(), but STRING and STORAGE values are not decoded.
+     * The body is copied and the values stay in the copy until an accessor needs them, at which
+     * point all of them are decoded at once (see materializeValues()). Field positions, types,
+     * annotations and numeric values are available right away through getLazyValues().
+     * Should be called only with BodyBufferInfo when logEvent.isValid() == true
+     * \return success of the parsing
+     */
+    bool parseBodyLazy(const BodyBufferInfo& bodyInfo);
+
     // Constructs a BinaryPushStateChanged LogEvent from API call.
     explicit LogEvent(const std::string& trainName, int64_t trainVersionCode, bool requiresStaging,
                       bool rollbackEnabled, bool requiresLowLatencyMonitor, int32_t state,
@@ -190,13 +202,54 @@ public:
     }
 
     const std::vector<FieldValue>& getValues() const {
+        materializeValues();
         return mValues;
     }
 
     std::vector<FieldValue>* getMutableValues() {
+        materializeValues();
+        return &mValues;
+    }
+
+    /**
+     * Returns the values without decoding the STRING and STORAGE values deferred by
+     * parseBodyLazy(). Those have the right field, type and annotations but an empty content,
+     * use getStringValue() to read strings.
+     */
+    const std::vector<FieldValue>& getLazyValues() const {
+        return mValues;
+    }
+
+    /**
+     * Same as getLazyValues(). Only numeric values may be modified.
+     */
+    std::vector<FieldValue>* getMutableLazyValues() {
         return &mValues;
     }
 
+    /**
+     * Returns the content of the STRING value at the given index of getLazyValues(), without
+     * decoding it. The view is valid until the event is modified or destroyed.
+     */
+    std::string_view getStringValue(size_t index) const;
+
+    /**
+     * Replaces the content of the STRING value at the given index of getLazyValues(), without
+     * decoding the other values deferred by parseBodyLazy().
+     */
+    void setStringValue(size_t index, std::string_view str);
+
+    /**
+     * Decodes the values deferred by parseBodyLazy(). Called by the accessors that need them.
+     * This is not thread safe, even though it is const: call it before sharing an event
+     * parsed with parseBodyLazy() between threads.
+     */
+    void materializeValues() const {
+        if (!mLazyValues.empty()) {
+            decodeLazyValues();
+        }
+    }
+
     // Default value = false
     inline bool shouldTruncateTimestamp() const {
         return mTruncateTimestamp;
@@ -233,6 +286,7 @@ public:
 
     template <class T>
     status_t updateValue(size_t key, T& value, Type type) {
+        materializeValues();
         int field = getSimpleField(key);
         for (auto& fieldValue : mValues) {
             if (fieldValue.mField.getField() == field) {
@@ -298,6 +352,7 @@ private:
     void parseFieldRestrictionAnnotation(uint8_t annotationType);
     bool checkPreviousValueType(Type expected) const;
     bool getRestrictedMetricsFlag();
+    void decodeLazyValues() const;
 
     /**
      * The below two variables are only valid during the execution of
@@ -306,6 +361,7 @@ private:
      */
     const uint8_t* mBuf;
     uint32_t mRemainingLen; // number of valid bytes left in the buffer being parsed
+    const BodyBufferInfo* mLazyBody = nullptr;  // body being parsed by parseBodyLazy()
 
     bool mValid = true; // stores whether the event we received from the socket is valid
 
@@ -351,9 +407,50 @@ private:
         mValues.push_back(FieldValue(f, v));
     }
 
+    // Adds a STRING or STORAGE value of numBytes bytes starting at mBuf. When parsing lazily,
+    // the value is added empty and its bytes are decoded later from mPayload.
+    void addBytesToValues(int32_t* pos, int32_t depth, bool* last, Type type, uint32_t numBytes) {
+        if (mLazyBody != nullptr && numBytes > 0) {
+            if (mPayload == nullptr) {
+                mPayload = std::make_shared<const std::vector<uint8_t>>(
+                        mLazyBody->buffer, mLazyBody->buffer + mLazyBody->bufferSize);
+            }
+            mLazyValues.push_back({(uint32_t)mValues.size(),
+                                   (uint32_t)(mBuf - mLazyBody->buffer), numBytes});
+            numBytes = 0;
+        }
+
+        Field f = Field(mTagId, pos, depth);
+        // only decorate last position for depths with repeated fields (depth 1)
+        if (depth > 0 && last[1]) f.decorateLastPos(1);
+
+        Value v;
+        if (type == STRING) {
+            v.setString(std::string_view((const char*)mBuf, numBytes));
+        } else {
+            v.setStorage(mBuf, numBytes);
+        }
+        mValues.emplace_back(f, std::move(v));
+    }
+
     // The items are naturally sorted in DFS order as we read them. this allows us to do fast
     // matching.
-    std::vector<FieldValue> mValues;
+    // Decoded lazily for events parsed with parseBodyLazy(), hence mutable.
+    mutable std::vector<FieldValue> mValues;
+
+    // A STRING or STORAGE value of mValues whose content is still in mPayload.
+    struct LazyValue {
+        uint32_t index;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // Sorted by index. Empty once all values are decoded.
+    mutable std::vector<LazyValue> mLazyValues;
+
+    // Copy of the body buffer holding the content of mLazyValues. Never modified, so that copies
+    // of the event share it.
+    mutable std::shared_ptr<const std::vector<uint8_t>> mPayload;
 
     // The timestamp set by the logd.
     int64_t mLogdTimestampNs;
@@ -19,42 +19,190 @@
 
 #include "LogEventQueue.h"
 
+#include <algorithm>
+#include <thread>
+
 namespace android {
 namespace os {
 namespace statsd {
 
 using std::unique_lock;
 using std::unique_ptr;
+using std::vector;
 
-unique_ptr<LogEvent> LogEventQueue::waitPop() {
-    std::unique_lock<std::mutex> lock(mMutex);
+namespace {
+
+// Number of polls of the head slot before the consumer parks on the condition variable. Bursts
+// of events usually arrive back to back, so a short spin avoids a park/wake round trip.
+constexpr int kConsumerSpinCount = 64;
+
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+}  // anonymous namespace
 
-    if (mQueue.empty()) {
-        mCondition.wait(lock, [this] { return !this->mQueue.empty(); });
+LogEventQueue::LogEventQueue(size_t maxSize)
+    : mQueueLimit(maxSize),
+      mCapacity(roundUpToPowerOfTwo(std::max<size_t>(maxSize, 1))),
+      mMask(mCapacity - 1),
+      mSlots(new Slot[mCapacity]),
+      mSize(0),
+      mTail(0),
+      mHead(0),
+      mConsumerWaiting(false) {
+    for (size_t i = 0; i < mCapacity; i++) {
+        mSlots[i].sequence.store(i, std::memory_order_relaxed);
+        mSlots[i].elapsedTimestampNs.store(0, std::memory_order_relaxed);
     }
+}
 
-    unique_ptr<LogEvent> item = std::move(mQueue.front());
-    mQueue.pop();
+bool LogEventQueue::isHeadReady() const {
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    return mSlots[head & mMask].sequence.load(std::memory_order_acquire) == head + 1;
+}
+
+unique_ptr<LogEvent> LogEventQueue::tryPop() {
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    Slot& slot = mSlots[head & mMask];
+    if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+        // Either empty, or a producer claimed the position but has not published it yet.
+        return nullptr;
+    }
 
+    unique_ptr<LogEvent> item = std::move(slot.event);
+    // Hand the slot over to the producer that will claim position head + mCapacity.
+    slot.sequence.store(head + mCapacity, std::memory_order_release);
+    mHead.store(head + 1, std::memory_order_relaxed);
+    mSize.fetch_sub(1, std::memory_order_release);
     return item;
 }
 
+void LogEventQueue::waitForData() {
+    for (int i = 0; i < kConsumerSpinCount; i++) {
+        if (isHeadReady()) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    unique_lock<std::mutex> lock(mMutex);
+    mConsumerWaiting.store(true, std::memory_order_seq_cst);
+    // Pairs with the fence in notifyConsumer(): either the producer observes mConsumerWaiting and
+    // notifies, or this thread observes the published slot in the predicate.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    mCondition.wait(lock, [this] { return isHeadReady(); });
+    mConsumerWaiting.store(false, std::memory_order_relaxed);
+}
+
+unique_ptr<LogEvent> LogEventQueue::waitPop() {
+    while (true) {
+        unique_ptr<LogEvent> item = tryPop();
+        if (item != nullptr) {
+            return item;
+        }
+        waitForData();
+    }
+}
+
+size_t LogEventQueue::waitPopN(vector<unique_ptr<LogEvent>>& events, size_t maxCount) {
+    if (maxCount == 0) {
+        return 0;
+    }
+    events.push_back(waitPop());
+    size_t count = 1;
+    while (count < maxCount) {
+        unique_ptr<LogEvent> item = tryPop();
+        if (item == nullptr) {
+            break;
+        }
+        events.push_back(std::move(item));
+        count++;
+    }
+    return count;
+}
+
+int64_t LogEventQueue::getOldestTimestampNs() const {
+    // The head slot may be popped concurrently; its timestamp is read from the slot so this is
+    // safe, at worst reporting the timestamp of the next event in line.
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    return mSlots[head & mMask].elapsedTimestampNs.load(std::memory_order_relaxed);
+}
+
+void LogEventQueue::publish(size_t position, unique_ptr<LogEvent> item) {
+    Slot& slot = mSlots[position & mMask];
+    // The reservation of the producer guarantees the consumer has released this slot, but its
+    // release store may not be visible yet.
+    while (slot.sequence.load(std::memory_order_acquire) != position) {
+        std::this_thread::yield();
+    }
+    slot.elapsedTimestampNs.store(item->GetElapsedTimestampNs(), std::memory_order_relaxed);
+    slot.event = std::move(item);
+    slot.sequence.store(position + 1, std::memory_order_release);
+}
+
+void LogEventQueue::notifyConsumer() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mConsumerWaiting.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCondition.notify_one();
+    }
+}
+
 LogEventQueue::Result LogEventQueue::push(unique_ptr<LogEvent> item) {
     Result result;
-    {
-        std::unique_lock<std::mutex> lock(mMutex);
-        if (mQueue.size() < mQueueLimit) {
-            mQueue.push(std::move(item));
-            result.success = true;
-        } else {
-            // safe operation as queue must not be empty.
-            result.oldestTimestampNs = mQueue.front()->GetElapsedTimestampNs();
-            result.success = false;
-        }
-        result.size = mQueue.size();
+
+    // Reserve room first so that the queue never holds more than mQueueLimit events, and so that
+    // the position claimed below is guaranteed to have been released by the consumer.
+    const size_t previousSize = mSize.fetch_add(1, std::memory_order_acq_rel);
+    if (previousSize >= mQueueLimit) {
+        mSize.fetch_sub(1, std::memory_order_relaxed);
+        result.oldestTimestampNs = getOldestTimestampNs();
+        result.success = false;
+        result.size = previousSize;
+        return result;
     }
 
-    mCondition.notify_one();
+    const size_t position = mTail.fetch_add(1, std::memory_order_relaxed);
+    publish(position, std::move(item));
+
+    result.success = true;
+    result.size = previousSize + 1;
+    notifyConsumer();
+    return result;
+}
+
+LogEventQueue::BatchResult LogEventQueue::pushBatch(vector<unique_ptr<LogEvent>>& events) {
+    BatchResult result;
+
+    // Reserve room for as much of the batch as fits, with the same guarantees as in push().
+    size_t previousSize = mSize.load(std::memory_order_relaxed);
+    size_t count = 0;
+    do {
+        count = previousSize >= mQueueLimit ? 0
+                                            : std::min(events.size(), mQueueLimit - previousSize);
+    } while (count > 0 && !mSize.compare_exchange_weak(previousSize, previousSize + count,
+                                                       std::memory_order_acq_rel,
+                                                       std::memory_order_relaxed));
+    result.count = count;
+    result.size = previousSize + count;
+    if (count < events.size()) {
+        result.oldestTimestampNs = getOldestTimestampNs();
+    }
+    if (count == 0) {
+        return result;
+    }
+
+    result.lastTimestampNs = events[count - 1]->GetElapsedTimestampNs();
+    const size_t position = mTail.fetch_add(count, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        publish(position + i, std::move(events[i]));
+    }
+    notifyConsumer();
     return result;
 }
 
@@ -16,11 +16,11 @@
 
 #pragma once
 
-#include <gtest/gtest_prod.h>
-
+#include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <vector>
 
 #include "LogEvent.h"
 
@@ -30,16 +30,30 @@ namespace statsd {
 
 /**
  * A zero copy thread safe queue buffer for producing and consuming LogEvent.
+ *
+ * The queue is a bounded lock-free ring buffer supporting multiple producers and a single
+ * consumer. Producers never take a lock unless the consumer is parked waiting for data, in which
+ * case the first producer to publish wakes it up. The ring slots are preallocated on
+ * construction, the LogEvent objects themselves are not.
  */
 class LogEventQueue {
 public:
-    explicit LogEventQueue(size_t maxSize) : mQueueLimit(maxSize){};
+    explicit LogEventQueue(size_t maxSize);
 
     /**
      * Blocking read one event from the queue.
+     * Must only be called from a single consumer thread.
      */
     std::unique_ptr<LogEvent> waitPop();
 
+    /**
+     * Blocking read of up to maxCount events from the queue. Blocks until at least one event is
+     * available, then drains whatever is ready without blocking again. Events are appended to
+     * the output vector in queue order. Returns the number of events appended.
+     * Must only be called from a single consumer thread.
+     */
+    size_t waitPopN(std::vector<std::unique_ptr<LogEvent>>& events, size_t maxCount);
+
     struct Result {
         bool success = false;
         int64_t oldestTimestampNs = 0;
@@ -50,22 +64,86 @@ public:
      * Puts a LogEvent ptr to the end of the queue.
      * Returns false on failure when the queue is full, and output the oldest event timestamp
      * in the queue. Returns true on success and new queue size.
+     * Safe to be called concurrently from multiple producer threads.
      */
     Result push(std::unique_ptr<LogEvent> event);
 
+    struct BatchResult {
+        // Number of events pushed, taken from the front of the batch.
+        size_t count = 0;
+        // Oldest event timestamp in the queue, set when some events did not fit.
+        int64_t oldestTimestampNs = 0;
+        // Timestamp of the last event pushed, set when count > 0.
+        int64_t lastTimestampNs = 0;
+        int32_t size = 0;
+    };
+
+    /**
+     * Puts the LogEvent ptrs of a batch to the end of the queue, in order. Room for the batch is
+     * reserved at once and the consumer is woken up at most once. The events pushed are moved
+     * out of the vector; the ones that did not fit because the queue is full are left at its
+     * end, from index count on. Returns the new queue size.
+     * Safe to be called concurrently from multiple producer threads.
+     */
+    BatchResult pushBatch(std::vector<std::unique_ptr<LogEvent>>& events);
+
+    /**
+     * Returns the number of events currently held by the queue.
+     */
+    size_t size() const {
+        return mSize.load(std::memory_order_acquire);
+    }
+
 private:
+    struct Slot {
+        // Sequence number used to hand the slot over between producers and the consumer.
+        // Equal to position when the slot is free for the producer claiming that position, and
+        // to position + 1 once the event at that position is published.
+        std::atomic<size_t> sequence;
+        // Kept next to the event so that a failing producer can report the oldest timestamp
+        // without touching a LogEvent that the consumer may be releasing concurrently.
+        std::atomic<int64_t> elapsedTimestampNs;
+        std::unique_ptr<LogEvent> event;
+    };
+
+    // Pops one published event, or returns nullptr if the head slot is not ready yet.
+    std::unique_ptr<LogEvent> tryPop();
+
+    // Returns true if the event at the head of the queue is published.
+    bool isHeadReady() const;
+
+    // Parks the consumer until a producer publishes an event.
+    void waitForData();
+
+    // Returns the timestamp of the event at the head of the queue, for overflow reports.
+    int64_t getOldestTimestampNs() const;
+
+    // Stores the event in the slot of a position claimed by this producer and publishes it.
+    void publish(size_t position, std::unique_ptr<LogEvent> item);
+
+    // Wakes the consumer up if it is parked. Called once the producer published its events.
+    void notifyConsumer();
+
     const size_t mQueueLimit;
-    std::condition_variable mCondition;
-    std::mutex mMutex;
-    std::queue<std::unique_ptr<LogEvent>> mQueue;
+    const size_t mCapacity;
+    const size_t mMask;
+    std::unique_ptr<Slot[]> mSlots;
+
+    // Number of events pushed and not yet consumed. Reserved by a producer before it claims a
+    // position, which keeps the queue bounded by mQueueLimit exactly.
+    std::atomic<size_t> mSize;
 
-    friend class SocketParseMessageTest;
+    // Next position to be claimed by a producer.
+    alignas(64) std::atomic<size_t> mTail;
 
-    FRIEND_TEST(SocketParseMessageTest, TestProcessMessage);
-    FRIEND_TEST(SocketParseMessageTest, TestProcessMessageEmptySetExplicitSet);
-    FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterCompleteSet);
-    FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterPartialSet);
-    FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterToggle);
+    // Next position to be consumed. Only written by the consumer thread; read by producers to
+    // report the oldest timestamp on overflow.
+    alignas(64) std::atomic<size_t> mHead;
+
+    // Consumer parking. Only used when the queue runs empty.
+    std::atomic<bool> mConsumerWaiting;
+    std::condition_variable mCondition;
+    std::mutex mMutex;
 };
 
 }  // namespace statsd
@@ -88,10 +88,11 @@ int main(int /*argc*/, char** /*argv*/) {
     ABinderProcess_startThreadPool();
 
     // Initialize boot flags
-    FlagProvider::getInstance().initBootFlags({});
+    FlagProvider::getInstance().initBootFlags(
+            {PARALLEL_CONFIG_DISPATCH_FLAG, CONCURRENT_PULLS_FLAG, CONCURRENT_PULL_THREADS_FLAG});
 
     std::shared_ptr<LogEventQueue> eventQueue =
-            std::make_shared<LogEventQueue>(50000); /*buffer limit. Buffer is NOT pre-allocated*/
+            std::make_shared<LogEventQueue>(50000); /*buffer limit. Only slots are pre-allocated*/
 
     sp<UidMap> uidMap = UidMap::getInstance();
 
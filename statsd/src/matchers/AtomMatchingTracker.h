@@ -88,6 +88,12 @@ public:
         return mAtomIds;
     }
 
+    // Get the indices of the child AtomMatchingTrackers that are evaluated by this matcher.
+    virtual const std::vector<int>& getChildren() const {
+        static const std::vector<int> kNoChildren;
+        return kNoChildren;
+    }
+
     int64_t getId() const {
         return mId;
     }
@@ -47,6 +47,10 @@ public:
                     std::vector<MatchingState>& matcherResults,
                     std::vector<std::shared_ptr<LogEvent>>& matcherTransformations) override;
 
+    const std::vector<int>& getChildren() const override {
+        return mChildren;
+    }
+
 private:
     LogicalOperation mLogicalOperation;
 
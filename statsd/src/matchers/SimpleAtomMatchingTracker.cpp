@@ -30,7 +30,7 @@ using std::vector;
 SimpleAtomMatchingTracker::SimpleAtomMatchingTracker(const int64_t id, const uint64_t protoHash,
                                                      const SimpleAtomMatcher& matcher,
                                                      const sp<UidMap>& uidMap)
-    : AtomMatchingTracker(id, protoHash), mMatcher(matcher), mUidMap(uidMap) {
+    : AtomMatchingTracker(id, protoHash), mMatcher(matcher), mProgram(matcher), mUidMap(uidMap) {
     if (!matcher.has_atom_id()) {
         mInitialized = false;
     } else {
@@ -90,7 +90,7 @@ void SimpleAtomMatchingTracker::onLogEvent(
         return;
     }
 
-    auto [matched, transformedEvent] = matchesSimple(mUidMap, mMatcher, event);
+    auto [matched, transformedEvent] = mProgram.match(mUidMap, event);
     matcherResults[matcherIndex] = matched ? MatchingState::kMatched : MatchingState::kNotMatched;
     VLOG("Stats SimpleAtomMatcher %lld matched? %d", (long long)mId, matched);
 
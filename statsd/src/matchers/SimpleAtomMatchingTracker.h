@@ -51,6 +51,10 @@ public:
 
 private:
     const SimpleAtomMatcher mMatcher;
+
+    // mMatcher compiled for matching events.
+    const SimpleAtomMatcherProgram mProgram;
+
     const sp<UidMap> mUidMap;
 };
 
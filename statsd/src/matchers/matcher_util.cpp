@@ -20,6 +20,9 @@
 
 #include <fnmatch.h>
 
+#include <algorithm>
+#include <string_view>
+
 #include "matchers/AtomMatchingTracker.h"
 #include "src/statsd_config.pb.h"
 #include "stats_util.h"
@@ -86,494 +89,525 @@ bool combinationMatch(const vector<int>& children, const LogicalOperation& opera
     return matched;
 }
 
-static bool tryMatchString(const sp<UidMap>& uidMap, const FieldValue& fieldValue,
-                           const string& str_match) {
-    if (isAttributionUidField(fieldValue) || isUidField(fieldValue)) {
-        int uid = fieldValue.mValue.int_value;
-        auto aidIt = UidMap::sAidToUidMapping.find(str_match);
-        if (aidIt != UidMap::sAidToUidMapping.end()) {
-            return ((int)aidIt->second) == uid;
-        }
-        return uidMap->hasApp(uid, str_match);
-    } else if (fieldValue.mValue.getType() == STRING) {
-        return fieldValue.mValue.str_value == str_match;
-    }
-    return false;
-}
-
-static bool tryMatchWildcardString(const sp<UidMap>& uidMap, const FieldValue& fieldValue,
-                                   const string& wildcardPattern) {
-    if (isAttributionUidField(fieldValue) || isUidField(fieldValue)) {
-        int uid = fieldValue.mValue.int_value;
-        // TODO(b/236886985): replace aid/uid mapping with efficient bidirectional container
-        // AidToUidMapping will never have uids above 10000
-        if (uid < 10000) {
-            for (auto aidIt = UidMap::sAidToUidMapping.begin();
-                 aidIt != UidMap::sAidToUidMapping.end(); ++aidIt) {
-                if ((int)aidIt->second == uid) {
-                    // Assumes there is only one aid mapping for each uid
-                    return fnmatch(wildcardPattern.c_str(), aidIt->first.c_str(), 0) == 0;
-                }
-            }
-        }
-        std::set<string> packageNames = uidMap->getAppNamesFromUid(uid, false /* normalize*/);
-        for (const auto& packageName : packageNames) {
-            if (fnmatch(wildcardPattern.c_str(), packageName.c_str(), 0) == 0) {
-                return true;
-            }
-        }
-    } else if (fieldValue.mValue.getType() == STRING) {
-        return fnmatch(wildcardPattern.c_str(), fieldValue.mValue.str_value.c_str(), 0) == 0;
-    }
-    return false;
-}
-
-static unique_ptr<LogEvent> getTransformedEvent(const FieldValueMatcher& matcher,
+static unique_ptr<LogEvent> getTransformedEvent(const Regex& re, const string& replacement,
                                                 const LogEvent& event, int start, int end) {
-    if (!matcher.has_replace_string()) {
-        return nullptr;
-    }
-
-    unique_ptr<Regex> re = Regex::create(matcher.replace_string().regex());
-
-    if (re == nullptr) {
-        return nullptr;
-    }
-
-    const string& replacement = matcher.replace_string().replacement();
     unique_ptr<LogEvent> transformedEvent = nullptr;
     for (int i = start; i < end; i++) {
-        const LogEvent& eventRef = transformedEvent == nullptr ? event : *transformedEvent;
-        const FieldValue& fieldValue = eventRef.getValues()[i];
-        if (fieldValue.mValue.getType() != STRING) {
+        if (event.getLazyValues()[i].mValue.getType() != STRING) {
             continue;
         }
-        string str = fieldValue.mValue.str_value;
-        if (!re->replace(str, replacement) || str == fieldValue.mValue.str_value) {
+        string str(event.getStringValue(i));
+        if (!re.replace(str, replacement) || str == event.getStringValue(i)) {
             continue;
         }
 
-        // String transformation occurred, update the FieldValue in transformedEvent.
+        // String transformation occurred, update the FieldValue in transformedEvent. Copies of
+        // an event share its strings and undecoded payload, so this does not copy the content
+        // of the other values.
         if (transformedEvent == nullptr) {
             transformedEvent = std::make_unique<LogEvent>(event);
         }
-        (*transformedEvent->getMutableValues())[i].mValue.str_value = str;
+        transformedEvent->setStringValue(i, str);
     }
     return transformedEvent;
 }
 
-static pair<int, int> getStartEndAtDepth(int targetField, int start, int end, int depth,
-                                         const vector<FieldValue>& values) {
-    // Filter by entry field first
-    int newStart = -1;
-    int newEnd = end;
-    // because the fields are naturally sorted in the DFS order. we can safely
-    // break when pos is larger than the one we are searching for.
-    for (int i = start; i < end; i++) {
-        int pos = values[i].mField.getPosAtDepth(depth);
-        if (pos == targetField) {
-            if (newStart == -1) {
-                newStart = i;
-            }
-            newEnd = i + 1;
-        } else if (pos > targetField) {
-            break;
+// Returns the end of the range starting at start whose values share the same repeated field
+// position, i.e. the end of one element of a repeated field.
+static int getPositionRangeEnd(int32_t positionMask, const vector<FieldValue>& values, int start,
+                               int end) {
+    const int32_t pos = values[start].mField.getField() & positionMask;
+    for (int i = start + 1; i < end; i++) {
+        if ((values[i].mField.getField() & positionMask) != pos) {
+            return i;
         }
     }
+    return end;
+}
 
-    return {newStart, newEnd};
+// Returns the shift of the 8 bit position segment for the given depth in Field::getField().
+static int32_t getPosShift(int depth) {
+    return 8 * (kMaxLogDepth - depth);
 }
 
-/*
- * Returns pairs of start-end indices in vector<FieldValue> that pariticipate in matching.
- * The returned vector is empty if an error was encountered.
- * If Position is ANY and value_matcher is matches_tuple, the vector contains a start/end pair
- * corresponding for each child FieldValueMatcher in matches_tuple. For all other cases, the
- * returned vector is of size 1.
- *
- * Also updates the depth reference parameter if matcher has Position specified.
- */
-static vector<pair<int, int>> computeRanges(const FieldValueMatcher& matcher,
-                                            const vector<FieldValue>& values, int start, int end,
-                                            int& depth) {
-    // Now we have zoomed in to a new range
-    std::tie(start, end) = getStartEndAtDepth(matcher.field(), start, end, depth, values);
+SimpleAtomMatcherProgram::SimpleAtomMatcherProgram(const SimpleAtomMatcher& matcher)
+    : mAtomId(matcher.atom_id()), mRootCount(matcher.field_value_matcher_size()) {
+    compileNodes(matcher.field_value_matcher(), 0 /* depth */);
+}
 
-    if (start == -1) {
-        // No such field found.
-        return {};
+size_t SimpleAtomMatcherProgram::compileNodes(
+        const google::protobuf::RepeatedPtrField<FieldValueMatcher>& matchers, int depth) {
+    const size_t first = mNodes.size();
+    mNodes.resize(first + matchers.size());
+    for (int i = 0; i < matchers.size(); i++) {
+        compileNode(matchers[i], depth, first + i);
     }
+    return first;
+}
+
+void SimpleAtomMatcherProgram::compileNode(const FieldValueMatcher& matcher, int depth,
+                                           size_t index) {
+    // Nodes are only accessed through mNodes[index] since compiling children grows mNodes.
+    mNodes[index] = Node{};
+    mNodes[index].op = Op::kNever;
+    mNodes[index].replacementIndex = -1;
 
-    vector<pair<int, int>> ranges;
+    // Depth >= 3 is not supported. Fields that do not fit in a position segment never match.
+    if (depth > kMaxLogDepth || matcher.field() < 0 || matcher.field() > kClearLastBitDeco) {
+        return;
+    }
+    const int32_t shift = getPosShift(depth);
+    mNodes[index].fieldMask = kClearLastBitDeco << shift;
+    mNodes[index].fieldPos = matcher.field() << shift;
+
+    int childDepth = depth + 1;
     if (matcher.has_position()) {
         // Repeated fields position is stored as a node in the path.
-        depth++;
-        if (depth > 2) {
-            return ranges;
+        if (depth + 1 > kMaxLogDepth || matcher.position() == Position::POSITION_UNKNOWN) {
+            return;
         }
-        switch (matcher.position()) {
-            case Position::FIRST: {
-                for (int i = start; i < end; i++) {
-                    int pos = values[i].mField.getPosAtDepth(depth);
-                    if (pos != 1) {
-                        // Again, the log elements are stored in sorted order. so
-                        // once the position is > 1, we break;
-                        end = i;
-                        break;
-                    }
-                }
-                ranges.push_back(std::make_pair(start, end));
-                break;
-            }
-            case Position::LAST: {
-                // move the starting index to the first LAST field at the depth.
-                for (int i = start; i < end; i++) {
-                    if (values[i].mField.isLastPos(depth)) {
-                        start = i;
-                        break;
-                    }
-                }
-                ranges.push_back(std::make_pair(start, end));
-                break;
-            }
-            case Position::ALL:
-                // ALL is only supported for string transformation. If a value_matcher other than
-                // matches_tuple is present, the matcher is invalid. This is enforced when
-                // the AtomMatchingTracker is initialized.
-
-                // fallthrough
-            case Position::ANY: {
-                // For string transformation, this case is treated the same as Position:ALL.
-                // Given a matcher on attribution_node[ANY].tag with a matches_tuple containing a
-                // child FieldValueMatcher with eq_string: "foo" and regex_replace: "[\d]+$" --> "",
-                // an event with attribution tags: ["bar123", "foo12", "abc230"] will transform to
-                // have attribution tags ["bar", "foo", "abc"] and will be a successful match.
-
-                // Note that if value_matcher is matches_tuple, there should be no string
-                // transformation on this matcher. However, child FieldValueMatchers in
-                // matches_tuple can have string transformations. This is enforced when
-                // AtomMatchingTracker is initialized.
-
-                if (matcher.value_matcher_case() == FieldValueMatcher::kMatchesTuple) {
-                    // For ANY with matches_tuple, if all the children matchers match in any of the
-                    // sub trees, it's a match.
-                    // Here start is guaranteed to be a valid index.
-                    int currentPos = values[start].mField.getPosAtDepth(depth);
-                    // Now find all sub trees ranges.
-                    for (int i = start; i < end; i++) {
-                        int newPos = values[i].mField.getPosAtDepth(depth);
-                        if (newPos != currentPos) {
-                            ranges.push_back(std::make_pair(start, i));
-                            start = i;
-                            currentPos = newPos;
-                        }
-                    }
-                }
-                ranges.push_back(std::make_pair(start, end));
-                break;
+        const int32_t positionShift = getPosShift(depth + 1);
+        mNodes[index].hasPosition = true;
+        mNodes[index].position = matcher.position();
+        mNodes[index].positionMask = kClearLastBitDeco << positionShift;
+        mNodes[index].firstPos = 1 << positionShift;
+        mNodes[index].lastPosMask = kLastBitMask << positionShift;
+        // ALL is only supported for string transformation and is treated the same as ANY. See
+        // the explanation of how ANY interacts with string transformation in matchNode().
+        mNodes[index].splitsRanges =
+                matcher.value_matcher_case() == FieldValueMatcher::kMatchesTuple &&
+                (matcher.position() == Position::ANY || matcher.position() == Position::ALL);
+        childDepth++;
+    }
+
+    if (matcher.has_replace_string()) {
+        mNodes[index].replacementIndex = mReplacements.size();
+        mNodes[index].hasTransformation = true;
+        mReplacements.push_back({Regex::create(matcher.replace_string().regex()),
+                                 matcher.replace_string().replacement()});
+    }
+
+    const auto addStrings = [this, index](const StringListMatcher& list) {
+        mNodes[index].begin = mStrings.size();
+        for (const string& str : list.str_value()) {
+            auto aidIt = UidMap::sAidToUidMapping.find(str);
+            mStrings.push_back({str, aidIt == UidMap::sAidToUidMapping.end()
+                                             ? std::nullopt
+                                             : std::optional<int32_t>(aidIt->second)});
+        }
+        mNodes[index].end = mStrings.size();
+        // Sorted for the binary search of STRING values. The order does not matter otherwise.
+        std::sort(mStrings.begin() + mNodes[index].begin, mStrings.end(),
+                  [](const StringOperand& a, const StringOperand& b) { return a.str < b.str; });
+    };
+    const auto addInts = [this, index](const IntListMatcher& list) {
+        mNodes[index].begin = mInts.size();
+        mInts.insert(mInts.end(), list.int_value().begin(), list.int_value().end());
+        mNodes[index].end = mInts.size();
+    };
+
+    switch (matcher.value_matcher_case()) {
+        case FieldValueMatcher::kMatchesTuple: {
+            const size_t first = compileNodes(matcher.matches_tuple().field_value_matcher(),
+                                              childDepth);
+            mNodes[index].op = Op::kTuple;
+            mNodes[index].begin = first;
+            mNodes[index].end = first + matcher.matches_tuple().field_value_matcher_size();
+            for (uint32_t child = mNodes[index].begin; child < mNodes[index].end; child++) {
+                mNodes[index].hasTransformation |= mNodes[child].hasTransformation;
             }
-            case Position::POSITION_UNKNOWN:
-                break;
+            break;
         }
-    } else {
-        // No position
-        ranges.push_back(std::make_pair(start, end));
+        case FieldValueMatcher::kEqBool:
+            mNodes[index].op = Op::kEqBool;
+            mNodes[index].boolOperand = matcher.eq_bool();
+            break;
+        case FieldValueMatcher::kEqString: {
+            StringListMatcher list;
+            list.add_str_value(matcher.eq_string());
+            addStrings(list);
+            mNodes[index].op = Op::kEqAnyString;
+            break;
+        }
+        case FieldValueMatcher::kEqAnyString:
+            addStrings(matcher.eq_any_string());
+            mNodes[index].op = Op::kEqAnyString;
+            break;
+        case FieldValueMatcher::kNeqAnyString:
+            addStrings(matcher.neq_any_string());
+            mNodes[index].op = Op::kNeqAnyString;
+            break;
+        case FieldValueMatcher::kEqWildcardString: {
+            StringListMatcher list;
+            list.add_str_value(matcher.eq_wildcard_string());
+            addStrings(list);
+            mNodes[index].op = Op::kEqAnyWildcardString;
+            break;
+        }
+        case FieldValueMatcher::kEqAnyWildcardString:
+            addStrings(matcher.eq_any_wildcard_string());
+            mNodes[index].op = Op::kEqAnyWildcardString;
+            break;
+        case FieldValueMatcher::kNeqAnyWildcardString:
+            addStrings(matcher.neq_any_wildcard_string());
+            mNodes[index].op = Op::kNeqAnyWildcardString;
+            break;
+        case FieldValueMatcher::kEqInt:
+            mNodes[index].op = Op::kEqInt;
+            mNodes[index].intOperand = matcher.eq_int();
+            break;
+        case FieldValueMatcher::kEqAnyInt:
+            addInts(matcher.eq_any_int());
+            mNodes[index].op = Op::kEqAnyInt;
+            break;
+        case FieldValueMatcher::kNeqAnyInt:
+            addInts(matcher.neq_any_int());
+            mNodes[index].op = Op::kNeqAnyInt;
+            break;
+        case FieldValueMatcher::kLtInt:
+            mNodes[index].op = Op::kLtInt;
+            mNodes[index].intOperand = matcher.lt_int();
+            break;
+        case FieldValueMatcher::kGtInt:
+            mNodes[index].op = Op::kGtInt;
+            mNodes[index].intOperand = matcher.gt_int();
+            break;
+        case FieldValueMatcher::kLteInt:
+            mNodes[index].op = Op::kLteInt;
+            mNodes[index].intOperand = matcher.lte_int();
+            break;
+        case FieldValueMatcher::kGteInt:
+            mNodes[index].op = Op::kGteInt;
+            mNodes[index].intOperand = matcher.gte_int();
+            break;
+        case FieldValueMatcher::kLtFloat:
+            mNodes[index].op = Op::kLtFloat;
+            mNodes[index].floatOperand = matcher.lt_float();
+            break;
+        case FieldValueMatcher::kGtFloat:
+            mNodes[index].op = Op::kGtFloat;
+            mNodes[index].floatOperand = matcher.gt_float();
+            break;
+        default:
+            // This only happens if the matcher has a string transformation and no value_matcher.
+            // So the default match result is true. If there is no string transformation either
+            // then this matcher is invalid, which is enforced when the AtomMatchingTracker is
+            // initialized.
+            mNodes[index].op = Op::kNone;
+            break;
     }
-
-    return ranges;
 }
 
-static MatchResult matchesSimple(const sp<UidMap>& uidMap, const FieldValueMatcher& matcher,
-                                 const LogEvent& event, int start, int end, int depth) {
-    if (depth > 2) {
-        ALOGE("Depth >= 3 not supported");
+MatchResult SimpleAtomMatcherProgram::match(const sp<UidMap>& uidMap,
+                                            const LogEvent& event) const {
+    if (event.GetTagId() != mAtomId) {
         return {false, nullptr};
     }
 
-    if (start >= end) {
-        return {false, nullptr};
+    unique_ptr<LogEvent> transformedEvent = nullptr;
+    for (size_t i = 0; i < mRootCount; i++) {
+        const LogEvent& inputEvent = transformedEvent == nullptr ? event : *transformedEvent;
+        auto [hasMatched, newTransformedEvent] =
+                matchNode(uidMap, mNodes[i], inputEvent, 0, inputEvent.size());
+        if (newTransformedEvent != nullptr) {
+            transformedEvent = std::move(newTransformedEvent);
+        }
+        if (!hasMatched) {
+            return {false, std::move(transformedEvent)};
+        }
     }
+    return {true, std::move(transformedEvent)};
+}
 
-    const vector<pair<int, int>> ranges =
-            computeRanges(matcher, event.getValues(), start, end, depth);
+MatchResult SimpleAtomMatcherProgram::matchNode(const sp<UidMap>& uidMap, const Node& node,
+                                                const LogEvent& event, int start,
+                                                int end) const {
+    if (node.op == Op::kNever || start >= end) {
+        return {false, nullptr};
+    }
 
-    if (ranges.empty()) {
+    // Zoom in to the range of the field. Because the fields are naturally sorted in the DFS
+    // order, we can safely break when the position is larger than the one we are searching for.
+    const vector<FieldValue>& values = event.getLazyValues();
+    int fieldStart = -1;
+    int fieldEnd = end;
+    for (int i = start; i < end; i++) {
+        const int32_t pos = values[i].mField.getField() & node.fieldMask;
+        if (pos == node.fieldPos) {
+            if (fieldStart == -1) {
+                fieldStart = i;
+            }
+            fieldEnd = i + 1;
+        } else if (pos > node.fieldPos) {
+            break;
+        }
+    }
+    if (fieldStart == -1) {
         // No such field found.
         return {false, nullptr};
     }
+    start = fieldStart;
+    end = fieldEnd;
+
+    if (node.position == Position::FIRST) {
+        for (int i = start; i < end; i++) {
+            if ((values[i].mField.getField() & node.positionMask) != node.firstPos) {
+                // Again, the log elements are stored in sorted order. so once the position is
+                // > 1, we break;
+                end = i;
+                break;
+            }
+        }
+    } else if (node.position == Position::LAST) {
+        // Move the starting index to the first LAST field at the depth.
+        for (int i = start; i < end; i++) {
+            if ((values[i].mField.getField() & node.lastPosMask) != 0) {
+                start = i;
+                break;
+            }
+        }
+    }
 
-    // ranges should have exactly one start/end pair at this point unless position is ANY and
-    // value_matcher is matches_tuple.
-    std::tie(start, end) = ranges[0];
+    // For string transformation, ANY is treated the same as ALL. Given a matcher on
+    // attribution_node[ANY].tag with a matches_tuple containing a child FieldValueMatcher with
+    // eq_string: "foo" and regex_replace: "[\d]+$" --> "", an event with attribution tags:
+    // ["bar123", "foo12", "abc230"] will transform to have attribution tags ["bar", "foo", "abc"]
+    // and will be a successful match.
+    //
+    // Note that if value_matcher is matches_tuple, there should be no string transformation on
+    // this matcher. However, child FieldValueMatchers in matches_tuple can have string
+    // transformations. This is enforced when AtomMatchingTracker is initialized.
+    int rangeStart = start;
+    int rangeEnd = node.splitsRanges ? getPositionRangeEnd(node.positionMask, values, start, end)
+                                     : end;
 
-    unique_ptr<LogEvent> transformedEvent = getTransformedEvent(matcher, event, start, end);
+    unique_ptr<LogEvent> transformedEvent = nullptr;
+    if (node.replacementIndex >= 0 && mReplacements[node.replacementIndex].regex != nullptr) {
+        const StringReplacement& replacement = mReplacements[node.replacementIndex];
+        transformedEvent = getTransformedEvent(*replacement.regex, replacement.replacement, event,
+                                               rangeStart, rangeEnd);
+    }
 
-    const vector<FieldValue>& values =
-            transformedEvent == nullptr ? event.getValues() : transformedEvent->getValues();
+    if (node.op != Op::kTuple) {
+        // String contents are read through getStringValue() so that matching does not decode the
+        // values of lazily parsed events.
+        const LogEvent& valuesEvent = transformedEvent == nullptr ? event : *transformedEvent;
+        const bool matched = matchValues(uidMap, node, valuesEvent, start, end);
+        return {matched, std::move(transformedEvent)};
+    }
 
-    switch (matcher.value_matcher_case()) {
-        case FieldValueMatcher::kMatchesTuple: {
-            ++depth;
-            // If any range matches all matchers, good.
-            bool matchResult = false;
-            for (const auto& [rangeStart, rangeEnd] : ranges) {
-                bool matched = true;
-                for (const auto& subMatcher : matcher.matches_tuple().field_value_matcher()) {
-                    const LogEvent& eventRef =
-                            transformedEvent == nullptr ? event : *transformedEvent;
-                    auto [hasMatched, newTransformedEvent] = matchesSimple(
-                            uidMap, subMatcher, eventRef, rangeStart, rangeEnd, depth);
-                    if (newTransformedEvent != nullptr) {
-                        transformedEvent = std::move(newTransformedEvent);
-                    }
-                    if (!hasMatched) {
-                        matched = false;
-                    }
-                }
-                matchResult = matchResult || matched;
+    // If any element of the repeated field matches all matchers, good. Without string
+    // transformations below this node, there is no need to look further once this is decided.
+    bool matchResult = false;
+    while (true) {
+        bool matched = true;
+        for (uint32_t child = node.begin; child < node.end; child++) {
+            if (!matched && !node.hasTransformation) {
+                break;
             }
-            return {matchResult, std::move(transformedEvent)};
-        }
-        // Finally, we get to the point of real value matching.
-        // If the field matcher ends with ANY, then we have [start, end) range > 1.
-        // In the following, we should return true, when ANY of the values matches.
-        case FieldValueMatcher::ValueMatcherCase::kEqBool: {
-            for (int i = start; i < end; i++) {
-                if ((values[i].mValue.getType() == INT &&
-                     (values[i].mValue.int_value != 0) == matcher.eq_bool()) ||
-                    (values[i].mValue.getType() == LONG &&
-                     (values[i].mValue.long_value != 0) == matcher.eq_bool())) {
-                    return {true, std::move(transformedEvent)};
-                }
+            const LogEvent& eventRef = transformedEvent == nullptr ? event : *transformedEvent;
+            auto [hasMatched, newTransformedEvent] =
+                    matchNode(uidMap, mNodes[child], eventRef, rangeStart, rangeEnd);
+            if (newTransformedEvent != nullptr) {
+                transformedEvent = std::move(newTransformedEvent);
             }
-            return {false, std::move(transformedEvent)};
+            matched = matched && hasMatched;
         }
-        case FieldValueMatcher::ValueMatcherCase::kEqString: {
-            for (int i = start; i < end; i++) {
-                if (tryMatchString(uidMap, values[i], matcher.eq_string())) {
-                    return {true, std::move(transformedEvent)};
-                }
-            }
-            return {false, std::move(transformedEvent)};
+        matchResult = matchResult || matched;
+        if (rangeEnd >= end || (matchResult && !node.hasTransformation)) {
+            break;
         }
-        case FieldValueMatcher::ValueMatcherCase::kNeqAnyString: {
-            const auto& str_list = matcher.neq_any_string();
+        rangeStart = rangeEnd;
+        rangeEnd = getPositionRangeEnd(node.positionMask, values, rangeStart, end);
+    }
+    return {matchResult, std::move(transformedEvent)};
+}
+
+// If the field matcher ends with ANY, then we have [start, end) range > 1. Returns true when ANY
+// of the values matches.
+bool SimpleAtomMatcherProgram::matchValues(const sp<UidMap>& uidMap, const Node& node,
+                                           const LogEvent& event, int start, int end) const {
+    const vector<FieldValue>& values = event.getLazyValues();
+    switch (node.op) {
+        case Op::kNone:
+            return true;
+        case Op::kEqBool:
             for (int i = start; i < end; i++) {
-                bool notEqAll = true;
-                for (const auto& str : str_list.str_value()) {
-                    if (tryMatchString(uidMap, values[i], str)) {
-                        notEqAll = false;
-                        break;
-                    }
-                }
-                if (notEqAll) {
-                    return {true, std::move(transformedEvent)};
+                if ((values[i].mValue.getType() == INT &&
+                     (values[i].mValue.int_value != 0) == node.boolOperand) ||
+                    (values[i].mValue.getType() == LONG &&
+                     (values[i].mValue.long_value != 0) == node.boolOperand)) {
+                    return true;
                 }
             }
-            return {false, std::move(transformedEvent)};
-        }
-        case FieldValueMatcher::ValueMatcherCase::kEqAnyString: {
-            const auto& str_list = matcher.eq_any_string();
+            return false;
+        case Op::kEqAnyString:
             for (int i = start; i < end; i++) {
-                for (const auto& str : str_list.str_value()) {
-                    if (tryMatchString(uidMap, values[i], str)) {
-                        return {true, std::move(transformedEvent)};
-                    }
+                if (matchesAnyString(uidMap, node, event, i)) {
+                    return true;
                 }
             }
-            return {false, std::move(transformedEvent)};
-        }
-        case FieldValueMatcher::ValueMatcherCase::kEqWildcardString: {
+            return false;
+        case Op::kNeqAnyString:
             for (int i = start; i < end; i++) {
-                if (tryMatchWildcardString(uidMap, values[i], matcher.eq_wildcard_string())) {
-                    return {true, std::move(transformedEvent)};
+                if (!matchesAnyString(uidMap, node, event, i)) {
+                    return true;
                 }
             }
-            return {false, std::move(transformedEvent)};
-        }
-        case FieldValueMatcher::ValueMatcherCase::kEqAnyWildcardString: {
-            const auto& str_list = matcher.eq_any_wildcard_string();
+            return false;
+        case Op::kEqAnyWildcardString:
             for (int i = start; i < end; i++) {
-                for (const auto& str : str_list.str_value()) {
-                    if (tryMatchWildcardString(uidMap, values[i], str)) {
-                        return {true, std::move(transformedEvent)};
-                    }
+                if (matchesAnyWildcardString(uidMap, node, event, i)) {
+                    return true;
                 }
             }
-            return {false, std::move(transformedEvent)};
-        }
-        case FieldValueMatcher::ValueMatcherCase::kNeqAnyWildcardString: {
-            const auto& str_list = matcher.neq_any_wildcard_string();
+            return false;
+        case Op::kNeqAnyWildcardString:
             for (int i = start; i < end; i++) {
-                bool notEqAll = true;
-                for (const auto& str : str_list.str_value()) {
-                    if (tryMatchWildcardString(uidMap, values[i], str)) {
-                        notEqAll = false;
-                        break;
-                    }
-                }
-                if (notEqAll) {
-                    return {true, std::move(transformedEvent)};
+                if (!matchesAnyWildcardString(uidMap, node, event, i)) {
+                    return true;
                 }
             }
-            return {false, std::move(transformedEvent)};
-        }
-        case FieldValueMatcher::ValueMatcherCase::kEqInt: {
+            return false;
+        case Op::kEqAnyInt:
             for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == INT &&
-                    (matcher.eq_int() == values[i].mValue.int_value)) {
-                    return {true, std::move(transformedEvent)};
-                }
-                // eq_int covers both int and long.
-                if (values[i].mValue.getType() == LONG &&
-                    (matcher.eq_int() == values[i].mValue.long_value)) {
-                    return {true, std::move(transformedEvent)};
+                if (matchesAnyInt(node, values[i].mValue)) {
+                    return true;
                 }
             }
-            return {false, std::move(transformedEvent)};
-        }
-        case FieldValueMatcher::ValueMatcherCase::kEqAnyInt: {
-            const auto& int_list = matcher.eq_any_int();
+            return false;
+        case Op::kNeqAnyInt:
             for (int i = start; i < end; i++) {
-                for (const int int_value : int_list.int_value()) {
-                    if (values[i].mValue.getType() == INT &&
-                        (int_value == values[i].mValue.int_value)) {
-                        return {true, std::move(transformedEvent)};
-                    }
-                    // eq_any_int covers both int and long.
-                    if (values[i].mValue.getType() == LONG &&
-                        (int_value == values[i].mValue.long_value)) {
-                        return {true, std::move(transformedEvent)};
-                    }
+                if (!matchesAnyInt(node, values[i].mValue)) {
+                    return true;
                 }
             }
-            return {false, std::move(transformedEvent)};
-        }
-        case FieldValueMatcher::ValueMatcherCase::kNeqAnyInt: {
-            const auto& int_list = matcher.neq_any_int();
-            for (int i = start; i < end; i++) {
-                bool notEqAll = true;
-                for (const int int_value : int_list.int_value()) {
-                    if (values[i].mValue.getType() == INT &&
-                        (int_value == values[i].mValue.int_value)) {
-                        notEqAll = false;
-                        break;
-                    }
-                    // neq_any_int covers both int and long.
-                    if (values[i].mValue.getType() == LONG &&
-                        (int_value == values[i].mValue.long_value)) {
-                        notEqAll = false;
-                        break;
-                    }
-                }
-                if (notEqAll) {
-                    return {true, std::move(transformedEvent)};
-                }
+            return false;
+        default:
+            break;
+    }
+
+    // Single operand comparisons. The int comparisons cover both int and long values.
+    for (int i = start; i < end; i++) {
+        const Value& value = values[i].mValue;
+        bool matched = false;
+        if (value.getType() == INT || value.getType() == LONG) {
+            const int64_t v = value.getType() == INT ? value.int_value : value.long_value;
+            switch (node.op) {
+                case Op::kEqInt:
+                    matched = v == node.intOperand;
+                    break;
+                case Op::kLtInt:
+                    matched = v < node.intOperand;
+                    break;
+                case Op::kGtInt:
+                    matched = v > node.intOperand;
+                    break;
+                case Op::kLteInt:
+                    matched = v <= node.intOperand;
+                    break;
+                case Op::kGteInt:
+                    matched = v >= node.intOperand;
+                    break;
+                default:
+                    break;
             }
-            return {false, std::move(transformedEvent)};
-        }
-        case FieldValueMatcher::ValueMatcherCase::kLtInt: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == INT &&
-                    (values[i].mValue.int_value < matcher.lt_int())) {
-                    return {true, std::move(transformedEvent)};
-                }
-                // lt_int covers both int and long.
-                if (values[i].mValue.getType() == LONG &&
-                    (values[i].mValue.long_value < matcher.lt_int())) {
-                    return {true, std::move(transformedEvent)};
-                }
+        } else if (value.getType() == FLOAT) {
+            if (node.op == Op::kLtFloat) {
+                matched = value.float_value < node.floatOperand;
+            } else if (node.op == Op::kGtFloat) {
+                matched = value.float_value > node.floatOperand;
             }
-            return {false, std::move(transformedEvent)};
         }
-        case FieldValueMatcher::ValueMatcherCase::kGtInt: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == INT &&
-                    (values[i].mValue.int_value > matcher.gt_int())) {
-                    return {true, std::move(transformedEvent)};
-                }
-                // gt_int covers both int and long.
-                if (values[i].mValue.getType() == LONG &&
-                    (values[i].mValue.long_value > matcher.gt_int())) {
-                    return {true, std::move(transformedEvent)};
-                }
-            }
-            return {false, std::move(transformedEvent)};
+        if (matched) {
+            return true;
         }
-        case FieldValueMatcher::ValueMatcherCase::kLtFloat: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == FLOAT &&
-                    (values[i].mValue.float_value < matcher.lt_float())) {
-                    return {true, std::move(transformedEvent)};
-                }
+    }
+    return false;
+}
+
+bool SimpleAtomMatcherProgram::matchesAnyString(const sp<UidMap>& uidMap, const Node& node,
+                                                const LogEvent& event, int index) const {
+    const FieldValue& fieldValue = event.getLazyValues()[index];
+    if (isAttributionUidField(fieldValue) || isUidField(fieldValue)) {
+        const int uid = fieldValue.mValue.int_value;
+        for (uint32_t i = node.begin; i < node.end; i++) {
+            const StringOperand& operand = mStrings[i];
+            if (operand.aidUid.has_value() ? *operand.aidUid == uid
+                                           : uidMap->hasApp(uid, operand.str)) {
+                return true;
             }
-            return {false, std::move(transformedEvent)};
         }
-        case FieldValueMatcher::ValueMatcherCase::kGtFloat: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == FLOAT &&
-                    (values[i].mValue.float_value > matcher.gt_float())) {
-                    return {true, std::move(transformedEvent)};
+        return false;
+    } else if (fieldValue.mValue.getType() == STRING) {
+        const std::string_view str = event.getStringValue(index);
+        const auto begin = mStrings.begin() + node.begin;
+        const auto end = mStrings.begin() + node.end;
+        const auto it = std::lower_bound(begin, end, str,
+                                         [](const StringOperand& operand, std::string_view s) {
+                                             return std::string_view(operand.str) < s;
+                                         });
+        return it != end && it->str == str;
+    }
+    return false;
+}
+
+bool SimpleAtomMatcherProgram::matchesAnyWildcardString(const sp<UidMap>& uidMap,
+                                                        const Node& node, const LogEvent& event,
+                                                        int index) const {
+    const FieldValue& fieldValue = event.getLazyValues()[index];
+    if (isAttributionUidField(fieldValue) || isUidField(fieldValue)) {
+        int uid = fieldValue.mValue.int_value;
+        // Assumes there is only one aid mapping for each uid
+        const string* aidName = UidMap::getAidName(uid);
+        if (aidName != nullptr) {
+            for (uint32_t i = node.begin; i < node.end; i++) {
+                if (fnmatch(mStrings[i].str.c_str(), aidName->c_str(), 0) == 0) {
+                    return true;
                 }
             }
-            return {false, std::move(transformedEvent)};
+            return false;
         }
-        case FieldValueMatcher::ValueMatcherCase::kLteInt: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == INT &&
-                    (values[i].mValue.int_value <= matcher.lte_int())) {
-                    return {true, std::move(transformedEvent)};
-                }
-                // lte_int covers both int and long.
-                if (values[i].mValue.getType() == LONG &&
-                    (values[i].mValue.long_value <= matcher.lte_int())) {
-                    return {true, std::move(transformedEvent)};
+        std::set<string> packageNames = uidMap->getAppNamesFromUid(uid, false /* normalize*/);
+        for (const auto& packageName : packageNames) {
+            for (uint32_t i = node.begin; i < node.end; i++) {
+                if (fnmatch(mStrings[i].str.c_str(), packageName.c_str(), 0) == 0) {
+                    return true;
                 }
             }
-            return {false, std::move(transformedEvent)};
         }
-        case FieldValueMatcher::ValueMatcherCase::kGteInt: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == INT &&
-                    (values[i].mValue.int_value >= matcher.gte_int())) {
-                    return {true, std::move(transformedEvent)};
-                }
-                // gte_int covers both int and long.
-                if (values[i].mValue.getType() == LONG &&
-                    (values[i].mValue.long_value >= matcher.gte_int())) {
-                    return {true, std::move(transformedEvent)};
-                }
+    } else if (fieldValue.mValue.getType() == STRING) {
+        // fnmatch needs a null terminated string.
+        const string str(event.getStringValue(index));
+        for (uint32_t i = node.begin; i < node.end; i++) {
+            if (fnmatch(mStrings[i].str.c_str(), str.c_str(), 0) == 0) {
+                return true;
             }
-            return {false, std::move(transformedEvent)};
         }
-        default:
-            // This only happens if the matcher has a string transformation and no value_matcher. So
-            // the default match result is true. If there is no string transformation either then
-            // this matcher is invalid, which is enforced when the AtomMatchingTracker is
-            // initialized.
-            return {true, std::move(transformedEvent)};
     }
+    return false;
 }
 
-MatchResult matchesSimple(const sp<UidMap>& uidMap, const SimpleAtomMatcher& simpleMatcher,
-                          const LogEvent& event) {
-    if (event.GetTagId() != simpleMatcher.atom_id()) {
-        return {false, nullptr};
+bool SimpleAtomMatcherProgram::matchesAnyInt(const Node& node, const Value& value) const {
+    int64_t v;
+    if (value.getType() == INT) {
+        v = value.int_value;
+    } else if (value.getType() == LONG) {
+        v = value.long_value;
+    } else {
+        return false;
     }
-
-    unique_ptr<LogEvent> transformedEvent = nullptr;
-    for (const auto& matcher : simpleMatcher.field_value_matcher()) {
-        const LogEvent& inputEvent = transformedEvent == nullptr ? event : *transformedEvent;
-        auto [hasMatched, newTransformedEvent] =
-                matchesSimple(uidMap, matcher, inputEvent, 0, inputEvent.getValues().size(), 0);
-        if (newTransformedEvent != nullptr) {
-            transformedEvent = std::move(newTransformedEvent);
-        }
-        if (!hasMatched) {
-            return {false, std::move(transformedEvent)};
+    for (uint32_t i = node.begin; i < node.end; i++) {
+        if (mInts[i] == v) {
+            return true;
         }
     }
-    return {true, std::move(transformedEvent)};
+    return false;
+}
+
+MatchResult matchesSimple(const sp<UidMap>& uidMap, const SimpleAtomMatcher& simpleMatcher,
+                          const LogEvent& event) {
+    return SimpleAtomMatcherProgram(simpleMatcher).match(uidMap, event);
 }
 
 }  // namespace statsd
@@ -18,10 +18,13 @@
 
 #include "logd/LogEvent.h"
 
+#include <optional>
+#include <string>
 #include <vector>
 #include "src/statsd_config.pb.h"
 #include "packages/UidMap.h"
 #include "stats_util.h"
+#include "utils/Regex.h"
 
 namespace android {
 namespace os {
@@ -41,6 +44,132 @@ struct MatchResult {
 bool combinationMatch(const std::vector<int>& children, const LogicalOperation& operation,
                       const std::vector<MatchingState>& matcherResults);
 
+/**
+ * A SimpleAtomMatcher compiled once into a flat program, so that matching an event does not
+ * walk the protos.
+ *
+ * Every FieldValueMatcher becomes a node. The children of a matches_tuple are stored next to each
+ * other and refer to their depth through precomputed masks over the raw Field encoding. Value
+ * matchers become typed ops with their operands stored in flat arrays, string lists are sorted
+ * for binary search and the AID names among them are resolved to uids up front. The regexes of
+ * string replacements are compiled once too.
+ */
+class SimpleAtomMatcherProgram {
+public:
+    explicit SimpleAtomMatcherProgram(const SimpleAtomMatcher& matcher);
+
+    MatchResult match(const sp<UidMap>& uidMap, const LogEvent& event) const;
+
+    inline int getAtomId() const {
+        return mAtomId;
+    }
+
+private:
+    enum class Op : uint8_t {
+        // Only transforms strings; matches if the field is present.
+        kNone,
+        // Can never match, e.g. the field is nested deeper than supported.
+        kNever,
+        kTuple,
+        kEqBool,
+        kEqAnyString,
+        kNeqAnyString,
+        kEqAnyWildcardString,
+        kNeqAnyWildcardString,
+        kEqInt,
+        kEqAnyInt,
+        kNeqAnyInt,
+        kLtInt,
+        kGtInt,
+        kLteInt,
+        kGteInt,
+        kLtFloat,
+        kGtFloat,
+    };
+
+    struct StringOperand {
+        std::string str;
+        // Uid of the AID name in str, if it is one.
+        std::optional<int32_t> aidUid;
+    };
+
+    struct StringReplacement {
+        // Compiled once, nullptr if the regex is invalid.
+        std::unique_ptr<Regex> regex;
+        std::string replacement;
+    };
+
+    struct Node {
+        // Selects the field at the depth of this node: (getField() & fieldMask) == fieldPos.
+        int32_t fieldMask;
+        int32_t fieldPos;
+
+        // Same for the repeated field position one level deeper, if the node has a position.
+        int32_t positionMask;
+        int32_t firstPos;
+        int32_t lastPosMask;
+        Position position;
+        bool hasPosition;
+
+        // For matches_tuple on ANY or ALL, the children are matched against every element.
+        bool splitsRanges;
+
+        // Set if this node or any node below it transforms strings. Such nodes cannot stop at
+        // the first element or child that decides the result.
+        bool hasTransformation;
+
+        Op op;
+
+        // Index in mReplacements, or -1.
+        int32_t replacementIndex;
+
+        union {
+            bool boolOperand;
+            int64_t intOperand;
+            float floatOperand;
+        };
+
+        // Children in mNodes for kTuple, operands in mStrings or mInts for list ops.
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    // Appends the nodes for the matchers at the given depth next to each other, followed by
+    // their children. Returns the index of the first node.
+    size_t compileNodes(const google::protobuf::RepeatedPtrField<FieldValueMatcher>& matchers,
+                        int depth);
+
+    void compileNode(const FieldValueMatcher& matcher, int depth, size_t index);
+
+    MatchResult matchNode(const sp<UidMap>& uidMap, const Node& node, const LogEvent& event,
+                          int start, int end) const;
+
+    bool matchValues(const sp<UidMap>& uidMap, const Node& node, const LogEvent& event, int start,
+                     int end) const;
+
+    bool matchesAnyString(const sp<UidMap>& uidMap, const Node& node, const LogEvent& event,
+                          int index) const;
+
+    bool matchesAnyWildcardString(const sp<UidMap>& uidMap, const Node& node,
+                                  const LogEvent& event, int index) const;
+
+    bool matchesAnyInt(const Node& node, const Value& value) const;
+
+    int32_t mAtomId;
+
+    // The top level FieldValueMatchers are the first mRootCount nodes.
+    size_t mRootCount;
+    std::vector<Node> mNodes;
+
+    std::vector<StringOperand> mStrings;
+    std::vector<int64_t> mInts;
+    std::vector<StringReplacement> mReplacements;
+};
+
+/**
+ * Compiles the matcher and matches it against the event. Callers matching many events against
+ * the same matcher should keep a SimpleAtomMatcherProgram instead.
+ */
 MatchResult matchesSimple(const sp<UidMap>& uidMap, const SimpleAtomMatcher& simpleMatcher,
                           const LogEvent& wrapper);
 
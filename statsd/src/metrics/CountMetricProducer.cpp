@@ -216,7 +216,7 @@ void CountMetricProducer::onSlicedConditionMayChangeLocked(bool overallCondition
 
 void CountMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mPastBuckets.clear();
-    mTotalDataSize = 0;
+    resetDataSizeLocked();
 }
 
 void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
@@ -224,42 +224,100 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                                              const bool erase_data, const DumpLatency dumpLatency,
                                              std::set<string>* str_set,
                                              ProtoOutputStream* protoOutput) {
+    writeDumpReport(getDumpReportInfoLocked(dumpTimeNs, include_current_partial_bucket),
+                    mPastBuckets, str_set, protoOutput);
+
+    if (erase_data) {
+        mPastBuckets.clear();
+        mDimensionGuardrailHit.store(false, std::memory_order_relaxed);
+        resetDataSizeLocked();
+    }
+}
+
+MetricProducer::DumpReportWriter CountMetricProducer::takeDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket, const bool erase_data,
+        const DumpLatency dumpLatency, std::set<string>* str_set) {
+    auto info = std::make_shared<DumpReportInfo>(
+            getDumpReportInfoLocked(dumpTimeNs, include_current_partial_bucket));
+
+    // The past buckets are handed over when erased, so that only the kept buckets are copied.
+    auto pastBuckets = std::make_shared<PastBucketMap>();
+    if (erase_data) {
+        pastBuckets->swap(mPastBuckets);
+        mDimensionGuardrailHit.store(false, std::memory_order_relaxed);
+        resetDataSizeLocked();
+    } else {
+        *pastBuckets = mPastBuckets;
+    }
+
+    return [info, pastBuckets, str_set](uint64_t fieldId, ProtoOutputStream* protoOutput) {
+        uint64_t token = protoOutput->start(fieldId);
+        writeDumpReport(*info, *pastBuckets, str_set, protoOutput);
+        protoOutput->end(token);
+    };
+}
+
+CountMetricProducer::DumpReportInfo CountMetricProducer::getDumpReportInfoLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket) {
     if (include_current_partial_bucket) {
         flushLocked(dumpTimeNs);
     } else {
         flushIfNeededLocked(dumpTimeNs);
     }
 
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
-    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
+    DumpReportInfo info;
+    info.metricId = mMetricId;
+    info.isActive = isActiveLocked();
+    info.dimensionGuardrailHit = mDimensionGuardrailHit.load(std::memory_order_relaxed);
+    info.byteSize = mPastBuckets.empty() ? 0 : byteSizeLocked();
+    info.timeBaseNs = mTimeBaseNs;
+    info.bucketSizeNs = mBucketSizeNs;
+    info.shouldUseNestedDimensions = mShouldUseNestedDimensions;
+    if (!mShouldUseNestedDimensions && !mPastBuckets.empty()) {
+        info.dimensionsInWhat = mDimensionsInWhat;
+    }
+    // We only write the condition timer value if the metric has a
+    // condition and isn't sliced by state or condition.
+    // TODO(b/268531179): Slice the condition timer by state and condition
+    info.writeConditionTrueNs =
+            mConditionTrackerIndex >= 0 && mSlicedStateAtoms.empty() && !mConditionSliced;
+    return info;
+}
+
+void CountMetricProducer::writeDumpReport(const DumpReportInfo& info,
+                                          const PastBucketMap& pastBuckets,
+                                          std::set<string>* str_set,
+                                          ProtoOutputStream* protoOutput) {
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)info.metricId);
+    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, info.isActive);
 
-    if (mPastBuckets.empty()) {
+    if (pastBuckets.empty()) {
         return;
     }
 
-    if (mDimensionGuardrailHit) {
+    if (info.dimensionGuardrailHit) {
         protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_DIMENSION_GUARDRAIL_HIT,
-                           mDimensionGuardrailHit);
+                           info.dimensionGuardrailHit);
     }
 
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ESTIMATED_MEMORY_BYTES,
-                       (long long)byteSizeLocked());
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)mTimeBaseNs);
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)mBucketSizeNs);
+                       (long long)info.byteSize);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)info.timeBaseNs);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)info.bucketSizeNs);
 
     // Fills the dimension path if not slicing by a primitive repeated field or position ALL.
-    if (!mShouldUseNestedDimensions) {
-        if (!mDimensionsInWhat.empty()) {
+    if (!info.shouldUseNestedDimensions) {
+        if (!info.dimensionsInWhat.empty()) {
             uint64_t dimenPathToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
-            writeDimensionPathToProto(mDimensionsInWhat, protoOutput);
+            writeDimensionPathToProto(info.dimensionsInWhat, protoOutput);
             protoOutput->end(dimenPathToken);
         }
     }
 
     uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_COUNT_METRICS);
 
-    for (const auto& counter : mPastBuckets) {
+    for (const auto& counter : pastBuckets) {
         const MetricDimensionKey& dimensionKey = counter.first;
         VLOG("  dimension key %s", dimensionKey.toString().c_str());
 
@@ -267,7 +325,7 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
 
         // First fill dimension.
-        if (mShouldUseNestedDimensions) {
+        if (info.shouldUseNestedDimensions) {
             uint64_t dimensionToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
             writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
@@ -288,21 +346,20 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
             uint64_t bucketInfoToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
             // Partial bucket.
-            if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
+            if (bucket.mBucketEndNs - bucket.mBucketStartNs != info.bucketSizeNs) {
                 protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
                                    (long long)NanoToMillis(bucket.mBucketStartNs));
                 protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
                                    (long long)NanoToMillis(bucket.mBucketEndNs));
             } else {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
-                                   (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+                protoOutput->write(
+                        FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
+                        (long long)((bucket.mBucketEndNs - info.timeBaseNs) / info.bucketSizeNs -
+                                    1));
             }
             protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_COUNT, (long long)bucket.mCount);
 
-            // We only write the condition timer value if the metric has a
-            // condition and isn't sliced by state or condition.
-            // TODO(b/268531179): Slice the condition timer by state and condition
-            if (mConditionTrackerIndex >= 0 && mSlicedStateAtoms.empty() && !mConditionSliced) {
+            if (info.writeConditionTrueNs) {
                 protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_CONDITION_TRUE_NS,
                                    (long long)bucket.mConditionTrueNs);
             }
@@ -315,19 +372,13 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
     }
 
     protoOutput->end(protoToken);
-
-    if (erase_data) {
-        mPastBuckets.clear();
-        mDimensionGuardrailHit = false;
-        mTotalDataSize = 0;
-    }
 }
 
 void CountMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     flushIfNeededLocked(dropTimeNs);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
     mPastBuckets.clear();
-    mTotalDataSize = 0;
+    resetDataSizeLocked();
 }
 
 void CountMetricProducer::onConditionChangedLocked(const bool conditionMet,
@@ -350,7 +401,7 @@ bool CountMetricProducer::hitGuardRailLocked(const MetricDimensionKey& newKey) {
     // 1. Report the tuple count if the tuple count > soft limit
     if (mCurrentSlicedCounter->size() >= StatsdStats::kDimensionKeySizeSoftLimit) {
         size_t newTupleCount = mCurrentSlicedCounter->size() + 1;
-        StatsdStats::getInstance().noteMetricDimensionSize(mConfigKey, mMetricId, newTupleCount);
+        noteDimensionSizeLocked(newTupleCount);
         // 2. Don't add more tuples, we are above the allowed threshold. Drop the data.
         if (newTupleCount > mDimensionHardLimit) {
             if (!mHasHitGuardrail) {
@@ -358,7 +409,7 @@ bool CountMetricProducer::hitGuardRailLocked(const MetricDimensionKey& newKey) {
                       newKey.toString().c_str());
                 mHasHitGuardrail = true;
             }
-            mDimensionGuardrailHit = true;
+            mDimensionGuardrailHit.store(true, std::memory_order_relaxed);
             StatsdStats::getInstance().noteHardDimensionLimitReached(mMetricId);
             return true;
         }
@@ -385,7 +436,7 @@ void CountMetricProducer::onMatchedLogEventInternalLocked(
             return;
         }
         // create a counter for the new key
-        (*mCurrentSlicedCounter)[eventKey] = 1;
+        (*mCurrentSlicedCounter)[internDimensionKeyLocked(eventKey)] = 1;
     } else {
         // increment the existing value
         auto& count = it->second;
@@ -464,8 +515,10 @@ void CountMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
             auto& bucketList = mPastBuckets[counter.first];
             const bool isFirstBucket = bucketList.empty();
             bucketList.push_back(info);
-            mTotalDataSize += computeBucketSizeLocked(eventTimeNs < fullBucketEndTimeNs,
-                                                      counter.first, isFirstBucket);
+            mTotalDataSize.fetch_add(computeBucketSizeLocked(eventTimeNs < fullBucketEndTimeNs,
+                                                             counter.first, isFirstBucket),
+                                     std::memory_order_relaxed);
+            mTotalDataSizeV1.fetch_add(kBucketSize, std::memory_order_relaxed);
             VLOG("metric %lld, dump key value: %s -> %lld", (long long)mMetricId,
                  counter.first.toString().c_str(), (long long)counter.second);
         }
@@ -513,14 +566,12 @@ void CountMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
 size_t CountMetricProducer::byteSizeLocked() const {
     sp<ConfigMetadataProvider> configMetadataProvider = getConfigMetadataProvider();
     if (configMetadataProvider != nullptr && configMetadataProvider->useV2SoftMemoryCalculation()) {
-        return computeOverheadSizeLocked(!mPastBuckets.empty(), mDimensionGuardrailHit) +
-               mTotalDataSize;
-    }
-    size_t totalSize = 0;
-    for (const auto& pair : mPastBuckets) {
-        totalSize += pair.second.size() * kBucketSize;
+        const size_t totalDataSize = mTotalDataSize.load(std::memory_order_relaxed);
+        return computeOverheadSizeLocked(/*hasPastBuckets=*/totalDataSize > 0,
+                                         mDimensionGuardrailHit.load(std::memory_order_relaxed)) +
+               totalDataSize;
     }
-    return totalSize;
+    return mTotalDataSizeV1.load(std::memory_order_relaxed);
 }
 
 // Estimate for the size of a CountBucket.
@@ -79,6 +79,11 @@ private:
                             std::set<string> *str_set,
                             android::util::ProtoOutputStream* protoOutput) override;
 
+    DumpReportWriter takeDumpReportLocked(const int64_t dumpTimeNs,
+                                          const bool include_current_partial_bucket,
+                                          const bool erase_data, const DumpLatency dumpLatency,
+                                          std::set<string>* str_set) override;
+
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
     // Internal interface to handle condition change.
@@ -120,7 +125,32 @@ private:
             std::unordered_map<int, std::vector<int>>& deactivationAtomTrackerToMetricMap,
             std::vector<int>& metricsWithActivation) override;
 
-    std::unordered_map<MetricDimensionKey, std::vector<CountBucket>> mPastBuckets;
+    using PastBucketMap = std::unordered_map<MetricDimensionKey, std::vector<CountBucket>>;
+
+    // What the report of the metric holds besides its past buckets, as of the dump.
+    struct DumpReportInfo {
+        int64_t metricId;
+        bool isActive;
+        bool dimensionGuardrailHit;
+        size_t byteSize;
+        int64_t timeBaseNs;
+        int64_t bucketSizeNs;
+        bool shouldUseNestedDimensions;
+        std::vector<Matcher> dimensionsInWhat;
+        bool writeConditionTrueNs;
+    };
+
+    // Flushes the buckets ending by the dump time, or all of them, and returns the report info.
+    DumpReportInfo getDumpReportInfoLocked(const int64_t dumpTimeNs,
+                                           const bool include_current_partial_bucket);
+
+    // Writes the fields of a StatsLogReport. It only reads its arguments, so that it can run
+    // without the lock.
+    static void writeDumpReport(const DumpReportInfo& info, const PastBucketMap& pastBuckets,
+                                std::set<string>* str_set,
+                                android::util::ProtoOutputStream* protoOutput);
+
+    PastBucketMap mPastBuckets;
 
     // The current bucket (may be a partial bucket).
     std::shared_ptr<DimToValMap> mCurrentSlicedCounter = std::make_shared<DimToValMap>();
@@ -135,8 +165,9 @@ private:
 
     bool countPassesThreshold(int64_t count);
 
-    // Tracks if the dimension guardrail has been hit in the current report.
-    bool mDimensionGuardrailHit;
+    // Tracks if the dimension guardrail has been hit in the current report. Atomic so that
+    // byteSize() can read it without mMutex.
+    std::atomic<bool> mDimensionGuardrailHit;
 
     const size_t mDimensionHardLimit;
 
@@ -146,6 +177,8 @@ private:
     FRIEND_TEST(CountMetricProducerTest, TestAnomalyDetectionUnSliced);
     FRIEND_TEST(CountMetricProducerTest, TestFirstBucket);
     FRIEND_TEST(CountMetricProducerTest, TestOneWeekTimeUnit);
+    FRIEND_TEST(CountMetricProducerTest, TestTakeDumpReport);
+    FRIEND_TEST(CountMetricProducerTest, TestRunningByteSize);
     FRIEND_TEST(CountMetricProducerTest, TestSplitOnAppUpgradeDisabled);
 
     FRIEND_TEST(CountMetricProducerTest_PartialBucket, TestSplitInCurrentBucket);
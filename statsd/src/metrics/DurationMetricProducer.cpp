@@ -272,7 +272,8 @@ void DurationMetricProducer::initTrueDimensions(const int whatIndex, const int64
     if (whatIndex == -1) {
         return;
     }
-    const map<HashableDimensionKey, int>* slicedWhatMap = mWizard->getSlicedDimensionMap(whatIndex);
+    const unordered_map<HashableDimensionKey, int>* slicedWhatMap =
+            mWizard->getSlicedDimensionMap(whatIndex);
     for (const auto& [internalDimKey, count] : *slicedWhatMap) {
         for (int i = 0; i < count; i++) {
             // Fake start events.
@@ -392,7 +393,7 @@ void DurationMetricProducer::onSlicedConditionMayChangeLocked_opt1(const int64_t
     // state based on the new unsliced condition state.
     if (dimensionsChangedToTrue == nullptr || dimensionsChangedToFalse == nullptr ||
         (dimensionsChangedToTrue->empty() && dimensionsChangedToFalse->empty())) {
-        const map<HashableDimensionKey, int>* slicedConditionMap =
+        const unordered_map<HashableDimensionKey, int>* slicedConditionMap =
                 mWizard->getSlicedDimensionMap(mConditionTrackerIndex);
         for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
             HashableDimensionKey linkedConditionDimensionKey;
@@ -501,54 +502,112 @@ void DurationMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     flushIfNeededLocked(dropTimeNs);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
     mPastBuckets.clear();
+    resetDataSizeLocked();
 }
 
 void DurationMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     flushIfNeededLocked(dumpTimeNs);
     mPastBuckets.clear();
+    resetDataSizeLocked();
 }
 
 void DurationMetricProducer::onDumpReportLocked(
         const int64_t dumpTimeNs, const bool include_current_partial_bucket, const bool erase_data,
         const DumpLatency dumpLatency, std::set<string>* str_set, ProtoOutputStream* protoOutput) {
+    writeDumpReport(getDumpReportInfoLocked(dumpTimeNs, include_current_partial_bucket),
+                    mPastBuckets, str_set, protoOutput);
+    if (erase_data) {
+        mPastBuckets.clear();
+        resetDataSizeLocked();
+    }
+}
+
+MetricProducer::DumpReportWriter DurationMetricProducer::takeDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket, const bool erase_data,
+        const DumpLatency dumpLatency, std::set<string>* str_set) {
+    auto info = std::make_shared<DumpReportInfo>(
+            getDumpReportInfoLocked(dumpTimeNs, include_current_partial_bucket));
+
+    // The past buckets are handed over when erased, so that only the kept buckets are copied.
+    auto pastBuckets = std::make_shared<PastBucketMap>();
+    if (erase_data) {
+        pastBuckets->swap(mPastBuckets);
+        resetDataSizeLocked();
+    } else {
+        *pastBuckets = mPastBuckets;
+    }
+
+    return [info, pastBuckets, str_set](uint64_t fieldId, ProtoOutputStream* protoOutput) {
+        uint64_t token = protoOutput->start(fieldId);
+        writeDumpReport(*info, *pastBuckets, str_set, protoOutput);
+        protoOutput->end(token);
+    };
+}
+
+DurationMetricProducer::DumpReportInfo DurationMetricProducer::getDumpReportInfoLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket) {
     if (include_current_partial_bucket) {
         flushLocked(dumpTimeNs);
     } else {
         flushIfNeededLocked(dumpTimeNs);
     }
 
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
-    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
+    DumpReportInfo info;
+    info.metricId = mMetricId;
+    info.isActive = isActiveLocked();
+    info.dimensionGuardrailHit = !mPastBuckets.empty() &&
+                                 StatsdStats::getInstance().hasHitDimensionGuardrail(mMetricId);
+    info.byteSize = mPastBuckets.empty() ? 0 : byteSizeLocked();
+    info.timeBaseNs = mTimeBaseNs;
+    info.bucketSizeNs = mBucketSizeNs;
+    info.shouldUseNestedDimensions = mShouldUseNestedDimensions;
+    if (!mShouldUseNestedDimensions && !mPastBuckets.empty()) {
+        info.dimensionsInWhat = mDimensionsInWhat;
+    }
+    // We only write the condition timer value if the metric has a
+    // condition and isn't sliced by state or condition.
+    // TODO(b/268531762): Slice the condition timer by state and condition
+    info.writeConditionTrueNs =
+            mConditionTrackerIndex >= 0 && mSlicedStateAtoms.empty() && !mConditionSliced;
+    return info;
+}
+
+void DurationMetricProducer::writeDumpReport(const DumpReportInfo& info,
+                                             const PastBucketMap& pastBuckets,
+                                             std::set<string>* str_set,
+                                             ProtoOutputStream* protoOutput) {
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)info.metricId);
+    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, info.isActive);
 
-    if (mPastBuckets.empty()) {
+    if (pastBuckets.empty()) {
         VLOG(" Duration metric, empty return");
         return;
     }
 
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ESTIMATED_MEMORY_BYTES,
-                       (long long)byteSizeLocked());
+                       (long long)info.byteSize);
 
-    if (StatsdStats::getInstance().hasHitDimensionGuardrail(mMetricId)) {
+    if (info.dimensionGuardrailHit) {
         protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_DIMENSION_GUARDRAIL_HIT, true);
     }
 
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)mTimeBaseNs);
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)mBucketSizeNs);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)info.timeBaseNs);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)info.bucketSizeNs);
 
-    if (!mShouldUseNestedDimensions) {
-        if (!mDimensionsInWhat.empty()) {
+    if (!info.shouldUseNestedDimensions) {
+        if (!info.dimensionsInWhat.empty()) {
             uint64_t dimenPathToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
-            writeDimensionPathToProto(mDimensionsInWhat, protoOutput);
+            writeDimensionPathToProto(info.dimensionsInWhat, protoOutput);
             protoOutput->end(dimenPathToken);
         }
     }
 
     uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DURATION_METRICS);
 
-    VLOG("Duration metric %lld dump report now...", (long long)mMetricId);
+    VLOG("Duration metric %lld dump report now...", (long long)info.metricId);
 
-    for (const auto& pair : mPastBuckets) {
+    for (const auto& pair : pastBuckets) {
         const MetricDimensionKey& dimensionKey = pair.first;
         VLOG("  dimension key %s", dimensionKey.toString().c_str());
 
@@ -556,7 +615,7 @@ void DurationMetricProducer::onDumpReportLocked(
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
 
         // First fill dimension.
-        if (mShouldUseNestedDimensions) {
+        if (info.shouldUseNestedDimensions) {
             uint64_t dimensionToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
             writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
@@ -576,21 +635,20 @@ void DurationMetricProducer::onDumpReportLocked(
         for (const auto& bucket : pair.second) {
             uint64_t bucketInfoToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
-            if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
+            if (bucket.mBucketEndNs - bucket.mBucketStartNs != info.bucketSizeNs) {
                 protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
                                    (long long)NanoToMillis(bucket.mBucketStartNs));
                 protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
                                    (long long)NanoToMillis(bucket.mBucketEndNs));
             } else {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
-                                   (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+                protoOutput->write(
+                        FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
+                        (long long)((bucket.mBucketEndNs - info.timeBaseNs) / info.bucketSizeNs -
+                                    1));
             }
             protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_DURATION, (long long)bucket.mDuration);
 
-            // We only write the condition timer value if the metric has a
-            // condition and isn't sliced by state or condition.
-            // TODO(b/268531762): Slice the condition timer by state and condition
-            if (mConditionTrackerIndex >= 0 && mSlicedStateAtoms.empty() && !mConditionSliced) {
+            if (info.writeConditionTrueNs) {
                 protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_CONDITION_TRUE_NS,
                                    (long long)bucket.mConditionTrueNs);
             }
@@ -604,9 +662,6 @@ void DurationMetricProducer::onDumpReportLocked(
     }
 
     protoOutput->end(protoToken);
-    if (erase_data) {
-        mPastBuckets.clear();
-    }
 }
 
 void DurationMetricProducer::flushIfNeededLocked(const int64_t eventTimeNs) {
@@ -631,13 +686,25 @@ void DurationMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
     for (auto whatIt = mCurrentSlicedDurationTrackerMap.begin();
             whatIt != mCurrentSlicedDurationTrackerMap.end();) {
         if (whatIt->second->flushCurrentBucket(eventTimeNs, mUploadThreshold, globalConditionTrueNs,
-                                               &mPastBuckets)) {
+                                               &mFlushedBuckets)) {
             VLOG("erase bucket for key %s", whatIt->first.toString().c_str());
             whatIt = mCurrentSlicedDurationTrackerMap.erase(whatIt);
         } else {
             ++whatIt;
         }
     }
+    for (const auto& [dimKey, buckets] : mFlushedBuckets) {
+        auto& bucketList = mPastBuckets[dimKey];
+        for (const DurationBucket& bucket : buckets) {
+            const bool isFullBucket = bucket.mBucketEndNs - bucket.mBucketStartNs >= mBucketSizeNs;
+            mTotalDataSize.fetch_add(computeBucketSizeLocked(isFullBucket, dimKey,
+                                                             bucketList.empty()),
+                                     std::memory_order_relaxed);
+            mTotalDataSizeV1.fetch_add(kBucketSize, std::memory_order_relaxed);
+            bucketList.push_back(bucket);
+        }
+    }
+    mFlushedBuckets.clear();
 
     StatsdStats::getInstance().noteBucketCount(mMetricId);
     mCurrentBucketStartTimeNs = nextBucketStartTimeNs;
@@ -666,8 +733,7 @@ bool DurationMetricProducer::hitGuardRailLocked(const MetricDimensionKey& newKey
         // 1. Report the tuple count if the tuple count > soft limit
         if (mCurrentSlicedDurationTrackerMap.size() >= StatsdStats::kDimensionKeySizeSoftLimit) {
             size_t newTupleCount = mCurrentSlicedDurationTrackerMap.size() + 1;
-            StatsdStats::getInstance().noteMetricDimensionSize(
-                    mConfigKey, mMetricId, newTupleCount);
+            noteDimensionSizeLocked(newTupleCount);
             // 2. Don't add more tuples, we are above the allowed threshold. Drop the data.
             if (newTupleCount > mDimensionHardLimit) {
                 if (!mHasHitGuardrail) {
@@ -693,7 +759,9 @@ void DurationMetricProducer::handleStartEvent(const MetricDimensionKey& eventKey
         if (hitGuardRailLocked(eventKey)) {
             return;
         }
-        mCurrentSlicedDurationTrackerMap[whatKey] = createDurationTracker(eventKey);
+        const MetricDimensionKey newKey = internDimensionKeyLocked(eventKey);
+        mCurrentSlicedDurationTrackerMap[newKey.getDimensionKeyInWhat()] =
+                createDurationTracker(newKey);
     }
 
     auto it = mCurrentSlicedDurationTrackerMap.find(whatKey);
@@ -866,27 +934,16 @@ size_t DurationMetricProducer::computeBucketSizeLocked(const bool isFullBucket,
 }
 
 size_t DurationMetricProducer::byteSizeLocked() const {
-    size_t totalSize = 0;
     sp<ConfigMetadataProvider> configMetadataProvider = getConfigMetadataProvider();
     if (configMetadataProvider != nullptr && configMetadataProvider->useV2SoftMemoryCalculation()) {
-        bool hasHitDimensionGuardrail =
-                StatsdStats::getInstance().hasHitDimensionGuardrail(mMetricId);
-        totalSize += computeOverheadSizeLocked(!mPastBuckets.empty(), hasHitDimensionGuardrail);
-        for (const auto& pair : mPastBuckets) {
-            bool isFirstBucket = true;
-            for (const auto& bucket : pair.second) {
-                bool isFullBucket = bucket.mBucketEndNs - bucket.mBucketStartNs >= mBucketSizeNs;
-                totalSize +=
-                        computeBucketSizeLocked(isFullBucket, /*dimKey=*/pair.first, isFirstBucket);
-                isFirstBucket = false;
-            }
-        }
-        return totalSize;
-    }
-    for (const auto& pair : mPastBuckets) {
-        totalSize += pair.second.size() * kBucketSize;
-    }
-    return totalSize;
+        // The guardrail only counts with past buckets, so that StatsdStats is not locked otherwise.
+        const size_t totalDataSize = mTotalDataSize.load(std::memory_order_relaxed);
+        const bool hasPastBuckets = totalDataSize > 0;
+        const bool dimensionGuardrailHit =
+                hasPastBuckets && StatsdStats::getInstance().hasHitDimensionGuardrail(mMetricId);
+        return computeOverheadSizeLocked(hasPastBuckets, dimensionGuardrailHit) + totalDataSize;
+    }
+    return mTotalDataSizeV1.load(std::memory_order_relaxed);
 }
 
 }  // namespace statsd
@@ -93,6 +93,11 @@ private:
                             std::set<string> *str_set,
                             android::util::ProtoOutputStream* protoOutput) override;
 
+    DumpReportWriter takeDumpReportLocked(const int64_t dumpTimeNs,
+                                          const bool include_current_partial_bucket,
+                                          const bool erase_data, const DumpLatency dumpLatency,
+                                          std::set<string>* str_set) override;
+
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
     // Internal interface to handle condition change.
@@ -167,8 +172,36 @@ private:
     // Caches the current unsliced part condition.
     ConditionState mUnSlicedPartCondition;
 
+    using PastBucketMap = std::unordered_map<MetricDimensionKey, std::vector<DurationBucket>>;
+
+    // What the report of the metric holds besides its past buckets, as of the dump.
+    struct DumpReportInfo {
+        int64_t metricId;
+        bool isActive;
+        bool dimensionGuardrailHit;
+        size_t byteSize;
+        int64_t timeBaseNs;
+        int64_t bucketSizeNs;
+        bool shouldUseNestedDimensions;
+        std::vector<Matcher> dimensionsInWhat;
+        bool writeConditionTrueNs;
+    };
+
+    // Flushes the buckets ending by the dump time, or all of them, and returns the report info.
+    DumpReportInfo getDumpReportInfoLocked(const int64_t dumpTimeNs,
+                                           const bool include_current_partial_bucket);
+
+    // Writes the fields of a StatsLogReport. It only reads its arguments, so that it can run
+    // without the lock.
+    static void writeDumpReport(const DumpReportInfo& info, const PastBucketMap& pastBuckets,
+                                std::set<string>* str_set,
+                                android::util::ProtoOutputStream* protoOutput);
+
     // Save the past buckets and we can clear when the StatsLogReport is dumped.
-    std::unordered_map<MetricDimensionKey, std::vector<DurationBucket>> mPastBuckets;
+    PastBucketMap mPastBuckets;
+
+    // The buckets just flushed by the trackers, moved to mPastBuckets as their size is counted.
+    PastBucketMap mFlushedBuckets;
 
     // The duration trackers in the current bucket.
     std::unordered_map<HashableDimensionKey, std::unique_ptr<DurationTracker>>
@@ -189,6 +222,7 @@ private:
     FRIEND_TEST(DurationMetricTrackerTest, TestNonSlicedCondition);
     FRIEND_TEST(DurationMetricTrackerTest, TestNonSlicedConditionUnknownState);
     FRIEND_TEST(DurationMetricTrackerTest, TestFirstBucket);
+    FRIEND_TEST(DurationMetricTrackerTest, TestByteSize);
 
     FRIEND_TEST(DurationMetricProducerTest, TestSumDurationAppUpgradeSplitDisabled);
     FRIEND_TEST(DurationMetricProducerTest, TestClearCurrentSlicedTrackerMapWhenStop);
@@ -139,7 +139,7 @@ optional<InvalidConfigReason> EventMetricProducer::onConfigUpdatedLocked(
 void EventMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     mAggregatedAtoms.clear();
     resetDataCorruptionFlagsLocked();
-    mTotalDataSize = 0;
+    mTotalDataSize.store(0, std::memory_order_relaxed);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
 }
 
@@ -167,7 +167,7 @@ std::unique_ptr<std::vector<uint8_t>> serializeProtoLocked(ProtoOutputStream& pr
 void EventMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mAggregatedAtoms.clear();
     resetDataCorruptionFlagsLocked();
-    mTotalDataSize = 0;
+    mTotalDataSize.store(0, std::memory_order_relaxed);
 }
 
 void EventMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
@@ -176,18 +176,63 @@ void EventMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                                              const DumpLatency dumpLatency,
                                              std::set<string> *str_set,
                                              ProtoOutputStream* protoOutput) {
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
-    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
+    writeDumpReport(getDumpReportInfoLocked(), mAggregatedAtoms, protoOutput);
+    if (erase_data) {
+        mAggregatedAtoms.clear();
+        resetDataCorruptionFlagsLocked();
+        mTotalDataSize.store(0, std::memory_order_relaxed);
+    }
+}
+
+MetricProducer::DumpReportWriter EventMetricProducer::takeDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket, const bool erase_data,
+        const DumpLatency dumpLatency, std::set<string>* str_set) {
+    auto info = std::make_shared<DumpReportInfo>(getDumpReportInfoLocked());
+
+    // The atoms are handed over when erased, so that only the kept atoms are copied.
+    auto aggregatedAtoms = std::make_shared<AggregatedAtomMap>();
+    if (erase_data) {
+        aggregatedAtoms->swap(mAggregatedAtoms);
+        resetDataCorruptionFlagsLocked();
+        mTotalDataSize.store(0, std::memory_order_relaxed);
+    } else {
+        *aggregatedAtoms = mAggregatedAtoms;
+    }
+
+    return [info, aggregatedAtoms](uint64_t fieldId, ProtoOutputStream* protoOutput) {
+        uint64_t token = protoOutput->start(fieldId);
+        writeDumpReport(*info, *aggregatedAtoms, protoOutput);
+        protoOutput->end(token);
+    };
+}
+
+EventMetricProducer::DumpReportInfo EventMetricProducer::getDumpReportInfoLocked() const {
+    DumpReportInfo info;
+    info.metricId = mMetricId;
+    info.isActive = isActiveLocked();
+    info.dataCorruptedDueToQueueOverflow =
+            mDataCorruptedDueToQueueOverflow != DataCorruptionSeverity::kNone;
+    info.dataCorruptedDueToSocketLoss =
+            mDataCorruptedDueToSocketLoss != DataCorruptionSeverity::kNone;
+    info.byteSize = mAggregatedAtoms.empty() ? 0 : byteSizeLocked();
+    return info;
+}
+
+void EventMetricProducer::writeDumpReport(const DumpReportInfo& info,
+                                          const AggregatedAtomMap& aggregatedAtoms,
+                                          ProtoOutputStream* protoOutput) {
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)info.metricId);
+    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, info.isActive);
     // Data corrupted reason
     writeDataCorruptedReasons(*protoOutput, FIELD_ID_DATA_CORRUPTED_REASON,
-                              mDataCorruptedDueToQueueOverflow != DataCorruptionSeverity::kNone,
-                              mDataCorruptedDueToSocketLoss != DataCorruptionSeverity::kNone);
-    if (!mAggregatedAtoms.empty()) {
+                              info.dataCorruptedDueToQueueOverflow,
+                              info.dataCorruptedDueToSocketLoss);
+    if (!aggregatedAtoms.empty()) {
         protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ESTIMATED_MEMORY_BYTES,
-                           (long long)byteSizeLocked());
+                           (long long)info.byteSize);
     }
     uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_EVENT_METRICS);
-    for (const auto& [atomDimensionKey, elapsedTimestampsNs] : mAggregatedAtoms) {
+    for (const auto& [atomDimensionKey, elapsedTimestampsNs] : aggregatedAtoms) {
         uint64_t wrapperToken =
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
 
@@ -207,11 +252,6 @@ void EventMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
     }
 
     protoOutput->end(protoToken);
-    if (erase_data) {
-        mAggregatedAtoms.clear();
-        resetDataCorruptionFlagsLocked();
-        mTotalDataSize = 0;
-    }
 }
 
 void EventMetricProducer::onConditionChangedLocked(const bool conditionMet,
@@ -239,22 +279,25 @@ void EventMetricProducer::onMatchedLogEventInternalLocked(
     if (aggregatedTimestampsNs.empty()) {
         sp<ConfigMetadataProvider> provider = getConfigMetadataProvider();
         if (provider != nullptr && provider->useV2SoftMemoryCalculation()) {
-            mTotalDataSize += getFieldValuesSizeV2(key.getAtomFieldValues().getValues());
+            mTotalDataSize.fetch_add(getFieldValuesSizeV2(key.getAtomFieldValues().getValues()),
+                                     std::memory_order_relaxed);
         } else {
-            mTotalDataSize += getSize(key.getAtomFieldValues().getValues());
+            mTotalDataSize.fetch_add(getSize(key.getAtomFieldValues().getValues()),
+                                     std::memory_order_relaxed);
         }
     }
     aggregatedTimestampsNs.push_back(elapsedTimeNs);
-    mTotalDataSize += sizeof(int64_t);  // Add the size of the event timestamp
+    // Add the size of the event timestamp
+    mTotalDataSize.fetch_add(sizeof(int64_t), std::memory_order_relaxed);
 }
 
 size_t EventMetricProducer::byteSizeLocked() const {
     sp<ConfigMetadataProvider> provider = getConfigMetadataProvider();
     if (provider != nullptr && provider->useV2SoftMemoryCalculation()) {
-        return mTotalDataSize +
+        return mTotalDataSize.load(std::memory_order_relaxed) +
                computeOverheadSizeLocked(/*hasPastBuckets=*/false, /*dimensionGuardrailHit=*/false);
     }
-    return mTotalDataSize;
+    return mTotalDataSize.load(std::memory_order_relaxed);
 }
 
 MetricProducer::DataCorruptionSeverity EventMetricProducer::determineCorruptionSeverity(
@@ -63,6 +63,10 @@ private:
                             const DumpLatency dumpLatency,
                             std::set<string> *str_set,
                             android::util::ProtoOutputStream* protoOutput) override;
+    DumpReportWriter takeDumpReportLocked(const int64_t dumpTimeNs,
+                                          const bool include_current_partial_bucket,
+                                          const bool erase_data, const DumpLatency dumpLatency,
+                                          std::set<string>* str_set) override;
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
     // Internal interface to handle condition change.
@@ -97,8 +101,27 @@ private:
     DataCorruptionSeverity determineCorruptionSeverity(DataCorruptedReason reason,
                                                        LostAtomType atomType) const override;
 
+    using AggregatedAtomMap = std::unordered_map<AtomDimensionKey, std::vector<int64_t>>;
+
+    // What the report of the metric holds besides its atoms, as of the dump.
+    struct DumpReportInfo {
+        int64_t metricId;
+        bool isActive;
+        bool dataCorruptedDueToQueueOverflow;
+        bool dataCorruptedDueToSocketLoss;
+        size_t byteSize;
+    };
+
+    DumpReportInfo getDumpReportInfoLocked() const;
+
+    // Writes the fields of a StatsLogReport. It only reads its arguments, so that it can run
+    // without the lock.
+    static void writeDumpReport(const DumpReportInfo& info,
+                                const AggregatedAtomMap& aggregatedAtoms,
+                                android::util::ProtoOutputStream* protoOutput);
+
     // Maps the field/value pairs of an atom to a list of timestamps used to deduplicate atoms.
-    std::unordered_map<AtomDimensionKey, std::vector<int64_t>> mAggregatedAtoms;
+    AggregatedAtomMap mAggregatedAtoms;
 
     const int mSamplingPercentage;
 };
@@ -244,7 +244,7 @@ void GaugeMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     flushIfNeededLocked(dumpTimeNs);
     mPastBuckets.clear();
     mSkippedBuckets.clear();
-    mTotalDataSize = 0;
+    resetDataSizeLocked();
 }
 
 void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
@@ -253,6 +253,46 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                                              const DumpLatency dumpLatency,
                                              std::set<string> *str_set,
                                              ProtoOutputStream* protoOutput) {
+    writeDumpReport(getDumpReportInfoLocked(dumpTimeNs, include_current_partial_bucket),
+                    mPastBuckets, mSkippedBuckets, str_set, protoOutput);
+
+    if (erase_data) {
+        mPastBuckets.clear();
+        mSkippedBuckets.clear();
+        mDimensionGuardrailHit.store(false, std::memory_order_relaxed);
+        resetDataSizeLocked();
+    }
+}
+
+MetricProducer::DumpReportWriter GaugeMetricProducer::takeDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket, const bool erase_data,
+        const DumpLatency dumpLatency, std::set<string>* str_set) {
+    auto info = std::make_shared<DumpReportInfo>(
+            getDumpReportInfoLocked(dumpTimeNs, include_current_partial_bucket));
+
+    // The buckets are handed over when erased, so that only the kept buckets are copied.
+    auto pastBuckets = std::make_shared<PastBucketMap>();
+    auto skippedBuckets = std::make_shared<std::vector<SkippedBucket>>();
+    if (erase_data) {
+        pastBuckets->swap(mPastBuckets);
+        skippedBuckets->swap(mSkippedBuckets);
+        mDimensionGuardrailHit.store(false, std::memory_order_relaxed);
+        resetDataSizeLocked();
+    } else {
+        *pastBuckets = mPastBuckets;
+        *skippedBuckets = mSkippedBuckets;
+    }
+
+    return [info, pastBuckets, skippedBuckets, str_set](uint64_t fieldId,
+                                                        ProtoOutputStream* protoOutput) {
+        uint64_t token = protoOutput->start(fieldId);
+        writeDumpReport(*info, *pastBuckets, *skippedBuckets, str_set, protoOutput);
+        protoOutput->end(token);
+    };
+}
+
+GaugeMetricProducer::DumpReportInfo GaugeMetricProducer::getDumpReportInfoLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket) {
     VLOG("Gauge metric %lld report now...", (long long)mMetricId);
     if (include_current_partial_bucket) {
         flushLocked(dumpTimeNs);
@@ -260,37 +300,58 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
         flushIfNeededLocked(dumpTimeNs);
     }
 
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
-    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
+    DumpReportInfo info;
+    info.metricId = mMetricId;
+    info.isActive = isActiveLocked();
+    info.dimensionGuardrailHit = mDimensionGuardrailHit.load(std::memory_order_relaxed);
+    const bool hasBuckets = !mPastBuckets.empty() || !mSkippedBuckets.empty();
+    info.byteSize = hasBuckets ? byteSizeLocked() : 0;
+    info.timeBaseNs = mTimeBaseNs;
+    info.bucketSizeNs = mBucketSizeNs;
+    info.shouldUseNestedDimensions = mShouldUseNestedDimensions;
+    if (!mShouldUseNestedDimensions && hasBuckets) {
+        info.dimensionsInWhat = mDimensionsInWhat;
+    }
+    info.atomId = mAtomId;
+    return info;
+}
+
+void GaugeMetricProducer::writeDumpReport(const DumpReportInfo& info,
+                                          const PastBucketMap& pastBuckets,
+                                          const std::vector<SkippedBucket>& skippedBuckets,
+                                          std::set<string>* str_set,
+                                          ProtoOutputStream* protoOutput) {
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)info.metricId);
+    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, info.isActive);
 
-    if (mPastBuckets.empty() && mSkippedBuckets.empty()) {
+    if (pastBuckets.empty() && skippedBuckets.empty()) {
         return;
     }
 
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ESTIMATED_MEMORY_BYTES,
-                       (long long)byteSizeLocked());
+                       (long long)info.byteSize);
 
-    if (mDimensionGuardrailHit) {
+    if (info.dimensionGuardrailHit) {
         protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_DIMENSION_GUARDRAIL_HIT,
-                           mDimensionGuardrailHit);
+                           info.dimensionGuardrailHit);
     }
 
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)mTimeBaseNs);
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)mBucketSizeNs);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)info.timeBaseNs);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)info.bucketSizeNs);
 
     // Fills the dimension path if not slicing by a primitive repeated field or position ALL.
-    if (!mShouldUseNestedDimensions) {
-        if (!mDimensionsInWhat.empty()) {
+    if (!info.shouldUseNestedDimensions) {
+        if (!info.dimensionsInWhat.empty()) {
             uint64_t dimenPathToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
-            writeDimensionPathToProto(mDimensionsInWhat, protoOutput);
+            writeDimensionPathToProto(info.dimensionsInWhat, protoOutput);
             protoOutput->end(dimenPathToken);
         }
     }
 
     uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_GAUGE_METRICS);
 
-    for (const auto& skippedBucket : mSkippedBuckets) {
+    for (const auto& skippedBucket : skippedBuckets) {
         uint64_t wrapperToken =
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SKIPPED);
         protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_START_MILLIS,
@@ -308,7 +369,7 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
         protoOutput->end(wrapperToken);
     }
 
-    for (const auto& pair : mPastBuckets) {
+    for (const auto& pair : pastBuckets) {
         const MetricDimensionKey& dimensionKey = pair.first;
 
         VLOG("Gauge dimension key %s", dimensionKey.toString().c_str());
@@ -316,7 +377,7 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
 
         // First fill dimension.
-        if (mShouldUseNestedDimensions) {
+        if (info.shouldUseNestedDimensions) {
             uint64_t dimensionToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
             writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
@@ -331,14 +392,16 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
             uint64_t bucketInfoToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
 
-            if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
+            if (bucket.mBucketEndNs - bucket.mBucketStartNs != info.bucketSizeNs) {
                 protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
                                    (long long)NanoToMillis(bucket.mBucketStartNs));
                 protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
                                    (long long)NanoToMillis(bucket.mBucketEndNs));
             } else {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
-                                   (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+                protoOutput->write(
+                        FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
+                        (long long)((bucket.mBucketEndNs - info.timeBaseNs) / info.bucketSizeNs -
+                                    1));
             }
 
             if (!bucket.mAggregatedAtoms.empty()) {
@@ -348,7 +411,7 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                             FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_AGGREGATED_ATOM);
                     uint64_t atomToken =
                             protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM_VALUE);
-                    writeFieldValueTreeToStream(mAtomId,
+                    writeFieldValueTreeToStream(info.atomId,
                                                 atomDimensionKey.getAtomFieldValues().getValues(),
                                                 protoOutput);
                     protoOutput->end(atomToken);
@@ -369,14 +432,6 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
         protoOutput->end(wrapperToken);
     }
     protoOutput->end(protoToken);
-
-
-    if (erase_data) {
-        mPastBuckets.clear();
-        mSkippedBuckets.clear();
-        mDimensionGuardrailHit = false;
-        mTotalDataSize = 0;
-    }
 }
 
 void GaugeMetricProducer::prepareFirstBucketLocked() {
@@ -528,7 +583,7 @@ bool GaugeMetricProducer::hitGuardRailLocked(const MetricDimensionKey& newKey) {
     // 1. Report the tuple count if the tuple count > soft limit
     if (mCurrentSlicedBucket->size() >= mDimensionSoftLimit) {
         size_t newTupleCount = mCurrentSlicedBucket->size() + 1;
-        StatsdStats::getInstance().noteMetricDimensionSize(mConfigKey, mMetricId, newTupleCount);
+        noteDimensionSizeLocked(newTupleCount);
         // 2. Don't add more tuples, we are above the allowed threshold. Drop the data.
         if (newTupleCount > mDimensionHardLimit) {
             if (!mHasHitGuardrail) {
@@ -536,7 +591,7 @@ bool GaugeMetricProducer::hitGuardRailLocked(const MetricDimensionKey& newKey) {
                       newKey.toString().c_str());
                 mHasHitGuardrail = true;
             }
-            mDimensionGuardrailHit = true;
+            mDimensionGuardrailHit.store(true, std::memory_order_relaxed);
             StatsdStats::getInstance().noteHardDimensionLimitReached(mMetricId);
             return true;
         }
@@ -583,13 +638,18 @@ void GaugeMetricProducer::onMatchedLogEventInternalLocked(
     if (hitGuardRailLocked(eventKey)) {
         return;
     }
-    if ((*mCurrentSlicedBucket)[eventKey].size() >= mGaugeAtomsPerDimensionLimit) {
+    auto sliceIt = mCurrentSlicedBucket->find(eventKey);
+    if (sliceIt == mCurrentSlicedBucket->end()) {
+        sliceIt = mCurrentSlicedBucket->emplace(internDimensionKeyLocked(eventKey),
+                                                std::vector<GaugeAtom>()).first;
+    }
+    if (sliceIt->second.size() >= mGaugeAtomsPerDimensionLimit) {
         return;
     }
 
     const int64_t truncatedElapsedTimestampNs = truncateTimestampIfNecessary(event);
     GaugeAtom gaugeAtom(getGaugeFields(event), truncatedElapsedTimestampNs);
-    (*mCurrentSlicedBucket)[eventKey].push_back(gaugeAtom);
+    sliceIt->second.push_back(gaugeAtom);
     // Anomaly detection on gauge metric only works when there is one numeric
     // field specified.
     if (mAnomalyTrackers.size() > 0) {
@@ -629,7 +689,8 @@ void GaugeMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     flushIfNeededLocked(dropTimeNs);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
     mPastBuckets.clear();
-    mTotalDataSize = 0;
+    mSkippedBuckets.clear();
+    resetDataSizeLocked();
 }
 
 // When a new matched event comes in, we check if event falls into the current
@@ -679,9 +740,13 @@ void GaugeMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
             auto& bucketList = mPastBuckets[slice.first];
             const bool isFirstBucket = bucketList.empty();
             bucketList.push_back(info);
-            mTotalDataSize += computeGaugeBucketSizeLocked(eventTimeNs >= fullBucketEndTimeNs,
-                                                           /*dimKey=*/slice.first, isFirstBucket,
-                                                           info.mAggregatedAtoms);
+            mTotalDataSize.fetch_add(
+                    computeGaugeBucketSizeLocked(eventTimeNs >= fullBucketEndTimeNs,
+                                                 /*dimKey=*/slice.first, isFirstBucket,
+                                                 info.mAggregatedAtoms),
+                    std::memory_order_relaxed);
+            mTotalDataSizeV1.fetch_add(computeGaugeBucketSizeV1(info.mAggregatedAtoms),
+                                       std::memory_order_relaxed);
             VLOG("Gauge gauge metric %lld, dump key value: %s", (long long)mMetricId,
                  slice.first.toString().c_str());
         }
@@ -693,7 +758,8 @@ void GaugeMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
                     buildDropEvent(eventTimeNs, BucketDropReason::BUCKET_TOO_SMALL));
         }
         mSkippedBuckets.emplace_back(mCurrentSkippedBucket);
-        mTotalDataSize += computeSkippedBucketSizeLocked(mCurrentSkippedBucket);
+        mTotalDataSize.fetch_add(computeSkippedBucketSizeLocked(mCurrentSkippedBucket),
+                                 std::memory_order_relaxed);
     }
 
     // If we have anomaly trackers, we need to update the partial bucket values.
@@ -736,21 +802,23 @@ size_t GaugeMetricProducer::computeGaugeBucketSizeLocked(
 size_t GaugeMetricProducer::byteSizeLocked() const {
     sp<ConfigMetadataProvider> configMetadataProvider = getConfigMetadataProvider();
     if (configMetadataProvider != nullptr && configMetadataProvider->useV2SoftMemoryCalculation()) {
-        return computeOverheadSizeLocked(!mPastBuckets.empty() || !mSkippedBuckets.empty(),
-                                         mDimensionGuardrailHit) +
-               mTotalDataSize;
+        const size_t totalDataSize = mTotalDataSize.load(std::memory_order_relaxed);
+        return computeOverheadSizeLocked(/*hasPastBuckets=*/totalDataSize > 0,
+                                         mDimensionGuardrailHit.load(std::memory_order_relaxed)) +
+               totalDataSize;
     }
-    size_t totalSize = 0;
-    for (const auto& pair : mPastBuckets) {
-        for (const auto& bucket : pair.second) {
-            for (const auto& [atomDimensionKey, elapsedTimestampsNs] : bucket.mAggregatedAtoms) {
-                totalSize += sizeof(FieldValue) *
-                             atomDimensionKey.getAtomFieldValues().getValues().size();
-                totalSize += sizeof(int64_t) * elapsedTimestampsNs.size();
-            }
-        }
+    return mTotalDataSizeV1.load(std::memory_order_relaxed);
+}
+
+size_t GaugeMetricProducer::computeGaugeBucketSizeV1(
+        const std::unordered_map<AtomDimensionKey, std::vector<int64_t>>& aggregatedAtoms) {
+    size_t bucketSize = 0;
+    for (const auto& [atomDimensionKey, elapsedTimestampsNs] : aggregatedAtoms) {
+        bucketSize +=
+                sizeof(FieldValue) * atomDimensionKey.getAtomFieldValues().getValues().size();
+        bucketSize += sizeof(int64_t) * elapsedTimestampsNs.size();
     }
-    return totalSize;
+    return bucketSize;
 }
 
 }  // namespace statsd
@@ -121,6 +121,12 @@ private:
                             const DumpLatency dumpLatency,
                             std::set<string> *str_set,
                             android::util::ProtoOutputStream* protoOutput) override;
+
+    DumpReportWriter takeDumpReportLocked(const int64_t dumpTimeNs,
+                                          const bool include_current_partial_bucket,
+                                          const bool erase_data, const DumpLatency dumpLatency,
+                                          std::set<string>* str_set) override;
+
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
     // Internal interface to handle condition change.
@@ -154,6 +160,10 @@ private:
             const std::unordered_map<AtomDimensionKey, std::vector<int64_t>>& aggregatedAtoms)
             const;
 
+    // Estimates the size of a past bucket without useV2SoftMemoryCalculation.
+    static size_t computeGaugeBucketSizeV1(
+            const std::unordered_map<AtomDimensionKey, std::vector<int64_t>>& aggregatedAtoms);
+
     optional<InvalidConfigReason> onConfigUpdatedLocked(
             const StatsdConfig& config, int configIndex, int metricIndex,
             const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
@@ -192,8 +202,34 @@ private:
     // if this is pulled metric
     const bool mIsPulled;
 
+    using PastBucketMap = std::unordered_map<MetricDimensionKey, std::vector<GaugeBucket>>;
+
+    // What the report of the metric holds besides its past and skipped buckets, as of the dump.
+    struct DumpReportInfo {
+        int64_t metricId;
+        bool isActive;
+        bool dimensionGuardrailHit;
+        size_t byteSize;
+        int64_t timeBaseNs;
+        int64_t bucketSizeNs;
+        bool shouldUseNestedDimensions;
+        std::vector<Matcher> dimensionsInWhat;
+        int atomId;
+    };
+
+    // Flushes the buckets ending by the dump time, or all of them, and returns the report info.
+    DumpReportInfo getDumpReportInfoLocked(const int64_t dumpTimeNs,
+                                           const bool include_current_partial_bucket);
+
+    // Writes the fields of a StatsLogReport. It only reads its arguments, so that it can run
+    // without the lock.
+    static void writeDumpReport(const DumpReportInfo& info, const PastBucketMap& pastBuckets,
+                                const std::vector<SkippedBucket>& skippedBuckets,
+                                std::set<string>* str_set,
+                                android::util::ProtoOutputStream* protoOutput);
+
     // Save the past buckets and we can clear when the StatsLogReport is dumped.
-    std::unordered_map<MetricDimensionKey, std::vector<GaugeBucket>> mPastBuckets;
+    PastBucketMap mPastBuckets;
 
     // The current partial bucket.
     std::shared_ptr<DimToGaugeAtomsMap> mCurrentSlicedBucket;
@@ -229,8 +265,9 @@ private:
 
     const size_t mGaugeAtomsPerDimensionLimit;
 
-    // Tracks if the dimension guardrail has been hit in the current report.
-    bool mDimensionGuardrailHit;
+    // Tracks if the dimension guardrail has been hit in the current report. Atomic so that
+    // byteSize() can read it without mMutex.
+    std::atomic<bool> mDimensionGuardrailHit;
 
     const int mSamplingPercentage;
 
@@ -246,6 +283,8 @@ private:
     FRIEND_TEST(GaugeMetricProducerTest, TestPullNWithoutTrigger);
     FRIEND_TEST(GaugeMetricProducerTest, TestRemoveDimensionInOutput);
     FRIEND_TEST(GaugeMetricProducerTest, TestPullDimensionalSampling);
+    FRIEND_TEST(GaugeMetricProducerTest, TestTakeDumpReport);
+    FRIEND_TEST(GaugeMetricProducerTest, TestRunningByteSize);
 
     FRIEND_TEST(GaugeMetricProducerTest_PartialBucket, TestPushedEvents);
     FRIEND_TEST(GaugeMetricProducerTest_PartialBucket, TestPulled);
@@ -168,26 +168,28 @@ size_t KllMetricProducer::getAggregatedValueSize(const std::unique_ptr<KllQuanti
 size_t KllMetricProducer::byteSizeLocked() const {
     sp<ConfigMetadataProvider> configMetadataProvider = getConfigMetadataProvider();
     if (configMetadataProvider != nullptr && configMetadataProvider->useV2SoftMemoryCalculation()) {
-        bool dimensionGuardrailHit = StatsdStats::getInstance().hasHitDimensionGuardrail(mMetricId);
-        return computeOverheadSizeLocked(!mPastBuckets.empty() || !mSkippedBuckets.empty(),
-                                         dimensionGuardrailHit) +
-               mTotalDataSize;
+        // The guardrail only counts with past buckets, so that StatsdStats is not locked otherwise.
+        const size_t totalDataSize = mTotalDataSize.load(std::memory_order_relaxed);
+        const bool hasPastBuckets = totalDataSize > 0;
+        const bool dimensionGuardrailHit =
+                hasPastBuckets && StatsdStats::getInstance().hasHitDimensionGuardrail(mMetricId);
+        return computeOverheadSizeLocked(hasPastBuckets, dimensionGuardrailHit) + totalDataSize;
     }
-    size_t totalSize = 0;
-    for (const auto& [_, buckets] : mPastBuckets) {
-        totalSize += buckets.size() * kBucketSize;
-        for (const auto& bucket : buckets) {
-            static const size_t kIntSize = sizeof(int);
-            totalSize += bucket.aggIndex.size() * kIntSize;
-            if (!bucket.aggregates.empty()) {
-                static const size_t kInt64Size = sizeof(int64_t);
-                // Assume sketch size is the same for all aggregations in a bucket.
-                totalSize += bucket.aggregates.size() * kInt64Size *
-                             bucket.aggregates[0]->num_stored_values();
-            }
-        }
+    return mTotalDataSizeV1.load(std::memory_order_relaxed);
+}
+
+size_t KllMetricProducer::getPastBucketSizeV1(
+        const PastBucket<std::unique_ptr<KllQuantile>>& bucket) const {
+    size_t bucketSize = kBucketSize;
+    static const size_t kIntSize = sizeof(int);
+    bucketSize += bucket.aggIndex.size() * kIntSize;
+    if (!bucket.aggregates.empty()) {
+        static const size_t kInt64Size = sizeof(int64_t);
+        // Assume sketch size is the same for all aggregations in a bucket.
+        bucketSize += bucket.aggregates.size() * kInt64Size *
+                      bucket.aggregates[0]->num_stored_values();
     }
-    return totalSize;
+    return bucketSize;
 }
 
 }  // namespace statsd
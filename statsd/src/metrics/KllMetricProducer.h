@@ -105,6 +105,9 @@ private:
 
     size_t getAggregatedValueSize(const std::unique_ptr<KllQuantile>& kll) const override;
 
+    size_t getPastBucketSizeV1(
+            const PastBucket<std::unique_ptr<KllQuantile>>& bucket) const override;
+
     bool aggregateFields(const int64_t eventTimeNs, const MetricDimensionKey& eventKey,
                          const LogEvent& event, std::vector<Interval>& intervals,
                          Empty& empty) override;
@@ -113,6 +116,7 @@ private:
     size_t byteSizeLocked() const override;
 
     FRIEND_TEST(KllMetricProducerTest, TestByteSize);
+    FRIEND_TEST(KllMetricProducerTest, TestRunningByteSize);
     FRIEND_TEST(KllMetricProducerTest, TestPushedEventsWithoutCondition);
     FRIEND_TEST(KllMetricProducerTest, TestPushedEventsWithCondition);
     FRIEND_TEST(KllMetricProducerTest, TestForcedBucketSplitWhenConditionUnknownSkipsBucket);
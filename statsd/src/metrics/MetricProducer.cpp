@@ -308,6 +308,26 @@ void MetricProducer::loadActiveMetricLocked(const ActiveMetric& activeMetric,
     }
 }
 
+MetricProducer::DumpReportWriter MetricProducer::takeDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket, const bool erase_data,
+        const DumpLatency dumpLatency, std::set<string>* str_set) {
+    ProtoOutputStream proto;
+    onDumpReportLocked(dumpTimeNs, include_current_partial_bucket, erase_data, dumpLatency,
+                       str_set, &proto);
+
+    auto bytes = std::make_shared<std::string>();
+    bytes->reserve(proto.size());
+    sp<android::util::ProtoReader> reader = proto.data();
+    while (reader->readBuffer() != nullptr) {
+        size_t toRead = reader->currentToRead();
+        bytes->append(reinterpret_cast<const char*>(reader->readBuffer()), toRead);
+        reader->move(toRead);
+    }
+    return [bytes](uint64_t fieldId, ProtoOutputStream* protoOutput) {
+        protoOutput->write(fieldId, bytes->data(), bytes->size());
+    };
+}
+
 void MetricProducer::writeActiveMetricToProtoOutputStream(
         int64_t currentTimeNs, const DumpReportReason reason, ProtoOutputStream* proto) {
     proto->write(FIELD_TYPE_INT64 | FIELD_ID_ACTIVE_METRIC_ID, (long long)mMetricId);
@@ -402,6 +422,14 @@ bool MetricProducer::maxDropEventsReached() const {
     return mCurrentSkippedBucket.dropEvents.size() >= StatsdStats::kMaxLoggedBucketDropEvents;
 }
 
+void MetricProducer::noteDimensionSizeLocked(const size_t newTupleCount) const {
+    if (mDimensionSizeStat != nullptr) {
+        StatsdStats::noteMaxValue(*mDimensionSizeStat, newTupleCount);
+    } else {
+        StatsdStats::getInstance().noteMetricDimensionSize(mConfigKey, mMetricId, newTupleCount);
+    }
+}
+
 bool MetricProducer::passesSampleCheckLocked(const vector<FieldValue>& values) const {
     // Only perform sampling if shard count is correct and there is a sampled what field.
     if (mShardCount <= 1 || mSampledWhatFields.size() == 0) {
@@ -21,6 +21,8 @@
 #include <src/guardrail/stats_log_enums.pb.h>
 #include <utils/RefBase.h>
 
+#include <atomic>
+#include <functional>
 #include <unordered_map>
 
 #include "HashableDimensionKey.h"
@@ -249,6 +251,22 @@ public:
                            str_set, protoOutput);
     }
 
+    // Writes a StatsLogReport of the metric as field [fieldId] of [protoOutput].
+    using DumpReportWriter =
+            std::function<void(uint64_t fieldId, android::util::ProtoOutputStream* protoOutput)>;
+
+    // Takes the data that onDumpReport would output, and returns a writer encoding it without
+    // holding the lock of the metric, so that the encoding does not delay the events. The writer
+    // adds the hashed strings to [str_set] like onDumpReport, so [str_set] must outlive it.
+    DumpReportWriter takeDumpReport(const int64_t dumpTimeNs,
+                                    const bool include_current_partial_bucket,
+                                    const bool erase_data, const DumpLatency dumpLatency,
+                                    std::set<string>* str_set) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return takeDumpReportLocked(dumpTimeNs, include_current_partial_bucket, erase_data,
+                                    dumpLatency, str_set);
+    }
+
     virtual optional<InvalidConfigReason> onConfigUpdatedLocked(
             const StatsdConfig& config, int configIndex, int metricIndex,
             const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
@@ -276,9 +294,9 @@ public:
     }
 
     // Returns the memory in bytes currently used to store this metric's data. Does not change
-    // state.
+    // state. Does not lock mMutex either: byteSizeLocked() only reads the atomic data sizes and
+    // guardrail flags, and the dimension config that is fixed at construction.
     size_t byteSize() const {
-        std::lock_guard<std::mutex> lock(mMutex);
         return byteSizeLocked();
     }
 
@@ -383,8 +401,31 @@ public:
         mSampledWhatFields.swap(samplingInfo.sampledWhatFields);
         mShardCount = samplingInfo.shardCount;
     }
+
+    // Sets the StatsdStats entry that records the max output tuple size of this metric.
+    void setDimensionSizeStat(std::shared_ptr<std::atomic<int>> dimensionSizeStat) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDimensionSizeStat = std::move(dimensionSizeStat);
+    }
+
+    void setDimensionKeyPool(std::shared_ptr<HashableDimensionKeyPool> dimensionKeyPool) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDimensionKeyPool = std::move(dimensionKeyPool);
+    }
     // End: getters/setters
 protected:
+    // Returns the copy of key held by the dimension key pool, so that the key stored by the
+    // metric shares its values and cached hash with equal keys of the config. Only called when
+    // a new dimension is added to the maps of the metric, as it locks the pool.
+    HashableDimensionKey internDimensionKeyLocked(const HashableDimensionKey& key) const {
+        return mDimensionKeyPool != nullptr ? mDimensionKeyPool->intern(key) : key;
+    }
+
+    MetricDimensionKey internDimensionKeyLocked(const MetricDimensionKey& key) const {
+        return MetricDimensionKey(internDimensionKeyLocked(key.getDimensionKeyInWhat()),
+                                  internDimensionKeyLocked(key.getStateValuesKey()));
+    }
+
     /**
      * Flushes the current bucket if the eventTime is after the current bucket's end time.
      */
@@ -446,6 +487,13 @@ protected:
                                     const bool erase_data, const DumpLatency dumpLatency,
                                     std::set<string>* str_set,
                                     android::util::ProtoOutputStream* protoOutput) = 0;
+    // By default, the report is encoded right away and the writer copies the encoded bytes.
+    // Metrics holding many buckets override it to move or copy their buckets instead.
+    virtual DumpReportWriter takeDumpReportLocked(const int64_t dumpTimeNs,
+                                                  const bool include_current_partial_bucket,
+                                                  const bool erase_data,
+                                                  const DumpLatency dumpLatency,
+                                                  std::set<string>* str_set);
     virtual void clearPastBucketsLocked(const int64_t dumpTimeNs) = 0;
     virtual void prepareFirstBucketLocked(){};
     virtual size_t byteSizeLocked() const = 0;
@@ -507,6 +555,9 @@ protected:
 
     bool passesSampleCheckLocked(const vector<FieldValue>& values) const;
 
+    // Reports the output tuple size of this metric to StatsdStats when it's above the soft limit.
+    void noteDimensionSizeLocked(size_t newTupleCount) const;
+
     const int64_t mMetricId;
 
     // Hash of the Metric's proto bytes from StatsdConfig, including any activations.
@@ -590,6 +641,14 @@ protected:
     // If hard dimension guardrail is hit, do not spam logcat. This is a per bucket tracker.
     mutable bool mHasHitGuardrail;
 
+    // Max output tuple size of this metric in StatsdStats, updated without taking the StatsdStats
+    // lock. Null until set by the MetricsManager, in which case StatsdStats is called directly.
+    std::shared_ptr<std::atomic<int>> mDimensionSizeStat;
+
+    // Pool of the dimension keys of the config. Null until set by the MetricsManager, in which
+    // case keys are not pooled.
+    std::shared_ptr<HashableDimensionKeyPool> mDimensionKeyPool;
+
     // Matchers for sampled fields. Currently only one sampled dimension is supported.
     std::vector<Matcher> mSampledWhatFields;
 
@@ -619,7 +678,20 @@ protected:
      */
     void resetDataCorruptionFlagsLocked();
 
-    size_t mTotalDataSize = 0;
+    // Resets both data sizes when the past buckets are cleared. Must hold mMutex.
+    void resetDataSizeLocked() {
+        mTotalDataSize.store(0, std::memory_order_relaxed);
+        mTotalDataSizeV1.store(0, std::memory_order_relaxed);
+    }
+
+    // The data sizes are only written with mMutex held, but are read by byteSize() without it.
+    // Every past or skipped bucket adds a nonzero size, so the bucketed producers also use
+    // mTotalDataSize > 0 to tell whether they have past buckets.
+    std::atomic<size_t> mTotalDataSize = 0;
+
+    // The size of the past buckets as estimated without useV2SoftMemoryCalculation, kept by the
+    // bucketed producers next to mTotalDataSize so that byteSizeLocked() does not walk the buckets.
+    std::atomic<size_t> mTotalDataSizeV1 = 0;
 
     FRIEND_TEST(CountMetricE2eTest, TestSlicedState);
     FRIEND_TEST(CountMetricE2eTest, TestSlicedStateWithMap);
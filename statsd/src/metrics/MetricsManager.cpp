@@ -24,6 +24,8 @@
 #include <assert.h>
 #include <private/android_filesystem_config.h>
 
+#include <algorithm>
+
 #include "CountMetricProducer.h"
 #include "condition/CombinationConditionTracker.h"
 #include "condition/SimpleConditionTracker.h"
@@ -120,6 +122,7 @@ MetricsManager::MetricsManager(const ConfigKey& key, const StatsdConfig& config,
     }
     verifyGuardrailsAndUpdateStatsdStats();
     initializeConfigActiveStatus();
+    initEventScratchState();
 }
 
 MetricsManager::~MetricsManager() {
@@ -218,6 +221,7 @@ bool MetricsManager::updateConfig(const StatsdConfig& config, const int64_t time
 
     verifyGuardrailsAndUpdateStatsdStats();
     initializeConfigActiveStatus();
+    initEventScratchState();
     return !mInvalidConfigReason.has_value();
 }
 
@@ -328,6 +332,23 @@ void MetricsManager::verifyGuardrailsAndUpdateStatsdStats() {
             mConfigKey, mAllMetricProducers.size(), mAllConditionTrackers.size(),
             mAllAtomMatchingTrackers.size(), mAllAnomalyTrackers.size(), mAnnotations,
             mInvalidConfigReason);
+
+    // noteConfigReceived() created new ConfigStats for the config, previously fetched counters
+    // now belong to the iceboxed stats.
+    mMatcherMatchedStats.clear();
+    if (!isConfigValid()) {
+        return;
+    }
+    StatsdStats& stats = StatsdStats::getInstance();
+    mMatcherMatchedStats.reserve(mAllAtomMatchingTrackers.size());
+    for (const sp<AtomMatchingTracker>& tracker : mAllAtomMatchingTrackers) {
+        mMatcherMatchedStats.push_back(stats.getMatcherMatchedStat(mConfigKey, tracker->getId()));
+    }
+    for (const sp<MetricProducer>& producer : mAllMetricProducers) {
+        producer->setDimensionSizeStat(
+                stats.getMetricDimensionSizeStat(mConfigKey, producer->getMetricId()));
+        producer->setDimensionKeyPool(mDimensionKeyPool);
+    }
 }
 
 void MetricsManager::initializeConfigActiveStatus() {
@@ -480,10 +501,18 @@ void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs, const int64_t w
                                   const bool include_current_partial_bucket, const bool erase_data,
                                   const DumpLatency dumpLatency, std::set<string>* str_set,
                                   ProtoOutputStream* protoOutput) {
+    takeDumpReport(dumpTimeStampNs, wallClockNs, include_current_partial_bucket, erase_data,
+                   dumpLatency, str_set)(protoOutput);
+}
+
+MetricsManager::DumpReportWriter MetricsManager::takeDumpReport(
+        const int64_t dumpTimeStampNs, const int64_t wallClockNs,
+        const bool include_current_partial_bucket, const bool erase_data,
+        const DumpLatency dumpLatency, std::set<string>* str_set) {
     if (hasRestrictedMetricsDelegate()) {
         // TODO(b/268150038): report error to statsdstats
         VLOG("Unexpected call to onDumpReport in restricted metricsmanager.");
-        return;
+        return [](ProtoOutputStream*) {};
     }
 
     vector<std::pair<int32_t, int32_t>> queueOverflowStats =
@@ -492,38 +521,44 @@ void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs, const int64_t w
 
     VLOG("=========================Metric Reports Start==========================");
     // one StatsLogReport per MetricProduer
+    vector<MetricProducer::DumpReportWriter> metricWriters;
+    metricWriters.reserve(mAllMetricProducers.size());
     for (const auto& producer : mAllMetricProducers) {
         if (mNoReportMetricIds.find(producer->getMetricId()) == mNoReportMetricIds.end()) {
-            uint64_t token = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
-                                                FIELD_ID_METRICS);
-            if (mHashStringsInReport) {
-                producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
-                                       dumpLatency, str_set, protoOutput);
-            } else {
-                producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
-                                       dumpLatency, nullptr, protoOutput);
-            }
-            protoOutput->end(token);
+            metricWriters.push_back(producer->takeDumpReport(
+                    dumpTimeStampNs, include_current_partial_bucket, erase_data, dumpLatency,
+                    mHashStringsInReport ? str_set : nullptr));
         } else {
             producer->clearPastBuckets(dumpTimeStampNs);
         }
     }
-    for (const auto& annotation : mAnnotations) {
-        uint64_t token = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
-                                            FIELD_ID_ANNOTATIONS);
-        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ANNOTATIONS_INT64,
-                           (long long)annotation.first);
-        protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_ANNOTATIONS_INT32, annotation.second);
-        protoOutput->end(token);
-    }
 
     // Do not update the timestamps when data is not cleared to avoid timestamps from being
     // misaligned.
     if (erase_data) {
         mLastReportTimeNs = dumpTimeStampNs;
         mLastReportWallClockNs = wallClockNs;
+        // Drops the keys of the buckets that were just reported. The keys taken by the writers
+        // are still held by them, so they are dropped by the next prune.
+        mDimensionKeyPool->prune();
     }
     VLOG("=========================Metric Reports End==========================");
+
+    return [metricWriters = std::move(metricWriters),
+            annotations = mAnnotations](ProtoOutputStream* protoOutput) {
+        for (const auto& metricWriter : metricWriters) {
+            metricWriter(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_METRICS,
+                         protoOutput);
+        }
+        for (const auto& annotation : annotations) {
+            uint64_t token = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                                                FIELD_ID_ANNOTATIONS);
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ANNOTATIONS_INT64,
+                               (long long)annotation.first);
+            protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_ANNOTATIONS_INT32, annotation.second);
+            protoOutput->end(token);
+        }
+    };
 }
 
 bool MetricsManager::checkLogCredentials(const int32_t uid, const int32_t atomId) const {
@@ -572,77 +607,80 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
 
     bool isActive = mIsAlwaysActive;
 
-    // Set of metrics that are still active after flushing.
-    unordered_set<int> activeMetricsIndices;
+    // Whether any metric w/ activation condition is still active after flushing.
+    bool hasActiveMetricWithActivation = false;
 
     // Update state of all metrics w/ activation conditions as of eventTimeNs.
     for (int metricIndex : mMetricIndexesWithActivation) {
         const sp<MetricProducer>& metric = mAllMetricProducers[metricIndex];
         metric->flushIfExpire(eventTimeNs);
-        if (metric->isActive()) {
-            // If this metric w/ activation condition is still active after
-            // flushing, remember it.
-            activeMetricsIndices.insert(metricIndex);
-        }
+        hasActiveMetricWithActivation |= metric->isActive();
     }
 
-    mIsActive = isActive || !activeMetricsIndices.empty();
+    mIsActive = isActive || hasActiveMetricWithActivation;
 
-    const auto matchersIt = mTagIdsToMatchersMap.find(tagId);
+    const auto planIt = mAtomDispatchPlans.find(tagId);
 
-    if (matchersIt == mTagIdsToMatchersMap.end()) {
+    if (planIt == mAtomDispatchPlans.end()) {
         // Not interesting...
         return;
     }
+    const AtomDispatchPlan& plan = planIt->second;
 
     if (event.isParsedHeaderOnly()) {
         // This should not happen if metric config is defined for certain atom id
-        const int64_t firstMatcherId =
-                mAllAtomMatchingTrackers[*matchersIt->second.begin()]->getId();
+        const int64_t firstMatcherId = mAllAtomMatchingTrackers[plan.rootMatchers[0]]->getId();
         ALOGW("Atom %d is mistakenly skipped - there is a matcher %lld for it", tagId,
               (long long)firstMatcherId);
         return;
     }
 
-    vector<MatchingState> matcherCache(mAllAtomMatchingTrackers.size(),
-                                       MatchingState::kNotComputed);
-    vector<shared_ptr<LogEvent>> matcherTransformations(matcherCache.size(), nullptr);
+    // mMatcherCache and mMatcherTransformations are reset to their default values at the end of
+    // this function, only for the matchers evaluated for this atom.
+    vector<MatchingState>& matcherCache = mMatcherCache;
+    vector<shared_ptr<LogEvent>>& matcherTransformations = mMatcherTransformations;
 
-    for (const auto& matcherIndex : matchersIt->second) {
+    for (const int matcherIndex : plan.rootMatchers) {
         mAllAtomMatchingTrackers[matcherIndex]->onLogEvent(event, matcherIndex,
                                                            mAllAtomMatchingTrackers, matcherCache,
                                                            matcherTransformations);
     }
 
-    // Set of metrics that received an activation cancellation.
-    unordered_set<int> metricIndicesWithCanceledActivations;
-
     // Determine which metric activations received a cancellation and cancel them.
-    for (const auto& it : mDeactivationAtomTrackerToMetricMap) {
-        if (matcherCache[it.first] == MatchingState::kMatched) {
-            for (int metricIndex : it.second) {
-                mAllMetricProducers[metricIndex]->cancelEventActivation(it.first);
-                metricIndicesWithCanceledActivations.insert(metricIndex);
+    for (const DispatchEntry& deactivation : plan.deactivations) {
+        if (matcherCache[deactivation.index] == MatchingState::kMatched) {
+            for (const int metricIndex : deactivation.targets) {
+                mAllMetricProducers[metricIndex]->cancelEventActivation(deactivation.index);
+                if (!mMetricHasCanceledActivation[metricIndex]) {
+                    mMetricHasCanceledActivation[metricIndex] = true;
+                    mMetricsWithCanceledActivations.push_back(metricIndex);
+                }
             }
         }
     }
 
     // Determine whether any metrics are no longer active after cancelling metric activations.
-    for (const int metricIndex : metricIndicesWithCanceledActivations) {
-        const sp<MetricProducer>& metric = mAllMetricProducers[metricIndex];
-        metric->flushIfExpire(eventTimeNs);
-        if (!metric->isActive()) {
-            activeMetricsIndices.erase(metricIndex);
+    if (!mMetricsWithCanceledActivations.empty()) {
+        for (const int metricIndex : mMetricsWithCanceledActivations) {
+            mAllMetricProducers[metricIndex]->flushIfExpire(eventTimeNs);
+            mMetricHasCanceledActivation[metricIndex] = false;
+        }
+        mMetricsWithCanceledActivations.clear();
+
+        // Cancellation can only turn metrics off, re-check which ones are still active.
+        hasActiveMetricWithActivation = false;
+        for (int metricIndex : mMetricIndexesWithActivation) {
+            hasActiveMetricWithActivation |= mAllMetricProducers[metricIndex]->isActive();
         }
     }
 
-    isActive |= !activeMetricsIndices.empty();
+    isActive |= hasActiveMetricWithActivation;
 
     // Determine which metric activations should be turned on and turn them on
-    for (const auto& it : mActivationAtomTrackerToMetricMap) {
-        if (matcherCache[it.first] == MatchingState::kMatched) {
-            for (int metricIndex : it.second) {
-                mAllMetricProducers[metricIndex]->activate(it.first, eventTimeNs);
+    for (const DispatchEntry& activation : plan.activations) {
+        if (matcherCache[activation.index] == MatchingState::kMatched) {
+            for (const int metricIndex : activation.targets) {
+                mAllMetricProducers[metricIndex]->activate(activation.index, eventTimeNs);
                 isActive |= mAllMetricProducers[metricIndex]->isActive();
             }
         }
@@ -650,47 +688,39 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
 
     mIsActive = isActive;
 
-    // A bitmap to see which ConditionTracker needs to be re-evaluated.
-    vector<uint8_t> conditionToBeEvaluated(mAllConditionTrackers.size(), false);
-    vector<shared_ptr<LogEvent>> conditionToTransformedLogEvents(mAllConditionTrackers.size(),
-                                                                 nullptr);
-
-    for (const auto& [matcherIndex, conditionList] : mTrackerToConditionMap) {
-        if (matcherCache[matcherIndex] == MatchingState::kMatched) {
-            for (const int conditionIndex : conditionList) {
-                conditionToBeEvaluated[conditionIndex] = true;
-                conditionToTransformedLogEvents[conditionIndex] =
-                        matcherTransformations[matcherIndex];
-            }
+    // Mark the ConditionTrackers that need to be re-evaluated.
+    for (const DispatchEntry& matcherConditions : plan.matcherConditions) {
+        if (matcherCache[matcherConditions.index] != MatchingState::kMatched) {
+            continue;
+        }
+        for (const int conditionIndex : matcherConditions.targets) {
+            mConditionToBeEvaluated[conditionIndex] = true;
+            mConditionToTransformedLogEvents[conditionIndex] =
+                    matcherTransformations[matcherConditions.index];
         }
     }
 
-    vector<ConditionState> conditionCache(mAllConditionTrackers.size(),
-                                          ConditionState::kNotEvaluated);
+    vector<ConditionState>& conditionCache = mConditionCache;
     // A bitmap to track if a condition has changed value.
-    vector<uint8_t> changedCache(mAllConditionTrackers.size(), false);
-    for (size_t i = 0; i < mAllConditionTrackers.size(); i++) {
-        if (!conditionToBeEvaluated[i]) {
+    vector<uint8_t>& changedCache = mChangedCache;
+    for (const int i : plan.conditions) {
+        if (!mConditionToBeEvaluated[i]) {
             continue;
         }
         sp<ConditionTracker>& condition = mAllConditionTrackers[i];
-        const LogEvent& conditionEvent = conditionToTransformedLogEvents[i] == nullptr
+        const LogEvent& conditionEvent = mConditionToTransformedLogEvents[i] == nullptr
                                                  ? event
-                                                 : *conditionToTransformedLogEvents[i];
+                                                 : *mConditionToTransformedLogEvents[i];
         condition->evaluateCondition(conditionEvent, matcherCache, mAllConditionTrackers,
                                      conditionCache, changedCache);
     }
 
-    for (size_t i = 0; i < mAllConditionTrackers.size(); i++) {
+    for (const DispatchEntry& conditionMetrics : plan.conditionMetrics) {
+        const int i = conditionMetrics.index;
         if (!changedCache[i]) {
             continue;
         }
-        auto it = mConditionToMetricMap.find(i);
-        if (it == mConditionToMetricMap.end()) {
-            continue;
-        }
-        auto& metricList = it->second;
-        for (auto metricIndex : metricList) {
+        for (const int metricIndex : conditionMetrics.targets) {
             // Metric cares about non sliced condition, and it's changed.
             // Push the new condition to it directly.
             if (!mAllMetricProducers[metricIndex]->isConditionSliced()) {
@@ -706,23 +736,132 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
         }
     }
     // For matched AtomMatchers, tell relevant metrics that a matched event has come.
-    for (size_t i = 0; i < mAllAtomMatchingTrackers.size(); i++) {
-        if (matcherCache[i] == MatchingState::kMatched) {
-            StatsdStats::getInstance().noteMatcherMatched(mConfigKey,
-                                                          mAllAtomMatchingTrackers[i]->getId());
-            auto it = mTrackerToMetricMap.find(i);
-            if (it == mTrackerToMetricMap.end()) {
-                continue;
+    for (const int i : plan.matchers) {
+        if (matcherCache[i] == MatchingState::kMatched && mMatcherMatchedStats[i] != nullptr) {
+            mMatcherMatchedStats[i]->fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    for (const DispatchEntry& matcherMetrics : plan.matcherMetrics) {
+        const int i = matcherMetrics.index;
+        if (matcherCache[i] != MatchingState::kMatched) {
+            continue;
+        }
+        const LogEvent& metricEvent =
+                matcherTransformations[i] == nullptr ? event : *matcherTransformations[i];
+        for (const int metricIndex : matcherMetrics.targets) {
+            // pushed metrics are never scheduled pulls
+            mAllMetricProducers[metricIndex]->onMatchedLogEvent(i, metricEvent);
+        }
+    }
+
+    // Reset the scratch state reachable from this atom.
+    for (const int i : plan.matchers) {
+        matcherCache[i] = MatchingState::kNotComputed;
+        matcherTransformations[i] = nullptr;
+    }
+    for (const DispatchEntry& conditionMetrics : plan.conditionMetrics) {
+        const int i = conditionMetrics.index;
+        conditionCache[i] = ConditionState::kNotEvaluated;
+        changedCache[i] = false;
+        mConditionToBeEvaluated[i] = false;
+        mConditionToTransformedLogEvents[i] = nullptr;
+    }
+}
+
+void MetricsManager::initEventScratchState() {
+    mAtomDispatchPlans.clear();
+    if (!isConfigValid()) {
+        // onLogEvent drops all events, and the tracker maps may be partially built.
+        return;
+    }
+
+    const size_t matcherCount = mAllAtomMatchingTrackers.size();
+    const size_t conditionCount = mAllConditionTrackers.size();
+    mMatcherCache.assign(matcherCount, MatchingState::kNotComputed);
+    mMatcherTransformations.assign(matcherCount, nullptr);
+    mConditionCache.assign(conditionCount, ConditionState::kNotEvaluated);
+    mChangedCache.assign(conditionCount, false);
+    mConditionToBeEvaluated.assign(conditionCount, false);
+    mConditionToTransformedLogEvents.assign(conditionCount, nullptr);
+    mMetricHasCanceledActivation.assign(mAllMetricProducers.size(), false);
+    mMetricsWithCanceledActivations.clear();
+    mMetricsWithCanceledActivations.reserve(mMetricIndexesWithActivation.size());
+
+    for (const auto& [tagId, matcherIndices] : mTagIdsToMatchersMap) {
+        mAtomDispatchPlans.emplace(tagId, buildAtomDispatchPlan(matcherIndices));
+    }
+}
+
+MetricsManager::AtomDispatchPlan MetricsManager::buildAtomDispatchPlan(
+        const vector<int>& rootMatchers) const {
+    AtomDispatchPlan plan;
+    plan.rootMatchers = rootMatchers;
+
+    // Combination matchers evaluate all of their children.
+    vector<uint8_t> visitedMatchers(mAllAtomMatchingTrackers.size(), false);
+    for (const int matcherIndex : rootMatchers) {
+        if (!visitedMatchers[matcherIndex]) {
+            visitedMatchers[matcherIndex] = true;
+            plan.matchers.push_back(matcherIndex);
+        }
+    }
+    for (size_t i = 0; i < plan.matchers.size(); i++) {
+        for (const int childIndex : mAllAtomMatchingTrackers[plan.matchers[i]]->getChildren()) {
+            if (!visitedMatchers[childIndex]) {
+                visitedMatchers[childIndex] = true;
+                plan.matchers.push_back(childIndex);
             }
-            auto& metricList = it->second;
-            const LogEvent& metricEvent =
-                    matcherTransformations[i] == nullptr ? event : *matcherTransformations[i];
-            for (const int metricIndex : metricList) {
-                // pushed metrics are never scheduled pulls
-                mAllMetricProducers[metricIndex]->onMatchedLogEvent(i, metricEvent);
+        }
+    }
+    std::sort(plan.matchers.begin(), plan.matchers.end());
+
+    vector<uint8_t> visitedConditions(mAllConditionTrackers.size(), false);
+    for (const int matcherIndex : plan.matchers) {
+        if (const auto it = mDeactivationAtomTrackerToMetricMap.find(matcherIndex);
+            it != mDeactivationAtomTrackerToMetricMap.end()) {
+            plan.deactivations.push_back({matcherIndex, it->second});
+        }
+        if (const auto it = mActivationAtomTrackerToMetricMap.find(matcherIndex);
+            it != mActivationAtomTrackerToMetricMap.end()) {
+            plan.activations.push_back({matcherIndex, it->second});
+        }
+        if (const auto it = mTrackerToMetricMap.find(matcherIndex);
+            it != mTrackerToMetricMap.end()) {
+            plan.matcherMetrics.push_back({matcherIndex, it->second});
+        }
+        if (const auto it = mTrackerToConditionMap.find(matcherIndex);
+            it != mTrackerToConditionMap.end()) {
+            plan.matcherConditions.push_back({matcherIndex, it->second});
+            for (const int conditionIndex : it->second) {
+                if (!visitedConditions[conditionIndex]) {
+                    visitedConditions[conditionIndex] = true;
+                    plan.conditions.push_back(conditionIndex);
+                }
+            }
+        }
+    }
+    std::sort(plan.conditions.begin(), plan.conditions.end());
+
+    // Condition evaluation recurses into child conditions, which may change as well.
+    vector<int> reachableConditions = plan.conditions;
+    for (size_t i = 0; i < reachableConditions.size(); i++) {
+        for (const int childIndex : mAllConditionTrackers[reachableConditions[i]]->getChildren()) {
+            if (!visitedConditions[childIndex]) {
+                visitedConditions[childIndex] = true;
+                reachableConditions.push_back(childIndex);
             }
         }
     }
+    std::sort(reachableConditions.begin(), reachableConditions.end());
+    for (const int conditionIndex : reachableConditions) {
+        DispatchEntry& entry = plan.conditionMetrics.emplace_back();
+        entry.index = conditionIndex;
+        if (const auto it = mConditionToMetricMap.find(conditionIndex);
+            it != mConditionToMetricMap.end()) {
+            entry.targets = it->second;
+        }
+    }
+    return plan;
 }
 
 void MetricsManager::onLogEventLost(const SocketLossInfo& socketLossInfo) {
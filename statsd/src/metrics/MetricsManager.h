@@ -138,6 +138,17 @@ public:
                               const DumpLatency dumpLatency, std::set<string>* str_set,
                               android::util::ProtoOutputStream* protoOutput);
 
+    // Writes a ConfigMetricsReport's StatsLogReports and annotations to [protoOutput].
+    using DumpReportWriter = std::function<void(android::util::ProtoOutputStream* protoOutput)>;
+
+    // Takes the data that onDumpReport would output, and returns a writer encoding it later.
+    // Only taking the data needs to be synchronized with the events, the writer can run
+    // concurrently with them. [str_set] must outlive the writer.
+    virtual DumpReportWriter takeDumpReport(const int64_t dumpTimeNs, int64_t wallClockNs,
+                                            const bool include_current_partial_bucket,
+                                            const bool erase_data, const DumpLatency dumpLatency,
+                                            std::set<string>* str_set);
+
     // Computes the total byte size of all metrics managed by a single config source.
     // Does not change the state.
     virtual size_t byteSize();
@@ -329,6 +340,66 @@ private:
 
     std::vector<int> mMetricIndexesWithActivation;
 
+    // Scratch state reused by onLogEvent so that processing a matched event does not allocate.
+    // Sized on config creation/update. Every entry holds its default value between events: an
+    // event only resets the entries reachable from its atom id, so the cost is proportional to
+    // the matchers and conditions reachable from the atom rather than to the size of the config.
+    std::vector<MatchingState> mMatcherCache;
+    std::vector<std::shared_ptr<LogEvent>> mMatcherTransformations;
+    std::vector<ConditionState> mConditionCache;
+    std::vector<uint8_t> mChangedCache;
+    std::vector<uint8_t> mConditionToBeEvaluated;
+    std::vector<std::shared_ptr<LogEvent>> mConditionToTransformedLogEvents;
+
+    // Metrics that received an activation cancellation for the current event.
+    std::vector<uint8_t> mMetricHasCanceledActivation;
+    std::vector<int> mMetricsWithCanceledActivations;
+
+    // A matcher or condition tracker index and the trackers or metrics it dispatches to.
+    struct DispatchEntry {
+        int index;
+        std::vector<int> targets;
+    };
+
+    // Everything an event of one atom id can reach, derived from the config maps above on config
+    // creation/update so that onLogEvent does not scan them. All lists are sorted by index, which
+    // is the order trackers and metrics were notified in when scanning the whole config.
+    struct AtomDispatchPlan {
+        // Matchers in mTagIdsToMatchersMap for the atom id. Their onLogEvent is called.
+        std::vector<int> rootMatchers;
+        // rootMatchers and their descendants, i.e. every matcher that may be evaluated.
+        std::vector<int> matchers;
+        // Matchers to the metrics whose activation they cancel or trigger.
+        std::vector<DispatchEntry> deactivations;
+        std::vector<DispatchEntry> activations;
+        // Matchers to the condition trackers that use them.
+        std::vector<DispatchEntry> matcherConditions;
+        // Condition trackers using one of the matchers, i.e. the ones that may be evaluated.
+        std::vector<int> conditions;
+        // conditions and their descendants, which may change when conditions are evaluated,
+        // to the metrics using them.
+        std::vector<DispatchEntry> conditionMetrics;
+        // Matchers to the metrics they feed.
+        std::vector<DispatchEntry> matcherMetrics;
+    };
+
+    // Maps an atom id in mTagIdsToMatchersMap to its dispatch plan.
+    std::unordered_map<int, AtomDispatchPlan> mAtomDispatchPlans;
+
+    // StatsdStats match counters, indexed like mAllAtomMatchingTrackers. Incremented directly so
+    // that matching an event does not take the StatsdStats lock. Null if the config is invalid.
+    std::vector<std::shared_ptr<std::atomic<int>>> mMatcherMatchedStats;
+
+    // Dimension keys held by the metric producers, so that equal keys share their values.
+    const std::shared_ptr<HashableDimensionKeyPool> mDimensionKeyPool =
+            std::make_shared<HashableDimensionKeyPool>();
+
+    // Only called on config creation/update. Sizes the scratch state used by onLogEvent and
+    // builds mAtomDispatchPlans.
+    void initEventScratchState();
+
+    AtomDispatchPlan buildAtomDispatchPlan(const std::vector<int>& rootMatchers) const;
+
     inline bool checkLogCredentials(const LogEvent& event) const {
         return checkLogCredentials(event.GetUid(), event.GetTagId());
     }
@@ -346,6 +417,7 @@ private:
 
     // Verifies the config meets guardrails and updates statsdStats.
     // Sets up mInvalidConfigReason on error. Should be called on config creation/update
+    // Also fetches the StatsdStats counters of the new config used on the event path.
     void verifyGuardrailsAndUpdateStatsdStats();
 
     // Initializes mIsAlwaysActive and mIsActive.
@@ -443,6 +515,8 @@ private:
     FRIEND_TEST(MetricActivationE2eTest, TestCountMetricWithTwoMetricsTwoDeactivations);
 
     FRIEND_TEST(MetricsManagerTest, TestLogSources);
+    FRIEND_TEST(MetricsManagerTest, TestEventScratchStateReset);
+    FRIEND_TEST(MetricsManagerTest, TestAtomDispatchPlan);
     FRIEND_TEST(MetricsManagerTest, TestCheckLogCredentialsWhitelistedAtom);
     FRIEND_TEST(MetricsManagerTest, TestLogSourcesOnConfigUpdate);
     FRIEND_TEST(MetricsManagerTest_SPlus, TestRestrictedMetricsConfig);
@@ -649,17 +649,19 @@ size_t NumericValueMetricProducer::getAggregatedValueSize(const Value& value) co
 size_t NumericValueMetricProducer::byteSizeLocked() const {
     sp<ConfigMetadataProvider> configMetadataProvider = getConfigMetadataProvider();
     if (configMetadataProvider != nullptr && configMetadataProvider->useV2SoftMemoryCalculation()) {
-        bool dimensionGuardrailHit = StatsdStats::getInstance().hasHitDimensionGuardrail(mMetricId);
-        return computeOverheadSizeLocked(!mPastBuckets.empty() || !mSkippedBuckets.empty(),
-                                         dimensionGuardrailHit) +
-               mTotalDataSize;
-    }
-    size_t totalSize = 0;
-    for (const auto& [_, buckets] : mPastBuckets) {
-        totalSize += buckets.size() * kBucketSize;
-        // TODO(b/189283526): Add bytes used to store PastBucket.aggIndex vector
-    }
-    return totalSize;
+        // The guardrail only counts with past buckets, so that StatsdStats is not locked otherwise.
+        const size_t totalDataSize = mTotalDataSize.load(std::memory_order_relaxed);
+        const bool hasPastBuckets = totalDataSize > 0;
+        const bool dimensionGuardrailHit =
+                hasPastBuckets && StatsdStats::getInstance().hasHitDimensionGuardrail(mMetricId);
+        return computeOverheadSizeLocked(hasPastBuckets, dimensionGuardrailHit) + totalDataSize;
+    }
+    return mTotalDataSizeV1.load(std::memory_order_relaxed);
+}
+
+size_t NumericValueMetricProducer::getPastBucketSizeV1(const PastBucket<Value>& bucket) const {
+    // TODO(b/189283526): Add bytes used to store PastBucket.aggIndex vector
+    return kBucketSize;
 }
 
 bool NumericValueMetricProducer::valuePassesThreshold(const Interval& interval) const {
@@ -152,6 +152,8 @@ private:
 
     size_t getAggregatedValueSize(const Value& value) const override;
 
+    size_t getPastBucketSizeV1(const PastBucket<Value>& bucket) const override;
+
     bool hasAvgAggregationType(const vector<ValueMetric::AggregationType> aggregationTypes) const {
         for (const int aggType : aggregationTypes) {
             if (aggType == ValueMetric_AggregationType_AVG) {
@@ -239,6 +241,8 @@ private:
     FRIEND_TEST(NumericValueMetricProducerTest, TestSlicedStateWithMap);
     FRIEND_TEST(NumericValueMetricProducerTest, TestSlicedStateWithPrimaryField_WithDimensions);
     FRIEND_TEST(NumericValueMetricProducerTest, TestSlicedStateWithCondition);
+    FRIEND_TEST(NumericValueMetricProducerTest, TestTakeDumpReport);
+    FRIEND_TEST(NumericValueMetricProducerTest, TestRunningByteSize);
     FRIEND_TEST(NumericValueMetricProducerTest, TestTrimUnusedDimensionKey);
     FRIEND_TEST(NumericValueMetricProducerTest, TestUseZeroDefaultBase);
     FRIEND_TEST(NumericValueMetricProducerTest, TestUseZeroDefaultBaseWithPullFailures);
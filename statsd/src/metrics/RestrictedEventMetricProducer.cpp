@@ -57,12 +57,17 @@ void RestrictedEventMetricProducer::onMatchedLogEventInternalLocked(
         mRestrictedDataCategory != event.getRestrictionCategory()) {
         StatsdStats::getInstance().noteRestrictedMetricCategoryChanged(mConfigKey, mMetricId);
         deleteMetricTable();
-        mLogEvents.clear();
-        mTotalDataSize = 0;
+        mPendingEvents.clear();
+        mTotalDataSize.store(0, std::memory_order_relaxed);
     }
     mRestrictedDataCategory = event.getRestrictionCategory();
-    mLogEvents.push_back(event);
-    mTotalDataSize += getSize(event.getValues()) + sizeof(event);
+    if (!mPendingEvents.append(event)) {
+        // The pending events are inserted together, so they must fit the same table.
+        ALOGE("Dropping event with different fields for metric %lld", (long long)mMetricId);
+        StatsdStats::getInstance().noteRestrictedMetricInsertError(mConfigKey, mMetricId);
+        return;
+    }
+    mTotalDataSize.store(mPendingEvents.getByteSize(), std::memory_order_relaxed);
 }
 
 void RestrictedEventMetricProducer::onDumpReportLocked(
@@ -93,26 +98,26 @@ void RestrictedEventMetricProducer::clearPastBucketsLocked(const int64_t dumpTim
 }
 
 void RestrictedEventMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
-    mLogEvents.clear();
-    mTotalDataSize = 0;
+    mPendingEvents.clear();
+    mTotalDataSize.store(0, std::memory_order_relaxed);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
 }
 
 void RestrictedEventMetricProducer::flushRestrictedData() {
     std::lock_guard<std::mutex> lock(mMutex);
-    if (mLogEvents.empty()) {
+    if (mPendingEvents.empty()) {
         return;
     }
     int64_t flushStartNs = getElapsedRealtimeNs();
     if (!mIsMetricTableCreated) {
-        if (!dbutils::isEventCompatible(mConfigKey, mMetricId, mLogEvents[0])) {
+        if (!dbutils::isEventCompatible(mConfigKey, mMetricId, mPendingEvents)) {
             // Delete old data if schema changes
             // TODO(b/268150038): report error to statsdstats
             ALOGD("Detected schema change for metric %lld", (long long)mMetricId);
             deleteMetricTable();
         }
         // TODO(b/271481944): add retry.
-        if (!dbutils::createTableIfNeeded(mConfigKey, mMetricId, mLogEvents[0])) {
+        if (!dbutils::createTableIfNeeded(mConfigKey, mMetricId, mPendingEvents)) {
             ALOGE("Failed to create table for metric %lld", (long long)mMetricId);
             StatsdStats::getInstance().noteRestrictedMetricTableCreationError(mConfigKey,
                                                                               mMetricId);
@@ -121,7 +126,7 @@ void RestrictedEventMetricProducer::flushRestrictedData() {
         mIsMetricTableCreated = true;
     }
     string err;
-    if (!dbutils::insert(mConfigKey, mMetricId, mLogEvents, err)) {
+    if (!dbutils::insert(mConfigKey, mMetricId, mPendingEvents, err)) {
         ALOGE("Failed to insert logEvent to table for metric %lld. err=%s", (long long)mMetricId,
               err.c_str());
         StatsdStats::getInstance().noteRestrictedMetricInsertError(mConfigKey, mMetricId);
@@ -129,8 +134,8 @@ void RestrictedEventMetricProducer::flushRestrictedData() {
         StatsdStats::getInstance().noteRestrictedMetricFlushLatency(
                 mConfigKey, mMetricId, getElapsedRealtimeNs() - flushStartNs);
     }
-    mLogEvents.clear();
-    mTotalDataSize = 0;
+    mPendingEvents.clear();
+    mTotalDataSize.store(0, std::memory_order_relaxed);
 }
 
 bool RestrictedEventMetricProducer::writeMetricMetadataToProto(
@@ -4,6 +4,7 @@
 #include <gtest/gtest_prod.h>
 
 #include "EventMetricProducer.h"
+#include "utils/RestrictedEventColumns.h"
 #include "utils/RestrictedPolicyManager.h"
 
 namespace android {
@@ -59,7 +60,8 @@ private:
 
     StatsdRestrictionCategory mRestrictedDataCategory;
 
-    vector<LogEvent> mLogEvents;
+    // The events to insert into the metric table at the next flush.
+    RestrictedEventColumns mPendingEvents;
 };
 
 }  // namespace statsd
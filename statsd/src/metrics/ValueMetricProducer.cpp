@@ -316,13 +316,60 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::clearPastBucketsLocked(
         const int64_t dumpTimeNs) {
     mPastBuckets.clear();
     mSkippedBuckets.clear();
-    mTotalDataSize = 0;
+    resetDataSizeLocked();
 }
 
 template <typename AggregatedValue, typename DimExtras>
 void ValueMetricProducer<AggregatedValue, DimExtras>::onDumpReportLocked(
         const int64_t dumpTimeNs, const bool includeCurrentPartialBucket, const bool eraseData,
         const DumpLatency dumpLatency, set<string>* strSet, ProtoOutputStream* protoOutput) {
+    writeDumpReport(getDumpReportInfoLocked(dumpTimeNs, includeCurrentPartialBucket, dumpLatency),
+                    mPastBuckets, mSkippedBuckets, strSet, protoOutput);
+
+    VLOG("metric %lld done with dump report...", (long long)mMetricId);
+    if (eraseData) {
+        mPastBuckets.clear();
+        mSkippedBuckets.clear();
+        resetDataSizeLocked();
+    }
+}
+
+template <typename AggregatedValue, typename DimExtras>
+MetricProducer::DumpReportWriter
+ValueMetricProducer<AggregatedValue, DimExtras>::takeDumpReportLocked(
+        const int64_t dumpTimeNs, const bool includeCurrentPartialBucket, const bool eraseData,
+        const DumpLatency dumpLatency, set<string>* strSet) {
+    // The aggregates may not be copyable (KLL sketches), so the kept buckets are encoded now.
+    if (!eraseData) {
+        return MetricProducer::takeDumpReportLocked(dumpTimeNs, includeCurrentPartialBucket,
+                                                    eraseData, dumpLatency, strSet);
+    }
+
+    auto info = std::make_shared<DumpReportInfo>(
+            getDumpReportInfoLocked(dumpTimeNs, includeCurrentPartialBucket, dumpLatency));
+
+    // The erased buckets are handed over to the writer.
+    auto pastBuckets = std::make_shared<PastBucketMap>();
+    auto skippedBuckets = std::make_shared<std::vector<SkippedBucket>>();
+    pastBuckets->swap(mPastBuckets);
+    skippedBuckets->swap(mSkippedBuckets);
+    resetDataSizeLocked();
+
+    // The writer only calls the const aggregate encoder of the metric, which it keeps alive.
+    sp<const ValueMetricProducer<AggregatedValue, DimExtras>> self = this;
+    return [self, info, pastBuckets, skippedBuckets, strSet](uint64_t fieldId,
+                                                             ProtoOutputStream* protoOutput) {
+        uint64_t token = protoOutput->start(fieldId);
+        self->writeDumpReport(*info, *pastBuckets, *skippedBuckets, strSet, protoOutput);
+        protoOutput->end(token);
+    };
+}
+
+template <typename AggregatedValue, typename DimExtras>
+typename ValueMetricProducer<AggregatedValue, DimExtras>::DumpReportInfo
+ValueMetricProducer<AggregatedValue, DimExtras>::getDumpReportInfoLocked(
+        const int64_t dumpTimeNs, const bool includeCurrentPartialBucket,
+        const DumpLatency dumpLatency) {
     VLOG("metric %lld dump report now...", (long long)mMetricId);
 
     // Pulled metrics need to pull before flushing, which is why they do not call flushIfNeeded.
@@ -348,37 +395,66 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onDumpReportLocked(
         flushCurrentBucketLocked(dumpTimeNs, dumpTimeNs);
     }
 
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
-    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
+    DumpReportInfo info{getDumpProtoFields()};
+    info.metricId = mMetricId;
+    info.isActive = isActiveLocked();
     if (mPastBuckets.empty() && mSkippedBuckets.empty()) {
+        return info;
+    }
+    info.byteSize = byteSizeLocked();
+    info.dimensionGuardrailHit = StatsdStats::getInstance().hasHitDimensionGuardrail(mMetricId);
+    info.timeBaseNs = mTimeBaseNs;
+    info.bucketSizeNs = mBucketSizeNs;
+    info.shouldUseNestedDimensions = mShouldUseNestedDimensions;
+    if (!mShouldUseNestedDimensions) {
+        info.dimensionsInWhat = mDimensionsInWhat;
+    }
+    // We only write the condition timer value if the metric has a
+    // condition and/or is sliced by state.
+    // If the metric is sliced by state, the condition timer value is
+    // also sliced by state to reflect time spent in that state.
+    info.writeConditionTrueNs = mConditionTrackerIndex >= 0 || !mSlicedStateAtoms.empty();
+    info.isPulled = isPulled();
+    info.conditionCorrectionThresholdNs = mConditionCorrectionThresholdNs;
+    return info;
+}
+
+template <typename AggregatedValue, typename DimExtras>
+void ValueMetricProducer<AggregatedValue, DimExtras>::writeDumpReport(
+        const DumpReportInfo& info, const PastBucketMap& pastBuckets,
+        const std::vector<SkippedBucket>& skippedBuckets, set<string>* strSet,
+        ProtoOutputStream* protoOutput) const {
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)info.metricId);
+    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, info.isActive);
+    if (pastBuckets.empty() && skippedBuckets.empty()) {
         return;
     }
 
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ESTIMATED_MEMORY_BYTES,
-                       (long long)byteSizeLocked());
+                       (long long)info.byteSize);
 
-    if (StatsdStats::getInstance().hasHitDimensionGuardrail(mMetricId)) {
+    if (info.dimensionGuardrailHit) {
         protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_DIMENSION_GUARDRAIL_HIT, true);
     }
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)mTimeBaseNs);
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)mBucketSizeNs);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)info.timeBaseNs);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)info.bucketSizeNs);
     // Fills the dimension path if not slicing by a primitive repeated field or position ALL.
-    if (!mShouldUseNestedDimensions) {
-        if (!mDimensionsInWhat.empty()) {
+    if (!info.shouldUseNestedDimensions) {
+        if (!info.dimensionsInWhat.empty()) {
             uint64_t dimenPathToken =
                     protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
-            writeDimensionPathToProto(mDimensionsInWhat, protoOutput);
+            writeDimensionPathToProto(info.dimensionsInWhat, protoOutput);
             protoOutput->end(dimenPathToken);
         }
     }
 
     const auto& [metricTypeFieldId, bucketNumFieldId, startBucketMsFieldId, endBucketMsFieldId,
                  conditionTrueNsFieldId,
-                 conditionCorrectionNsFieldId] = getDumpProtoFields();
+                 conditionCorrectionNsFieldId] = info.protoFields;
 
     uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | metricTypeFieldId);
 
-    for (const auto& skippedBucket : mSkippedBuckets) {
+    for (const auto& skippedBucket : skippedBuckets) {
         uint64_t wrapperToken =
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SKIPPED);
         protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_START_MILLIS,
@@ -396,13 +472,13 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onDumpReportLocked(
         protoOutput->end(wrapperToken);
     }
 
-    for (const auto& [metricDimensionKey, buckets] : mPastBuckets) {
+    for (const auto& [metricDimensionKey, buckets] : pastBuckets) {
         VLOG("  dimension key %s", metricDimensionKey.toString().c_str());
         uint64_t wrapperToken =
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
 
         // First fill dimension.
-        if (mShouldUseNestedDimensions) {
+        if (info.shouldUseNestedDimensions) {
             uint64_t dimensionToken =
                     protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
             writeDimensionToProto(metricDimensionKey.getDimensionKeyInWhat(), strSet, protoOutput);
@@ -425,20 +501,18 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onDumpReportLocked(
             uint64_t bucketInfoToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
 
-            if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
+            if (bucket.mBucketEndNs - bucket.mBucketStartNs != info.bucketSizeNs) {
                 protoOutput->write(FIELD_TYPE_INT64 | startBucketMsFieldId,
                                    (long long)NanoToMillis(bucket.mBucketStartNs));
                 protoOutput->write(FIELD_TYPE_INT64 | endBucketMsFieldId,
                                    (long long)NanoToMillis(bucket.mBucketEndNs));
             } else {
-                protoOutput->write(FIELD_TYPE_INT64 | bucketNumFieldId,
-                                   (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+                protoOutput->write(
+                        FIELD_TYPE_INT64 | bucketNumFieldId,
+                        (long long)((bucket.mBucketEndNs - info.timeBaseNs) / info.bucketSizeNs -
+                                    1));
             }
-            // We only write the condition timer value if the metric has a
-            // condition and/or is sliced by state.
-            // If the metric is sliced by state, the condition timer value is
-            // also sliced by state to reflect time spent in that state.
-            if (mConditionTrackerIndex >= 0 || !mSlicedStateAtoms.empty()) {
+            if (info.writeConditionTrueNs) {
                 protoOutput->write(FIELD_TYPE_INT64 | conditionTrueNsFieldId,
                                    (long long)bucket.mConditionTrueNs);
             }
@@ -450,8 +524,8 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onDumpReportLocked(
                 //   see condition_correction_threshold_nanos
                 // - if the abs(value) >= condition_correction_threshold_nanos
 
-                if (isPulled() && mConditionCorrectionThresholdNs &&
-                    (abs(bucket.mConditionCorrectionNs) >= mConditionCorrectionThresholdNs)) {
+                if (info.isPulled && info.conditionCorrectionThresholdNs &&
+                    (abs(bucket.mConditionCorrectionNs) >= info.conditionCorrectionThresholdNs)) {
                     protoOutput->write(FIELD_TYPE_INT64 | conditionCorrectionNsFieldId.value(),
                                        (long long)bucket.mConditionCorrectionNs);
                 }
@@ -470,12 +544,6 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onDumpReportLocked(
     }
     protoOutput->end(protoToken);
 
-    VLOG("metric %lld done with dump report...", (long long)mMetricId);
-    if (eraseData) {
-        mPastBuckets.clear();
-        mSkippedBuckets.clear();
-        mTotalDataSize = 0;
-    }
 }
 
 template <typename AggregatedValue, typename DimExtras>
@@ -658,7 +726,7 @@ bool ValueMetricProducer<AggregatedValue, DimExtras>::hitGuardRailLocked(
     }
     if (mCurrentSlicedBucket.size() > mDimensionSoftLimit - 1) {
         size_t newTupleCount = mCurrentSlicedBucket.size() + 1;
-        StatsdStats::getInstance().noteMetricDimensionSize(mConfigKey, mMetricId, newTupleCount);
+        noteDimensionSizeLocked(newTupleCount);
         // 2. Don't add more tuples, we are above the allowed threshold. Drop the data.
         if (hasReachedGuardRailLimit()) {
             if (!mHasHitGuardrail) {
@@ -712,10 +780,17 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onMatchedLogEventInternalL
         return;
     }
 
-    const auto& returnVal = mDimInfos.emplace(whatKey, DimensionsInWhatInfo(getUnknownStateKey()));
-    DimensionsInWhatInfo& dimensionsInWhatInfo = returnVal.first->second;
+    auto dimInfoIt = mDimInfos.find(whatKey);
+    if (dimInfoIt == mDimInfos.end()) {
+        dimInfoIt = mDimInfos.emplace(internDimensionKeyLocked(whatKey),
+                                      DimensionsInWhatInfo(getUnknownStateKey()))
+                            .first;
+    }
+    const HashableDimensionKey& internedWhatKey = dimInfoIt->first;
+    DimensionsInWhatInfo& dimensionsInWhatInfo = dimInfoIt->second;
     const HashableDimensionKey& oldStateKey = dimensionsInWhatInfo.currentState;
-    CurrentBucket& currentBucket = mCurrentSlicedBucket[MetricDimensionKey(whatKey, oldStateKey)];
+    CurrentBucket& currentBucket =
+            mCurrentSlicedBucket[MetricDimensionKey(internedWhatKey, oldStateKey)];
 
     // Ensure we turn on the condition timer in the case where dimensions
     // were missing on a previous pull due to a state change.
@@ -731,7 +806,9 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onMatchedLogEventInternalL
     }
 
     dimensionsInWhatInfo.hasCurrentState = true;
-    dimensionsInWhatInfo.currentState = stateKey;
+    if (stateChange) {
+        dimensionsInWhatInfo.currentState = internDimensionKeyLocked(stateKey);
+    }
 
     dimensionsInWhatInfo.seenNewData |= aggregateFields(eventTimeNs, eventKey, event, intervals,
                                                         dimensionsInWhatInfo.dimExtras);
@@ -742,7 +819,7 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onMatchedLogEventInternalL
         currentBucket.conditionTimer.onConditionChanged(false, eventTimeNs);
 
         // Turn ON the condition timer for the new state key.
-        mCurrentSlicedBucket[MetricDimensionKey(whatKey, stateKey)]
+        mCurrentSlicedBucket[MetricDimensionKey(internedWhatKey, dimensionsInWhatInfo.currentState)]
                 .conditionTimer.onConditionChanged(true, eventTimeNs);
     }
 }
@@ -851,8 +928,11 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::closeCurrentBucket(
 
             auto& bucketList = mPastBuckets[metricDimensionKey];
             const bool isFirstBucket = bucketList.empty();
-            mTotalDataSize += computeValueBucketSizeLocked(
-                    eventTimeNs >= fullBucketEndTimeNs, metricDimensionKey, isFirstBucket, bucket);
+            mTotalDataSize.fetch_add(
+                    computeValueBucketSizeLocked(eventTimeNs >= fullBucketEndTimeNs,
+                                                 metricDimensionKey, isFirstBucket, bucket),
+                    std::memory_order_relaxed);
+            mTotalDataSizeV1.fetch_add(getPastBucketSizeV1(bucket), std::memory_order_relaxed);
             bucketList.push_back(std::move(bucket));
         }
         if (!bucketHasData) {
@@ -864,7 +944,8 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::closeCurrentBucket(
         mCurrentSkippedBucket.bucketStartTimeNs = mCurrentBucketStartTimeNs;
         mCurrentSkippedBucket.bucketEndTimeNs = bucketEndTimeNs;
         mSkippedBuckets.push_back(mCurrentSkippedBucket);
-        mTotalDataSize += computeSkippedBucketSizeLocked(mCurrentSkippedBucket);
+        mTotalDataSize.fetch_add(computeSkippedBucketSizeLocked(mCurrentSkippedBucket),
+                                 std::memory_order_relaxed);
     }
 
     // This means that the current bucket was not flushed before a forced bucket split.
@@ -877,6 +958,8 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::closeCurrentBucket(
         bucketInGap.bucketEndTimeNs = nextBucketStartTimeNs;
         bucketInGap.dropEvents.emplace_back(buildDropEvent(eventTimeNs, BucketDropReason::NO_DATA));
         mSkippedBuckets.emplace_back(bucketInGap);
+        mTotalDataSize.fetch_add(computeSkippedBucketSizeLocked(bucketInGap),
+                                 std::memory_order_relaxed);
     }
 }
 
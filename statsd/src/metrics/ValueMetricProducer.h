@@ -170,6 +170,43 @@ protected:
 
     virtual DumpProtoFields getDumpProtoFields() const = 0;
 
+    DumpReportWriter takeDumpReportLocked(const int64_t dumpTimeNs,
+                                          const bool includeCurrentPartialBucket,
+                                          const bool eraseData, const DumpLatency dumpLatency,
+                                          std::set<string>* strSet) override;
+
+    using PastBucketMap =
+            std::unordered_map<MetricDimensionKey, std::vector<PastBucket<AggregatedValue>>>;
+
+    // What the report of the metric holds besides its past and skipped buckets, as of the dump.
+    struct DumpReportInfo {
+        DumpProtoFields protoFields;
+        int64_t metricId = 0;
+        bool isActive = false;
+        bool dimensionGuardrailHit = false;
+        size_t byteSize = 0;
+        int64_t timeBaseNs = 0;
+        int64_t bucketSizeNs = 0;
+        bool shouldUseNestedDimensions = false;
+        std::vector<Matcher> dimensionsInWhat;
+        bool writeConditionTrueNs = false;
+        bool isPulled = false;
+        optional<int64_t> conditionCorrectionThresholdNs;
+    };
+
+    // Flushes the buckets ending by the dump time, or all of them, and returns the report info.
+    DumpReportInfo getDumpReportInfoLocked(const int64_t dumpTimeNs,
+                                           const bool includeCurrentPartialBucket,
+                                           const DumpLatency dumpLatency);
+
+    // Writes the fields of a StatsLogReport. Besides its arguments, it only reads the const
+    // configuration of the metric through writePastBucketAggregateToProto, so that it can run
+    // without the lock.
+    void writeDumpReport(const DumpReportInfo& info, const PastBucketMap& pastBuckets,
+                         const std::vector<SkippedBucket>& skippedBuckets,
+                         std::set<string>* strSet,
+                         android::util::ProtoOutputStream* protoOutput) const;
+
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
     // ValueMetricProducer internal interface to handle active state change.
@@ -238,6 +275,9 @@ protected:
 
     virtual size_t getAggregatedValueSize(const AggregatedValue& value) const = 0;
 
+    // Estimates the size of a past bucket without useV2SoftMemoryCalculation.
+    virtual size_t getPastBucketSizeV1(const PastBucket<AggregatedValue>& bucket) const = 0;
+
     virtual optional<int64_t> getConditionIdForMetric(const StatsdConfig& config,
                                                       const int configIndex) const = 0;
 
@@ -322,7 +362,7 @@ protected:
     std::unordered_map<HashableDimensionKey, DimensionsInWhatInfo> mDimInfos;
 
     // Save the past buckets and we can clear when the StatsLogReport is dumped.
-    std::unordered_map<MetricDimensionKey, std::vector<PastBucket<AggregatedValue>>> mPastBuckets;
+    PastBucketMap mPastBuckets;
 
     const int64_t mMinBucketSizeNs;
 
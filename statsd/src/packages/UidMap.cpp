@@ -82,7 +82,10 @@ inline bool omitUid(int32_t uid, bool omitSystemUids) {
 
 }  // namespace
 
-UidMap::UidMap() : mBytesUsed(0) {
+UidMap::UidMap()
+    : mAppIndex(std::make_shared<AppIndex>()),
+      mIsolatedUidMap(std::make_shared<IsolatedUidMap>()),
+      mBytesUsed(0) {
 }
 
 UidMap::~UidMap() {}
@@ -93,10 +96,9 @@ sp<UidMap> UidMap::getInstance() {
 }
 
 bool UidMap::hasApp(int uid, const string& packageName) const {
-    lock_guard<mutex> lock(mMutex);
-
-    auto it = mMap.find(std::make_pair(uid, packageName));
-    return it != mMap.end() && !it->second.deleted;
+    const std::shared_ptr<const AppIndex> index = getAppIndex();
+    const auto it = index->uidPackages.find(uid);
+    return it != index->uidPackages.end() && it->second.count(packageName) > 0;
 }
 
 string UidMap::normalizeAppName(const string& appName) const {
@@ -106,18 +108,51 @@ string UidMap::normalizeAppName(const string& appName) const {
 }
 
 std::set<string> UidMap::getAppNamesFromUid(const int32_t uid, bool returnNormalized) const {
-    lock_guard<mutex> lock(mMutex);
-    return getAppNamesFromUidLocked(uid,returnNormalized);
+    const std::shared_ptr<const AppIndex> index = getAppIndex();
+    const auto it = index->uidPackages.find(uid);
+    if (it == index->uidPackages.end()) {
+        return {};
+    }
+    if (!returnNormalized) {
+        return it->second;
+    }
+    std::set<string> names;
+    for (const string& name : it->second) {
+        names.insert(normalizeAppName(name));
+    }
+    return names;
 }
 
-std::set<string> UidMap::getAppNamesFromUidLocked(const int32_t uid, bool returnNormalized) const {
-    std::set<string> names;
-    for (const auto& kv : mMap) {
-        if (kv.first.first == uid && !kv.second.deleted) {
-            names.insert(returnNormalized ? normalizeAppName(kv.first.second) : kv.first.second);
+void UidMap::AppIndex::add(const int32_t uid, const string& packageName) {
+    packageUids[packageName].insert(uid);
+    uidPackages[uid].insert(packageName);
+}
+
+void UidMap::AppIndex::remove(const int32_t uid, const string& packageName) {
+    auto packageIt = packageUids.find(packageName);
+    if (packageIt != packageUids.end()) {
+        packageIt->second.erase(uid);
+        if (packageIt->second.empty()) {
+            packageUids.erase(packageIt);
         }
     }
-    return names;
+    auto uidIt = uidPackages.find(uid);
+    if (uidIt != uidPackages.end()) {
+        uidIt->second.erase(packageName);
+        if (uidIt->second.empty()) {
+            uidPackages.erase(uidIt);
+        }
+    }
+}
+
+void UidMap::rebuildAppIndexLocked() {
+    std::shared_ptr<AppIndex> index = std::make_shared<AppIndex>();
+    for (const auto& [keyPair, appData] : mMap) {
+        if (!appData.deleted) {
+            index->add(keyPair.first, keyPair.second);
+        }
+    }
+    std::atomic_store(&mAppIndex, std::shared_ptr<const AppIndex>(std::move(index)));
 }
 
 int64_t UidMap::getAppVersion(int uid, const string& packageName) const {
@@ -158,6 +193,7 @@ void UidMap::updateMap(const int64_t timestamp, const UidData& uidData) {
                 mMap[kv.first] = kv.second;
             }
         }
+        rebuildAppIndexLocked();
 
         ensureBytesUsedBelowLimit();
         StatsdStats::getInstance().setCurrentUidMapMemory(mBytesUsed);
@@ -185,6 +221,7 @@ void UidMap::updateApp(const int64_t timestamp, const string& appName, const int
         string prevVersionString = "";
         auto key = std::make_pair(uid, appName);
         auto it = mMap.find(key);
+        const bool installed = it != mMap.end() && !it->second.deleted;
         if (it != mMap.end()) {
             prevVersion = it->second.versionCode;
             prevVersionString = it->second.versionString;
@@ -203,6 +240,11 @@ void UidMap::updateApp(const int64_t timestamp, const string& appName, const int
             // Otherwise, we need to add an app at this uid.
             mMap[key] = AppData(versionCode, versionString, installer, certificateHashString);
         }
+        if (!installed) {
+            std::shared_ptr<AppIndex> index = std::make_shared<AppIndex>(*mAppIndex);
+            index->add(uid, appName);
+            std::atomic_store(&mAppIndex, std::shared_ptr<const AppIndex>(std::move(index)));
+        }
 
         mChanges.emplace_back(false, timestamp, appName, uid, versionCode, versionString,
                               prevVersion, prevVersionString);
@@ -244,19 +286,30 @@ void UidMap::removeApp(const int64_t timestamp, const string& app, const int32_t
         string prevVersionString = "";
         auto key = std::make_pair(uid, app);
         auto it = mMap.find(key);
+        std::shared_ptr<AppIndex> index;
         if (it != mMap.end() && !it->second.deleted) {
             prevVersion = it->second.versionCode;
             prevVersionString = it->second.versionString;
             it->second.deleted = true;
             mDeletedApps.push_back(key);
+            index = std::make_shared<AppIndex>(*mAppIndex);
+            index->remove(uid, app);
         }
         if (mDeletedApps.size() > StatsdStats::kMaxDeletedAppsInUidMap) {
             // Delete the oldest one.
             auto oldest = mDeletedApps.front();
             mDeletedApps.pop_front();
+            // The app may have been reinstalled since.
+            if (index == nullptr) {
+                index = std::make_shared<AppIndex>(*mAppIndex);
+            }
+            index->remove(oldest.first, oldest.second);
             mMap.erase(oldest);
             StatsdStats::getInstance().noteUidMapAppDeletionDropped();
         }
+        if (index != nullptr) {
+            std::atomic_store(&mAppIndex, std::shared_ptr<const AppIndex>(std::move(index)));
+        }
         mChanges.emplace_back(true, timestamp, app, uid, 0, "", prevVersion, prevVersionString);
         mBytesUsed += kBytesChangeRecord;
         ensureBytesUsedBelowLimit();
@@ -279,23 +332,27 @@ void UidMap::setListener(const wp<PackageInfoListener>& listener) {
 void UidMap::assignIsolatedUid(int isolatedUid, int parentUid) {
     lock_guard<mutex> lock(mIsolatedMutex);
 
-    mIsolatedUidMap[isolatedUid] = parentUid;
+    auto isolatedUidMap = std::make_shared<IsolatedUidMap>(*mIsolatedUidMap);
+    (*isolatedUidMap)[isolatedUid] = parentUid;
+    std::atomic_store(&mIsolatedUidMap,
+                      std::shared_ptr<const IsolatedUidMap>(std::move(isolatedUidMap)));
 }
 
 void UidMap::removeIsolatedUid(int isolatedUid) {
     lock_guard<mutex> lock(mIsolatedMutex);
 
-    auto it = mIsolatedUidMap.find(isolatedUid);
-    if (it != mIsolatedUidMap.end()) {
-        mIsolatedUidMap.erase(it);
+    if (mIsolatedUidMap->find(isolatedUid) != mIsolatedUidMap->end()) {
+        auto isolatedUidMap = std::make_shared<IsolatedUidMap>(*mIsolatedUidMap);
+        isolatedUidMap->erase(isolatedUid);
+        std::atomic_store(&mIsolatedUidMap,
+                          std::shared_ptr<const IsolatedUidMap>(std::move(isolatedUidMap)));
     }
 }
 
 int UidMap::getHostUidOrSelf(int uid) const {
-    lock_guard<mutex> lock(mIsolatedMutex);
-
-    auto it = mIsolatedUidMap.find(uid);
-    if (it != mIsolatedUidMap.end()) {
+    const std::shared_ptr<const IsolatedUidMap> isolatedUidMap = std::atomic_load(&mIsolatedUidMap);
+    auto it = isolatedUidMap->find(uid);
+    if (it != isolatedUidMap->end()) {
         return it->second;
     }
     return uid;
@@ -546,15 +603,22 @@ void UidMap::OnConfigRemoved(const ConfigKey& key) {
 }
 
 set<int32_t> UidMap::getAppUid(const string& package) const {
-    lock_guard<mutex> lock(mMutex);
+    const std::shared_ptr<const AppIndex> index = getAppIndex();
+    const auto it = index->packageUids.find(package);
+    return it == index->packageUids.end() ? set<int32_t>() : it->second;
+}
 
-    set<int32_t> results;
-    for (const auto& kv : mMap) {
-        if (kv.first.second == package && !kv.second.deleted) {
-            results.insert(kv.first.first);
+const string* UidMap::getAidName(const int32_t uid) {
+    static const std::unordered_map<int32_t, string> sUidToAidMapping = [] {
+        std::unordered_map<int32_t, string> mapping;
+        for (const auto& [aid, aidUid] : sAidToUidMapping) {
+            // Keeps the first AID of a uid, in name order.
+            mapping.emplace(aidUid, aid);
         }
-    }
-    return results;
+        return mapping;
+    }();
+    const auto it = sUidToAidMapping.find(uid);
+    return it == sUidToAidMapping.end() ? nullptr : &it->second;
 }
 
 // Note not all the following AIDs are used as uids. Some are used only for gids.
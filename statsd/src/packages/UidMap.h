@@ -23,6 +23,7 @@
 #include <utils/String16.h>
 
 #include <list>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <string>
@@ -91,12 +92,19 @@ const unsigned int kBytesChangeRecord = sizeof(struct ChangeRecord);
 
 // UidMap keeps track of what the corresponding app name (APK name) and version code for every uid
 // at any given moment. This map must be updated by StatsCompanionService.
+//
+// The lookups made for every event (hasApp, getAppNamesFromUid, getAppUid, getHostUidOrSelf) read
+// immutable snapshots instead of taking a lock. Writers publish a new snapshot on every change.
 class UidMap : public virtual RefBase {
 public:
     UidMap();
     ~UidMap();
     static const std::map<std::string, uint32_t> sAidToUidMapping;
 
+    // Returns the AID name of uid, e.g. "AID_SYSTEM" for 1000, or nullptr if uid is not an AID.
+    // The reverse of sAidToUidMapping.
+    static const std::string* getAidName(int32_t uid);
+
     static sp<UidMap> getInstance();
 
     void updateMap(const int64_t timestamp, const UidData& uidData);
@@ -165,9 +173,28 @@ public:
                              ProtoOutputStream* proto) const;
 
 private:
-    std::set<string> getAppNamesFromUidLocked(int32_t uid, bool returnNormalized) const;
     string normalizeAppName(const string& appName) const;
 
+    // Index of the apps of mMap that are not deleted.
+    struct AppIndex {
+        // Maps package name to the uids it is installed for.
+        std::unordered_map<string, std::set<int32_t>> packageUids;
+
+        // Maps uid to the package names installed for it.
+        std::unordered_map<int32_t, std::set<string>> uidPackages;
+
+        void add(int32_t uid, const string& packageName);
+        void remove(int32_t uid, const string& packageName);
+    };
+
+    // Returns the current AppIndex snapshot. Does not need mMutex.
+    std::shared_ptr<const AppIndex> getAppIndex() const {
+        return std::atomic_load(&mAppIndex);
+    }
+
+    // Publishes a new AppIndex snapshot built from mMap.
+    void rebuildAppIndexLocked();
+
     void writeUidMapSnapshotLocked(const int64_t timestamp, const bool includeVersionStrings,
                                    const bool includeInstaller,
                                    const uint8_t truncatedCertificateHashSize,
@@ -181,16 +208,23 @@ private:
 
     struct PairHash {
         size_t operator()(const std::pair<int, string>& p) const noexcept {
-            std::hash<std::string> hash_fn;
-            return hash_fn(std::to_string(p.first) + p.second);
+            // Combines the hashes without building a temporary string.
+            const size_t h = std::hash<std::string>()(p.second);
+            return h ^ (std::hash<int>()(p.first) + 0x9e3779b9 + (h << 6) + (h >> 2));
         }
     };
     // Maps uid and package name to application data.
     std::unordered_map<std::pair<int, string>, AppData, PairHash> mMap;
 
+    // Snapshot of the index of mMap. Never modified once published: writers replace it with
+    // std::atomic_store() while holding mMutex, and readers get it with std::atomic_load().
+    std::shared_ptr<const AppIndex> mAppIndex;
+
+    typedef std::unordered_map<int, int> IsolatedUidMap;
+
     // Maps isolated uid to the parent uid. Any metrics for an isolated uid will instead contribute
-    // to the parent uid.
-    std::unordered_map<int, int> mIsolatedUidMap;
+    // to the parent uid. A snapshot like mAppIndex, replaced while holding mIsolatedMutex.
+    std::shared_ptr<const IsolatedUidMap> mIsolatedUidMap;
 
     // Record the changes that can be provided with the uploads.
     std::list<ChangeRecord> mChanges;
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "ShellDataWriter.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "stats_log_util.h"
+
+using android::base::unique_fd;
+using android::util::ProtoOutputStream;
+using android::util::ProtoReader;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+ShellDataWriter::ShellDataWriter(unique_fd out, int64_t lastWriteMs)
+    : mOut(std::move(out)),
+      mWakeFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+      mBuffer(kCapacityBytes),
+      mHead(0),
+      mSize(0),
+      mFirstAppendMs(0),
+      mHeartbeatRequested(false),
+      mStopping(false),
+      mAlive(mOut.ok() && mWakeFd.ok()),
+      mLastWriteMs(lastWriteMs) {
+    // Without the wake fd, the writer thread would never wake up. The writer is dead instead.
+    if (!mWakeFd.ok()) {
+        ALOGE("ShellDataWriter: failed to create the wake fd: %s", strerror(errno));
+        return;
+    }
+    if (mAlive) {
+        mThread = std::thread([this] { run(); });
+    }
+}
+
+ShellDataWriter::~ShellDataWriter() {
+    mStopping = true;
+    wakeUp();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+bool ShellDataWriter::append(ProtoOutputStream& proto) {
+    const size_t size = proto.size();
+    if (size == 0) {
+        return true;
+    }
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mSize + size > kCapacityBytes) {
+            return false;
+        }
+        size_t tail = (mHead + mSize) % kCapacityBytes;
+        sp<ProtoReader> reader = proto.data();
+        while (reader->readBuffer() != nullptr) {
+            const size_t toRead = std::min(reader->currentToRead(), kCapacityBytes - tail);
+            memcpy(&mBuffer[tail], reader->readBuffer(), toRead);
+            tail = (tail + toRead) % kCapacityBytes;
+            reader->move(toRead);
+        }
+
+        // Wake the writer thread to start the batch timer, or to write a full batch.
+        wake = mSize == 0 || (mSize < kBatchBytes && mSize + size >= kBatchBytes);
+        if (mSize == 0) {
+            mFirstAppendMs = getElapsedRealtimeMillis();
+        }
+        mSize += size;
+    }
+    if (wake) {
+        wakeUp();
+    }
+    return true;
+}
+
+void ShellDataWriter::requestHeartbeat() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mHeartbeatRequested = true;
+    }
+    wakeUp();
+}
+
+void ShellDataWriter::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mStopping) {
+        const int64_t nowMs = getElapsedRealtimeMillis();
+        const int64_t batchDueMs = mFirstAppendMs + kMaxBatchDelayMs;
+        if (!mHeartbeatRequested && mSize < kBatchBytes && (mSize == 0 || nowMs < batchDueMs)) {
+            const int timeoutMs = mSize == 0 ? -1 : batchDueMs - nowMs;
+            lock.unlock();
+            waitForWakeUp(timeoutMs);
+            lock.lock();
+            continue;
+        }
+
+        mHeartbeatRequested = false;
+        const size_t offset = mHead;
+        const size_t size = mSize;
+        lock.unlock();
+        const bool written = writeFrame(offset, size, /*wait=*/true);
+        lock.lock();
+        if (!written) {
+            // A frame cut short by stopping cannot be followed by more data.
+            if (!mStopping) {
+                VLOG("ShellDataWriter: failed to write to the subscription fd");
+                mAlive = false;
+            }
+            return;
+        }
+        mHead = (mHead + size) % kCapacityBytes;
+        mSize -= size;
+        mFirstAppendMs = getElapsedRealtimeMillis();
+        mLastWriteMs = mFirstAppendMs;
+    }
+
+    // Deliver the last batch if the client is keeping up, without delaying the destructor.
+    if (mSize > 0) {
+        writeFrame(mHead, mSize, /*wait=*/false);
+    }
+}
+
+bool ShellDataWriter::writeFrame(size_t offset, size_t size, bool wait) {
+    if (!writeFully(&size, sizeof(size), wait)) {
+        return false;
+    }
+    const size_t firstSize = std::min(size, kCapacityBytes - offset);
+    return writeFully(&mBuffer[offset], firstSize, wait) &&
+           writeFully(&mBuffer[0], size - firstSize, wait);
+}
+
+bool ShellDataWriter::writeFully(const void* data, size_t size, bool wait) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        pollfd fds[] = {{mOut.get(), POLLOUT, 0}, {mWakeFd.get(), POLLIN, 0}};
+        const int ready = TEMP_FAILURE_RETRY(poll(fds, wait ? 2 : 1, wait ? -1 : 0));
+        if (ready < 0 || (!wait && ready == 0)) {
+            return false;
+        }
+        if (fds[1].revents & POLLIN) {
+            clearWakeUp();
+            if (mStopping) {
+                return false;
+            }
+        }
+        if (fds[0].revents == 0) {
+            continue;
+        }
+
+        // A pipe with POLLOUT has room for PIPE_BUF bytes, so that this does not block.
+        const size_t toWrite = std::min(size, (size_t)PIPE_BUF);
+        const ssize_t n = TEMP_FAILURE_RETRY(write(mOut.get(), p, toWrite));
+        if (n < 0) {
+            if (errno == EAGAIN) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+void ShellDataWriter::waitForWakeUp(int timeoutMs) {
+    pollfd fd = {mWakeFd.get(), POLLIN, 0};
+    if (TEMP_FAILURE_RETRY(poll(&fd, 1, timeoutMs)) > 0) {
+        clearWakeUp();
+    }
+}
+
+void ShellDataWriter::clearWakeUp() {
+    uint64_t count;
+    // EAGAIN means that the counter is already cleared.
+    if (TEMP_FAILURE_RETRY(read(mWakeFd.get(), &count, sizeof(count))) < 0 && errno != EAGAIN) {
+        ALOGE("ShellDataWriter: failed to read the wake fd: %s", strerror(errno));
+    }
+}
+
+void ShellDataWriter::wakeUp() {
+    if (!mWakeFd.ok()) {
+        return;
+    }
+    const uint64_t count = 1;
+    // EAGAIN means that the counter is saturated, so the writer thread wakes up anyway.
+    if (TEMP_FAILURE_RETRY(write(mWakeFd.get(), &count, sizeof(count))) < 0 && errno != EAGAIN) {
+        ALOGE("ShellDataWriter: failed to signal the wake fd: %s", strerror(errno));
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <android/util/ProtoOutputStream.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Writes the ShellData of a file descriptor subscription to its output fd on a dedicated thread,
+ * so that a client reading slowly never blocks the threads producing the data.
+ *
+ * Serialized ShellData messages are appended to a bounded ring buffer. The writer thread sends
+ * its content as one |size_t|ShellData| frame once kBatchBytes are buffered or the oldest
+ * buffered data is kMaxBatchDelayMs old. Consecutive ShellData messages concatenate into a valid
+ * ShellData, so the frames have the same format as when every message was written on its own.
+ * Data that does not fit in the ring buffer is dropped.
+ *
+ * Thread-safe.
+ */
+class ShellDataWriter {
+public:
+    // Takes ownership of out. lastWriteMs is the elapsed realtime to report before any write.
+    ShellDataWriter(android::base::unique_fd out, int64_t lastWriteMs);
+
+    // Stops the writer thread. Buffered data is written only if that does not block.
+    ~ShellDataWriter();
+
+    /**
+     * Copies the serialized ShellData in proto to the ring buffer. Returns false, leaving the
+     * buffer unchanged, if there is not enough room left. Never blocks on the output fd.
+     */
+    bool append(android::util::ProtoOutputStream& proto);
+
+    /**
+     * Sends the buffered data without waiting for a full batch, or an empty frame if there is
+     * none, telling the client that the subscription is still active.
+     */
+    void requestHeartbeat();
+
+    // Returns false once a write to the output fd has failed, e.g. because the client is gone.
+    bool isAlive() const {
+        return mAlive;
+    }
+
+    // Returns the elapsed realtime of the last frame written.
+    int64_t getLastWriteMs() const {
+        return mLastWriteMs;
+    }
+
+    static constexpr size_t kCapacityBytes = 128 * 1024;
+
+    static constexpr size_t kBatchBytes = 4 * 1024;
+
+    static constexpr int64_t kMaxBatchDelayMs = 100;
+
+private:
+    void run();
+
+    /**
+     * Writes a frame with the size bytes of the ring buffer starting at offset. If wait is false,
+     * gives up as soon as the output fd is not writable. Returns false if the frame was not
+     * entirely written.
+     */
+    bool writeFrame(size_t offset, size_t size, bool wait);
+
+    bool writeFully(const void* data, size_t size, bool wait);
+
+    // Blocks until the wake fd is signaled or timeoutMs elapse. A negative timeout never elapses.
+    void waitForWakeUp(int timeoutMs);
+
+    // Resets the wake fd once its signal is handled.
+    void clearWakeUp();
+
+    void wakeUp();
+
+    const android::base::unique_fd mOut;
+
+    // Signaled when the writer thread has to reevaluate its state.
+    const android::base::unique_fd mWakeFd;
+
+    // Protects the fields below up to mHeartbeatRequested.
+    std::mutex mMutex;
+
+    // Ring buffer of kCapacityBytes holding mSize bytes from mHead. The writer thread reads them
+    // without holding mMutex, since append() only writes after them.
+    std::vector<uint8_t> mBuffer;
+
+    size_t mHead;
+
+    size_t mSize;
+
+    // Elapsed realtime at which the ring buffer last became non empty.
+    int64_t mFirstAppendMs;
+
+    bool mHeartbeatRequested;
+
+    std::atomic<bool> mStopping;
+
+    std::atomic<bool> mAlive;
+
+    std::atomic<int64_t> mLastWriteMs;
+
+    std::thread mThread;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -53,6 +53,9 @@ namespace statsd {
  * The stream would be in the following format:
  * |size_t|shellData proto|size_t|shellData proto|....
  *
+ * The data is written by a ShellDataWriter per client, off the thread processing the events.
+ * Atoms may be batched in one shellData proto for up to ShellDataWriter::kMaxBatchDelayMs, and
+ * are dropped if the client does not read them fast enough.
  */
 class ShellSubscriber : public virtual RefBase {
 public:
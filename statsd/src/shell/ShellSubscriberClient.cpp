@@ -97,14 +97,22 @@ ShellSubscriberClient::ShellSubscriberClient(
     : mId(id),
       mUidMap(uidMap),
       mPullerMgr(pullerMgr),
-      mDupOut(fcntl(out, F_DUPFD_CLOEXEC, 0)),
       mPushedMatchers(pushedMatchers),
       mPulledInfo(pulledInfo),
       mCallback(callback),
+      mWriter(callback == nullptr
+                      ? std::make_unique<ShellDataWriter>(unique_fd(fcntl(out, F_DUPFD_CLOEXEC, 0)),
+                                                          startTimeSec * 1000)
+                      : nullptr),
       mTimeoutSec(timeoutSec),
       mStartTimeSec(startTimeSec),
       mLastWriteMs(startTimeSec * 1000),
-      mCacheSize(0){};
+      mCacheSize(0) {
+    mPushedMatcherPrograms.reserve(mPushedMatchers.size());
+    for (const SimpleAtomMatcher& matcher : mPushedMatchers) {
+        mPushedMatcherPrograms.emplace_back(matcher);
+    }
+}
 
 unique_ptr<ShellSubscriberClient> ShellSubscriberClient::create(
         int in, int out, int64_t timeoutSec, int64_t startTimeSec, const sp<UidMap>& uidMap,
@@ -174,9 +182,9 @@ unique_ptr<ShellSubscriberClient> ShellSubscriberClient::create(
 }
 
 bool ShellSubscriberClient::writeEventToProtoIfMatched(const LogEvent& event,
-                                                       const SimpleAtomMatcher& matcher,
+                                                       const SimpleAtomMatcherProgram& matcher,
                                                        const sp<UidMap>& uidMap) {
-    auto [matched, transformedEvent] = matchesSimple(mUidMap, matcher, event);
+    auto [matched, transformedEvent] = matcher.match(mUidMap, event);
     if (!matched) {
         return false;
     }
@@ -201,7 +209,7 @@ bool ShellSubscriberClient::writeEventToProtoIfMatched(const LogEvent& event,
 
 // Called by ShellSubscriber when a pushed event occurs
 void ShellSubscriberClient::onLogEvent(const LogEvent& event) {
-    for (const auto& matcher : mPushedMatchers) {
+    for (const SimpleAtomMatcherProgram& matcher : mPushedMatcherPrograms) {
         if (writeEventToProtoIfMatched(event, matcher, mUidMap)) {
             flushProtoIfNeeded();
             break;
@@ -260,16 +268,17 @@ int64_t ShellSubscriberClient::pullAndSendHeartbeatsIfNeeded(int64_t nowSecs, in
         }
 
         sleepTimeMs = min(kMsBetweenHeartbeats, pullIfNeeded(nowSecs, nowMillis, nowNanos));
+        if (!isAlive()) return kMsBetweenHeartbeats;
 
         // Send a heartbeat consisting of data size of 0, if
         // the user hasn't recently received data from statsd. When it receives the data size of 0,
         // the user will not expect any atoms and recheck whether the subscription should end.
-        if (nowMillis - mLastWriteMs >= kMsBetweenHeartbeats) {
-            triggerFdFlush();
-            if (!mClientAlive) return kMsBetweenHeartbeats;
+        int64_t timeBeforeHeartbeat =
+                mWriter->getLastWriteMs() + kMsBetweenHeartbeats - nowMillis;
+        if (timeBeforeHeartbeat <= 0) {
+            mWriter->requestHeartbeat();
+            timeBeforeHeartbeat = kMsBetweenHeartbeats;
         }
-
-        int64_t timeBeforeHeartbeat = mLastWriteMs + kMsBetweenHeartbeats - nowMillis;
         sleepTimeMs = min(sleepTimeMs, timeBeforeHeartbeat);
     } else {  // Callback subscription.
         sleepTimeMs = min(kMsBetweenCallbacks, pullIfNeeded(nowSecs, nowMillis, nowNanos));
@@ -295,10 +304,15 @@ int64_t ShellSubscriberClient::pullAndSendHeartbeatsIfNeeded(int64_t nowSecs, in
 
 void ShellSubscriberClient::writePulledAtomsLocked(const vector<shared_ptr<LogEvent>>& data,
                                                    const SimpleAtomMatcher& matcher) {
+    const SimpleAtomMatcherProgram program(matcher);
     bool hasData = false;
     for (const shared_ptr<LogEvent>& event : data) {
-        if (writeEventToProtoIfMatched(*event, matcher, mUidMap)) {
+        if (writeEventToProtoIfMatched(*event, program, mUidMap)) {
             hasData = true;
+            if (mWriter != nullptr) {
+                // Hand over atoms one by one so that a large pull only loses what does not fit.
+                triggerFdFlush();
+            }
         }
     }
 
@@ -307,27 +321,8 @@ void ShellSubscriberClient::writePulledAtomsLocked(const vector<shared_ptr<LogEv
     }
 }
 
-// Tries to write the atom encoded in mProtoOut to the pipe. If the write fails
-// because the read end of the pipe has closed, change the client status so
-// the manager knows the subscription is no longer active
-void ShellSubscriberClient::attemptWriteToPipeLocked() {
-    const size_t dataSize = mProtoOut.size();
-    // First, write the payload size.
-    if (!android::base::WriteFully(mDupOut, &dataSize, sizeof(dataSize))) {
-        mClientAlive = false;
-        return;
-    }
-    // Then, write the payload if this is not just a heartbeat.
-    if (dataSize > 0 && !mProtoOut.flush(mDupOut.get())) {
-        mClientAlive = false;
-        return;
-    }
-    mLastWriteMs = getElapsedRealtimeMillis();
-}
-
 void ShellSubscriberClient::getUidsForPullAtom(vector<int32_t>* uids, const PullInfo& pullInfo) {
     uids->insert(uids->end(), pullInfo.mPullUids.begin(), pullInfo.mPullUids.end());
-    // This is slow. Consider storing the uids per app and listening to uidmap updates.
     for (const string& pkg : pullInfo.mPullPackages) {
         set<int32_t> uidsForPkg = mUidMap->getAppUid(pkg);
         uids->insert(uids->end(), uidsForPkg.begin(), uidsForPkg.end());
@@ -340,8 +335,12 @@ void ShellSubscriberClient::clearCache() {
     mCacheSize = 0;
 }
 
+// Hands the atoms encoded in mProtoOut to mWriter, which writes them to the pipe on its own
+// thread. If the client does not keep up with the data, the atoms are dropped.
 void ShellSubscriberClient::triggerFdFlush() {
-    attemptWriteToPipeLocked();
+    if (!mWriter->append(mProtoOut)) {
+        StatsdStats::getInstance().noteSubscriptionAtomDropped();
+    }
     clearCache();
 }
 
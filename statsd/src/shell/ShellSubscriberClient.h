@@ -26,7 +26,9 @@
 
 #include "external/StatsPullerManager.h"
 #include "logd/LogEvent.h"
+#include "matchers/matcher_util.h"
 #include "packages/UidMap.h"
+#include "shell/ShellDataWriter.h"
 #include "socket/LogEventFilter.h"
 #include "src/shell/shell_config.pb.h"
 #include "src/statsd_config.pb.h"
@@ -82,7 +84,7 @@ public:
     void onUnsubscribe();
 
     bool isAlive() const {
-        return mClientAlive;
+        return mClientAlive && (mWriter == nullptr || mWriter->isAlive());
     }
 
     bool hasCallback(const std::shared_ptr<IStatsSubscriptionCallback>& callback) const {
@@ -107,13 +109,11 @@ private:
     void writePulledAtomsLocked(const vector<std::shared_ptr<LogEvent>>& data,
                                 const SimpleAtomMatcher& matcher);
 
-    void attemptWriteToPipeLocked();
-
     void getUidsForPullAtom(vector<int32_t>* uids, const PullInfo& pullInfo);
 
     void flushProtoIfNeeded();
 
-    bool writeEventToProtoIfMatched(const LogEvent& event, const SimpleAtomMatcher& matcher,
+    bool writeEventToProtoIfMatched(const LogEvent& event, const SimpleAtomMatcherProgram& matcher,
                                     const sp<UidMap>& uidMap);
 
     void clearCache();
@@ -131,20 +131,25 @@ private:
 
     const sp<StatsPullerManager> mPullerMgr;
 
-    android::base::unique_fd mDupOut;
-
     const std::vector<SimpleAtomMatcher> mPushedMatchers;
 
+    // mPushedMatchers compiled for matching events, in the same order.
+    std::vector<SimpleAtomMatcherProgram> mPushedMatcherPrograms;
+
     std::vector<PullInfo> mPulledInfo;
 
     std::shared_ptr<IStatsSubscriptionCallback> mCallback;
 
+    // Writes the data of file descriptor subscriptions, nullptr when mCallback is used.
+    std::unique_ptr<ShellDataWriter> mWriter;
+
     const int64_t mTimeoutSec;
 
     const int64_t mStartTimeSec;
 
     bool mClientAlive = true;
 
+    // Last callback invocation, for callback subscriptions.
     int64_t mLastWriteMs;
 
     // Stores Atom proto messages for events along with their respective timestamps.
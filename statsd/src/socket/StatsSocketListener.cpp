@@ -41,12 +41,23 @@ namespace android {
 namespace os {
 namespace statsd {
 
+StatsSocketListener::ReadBuffers::ReadBuffers() {
+    for (int i = 0; i < kMaxMessagesPerRead; i++) {
+        iovs[i] = {messages[i], sizeof(messages[i]) - 1};
+        headers[i].msg_hdr = {
+                NULL, 0, &iovs[i], 1, controls[i], sizeof(controls[i]), 0,
+        };
+    }
+    events.reserve(kMaxMessagesPerRead);
+}
+
 StatsSocketListener::StatsSocketListener(const std::shared_ptr<LogEventQueue>& queue,
                                          const std::shared_ptr<LogEventFilter>& logEventFilter)
     : SocketListener(getLogSocket(), false /*start listen*/),
       mQueue(queue),
       mLogEventFilter(logEventFilter),
-      mLastSocketReadTimeNs(0) {
+      mLastSocketReadTimeNs(0),
+      mReadBuffers(std::make_unique<ReadBuffers>()) {
 }
 
 bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
@@ -58,66 +69,127 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
     }
 
     int64_t elapsedTimeNs = getElapsedRealtimeNs();
-    // + 1 to ensure null terminator if MAX_PAYLOAD buffer is received
-    char buffer[sizeof(android_log_header_t) + LOGGER_ENTRY_MAX_PAYLOAD + 1];
-    struct iovec iov = {buffer, sizeof(buffer) - 1};
-
-    alignas(4) char control[CMSG_SPACE(sizeof(struct ucred))];
-    struct msghdr hdr = {
-            NULL, 0, &iov, 1, control, sizeof(control), 0,
-    };
-
-    const int socket = cli->getSocket();
-    int i = 0;
-    int64_t minAtomReadTime = INT64_MAX;
-    int64_t maxAtomReadTime = -1;
-    mAtomCounts.clear();
-    ssize_t n = 0;
-    while (n = recvmsg(socket, &hdr, MSG_DONTWAIT), n > 0) {
-        // To clear the entire buffer is secure/safe, but this contributes to 1.68%
-        // overhead under logging load. We are safe because we check counts, but
-        // still need to clear null terminator.
-        // Note that the memset, if needed, should happen before each read in the while loop.
-        // memset(buffer, 0, sizeof(buffer));
-        if (n <= (ssize_t)(sizeof(android_log_header_t))) {
-            return false;
+
+    mReadStats.messageCount = 0;
+    mReadStats.minAtomReadTimeNs = INT64_MAX;
+    mReadStats.maxAtomReadTimeNs = -1;
+    mReadStats.atomCounts.clear();
+    const bool valid = readSocketMessages(cli->getSocket(), *mReadBuffers, *mQueue,
+                                          *mLogEventFilter, mReadStats);
+
+    // The atoms read before a malformed datagram are queued, so they are accounted for too.
+    StatsdStats::getInstance().noteBatchSocketRead(
+            mReadStats.messageCount, mLastSocketReadTimeNs, elapsedTimeNs,
+            mReadStats.minAtomReadTimeNs, mReadStats.maxAtomReadTimeNs, mReadStats.atomCounts);
+    mLastSocketReadTimeNs = elapsedTimeNs;
+    mReadStats.atomCounts.clear();
+    return valid;
+}
+
+bool StatsSocketListener::readSocketMessages(const int socket, ReadBuffers& buffers,
+                                             LogEventQueue& queue, const LogEventFilter& filter,
+                                             ReadStats& stats) {
+    bool valid = true;
+    int count = 0;
+    do {
+        // The kernel shrinks the control lengths to what it wrote, restore them before each read.
+        for (int i = 0; i < kMaxMessagesPerRead; i++) {
+            buffers.headers[i].msg_hdr.msg_controllen = sizeof(buffers.controls[i]);
         }
-        buffer[n] = 0;
-        i++;
+        count = recvmmsg(socket, buffers.headers, kMaxMessagesPerRead, MSG_DONTWAIT, NULL);
+        for (int i = 0; i < count; i++) {
+            struct msghdr* hdr = &buffers.headers[i].msg_hdr;
+            char* buffer = buffers.messages[i];
+            const ssize_t n = buffers.headers[i].msg_len;
+            // To clear the entire buffer is secure/safe, but this contributes to 1.68%
+            // overhead under logging load. We are safe because we check counts, but
+            // still need to clear null terminator.
+            if (n == 0) {
+                // An empty datagram carries nothing, and is not an error of the socket.
+                continue;
+            }
+            if (n <= (ssize_t)(sizeof(android_log_header_t))) {
+                // The rest of the batch is already read from the socket, process it before
+                // returning.
+                valid = false;
+                continue;
+            }
+            buffer[n] = 0;
+            stats.messageCount++;
+
+            struct ucred* cred = NULL;
+
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr);
+            while (cmsg != NULL) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS) {
+                    cred = (struct ucred*)CMSG_DATA(cmsg);
+                    break;
+                }
+                cmsg = CMSG_NXTHDR(hdr, cmsg);
+            }
+
+            struct ucred fake_cred;
+            if (cred == NULL) {
+                cred = &fake_cred;
+                cred->pid = 0;
+                cred->uid = DEFAULT_OVERFLOWUID;
+            }
 
-        struct ucred* cred = NULL;
+            const uint32_t uid = cred->uid;
+            const uint32_t pid = cred->pid;
 
-        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
-        while (cmsg != NULL) {
-            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS) {
-                cred = (struct ucred*)CMSG_DATA(cmsg);
-                break;
+            unique_ptr<LogEvent> logEvent = parseSocketMessage(buffer, n, uid, pid, filter);
+            int32_t atomId = -1;
+            int64_t atomTimeNs = 0;
+            if (logEvent != nullptr) {
+                atomId = logEvent->GetTagId();
+                atomTimeNs = logEvent->GetElapsedTimestampNs();
+                buffers.events.push_back(std::move(logEvent));
             }
-            cmsg = CMSG_NXTHDR(&hdr, cmsg);
+            stats.atomCounts[atomId]++;
+            stats.minAtomReadTimeNs = min(stats.minAtomReadTimeNs, atomTimeNs);
+            stats.maxAtomReadTimeNs = max(stats.maxAtomReadTimeNs, atomTimeNs);
         }
+        pushEvents(buffers.events, queue);
+        // A partial batch means that the socket is drained, skip the read failing with EAGAIN.
+    } while (valid && count == kMaxMessagesPerRead);
+    return valid;
+}
 
-        struct ucred fake_cred;
-        if (cred == NULL) {
-            cred = &fake_cred;
-            cred->pid = 0;
-            cred->uid = DEFAULT_OVERFLOWUID;
-        }
+namespace {
 
-        const uint32_t uid = cred->uid;
-        const uint32_t pid = cred->pid;
+// Submits a single event into the queue and notes the queue size or the overflowed event.
+tuple<int32_t, int64_t> pushEvent(unique_ptr<LogEvent> logEvent, LogEventQueue& queue) {
+    const int32_t atomId = logEvent->GetTagId();
+    const bool isAtomSkipped = logEvent->isParsedHeaderOnly();
+    const int64_t atomTimestamp = logEvent->GetElapsedTimestampNs();
 
-        auto [atomId, atomTimeNs] =
-                processSocketMessage(buffer, n, uid, pid, *mQueue, *mLogEventFilter);
-        mAtomCounts[atomId]++;
-        minAtomReadTime = min(minAtomReadTime, atomTimeNs);
-        maxAtomReadTime = max(maxAtomReadTime, atomTimeNs);
+    const auto [success, oldestTimestamp, queueSize] = queue.push(std::move(logEvent));
+    if (success) {
+        StatsdStats::getInstance().noteEventQueueSize(queueSize, atomTimestamp);
+    } else {
+        StatsdStats::getInstance().noteEventQueueOverflow(oldestTimestamp, atomId, isAtomSkipped);
     }
+    return {atomId, atomTimestamp};
+}
 
-    StatsdStats::getInstance().noteBatchSocketRead(i, mLastSocketReadTimeNs, elapsedTimeNs,
-                                                   minAtomReadTime, maxAtomReadTime, mAtomCounts);
-    mLastSocketReadTimeNs = elapsedTimeNs;
-    mAtomCounts.clear();
-    return true;
+}  // namespace
+
+void StatsSocketListener::pushEvents(vector<unique_ptr<LogEvent>>& events, LogEventQueue& queue) {
+    if (events.empty()) {
+        return;
+    }
+    const LogEventQueue::BatchResult result = queue.pushBatch(events);
+    if (result.count > 0) {
+        // The size only grows within the batch, so its last event brought the queue to its
+        // largest size.
+        StatsdStats::getInstance().noteEventQueueSize(result.size, result.lastTimestampNs);
+    }
+    for (size_t i = result.count; i < events.size(); i++) {
+        StatsdStats::getInstance().noteEventQueueOverflow(
+                result.oldestTimestampNs, events[i]->GetTagId(), events[i]->isParsedHeaderOnly());
+    }
+    events.clear();
 }
 
 tuple<int32_t, int64_t> StatsSocketListener::processSocketMessage(const char* buffer,
@@ -125,11 +197,30 @@ tuple<int32_t, int64_t> StatsSocketListener::processSocketMessage(const char* bu
                                                                   uint32_t pid,
                                                                   LogEventQueue& queue,
                                                                   const LogEventFilter& filter) {
+    unique_ptr<LogEvent> logEvent = parseSocketMessage(buffer, len, uid, pid, filter);
+    if (logEvent == nullptr) {
+        return {-1, 0};
+    }
+    return pushEvent(std::move(logEvent), queue);
+}
+
+tuple<int32_t, int64_t> StatsSocketListener::processStatsEventBuffer(const uint8_t* msg,
+                                                                     const uint32_t len,
+                                                                     uint32_t uid, uint32_t pid,
+                                                                     LogEventQueue& queue,
+                                                                     const LogEventFilter& filter) {
+    return pushEvent(parseStatsEventBuffer(msg, len, uid, pid, filter), queue);
+}
+
+unique_ptr<LogEvent> StatsSocketListener::parseSocketMessage(const char* buffer,
+                                                             const uint32_t len, uint32_t uid,
+                                                             uint32_t pid,
+                                                             const LogEventFilter& filter) {
     ATRACE_CALL();
     static const uint32_t kStatsEventTag = 1937006964;
 
     if (len <= (ssize_t)(sizeof(android_log_header_t)) + sizeof(uint32_t)) {
-        return {-1, 0};
+        return nullptr;
     }
 
     const uint8_t* ptr = ((uint8_t*)buffer) + sizeof(android_log_header_t);
@@ -157,46 +248,42 @@ tuple<int32_t, int64_t> StatsSocketListener::processSocketMessage(const char* bu
                   long_event->header.tag, last_atom_tag, uid);
             StatsdStats::getInstance().noteLogLost((int32_t)getWallClockSec(), dropped_count,
                                                    long_event->header.tag, last_atom_tag, uid, pid);
-            return {-1, 0};
+            return nullptr;
         }
     }
 
     // test that received valid StatsEvent buffer
     const uint32_t statsEventTag = *reinterpret_cast<const uint32_t*>(ptr);
     if (statsEventTag != kStatsEventTag) {
-        return {-1, 0};
+        return nullptr;
     }
 
     // move past the 4-byte StatsEventTag
     const uint8_t* msg = ptr + sizeof(uint32_t);
     bufferLen -= sizeof(uint32_t);
 
-    return processStatsEventBuffer(msg, bufferLen, uid, pid, queue, filter);
+    return parseStatsEventBuffer(msg, bufferLen, uid, pid, filter);
 }
 
-tuple<int32_t, int64_t> StatsSocketListener::processStatsEventBuffer(const uint8_t* msg,
-                                                                     const uint32_t len,
-                                                                     uint32_t uid, uint32_t pid,
-                                                                     LogEventQueue& queue,
-                                                                     const LogEventFilter& filter) {
+unique_ptr<LogEvent> StatsSocketListener::parseStatsEventBuffer(const uint8_t* msg,
+                                                                const uint32_t len, uint32_t uid,
+                                                                uint32_t pid,
+                                                                const LogEventFilter& filter) {
     ATRACE_CALL();
     std::unique_ptr<LogEvent> logEvent = std::make_unique<LogEvent>(uid, pid);
 
     if (filter.getFilteringEnabled()) {
         const LogEvent::BodyBufferInfo bodyInfo = logEvent->parseHeader(msg, len);
         if (filter.isAtomInUse(logEvent->GetTagId())) {
-            logEvent->parseBody(bodyInfo);
+            // Strings are only decoded if the event reaches code that needs them.
+            logEvent->parseBodyLazy(bodyInfo);
         }
     } else {
         logEvent->parseBuffer(msg, len);
     }
 
-    const int32_t atomId = logEvent->GetTagId();
-    const bool isAtomSkipped = logEvent->isParsedHeaderOnly();
-    const int64_t atomTimestamp = logEvent->GetElapsedTimestampNs();
-
-    if (atomId == util::STATS_SOCKET_LOSS_REPORTED) {
-        if (isAtomSkipped) {
+    if (logEvent->GetTagId() == util::STATS_SOCKET_LOSS_REPORTED) {
+        if (logEvent->isParsedHeaderOnly()) {
             ALOGW("Atom STATS_SOCKET_LOSS_REPORTED should not be skipped");
         }
 
@@ -209,14 +296,7 @@ tuple<int32_t, int64_t> StatsSocketListener::processStatsEventBuffer(const uint8
             ALOGW("Atom STATS_SOCKET_LOSS_REPORTED content is invalid");
         }
     }
-
-    const auto [success, oldestTimestamp, queueSize] = queue.push(std::move(logEvent));
-    if (success) {
-        StatsdStats::getInstance().noteEventQueueSize(queueSize, atomTimestamp);
-    } else {
-        StatsdStats::getInstance().noteEventQueueOverflow(oldestTimestamp, atomId, isAtomSkipped);
-    }
-    return {atomId, atomTimestamp};
+    return logEvent;
 }
 
 int StatsSocketListener::getLogSocket() {
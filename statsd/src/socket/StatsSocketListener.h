@@ -16,9 +16,14 @@
 #pragma once
 
 #include <gtest/gtest_prod.h>
+#include <sys/socket.h>
 #include <sysutils/SocketListener.h>
 #include <utils/RefBase.h>
 
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 #include "LogEventFilter.h"
 #include "logd/LogEventQueue.h"
 
@@ -49,6 +54,89 @@ protected:
 private:
     static int getLogSocket();
 
+    // Maximum number of datagrams read from the socket by a single system call.
+    static constexpr int kMaxMessagesPerRead = 16;
+
+    /**
+     * Message and control buffers of the datagrams read by a single system call. Allocated once
+     * as they are too large for the stack.
+     */
+    struct ReadBuffers {
+        ReadBuffers();
+
+        // + 1 to ensure null terminator if MAX_PAYLOAD buffer is received
+        char messages[kMaxMessagesPerRead]
+                     [sizeof(android_log_header_t) + LOGGER_ENTRY_MAX_PAYLOAD + 1];
+        alignas(struct cmsghdr) char controls[kMaxMessagesPerRead]
+                                             [CMSG_SPACE(sizeof(struct ucred))];
+        struct iovec iovs[kMaxMessagesPerRead];
+        struct mmsghdr headers[kMaxMessagesPerRead];
+        // Events parsed from the datagrams of a read, submitted into the queue together.
+        std::vector<std::unique_ptr<LogEvent>> events;
+    };
+
+    struct ReadStats {
+        int messageCount = 0;
+        int64_t minAtomReadTimeNs = INT64_MAX;
+        int64_t maxAtomReadTimeNs = -1;
+        // Tracks the atom counts per read.
+        std::unordered_map<int32_t, int32_t> atomCounts;
+    };
+
+    /**
+     * @brief Helper API to read the datagrams available on the socket, up to
+     * kMaxMessagesPerRead per system call, and submit their LogEvents into the queue.
+     * Created as a separate API to be easily tested without StatsSocketListener instance
+     *
+     * @param socket socket to read
+     * @param buffers buffers to read the datagrams into
+     * @param queue queue to submit the events
+     * @param filter to be used for event evaluation
+     * @param stats updated with the datagrams read
+     * @return false if a malformed datagram was read. The other datagrams of its batch are still
+     * processed, and the read stops after that batch.
+     */
+    static bool readSocketMessages(int socket, ReadBuffers& buffers, LogEventQueue& queue,
+                                   const LogEventFilter& filter, ReadStats& stats);
+
+    /**
+     * @brief Helper API to parse raw socket data buffer and make the LogEvent. Performs
+     * preliminary data validation.
+     *
+     * @param buffer buffer to parse
+     * @param len size of buffer in bytes
+     * @param uid arguments for LogEvent constructor
+     * @param pid arguments for LogEvent constructor
+     * @param filter to be used for event evaluation
+     * @return the LogEvent, or nullptr if the buffer holds no stats event
+     */
+    static std::unique_ptr<LogEvent> parseSocketMessage(const char* buffer, uint32_t len,
+                                                        uint32_t uid, uint32_t pid,
+                                                        const LogEventFilter& filter);
+
+    /**
+     * @brief Helper API to parse buffer and make the LogEvent
+     *
+     * @param msg buffer to parse
+     * @param len size of buffer in bytes
+     * @param uid arguments for LogEvent constructor
+     * @param pid arguments for LogEvent constructor
+     * @param filter to be used for event evaluation
+     * @return the LogEvent
+     */
+    static std::unique_ptr<LogEvent> parseStatsEventBuffer(const uint8_t* msg, uint32_t len,
+                                                           uint32_t uid, uint32_t pid,
+                                                           const LogEventFilter& filter);
+
+    /**
+     * @brief Helper API to submit the LogEvents of a read into the queue with a single batch
+     * push, and note the queue size or the overflowed events. Clears the vector.
+     *
+     * @param events events to submit, in order
+     * @param queue queue to submit the events
+     */
+    static void pushEvents(std::vector<std::unique_ptr<LogEvent>>& events, LogEventQueue& queue);
+
     /**
      * @brief Helper API to parse raw socket data buffer, make the LogEvent & submit it into the
      * queue. Performs preliminary data validation.
@@ -93,8 +181,10 @@ private:
 
     int64_t mLastSocketReadTimeNs;
 
-    // Tracks the atom counts per read. Member variable to avoid churn.
-    std::unordered_map<int32_t, int32_t> mAtomCounts;
+    std::unique_ptr<ReadBuffers> mReadBuffers;
+
+    // Member variable to avoid churn.
+    ReadStats mReadStats;
 
     friend void fuzzSocket(const uint8_t* data, size_t size);
 
@@ -108,6 +198,10 @@ private:
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterPartialSet);
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterToggle);
     FRIEND_TEST(LogEventQueue_test, TestQueueMaxSize);
+    FRIEND_TEST(SocketReadMessagesTest, TestBatchRead);
+    FRIEND_TEST(SocketReadMessagesTest, TestCredentials);
+    FRIEND_TEST(SocketReadMessagesTest, TestDroppedEventsMessage);
+    FRIEND_TEST(SocketReadMessagesTest, TestMalformedMessage);
 };
 
 }  // namespace statsd
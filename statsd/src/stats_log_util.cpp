@@ -138,12 +138,14 @@ void writeDimensionToProtoHelper(const std::vector<FieldValue>& dims, size_t* in
                     break;
                 case STRING:
                     if (str_set == nullptr) {
+                        const std::string_view str = dim.mValue.getString();
                         protoOutput->write(FIELD_TYPE_STRING | DIMENSIONS_VALUE_VALUE_STR,
-                                           dim.mValue.str_value);
+                                           str.data(), str.size());
                     } else {
-                        str_set->insert(dim.mValue.str_value);
+                        str_set->emplace(dim.mValue.getString());
                         protoOutput->write(FIELD_TYPE_UINT64 | DIMENSIONS_VALUE_VALUE_STR_HASH,
-                                           (long long)Hash64(dim.mValue.str_value));
+                                           (long long)Hash64(dim.mValue.getString().data(),
+                                                             dim.mValue.getString().size()));
                     }
                     break;
                 default:
@@ -204,12 +206,14 @@ void writeDimensionLeafToProtoHelper(const std::vector<FieldValue>& dims,
                     break;
                 case STRING:
                     if (str_set == nullptr) {
+                        const std::string_view str = dim.mValue.getString();
                         protoOutput->write(FIELD_TYPE_STRING | DIMENSIONS_VALUE_VALUE_STR,
-                                           dim.mValue.str_value);
+                                           str.data(), str.size());
                     } else {
-                        str_set->insert(dim.mValue.str_value);
+                        str_set->emplace(dim.mValue.getString());
                         protoOutput->write(FIELD_TYPE_UINT64 | DIMENSIONS_VALUE_VALUE_STR_HASH,
-                                           (long long)Hash64(dim.mValue.str_value));
+                                           (long long)Hash64(dim.mValue.getString().data(),
+                                                             dim.mValue.getString().size()));
                     }
                     break;
                 default:
@@ -368,14 +372,15 @@ void writeFieldValueTreeToStreamHelper(int tagId, const std::vector<FieldValue>&
                                        dim.mValue.float_value);
                     break;
                 case STRING: {
+                    const std::string_view str = dim.mValue.getString();
                     protoOutput->write(FIELD_TYPE_STRING | repeatedFieldMask | fieldNum,
-                                       dim.mValue.str_value);
+                                       str.data(), str.size());
                     break;
                 }
                 case STORAGE:
                     protoOutput->write(FIELD_TYPE_MESSAGE | fieldNum,
-                                       (const char*)dim.mValue.storage_value.data(),
-                                       dim.mValue.storage_value.size());
+                                       (const char*)dim.mValue.getStorageData(),
+                                       dim.mValue.getStorageSize());
                     break;
                 default:
                     break;
@@ -635,7 +640,7 @@ bool checkPermissionForIds(const char* permission, pid_t pid, uid_t uid) {
 
 void mapIsolatedUidsToHostUidInLogEvent(const sp<UidMap>& uidMap, LogEvent& event) {
     uint8_t remainingUidCount = event.getNumUidFields();
-    vector<FieldValue>* fieldValues = event.getMutableValues();
+    vector<FieldValue>* fieldValues = event.getMutableLazyValues();
     auto it = fieldValues->begin();
     while(it != fieldValues->end() && remainingUidCount > 0) {
         if (isUidField(*it)) {
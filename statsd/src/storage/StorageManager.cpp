@@ -23,9 +23,15 @@
 #include <private/android_filesystem_config.h>
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
 
 #include "android-base/stringprintf.h"
+#include "android-base/strings.h"
 #include "guardrail/StatsdStats.h"
 #include "stats_log_util.h"
 #include "utils/DbUtils.h"
@@ -122,6 +128,11 @@ static void parseFileName(char* name, FileName* output) {
     output->mIsHistory = (substr != nullptr && strcmp("history", substr) == 0);
 }
 
+// Returns true for the -wal and -shm files SQLite keeps next to a db in WAL mode.
+static bool isDbWalFile(const string& fileName) {
+    return android::base::EndsWith(fileName, "-wal") || android::base::EndsWith(fileName, "-shm");
+}
+
 // Returns array of int64_t which contains a sqlite db's uid and configId
 static ConfigKey parseDbName(char* name) {
     char* uid = strtok(name, "_");
@@ -132,14 +143,174 @@ static ConfigKey parseDbName(char* name) {
     return ConfigKey(StrToInt64(uid), StrToInt64(configId));
 }
 
+namespace {
+
+/**
+ * The files of a directory trimmed by trimToFit(), with their sizes and the timestamps in their
+ * names. The directory is listed once, when the index is created. The index is then kept up to
+ * date by the StorageManager functions writing, renaming and deleting files, so that trimming
+ * does not list and stat the whole directory again.
+ *
+ * Files created by other means are only seen by the first listing.
+ */
+class FileIndex {
+public:
+    FileIndex(const char* path, bool parseTimestampOnly)
+        : mParseTimestampOnly(parseTimestampOnly), mTotalFileSize(0) {
+        unique_ptr<DIR, decltype(&closedir)> dir(opendir(path), closedir);
+        if (dir == NULL) {
+            VLOG("Path %s does not exist", path);
+            return;
+        }
+        dirent* de;
+        while ((de = readdir(dir.get()))) {
+            const char* name = de->d_name;
+            if (name[0] == '.' || de->d_type == DT_DIR) continue;
+            const string fileName = StringPrintf("%s/%s", path, name);
+            struct stat fileInfo;
+            put(fileName, stat(fileName.c_str(), &fileInfo) == 0 ? fileInfo.st_size : 0);
+        }
+    }
+
+    // Adds the file with the given full path, or updates its size.
+    void put(const string& fileName, int64_t fileSize) {
+        erase(fileName);
+        FileName output;
+        if (!parse(fileName, &output)) {
+            return;
+        }
+        mFiles[fileName] = {output.mTimestampSec, output.mIsHistory, fileSize};
+        getQueue(output.mIsHistory).emplace(output.mTimestampSec, fileName);
+        mTotalFileSize += fileSize;
+    }
+
+    // Removes the file from the index, returning its size, or -1 if it was not in it.
+    int64_t erase(const string& fileName) {
+        auto it = mFiles.find(fileName);
+        if (it == mFiles.end()) {
+            return -1;
+        }
+        const int64_t fileSize = it->second.mFileSize;
+        getQueue(it->second.mIsHistory).erase({it->second.mTimestampSec, fileName});
+        mTotalFileSize -= fileSize;
+        mFiles.erase(it);
+        return fileSize;
+    }
+
+    // Deletes the outdated files, then the oldest ones while there are too many or too large.
+    void trim(int64_t nowSec) {
+        deleteOlderThan(&mDataFiles, nowSec - StatsdStats::kMaxAgeSecond);
+        deleteOlderThan(&mHistoryFiles,
+                        nowSec - std::min<int64_t>(StatsdStats::kMaxAgeSecond,
+                                                   StatsdStats::kMaxLocalHistoryAgeSecond));
+
+        // Same order as StorageManager::sortFiles(), from the end.
+        while (mFiles.size() > StatsdStats::kMaxFileNumber ||
+               mTotalFileSize > StatsdStats::kMaxFileSize) {
+            FileQueue& queue = mHistoryFiles.empty() ? mDataFiles : mHistoryFiles;
+            deleteIndexedFile(queue.begin()->second);
+        }
+    }
+
+private:
+    struct IndexedFile {
+        int64_t mTimestampSec;
+        bool mIsHistory;
+        int64_t mFileSize;
+    };
+
+    // File names by timestamp, oldest first.
+    typedef std::set<std::pair<int64_t, string>> FileQueue;
+
+    bool parse(const string& fileName, FileName* output) const {
+        string name = fileName.substr(fileName.rfind('/') + 1);
+        if (mParseTimestampOnly) {
+            const char* timestamp = strtok(name.data(), "_");
+            output->mTimestampSec = timestamp != nullptr ? StrToInt64(timestamp) : -1;
+            output->mIsHistory = false;
+        } else {
+            parseFileName(name.data(), output);
+        }
+        return output->mTimestampSec != -1;
+    }
+
+    FileQueue& getQueue(bool isHistory) {
+        return isHistory ? mHistoryFiles : mDataFiles;
+    }
+
+    void deleteOlderThan(FileQueue* queue, int64_t minTimestampSec) {
+        while (!queue->empty() && queue->begin()->first < minTimestampSec) {
+            deleteIndexedFile(queue->begin()->second);
+        }
+    }
+
+    void deleteIndexedFile(string fileName) {
+        erase(fileName);
+        if (remove(fileName.c_str()) != 0) {
+            VLOG("Attempt to delete %s but is not found", fileName.c_str());
+        } else {
+            VLOG("Successfully deleted %s", fileName.c_str());
+        }
+    }
+
+    const bool mParseTimestampOnly;
+
+    std::unordered_map<string, IndexedFile> mFiles;
+
+    FileQueue mDataFiles;
+
+    // Local history files, deleted before data files.
+    FileQueue mHistoryFiles;
+
+    int64_t mTotalFileSize;
+};
+
+std::mutex sFileIndexMutex;
+
+// The indexes of the directories trimmed so far, by path. Guarded by sFileIndexMutex.
+std::map<string, unique_ptr<FileIndex>> sFileIndexes;
+
+FileIndex* findFileIndexLocked(const string& fileName) {
+    auto it = sFileIndexes.find(fileName.substr(0, fileName.rfind('/')));
+    return it == sFileIndexes.end() ? nullptr : it->second.get();
+}
+
+void noteFileWritten(const string& fileName, int64_t fileSize) {
+    std::lock_guard<std::mutex> lock(sFileIndexMutex);
+    FileIndex* index = findFileIndexLocked(fileName);
+    if (index != nullptr) {
+        index->put(fileName, fileSize);
+    }
+}
+
+void noteFileDeleted(const string& fileName) {
+    std::lock_guard<std::mutex> lock(sFileIndexMutex);
+    FileIndex* index = findFileIndexLocked(fileName);
+    if (index != nullptr) {
+        index->erase(fileName);
+    }
+}
+
+void noteFileRenamed(const string& oldFileName, const string& newFileName) {
+    std::lock_guard<std::mutex> lock(sFileIndexMutex);
+    FileIndex* index = findFileIndexLocked(oldFileName);
+    if (index == nullptr) {
+        return;
+    }
+    const int64_t fileSize = index->erase(oldFileName);
+    if (fileSize >= 0) {
+        index->put(newFileName, fileSize);
+    }
+}
+
+}  // namespace
+
 void StorageManager::writeFile(const char* file, const void* buffer, int numBytes) {
     int fd = open(file, O_WRONLY | O_CREAT | O_CLOEXEC | O_TRUNC, S_IRUSR | S_IWUSR);
     if (fd == -1) {
         VLOG("Attempt to access %s but failed", file);
         return;
     }
-    trimToFit(STATS_SERVICE_DIR);
-    trimToFit(STATS_DATA_DIR);
 
     if (android::base::WriteFully(fd, buffer, numBytes)) {
         VLOG("Successfully wrote %s", file);
@@ -152,33 +323,21 @@ void StorageManager::writeFile(const char* file, const void* buffer, int numByte
         VLOG("Failed to chown %s to statsd", file);
     }
 
+    struct stat fileInfo;
+    noteFileWritten(file, fstat(fd, &fileInfo) == 0 ? fileInfo.st_size : numBytes);
     close(fd);
-}
-
-bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
-    std::lock_guard<std::mutex> lock(sTrainInfoMutex);
-
-    if (trainInfo.trainName.empty()) {
-      return false;
-    }
-    deleteSuffixedFiles(TRAIN_INFO_DIR, trainInfo.trainName.c_str());
 
-    std::string fileName =
-            StringPrintf("%s/%ld_%s", TRAIN_INFO_DIR, (long) getWallClockSec(),
-                         trainInfo.trainName.c_str());
-
-    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
-    if (fd == -1) {
-        VLOG("Attempt to access %s but failed", fileName.c_str());
-        return false;
-    }
+    trimToFit(STATS_SERVICE_DIR);
+    trimToFit(STATS_DATA_DIR);
+}
 
+// Writes the train info to the train info file open as fd.
+static bool writeTrainInfoToFd(int fd, const InstallTrainInfo& trainInfo) {
     size_t result;
     // Write the magic word
     result = write(fd, &TRAIN_INFO_FILE_MAGIC, sizeof(TRAIN_INFO_FILE_MAGIC));
     if (result != sizeof(TRAIN_INFO_FILE_MAGIC)) {
         VLOG("Failed to wrtie train info magic");
-        close(fd);
         return false;
     }
 
@@ -187,7 +346,6 @@ bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
     result = write(fd, &trainInfo.trainVersionCode, trainVersionCodeByteCount);
     if (result != trainVersionCodeByteCount) {
         VLOG("Failed to wrtie train version code");
-        close(fd);
         return false;
     }
 
@@ -197,7 +355,6 @@ bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
     result = write(fd, (uint8_t*)&trainNameSize, trainNameSizeByteCount);
     if (result != trainNameSizeByteCount) {
         VLOG("Failed to write train name size");
-        close(fd);
         return false;
     }
 
@@ -205,7 +362,6 @@ bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
     result = write(fd, trainInfo.trainName.c_str(), trainNameSize);
     if (result != trainNameSize) {
         VLOG("Failed to write train name");
-        close(fd);
         return false;
     }
 
@@ -214,7 +370,6 @@ bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
     result = write(fd, (uint8_t*)&trainInfo.status, statusByteCount);
     if (result != statusByteCount) {
         VLOG("Failed to write status");
-        close(fd);
         return false;
     }
 
@@ -224,7 +379,6 @@ bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
     result = write(fd, (uint8_t*) &experimentIdsCount, experimentIdsCountByteCount);
     if (result != experimentIdsCountByteCount) {
         VLOG("Failed to write experiment id count");
-        close(fd);
         return false;
     }
 
@@ -237,7 +391,6 @@ bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
             VLOG("Successfully wrote experiment IDs");
         } else {
             VLOG("Failed to write experiment ids");
-            close(fd);
             return false;
         }
     }
@@ -247,28 +400,49 @@ bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
     result = write(fd, (uint8_t*)&trainInfo.requiresStaging, boolByteCount);
     if (result != boolByteCount) {
       VLOG("Failed to write requires staging");
-      close(fd);
       return false;
     }
 
     result = write(fd, (uint8_t*)&trainInfo.rollbackEnabled, boolByteCount);
     if (result != boolByteCount) {
       VLOG("Failed to write rollback enabled");
-      close(fd);
       return false;
     }
 
     result = write(fd, (uint8_t*)&trainInfo.requiresLowLatencyMonitor, boolByteCount);
     if (result != boolByteCount) {
       VLOG("Failed to write requires log latency monitor");
-      close(fd);
       return false;
     }
 
-    close(fd);
     return true;
 }
 
+bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
+    std::lock_guard<std::mutex> lock(sTrainInfoMutex);
+
+    if (trainInfo.trainName.empty()) {
+      return false;
+    }
+    deleteSuffixedFiles(TRAIN_INFO_DIR, trainInfo.trainName.c_str());
+
+    std::string fileName =
+            StringPrintf("%s/%ld_%s", TRAIN_INFO_DIR, (long) getWallClockSec(),
+                         trainInfo.trainName.c_str());
+
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        VLOG("Attempt to access %s but failed", fileName.c_str());
+        return false;
+    }
+
+    const bool success = writeTrainInfoToFd(fd, trainInfo);
+    struct stat fileInfo;
+    noteFileWritten(fileName, fstat(fd, &fileInfo) == 0 ? fileInfo.st_size : 0);
+    close(fd);
+    return success;
+}
+
 bool StorageManager::readTrainInfo(const std::string& trainName, InstallTrainInfo& trainInfo) {
     std::lock_guard<std::mutex> lock(sTrainInfoMutex);
     return readTrainInfoLocked(trainName, trainInfo);
@@ -463,6 +637,7 @@ void StorageManager::deleteFile(const char* file) {
         VLOG("Attempt to delete %s but is not found", file);
     } else {
         VLOG("Successfully deleted %s", file);
+        noteFileDeleted(file);
     }
 }
 
@@ -586,7 +761,7 @@ void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutput
         }
 
         if (erase_data) {
-            remove(fullPathName.c_str());
+            deleteFile(fullPathName.c_str());
         } else if (!output.mIsHistory && !isAdb) {
             // This means a real data owner has called to get this data. But the config says it
             // wants to keep a local history. So now this file must be renamed as a history file.
@@ -594,6 +769,8 @@ void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutput
             // again. rename returns 0 on success
             if (rename(fullPathName.c_str(), (fullPathName + "_history").c_str())) {
                 ALOGE("Failed to rename file %s", fullPathName.c_str());
+            } else {
+                noteFileRenamed(fullPathName, fullPathName + "_history");
             }
         }
     }
@@ -721,62 +898,12 @@ void StorageManager::sortFiles(vector<FileInfo>* fileNames) {
 }
 
 void StorageManager::trimToFit(const char* path, bool parseTimestampOnly) {
-    unique_ptr<DIR, decltype(&closedir)> dir(opendir(path), closedir);
-    if (dir == NULL) {
-        VLOG("Path %s does not exist", path);
-        return;
-    }
-    dirent* de;
-    int totalFileSize = 0;
-    vector<FileInfo> fileNames;
-    auto nowSec = getWallClockSec();
-    while ((de = readdir(dir.get()))) {
-        char* name = de->d_name;
-        if (name[0] == '.' || de->d_type == DT_DIR) continue;
-
-        FileName output;
-        string file_name;
-        if (parseTimestampOnly) {
-            file_name = StringPrintf("%s/%s", path, name);
-            output.mTimestampSec = StrToInt64(strtok(name, "_"));
-            output.mIsHistory = false;
-        } else {
-            parseFileName(name, &output);
-            file_name = output.getFullFileName(path);
-        }
-        if (output.mTimestampSec == -1) continue;
-
-        // Check for timestamp and delete if it's too old.
-        long fileAge = nowSec - output.mTimestampSec;
-        if (fileAge > StatsdStats::kMaxAgeSecond ||
-            (output.mIsHistory && fileAge > StatsdStats::kMaxLocalHistoryAgeSecond)) {
-            deleteFile(file_name.c_str());
-            continue;
-        }
-
-        ifstream file(file_name.c_str(), ifstream::in | ifstream::binary);
-        int fileSize = 0;
-        if (file.is_open()) {
-            file.seekg(0, ios::end);
-            fileSize = file.tellg();
-            file.close();
-            totalFileSize += fileSize;
-        }
-        fileNames.emplace_back(file_name, output.mIsHistory, fileSize, fileAge);
-    }
-
-    if (fileNames.size() > StatsdStats::kMaxFileNumber ||
-        totalFileSize > StatsdStats::kMaxFileSize) {
-        sortFiles(&fileNames);
-    }
-
-    // Start removing files from oldest to be under the limit.
-    while (fileNames.size() > 0 && (fileNames.size() > StatsdStats::kMaxFileNumber ||
-                                    totalFileSize > StatsdStats::kMaxFileSize)) {
-        totalFileSize -= fileNames.at(fileNames.size() - 1).mFileSizeBytes;
-        deleteFile(fileNames.at(fileNames.size() - 1).mFileName.c_str());
-        fileNames.pop_back();
+    std::lock_guard<std::mutex> lock(sFileIndexMutex);
+    unique_ptr<FileIndex>& index = sFileIndexes[path];
+    if (index == nullptr) {
+        index = std::make_unique<FileIndex>(path, parseTimestampOnly);
     }
+    index->trim(getWallClockSec());
 }
 
 void StorageManager::printStats(int outFd) {
@@ -838,6 +965,14 @@ void StorageManager::enforceDbGuardrails(const char* path, const int64_t currWal
         char* name = de->d_name;
         if (name[0] == '.' || de->d_type == DT_DIR) continue;
         string fullPathName = StringPrintf("%s/%s", path, name);
+        if (isDbWalFile(fullPathName)) {
+            // Accounted for and deleted with their db. Only the files left without one are
+            // removed here.
+            if (!hasFile(fullPathName.substr(0, fullPathName.size() - 4).c_str())) {
+                remove(fullPathName.c_str());
+            }
+            continue;
+        }
         struct stat fileInfo;
         const ConfigKey key = parseDbName(name);
         if (stat(fullPathName.c_str(), &fileInfo) != 0) {
@@ -846,15 +981,29 @@ void StorageManager::enforceDbGuardrails(const char* path, const int64_t currWal
             remove(fullPathName.c_str());
             continue;
         }
+        // The latest writes to a db in WAL mode are in its -wal file until they are checkpointed.
+        struct stat walInfo;
+        if (stat((fullPathName + "-wal").c_str(), &walInfo) == 0) {
+            fileInfo.st_size += walInfo.st_size;
+            fileInfo.st_mtime = std::max(fileInfo.st_mtime, walInfo.st_mtime);
+        }
+        // Closes the connection statsd keeps to the db, if any, along with deleting its files.
+        const auto deleteDbFiles = [&key, &fullPathName] {
+            if (dbutils::getDbName(key) == fullPathName) {
+                dbutils::deleteDb(key);
+            } else {
+                remove(fullPathName.c_str());
+            }
+        };
         StatsdStats::getInstance().noteRestrictedConfigDbSize(key, currWallClockSec,
                                                               fileInfo.st_size);
         if (fileInfo.st_mtime <= deleteThresholdSec) {
             StatsdStats::getInstance().noteDbTooOld(key);
-            remove(fullPathName.c_str());
+            deleteDbFiles();
         }
         if (fileInfo.st_size >= maxBytes) {
             StatsdStats::getInstance().noteDbSizeExceeded(key);
-            remove(fullPathName.c_str());
+            deleteDbFiles();
         }
         if (hasFile(dbutils::getDbName(key).c_str())) {
             dbutils::verifyIntegrityAndDeleteIfNecessary(key);
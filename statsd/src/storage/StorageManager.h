@@ -145,6 +145,9 @@ public:
     /**
      * Trims files in the provided directory to limit the total size, number of
      * files, accumulation of outdated files.
+     *
+     * The directory is listed on the first call only. The sizes and timestamps of its files are
+     * then kept in memory, and updated as StorageManager writes, renames and deletes them.
      */
     static void trimToFit(const char* dir, bool parseTimestampOnly = false);
 
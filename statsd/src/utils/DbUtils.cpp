@@ -22,6 +22,11 @@
 
 #include <android/api-level.h>
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include "FieldValue.h"
 #include "android-base/properties.h"
 #include "android-base/stringprintf.h"
@@ -40,6 +45,7 @@ using ::android::os::statsd::StorageManager;
 using ::android::os::statsd::STRING;
 using base::GetProperty;
 using base::StringPrintf;
+using FieldColumn = RestrictedEventColumns::FieldColumn;
 
 const string TABLE_NAME_PREFIX = "metric_";
 const string COLUMN_NAME_ATOM_TAG = "atomId";
@@ -57,28 +63,113 @@ const string COLUMN_NAME_BRAND = "brand";
 const string COLUMN_NAME_MANUFACTURER = "manufacturer";
 const string COLUMN_NAME_BOARD = "board";
 
-static std::vector<std::string> getExpectedTableSchema(const LogEvent& logEvent) {
+namespace {
+
+// Prepared single row inserts, by metric id and number of values bound.
+typedef std::map<std::pair<int64_t, int32_t>, sqlite3_stmt*> InsertStmtCache;
+
+void finalizeInsertStmts(InsertStmtCache* stmts) {
+    for (const auto& [key, stmt] : *stmts) {
+        sqlite3_finalize(stmt);
+    }
+    stmts->clear();
+}
+
+// The db of a config, kept open across operations along with its prepared inserts.
+struct DbConnection {
+    // Serializes the use of the connection, which is opened on first use.
+    std::mutex mutex;
+
+    // Read-write handle, in WAL mode.
+    sqlite3* db = nullptr;
+
+    // Read-only handle used by query(), so that queries cannot modify the db.
+    sqlite3* readOnlyDb = nullptr;
+
+    InsertStmtCache insertStmts;
+
+    // Whether the db was deleted. Holders of the connection must not reopen it.
+    bool closed = false;
+
+    ~DbConnection() {
+        closeLocked();
+    }
+
+    void closeLocked() {
+        finalizeInsertStmts(&insertStmts);
+        sqlite3_close(db);
+        db = nullptr;
+        sqlite3_close(readOnlyDb);
+        readOnlyDb = nullptr;
+    }
+};
+
+std::mutex& getDbPoolMutex() {
+    static std::mutex sMutex;
+    return sMutex;
+}
+
+// Open connections by config. Guarded by getDbPoolMutex().
+std::unordered_map<ConfigKey, std::shared_ptr<DbConnection>>& getDbPool() {
+    static std::unordered_map<ConfigKey, std::shared_ptr<DbConnection>> sPool;
+    return sPool;
+}
+
+std::shared_ptr<DbConnection> getDbConnection(const ConfigKey& key) {
+    std::lock_guard<std::mutex> lock(getDbPoolMutex());
+    std::shared_ptr<DbConnection>& connection = getDbPool()[key];
+    if (connection == nullptr) {
+        connection = std::make_shared<DbConnection>();
+    }
+    return connection;
+}
+
+// Returns the read-write handle of the connection, opening it if needed, or nullptr on error.
+sqlite3* getWritableDbLocked(DbConnection* connection, const ConfigKey& key, string* error) {
+    if (connection->db != nullptr) {
+        return connection->db;
+    }
+    if (connection->closed) {
+        *error = "db was deleted";
+        return nullptr;
+    }
+    sqlite3* db;
+    if (sqlite3_open(getDbName(key).c_str(), &db) != SQLITE_OK) {
+        *error = sqlite3_errmsg(db);
+        sqlite3_close(db);
+        return nullptr;
+    }
+    // WAL commits append to a log instead of rewriting the db through a rollback journal, and
+    // need fewer fsyncs. The journal mode is persisted in the db file.
+    char* walError = nullptr;
+    sqlite3_exec(db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;", nullptr, nullptr,
+                 &walError);
+    if (walError) {
+        ALOGW("Failed to enable WAL for db: %s", walError);
+        sqlite3_free(walError);
+    }
+    connection->db = db;
+    return db;
+}
+
+}  // namespace
+
+static const char* getColumnType(const Type type) {
+    switch (type) {
+        case INT:
+        case LONG:
+            return "INTEGER";
+        case STRING:
+            return "TEXT";
+        default:
+            return "REAL";
+    }
+}
+
+static std::vector<std::string> getExpectedTableSchema(const vector<FieldColumn>& fieldColumns) {
     vector<std::string> result;
-    for (const FieldValue& fieldValue : logEvent.getValues()) {
-        if (fieldValue.mField.getDepth() > 0) {
-            // Repeated fields are not supported.
-            continue;
-        }
-        switch (fieldValue.mValue.getType()) {
-            case INT:
-            case LONG:
-                result.push_back("INTEGER");
-                break;
-            case STRING:
-                result.push_back("TEXT");
-                break;
-            case FLOAT:
-                result.push_back("REAL");
-                break;
-            default:
-                // Byte array fields are not supported.
-                break;
-        }
+    for (const FieldColumn& fieldColumn : fieldColumns) {
+        result.push_back(getColumnType(fieldColumn.type));
     }
     return result;
 }
@@ -96,33 +187,15 @@ string getDbName(const ConfigKey& key) {
                         (long long)key.GetId());
 }
 
-static string getCreateSqlString(const int64_t metricId, const LogEvent& event) {
+static string getCreateSqlString(const int64_t metricId, const vector<FieldColumn>& fieldColumns) {
     string result = StringPrintf("CREATE TABLE IF NOT EXISTS %s%s", TABLE_NAME_PREFIX.c_str(),
                                  reformatMetricId(metricId).c_str());
     result += StringPrintf("(%s INTEGER,%s INTEGER,%s INTEGER,", COLUMN_NAME_ATOM_TAG.c_str(),
                            COLUMN_NAME_EVENT_ELAPSED_CLOCK_NS.c_str(),
                            COLUMN_NAME_EVENT_WALL_CLOCK_NS.c_str());
-    for (size_t fieldId = 1; fieldId <= event.getValues().size(); ++fieldId) {
-        const FieldValue& fieldValue = event.getValues()[fieldId - 1];
-        if (fieldValue.mField.getDepth() > 0) {
-            // Repeated fields are not supported.
-            continue;
-        }
-        switch (fieldValue.mValue.getType()) {
-            case INT:
-            case LONG:
-                result += StringPrintf("field_%d INTEGER,", fieldValue.mField.getPosAtDepth(0));
-                break;
-            case STRING:
-                result += StringPrintf("field_%d TEXT,", fieldValue.mField.getPosAtDepth(0));
-                break;
-            case FLOAT:
-                result += StringPrintf("field_%d REAL,", fieldValue.mField.getPosAtDepth(0));
-                break;
-            default:
-                // Byte array fields are not supported.
-                break;
-        }
+    for (const FieldColumn& fieldColumn : fieldColumns) {
+        result += StringPrintf("field_%d %s,", fieldColumn.position,
+                               getColumnType(fieldColumn.type));
     }
     result.pop_back();
     result += ") STRICT;";
@@ -134,31 +207,47 @@ string reformatMetricId(const int64_t metricId) {
                         : StringPrintf("%lld", (long long)metricId);
 }
 
-bool createTableIfNeeded(const ConfigKey& key, const int64_t metricId, const LogEvent& event) {
-    const string dbName = getDbName(key);
-    sqlite3* db;
-    if (sqlite3_open(dbName.c_str(), &db) != SQLITE_OK) {
-        sqlite3_close(db);
+static bool createTableIfNeeded(const ConfigKey& key, const int64_t metricId,
+                                const vector<FieldColumn>& fieldColumns) {
+    std::shared_ptr<DbConnection> connection = getDbConnection(key);
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    string openError;
+    sqlite3* db = getWritableDbLocked(connection.get(), key, &openError);
+    if (db == nullptr) {
+        ALOGW("Failed to open db: %s", openError.c_str());
         return false;
     }
 
     char* error = nullptr;
-    string zSql = getCreateSqlString(metricId, event);
+    string zSql = getCreateSqlString(metricId, fieldColumns);
     sqlite3_exec(db, zSql.c_str(), nullptr, nullptr, &error);
-    sqlite3_close(db);
     if (error) {
         ALOGW("Failed to create table to db: %s", error);
+        sqlite3_free(error);
         return false;
     }
     return true;
 }
 
-bool isEventCompatible(const ConfigKey& key, const int64_t metricId, const LogEvent& event) {
-    const string dbName = getDbName(key);
-    sqlite3* db;
-    if (sqlite3_open(dbName.c_str(), &db) != SQLITE_OK) {
-        sqlite3_close(db);
-        return false;
+bool createTableIfNeeded(const ConfigKey& key, const int64_t metricId, const LogEvent& event) {
+    return createTableIfNeeded(key, metricId, RestrictedEventColumns::getFieldColumns(event));
+}
+
+bool createTableIfNeeded(const ConfigKey& key, const int64_t metricId,
+                         const RestrictedEventColumns& events) {
+    return createTableIfNeeded(key, metricId, events.getFieldColumns());
+}
+
+static bool isEventCompatible(const ConfigKey& key, const int64_t metricId,
+                              const vector<FieldColumn>& fieldColumns) {
+    {
+        // Creates the db file if needed, so that the read-only query below can open it.
+        std::shared_ptr<DbConnection> connection = getDbConnection(key);
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        string openError;
+        if (getWritableDbLocked(connection.get(), key, &openError) == nullptr) {
+            return false;
+        }
     }
     string zSql = StringPrintf("PRAGMA table_info(metric_%s);", reformatMetricId(metricId).c_str());
     string err;
@@ -167,7 +256,6 @@ bool isEventCompatible(const ConfigKey& key, const int64_t metricId, const LogEv
     std::vector<std::vector<std::string>> rows;
     if (!query(key, zSql, rows, columnTypes, columnNames, err)) {
         ALOGE("Failed to check table schema for metric %lld: %s", (long long)metricId, err.c_str());
-        sqlite3_close(db);
         return false;
     }
     // Sample query result
@@ -182,32 +270,68 @@ bool isEventCompatible(const ConfigKey& key, const int64_t metricId, const LogEv
     for (size_t i = 3; i < rows.size(); ++i) {  // Atom fields start at the third row
         tableSchema.push_back(rows[i][2]);  // The third column stores the data type for the column
     }
-    sqlite3_close(db);
     // An empty rows vector implies the table has not yet been created.
-    return rows.size() == 0 || getExpectedTableSchema(event) == tableSchema;
+    return rows.size() == 0 || getExpectedTableSchema(fieldColumns) == tableSchema;
+}
+
+bool isEventCompatible(const ConfigKey& key, const int64_t metricId, const LogEvent& event) {
+    return isEventCompatible(key, metricId, RestrictedEventColumns::getFieldColumns(event));
+}
+
+bool isEventCompatible(const ConfigKey& key, const int64_t metricId,
+                       const RestrictedEventColumns& events) {
+    return isEventCompatible(key, metricId, events.getFieldColumns());
 }
 
 bool deleteTable(const ConfigKey& key, const int64_t metricId) {
-    const string dbName = getDbName(key);
-    sqlite3* db;
-    if (sqlite3_open(dbName.c_str(), &db) != SQLITE_OK) {
-        sqlite3_close(db);
+    std::shared_ptr<DbConnection> connection = getDbConnection(key);
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    string openError;
+    sqlite3* db = getWritableDbLocked(connection.get(), key, &openError);
+    if (db == nullptr) {
+        ALOGW("Failed to open db: %s", openError.c_str());
         return false;
     }
+    // The table may be recreated with another schema.
+    for (auto it = connection->insertStmts.begin(); it != connection->insertStmts.end();) {
+        if (it->first.first == metricId) {
+            sqlite3_finalize(it->second);
+            it = connection->insertStmts.erase(it);
+        } else {
+            ++it;
+        }
+    }
     string zSql = StringPrintf("DROP TABLE metric_%s", reformatMetricId(metricId).c_str());
     char* error = nullptr;
     sqlite3_exec(db, zSql.c_str(), nullptr, nullptr, &error);
-    sqlite3_close(db);
     if (error) {
         ALOGW("Failed to drop table from db: %s", error);
+        sqlite3_free(error);
         return false;
     }
     return true;
 }
 
 void deleteDb(const ConfigKey& key) {
+    std::shared_ptr<DbConnection> connection;
+    {
+        std::lock_guard<std::mutex> lock(getDbPoolMutex());
+        auto it = getDbPool().find(key);
+        if (it != getDbPool().end()) {
+            connection = std::move(it->second);
+            getDbPool().erase(it);
+        }
+    }
+    if (connection != nullptr) {
+        // Waits for the operations in progress, which may still hold the connection.
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        connection->closeLocked();
+        connection->closed = true;
+    }
     const string dbName = getDbName(key);
     StorageManager::deleteFile(dbName.c_str());
+    StorageManager::deleteFile((dbName + "-wal").c_str());
+    StorageManager::deleteFile((dbName + "-shm").c_str());
 }
 
 sqlite3* getDb(const ConfigKey& key) {
@@ -223,108 +347,165 @@ void closeDb(sqlite3* db) {
     sqlite3_close(db);
 }
 
-static bool getInsertSqlStmt(sqlite3* db, sqlite3_stmt** stmt, const int64_t metricId,
-                             const vector<LogEvent>& events, string& err) {
-    string result =
-            StringPrintf("INSERT INTO metric_%s VALUES", reformatMetricId(metricId).c_str());
-    for (auto& logEvent : events) {
-        result += StringPrintf("(%d, %lld, %lld,", logEvent.GetTagId(),
-                               (long long)logEvent.GetElapsedTimestampNs(),
-                               (long long)logEvent.GetLogdTimestampNs());
-        for (auto& fieldValue : logEvent.getValues()) {
-            if (fieldValue.mField.getDepth() > 0 || fieldValue.mValue.getType() == STORAGE) {
-                // Repeated fields and byte fields are not supported.
-                continue;
-            }
-            result += "?,";
-        }
-        result.pop_back();
-        result += "),";
+static bool prepareInsertStmt(sqlite3* db, const int64_t metricId, const int32_t paramCount,
+                              sqlite3_stmt** stmt, string& err) {
+    string zSql = StringPrintf("INSERT INTO metric_%s VALUES(", reformatMetricId(metricId).c_str());
+    for (int32_t i = 0; i < paramCount; ++i) {
+        zSql += "?,";
     }
-    result.pop_back();
-    result += ";";
-    if (sqlite3_prepare_v2(db, result.c_str(), -1, stmt, nullptr) != SQLITE_OK) {
+    zSql.pop_back();
+    zSql += ");";
+    if (sqlite3_prepare_v2(db, zSql.c_str(), -1, stmt, nullptr) != SQLITE_OK) {
         err = sqlite3_errmsg(db);
+        sqlite3_finalize(*stmt);
+        *stmt = nullptr;
         return false;
     }
+    return true;
+}
+
+static void bindInsertStmt(sqlite3_stmt* stmt, const RestrictedEventColumns& events,
+                           const size_t row) {
     // ? parameters start with an index of 1 from start of query string to the
     // end.
-    int32_t index = 1;
-    for (auto& logEvent : events) {
-        for (auto& fieldValue : logEvent.getValues()) {
-            if (fieldValue.mField.getDepth() > 0 || fieldValue.mValue.getType() == STORAGE) {
-                // Repeated fields and byte fields are not supported.
-                continue;
-            }
-            switch (fieldValue.mValue.getType()) {
-                case INT:
-                    sqlite3_bind_int(*stmt, index, fieldValue.mValue.int_value);
-                    break;
-                case LONG:
-                    sqlite3_bind_int64(*stmt, index, fieldValue.mValue.long_value);
-                    break;
-                case STRING:
-                    sqlite3_bind_text(*stmt, index, fieldValue.mValue.str_value.c_str(), -1,
-                                      SQLITE_STATIC);
-                    break;
-                case FLOAT:
-                    sqlite3_bind_double(*stmt, index, fieldValue.mValue.float_value);
-                    break;
-                default:
-                    // Byte array fields are not supported.
-                    break;
+    sqlite3_bind_int(stmt, 1, events.getAtomId(row));
+    sqlite3_bind_int64(stmt, 2, events.getElapsedTimestampNs(row));
+    sqlite3_bind_int64(stmt, 3, events.getWallClockTimestampNs(row));
+    const vector<FieldColumn>& fieldColumns = events.getFieldColumns();
+    for (size_t i = 0; i < fieldColumns.size(); ++i) {
+        const int32_t index = i + 4;
+        switch (fieldColumns[i].type) {
+            case INT:
+                sqlite3_bind_int(stmt, index, events.getInt(i, row));
+                break;
+            case LONG:
+                sqlite3_bind_int64(stmt, index, events.getLong(i, row));
+                break;
+            case STRING: {
+                size_t length;
+                const char* value = events.getString(i, row, &length);
+                sqlite3_bind_text(stmt, index, value, length, SQLITE_STATIC);
+                break;
             }
-            ++index;
+            case FLOAT:
+                sqlite3_bind_double(stmt, index, events.getFloat(i, row));
+                break;
+            default:
+                break;
         }
     }
-    return true;
 }
 
-bool insert(const ConfigKey& key, const int64_t metricId, const vector<LogEvent>& events,
-            string& error) {
-    const string dbName = getDbName(key);
-    sqlite3* db;
-    if (sqlite3_open(dbName.c_str(), &db) != SQLITE_OK) {
+/* Inserts the events one row at a time in a single transaction, with the insert of stmts for
+ * their number of columns. The prepared insert is added to stmts if missing.
+ */
+static bool insertInTransaction(sqlite3* db, const int64_t metricId,
+                                const RestrictedEventColumns& events, InsertStmtCache* stmts,
+                                string& error) {
+    if (events.empty()) {
+        return true;
+    }
+    const int32_t paramCount = 3 + events.getFieldColumns().size();  // Atom id and timestamps.
+    sqlite3_stmt*& stmt = (*stmts)[std::make_pair(metricId, paramCount)];
+    if (stmt == nullptr && !prepareInsertStmt(db, metricId, paramCount, &stmt, error)) {
+        stmts->erase(std::make_pair(metricId, paramCount));
+        return false;
+    }
+    if (sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK) {
         error = sqlite3_errmsg(db);
-        sqlite3_close(db);
         return false;
     }
-    bool success = insert(db, metricId, events, error);
-    sqlite3_close(db);
-    return success;
+    for (size_t row = 0; row < events.size(); ++row) {
+        bindInsertStmt(stmt, events, row);
+        const bool done = sqlite3_step(stmt) == SQLITE_DONE;
+        if (!done) {
+            error = sqlite3_errmsg(db);
+        }
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        if (!done) {
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            return false;
+        }
+    }
+    if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        error = sqlite3_errmsg(db);
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
 }
 
-bool insert(sqlite3* db, const int64_t metricId, const vector<LogEvent>& events, string& error) {
-    sqlite3_stmt* stmt = nullptr;
-    if (!getInsertSqlStmt(db, &stmt, metricId, events, error)) {
-        ALOGW("Failed to generate prepared sql insert query %s", error.c_str());
-        sqlite3_finalize(stmt);
+// Stores the events by column. Returns false if they do not all have the same field columns.
+static bool toColumns(const vector<LogEvent>& events, RestrictedEventColumns* columns,
+                      string& error) {
+    for (const LogEvent& event : events) {
+        if (!columns->append(event)) {
+            error = "events have different fields";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool insert(const ConfigKey& key, const int64_t metricId, const RestrictedEventColumns& events,
+            string& error) {
+    std::shared_ptr<DbConnection> connection = getDbConnection(key);
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    sqlite3* db = getWritableDbLocked(connection.get(), key, &error);
+    if (db == nullptr) {
         return false;
     }
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        error = sqlite3_errmsg(db);
+    if (!insertInTransaction(db, metricId, events, &connection->insertStmts, error)) {
         ALOGW("Failed to insert data to db: %s", error.c_str());
-        sqlite3_finalize(stmt);
         return false;
     }
-    sqlite3_finalize(stmt);
     return true;
 }
 
+bool insert(const ConfigKey& key, const int64_t metricId, const vector<LogEvent>& events,
+            string& error) {
+    RestrictedEventColumns columns;
+    return toColumns(events, &columns, error) && insert(key, metricId, columns, error);
+}
+
+bool insert(sqlite3* db, const int64_t metricId, const vector<LogEvent>& events, string& error) {
+    RestrictedEventColumns columns;
+    if (!toColumns(events, &columns, error)) {
+        return false;
+    }
+    InsertStmtCache stmts;
+    const bool success = insertInTransaction(db, metricId, columns, &stmts, error);
+    finalizeInsertStmts(&stmts);
+    if (!success) {
+        ALOGW("Failed to insert data to db: %s", error.c_str());
+    }
+    return success;
+}
+
 bool query(const ConfigKey& key, const string& zSql, vector<vector<string>>& rows,
            vector<int32_t>& columnTypes, vector<string>& columnNames, string& err) {
-    const string dbName = getDbName(key);
-    sqlite3* db;
-    if (sqlite3_open_v2(dbName.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
-        err = sqlite3_errmsg(db);
-        sqlite3_close(db);
-        return false;
+    std::shared_ptr<DbConnection> connection = getDbConnection(key);
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    if (connection->readOnlyDb == nullptr) {
+        if (connection->closed) {
+            err = "db was deleted";
+            return false;
+        }
+        sqlite3* readOnlyDb;
+        if (sqlite3_open_v2(getDbName(key).c_str(), &readOnlyDb, SQLITE_OPEN_READONLY,
+                            nullptr) != SQLITE_OK) {
+            err = sqlite3_errmsg(readOnlyDb);
+            sqlite3_close(readOnlyDb);
+            return false;
+        }
+        connection->readOnlyDb = readOnlyDb;
     }
+    sqlite3* db = connection->readOnlyDb;
     sqlite3_stmt* stmt;
     if (sqlite3_prepare_v2(db, zSql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
         err = sqlite3_errmsg(db);
         sqlite3_finalize(stmt);
-        sqlite3_close(db);
         return false;
     }
     int result = sqlite3_step(stmt);
@@ -351,13 +532,12 @@ bool query(const ConfigKey& key, const string& zSql, vector<vector<string>>& row
         firstIter = false;
         result = sqlite3_step(stmt);
     }
-    sqlite3_finalize(stmt);
     if (result != SQLITE_DONE) {
         err = sqlite3_errmsg(db);
-        sqlite3_close(db);
+        sqlite3_finalize(stmt);
         return false;
     }
-    sqlite3_close(db);
+    sqlite3_finalize(stmt);
     return true;
 }
 
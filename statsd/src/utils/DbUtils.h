@@ -19,6 +19,7 @@
 
 #include "config/ConfigKey.h"
 #include "logd/LogEvent.h"
+#include "utils/RestrictedEventColumns.h"
 
 using std::string;
 using std::vector;
@@ -41,15 +42,25 @@ string reformatMetricId(const int64_t metricId);
 /* Creates a new data table for a specified metric if one does not yet exist. */
 bool createTableIfNeeded(const ConfigKey& key, int64_t metricId, const LogEvent& event);
 
+/* Creates a new data table for the fields of the events if one does not yet exist. */
+bool createTableIfNeeded(const ConfigKey& key, int64_t metricId,
+                         const RestrictedEventColumns& events);
+
 /* Checks whether the table schema for the given metric matches the event.
  * Returns true if the table has not yet been created.
  */
 bool isEventCompatible(const ConfigKey& key, int64_t metricId, const LogEvent& event);
 
+/* Checks whether the table schema for the given metric matches the fields of the events.
+ * Returns true if the table has not yet been created.
+ */
+bool isEventCompatible(const ConfigKey& key, int64_t metricId,
+                       const RestrictedEventColumns& events);
+
 /* Deletes a data table for the specified metric. */
 bool deleteTable(const ConfigKey& key, int64_t metricId);
 
-/* Deletes the SQLite db data file. */
+/* Closes the connection to the SQLite db and deletes its data files. */
 void deleteDb(const ConfigKey& key);
 
 /* Gets a handle to the sqlite db. You must call closeDb to free the allocated memory.
@@ -60,16 +71,25 @@ sqlite3* getDb(const ConfigKey& key);
 /* Closes the handle to the sqlite db. */
 void closeDb(sqlite3* db);
 
-/* Inserts new data into the specified metric data table.
- * A temp sqlite handle is created using the ConfigKey.
+/* Inserts new data into the specified metric data table, in a single transaction.
+ * Uses a connection to the db of the ConfigKey that is kept open, in WAL mode, along with its
+ * prepared insert statements.
+ */
+bool insert(const ConfigKey& key, int64_t metricId, const RestrictedEventColumns& events,
+            string& error);
+
+/* Inserts new data into the specified metric data table, like above. Fails if the events do not
+ * all have the same fields.
  */
 bool insert(const ConfigKey& key, int64_t metricId, const vector<LogEvent>& events, string& error);
 
-/* Inserts new data into the specified sqlite db handle. */
+/* Inserts new data into the specified sqlite db handle, in a single transaction. Fails if the
+ * events do not all have the same fields.
+ */
 bool insert(sqlite3* db, int64_t metricId, const vector<LogEvent>& events, string& error);
 
 /* Executes a sql query on the specified SQLite db.
- * A temp sqlite handle is created using the ConfigKey.
+ * Uses a read-only connection to the db of the ConfigKey that is kept open.
  */
 bool query(const ConfigKey& key, const string& zSql, vector<vector<string>>& rows,
            vector<int32_t>& columnTypes, vector<string>& columnNames, string& err);
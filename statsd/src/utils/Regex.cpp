@@ -56,7 +56,7 @@ unique_ptr<Regex> Regex::create(const string& pattern) {
     }
 }
 
-bool Regex::replace(string& str, const string& replacement) {
+bool Regex::replace(string& str, const string& replacement) const {
     regmatch_t match;
     int status = regexec(&mImpl, str.c_str(), 1 /* nmatch */, &match /* pmatch */, 0 /* flags */);
 
@@ -37,7 +37,7 @@ public:
 
     // Looks for a regex match in str and replaces the matched portion with replacement in-place.
     // Returns true if there was a match, false otherwise.
-    bool replace(std::string& str, const std::string& replacement);
+    bool replace(std::string& str, const std::string& replacement) const;
 
 private:
     regex_t mImpl;
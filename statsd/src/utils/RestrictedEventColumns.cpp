@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/RestrictedEventColumns.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+static bool isFieldColumn(const FieldValue& fieldValue) {
+    if (fieldValue.mField.getDepth() > 0) {
+        // Repeated fields are not supported.
+        return false;
+    }
+    switch (fieldValue.mValue.getType()) {
+        case INT:
+        case LONG:
+        case FLOAT:
+        case STRING:
+            return true;
+        default:
+            // Byte array fields are not supported.
+            return false;
+    }
+}
+
+std::vector<RestrictedEventColumns::FieldColumn> RestrictedEventColumns::getFieldColumns(
+        const LogEvent& event) {
+    std::vector<FieldColumn> fieldColumns;
+    for (const FieldValue& fieldValue : event.getValues()) {
+        if (isFieldColumn(fieldValue)) {
+            fieldColumns.push_back(
+                    {fieldValue.mField.getPosAtDepth(0), fieldValue.mValue.getType()});
+        }
+    }
+    return fieldColumns;
+}
+
+bool RestrictedEventColumns::append(const LogEvent& event) {
+    if (empty()) {
+        mFieldColumns = getFieldColumns(event);
+        mValues.assign(mFieldColumns.size(), Values());
+    } else {
+        size_t i = 0;
+        for (const FieldValue& fieldValue : event.getValues()) {
+            if (!isFieldColumn(fieldValue)) {
+                continue;
+            }
+            if (i == mFieldColumns.size() ||
+                mFieldColumns[i].position != fieldValue.mField.getPosAtDepth(0) ||
+                mFieldColumns[i].type != fieldValue.mValue.getType()) {
+                return false;
+            }
+            i++;
+        }
+        if (i != mFieldColumns.size()) {
+            return false;
+        }
+    }
+
+    mAtomIds.push_back(event.GetTagId());
+    mElapsedTimestampsNs.push_back(event.GetElapsedTimestampNs());
+    mWallClockTimestampsNs.push_back(event.GetLogdTimestampNs());
+    size_t i = 0;
+    for (const FieldValue& fieldValue : event.getValues()) {
+        if (!isFieldColumn(fieldValue)) {
+            continue;
+        }
+        Values& values = mValues[i++];
+        switch (fieldValue.mValue.getType()) {
+            case INT:
+                values.ints.push_back(fieldValue.mValue.int_value);
+                break;
+            case LONG:
+                values.longs.push_back(fieldValue.mValue.long_value);
+                break;
+            case FLOAT:
+                values.floats.push_back(fieldValue.mValue.float_value);
+                break;
+            case STRING:
+                // Stored as a C string, up to its first null char.
+                values.strings.append(fieldValue.mValue.getCString());
+                values.stringEnds.push_back(values.strings.size());
+                values.strings.push_back('\0');
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+void RestrictedEventColumns::clear() {
+    *this = RestrictedEventColumns();
+}
+
+size_t RestrictedEventColumns::getByteSize() const {
+    size_t byteSize = size() * (sizeof(int32_t) + 2 * sizeof(int64_t));
+    for (const Values& values : mValues) {
+        byteSize += values.ints.size() * sizeof(int32_t) + values.longs.size() * sizeof(int64_t) +
+                    values.floats.size() * sizeof(float) + values.strings.size() +
+                    values.stringEnds.size() * sizeof(uint32_t);
+    }
+    return byteSize;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
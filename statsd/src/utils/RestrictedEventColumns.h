@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "FieldValue.h"
+#include "logd/LogEvent.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Events of a restricted metric waiting to be inserted into its data table, stored by column.
+ *
+ * Only what the table stores is kept: the atom id, the timestamps and the top level fields that
+ * are not byte arrays, each field in a typed column. This takes a fraction of the memory of
+ * copies of the LogEvents, and the inserts bind the columns without walking FieldValues again.
+ *
+ * All the events share the field columns of the first event appended.
+ *
+ * Not thread-safe.
+ */
+class RestrictedEventColumns {
+public:
+    // A top level field of the events, stored in the field_<position> column of the table.
+    struct FieldColumn {
+        int32_t position;
+
+        // INT, LONG, FLOAT or STRING.
+        Type type;
+
+        bool operator==(const FieldColumn& that) const {
+            return position == that.position && type == that.type;
+        }
+    };
+
+    // Returns the field columns of the table storing the event, in the order of its values.
+    static std::vector<FieldColumn> getFieldColumns(const LogEvent& event);
+
+    /**
+     * Appends the event. Returns false, leaving the columns unchanged, if its field columns
+     * differ from the ones of the events already appended.
+     */
+    bool append(const LogEvent& event);
+
+    // Removes all the events and releases the memory they use.
+    void clear();
+
+    inline size_t size() const {
+        return mAtomIds.size();
+    }
+
+    inline bool empty() const {
+        return mAtomIds.empty();
+    }
+
+    inline const std::vector<FieldColumn>& getFieldColumns() const {
+        return mFieldColumns;
+    }
+
+    // Returns the number of bytes used by the values of the events.
+    size_t getByteSize() const;
+
+    inline int32_t getAtomId(size_t row) const {
+        return mAtomIds[row];
+    }
+
+    inline int64_t getElapsedTimestampNs(size_t row) const {
+        return mElapsedTimestampsNs[row];
+    }
+
+    inline int64_t getWallClockTimestampNs(size_t row) const {
+        return mWallClockTimestampsNs[row];
+    }
+
+    // The getters of the values of field column i. They must match the type of the column.
+    inline int32_t getInt(size_t i, size_t row) const {
+        return mValues[i].ints[row];
+    }
+
+    inline int64_t getLong(size_t i, size_t row) const {
+        return mValues[i].longs[row];
+    }
+
+    inline float getFloat(size_t i, size_t row) const {
+        return mValues[i].floats[row];
+    }
+
+    // Returns a null terminated string, and its length in *length.
+    inline const char* getString(size_t i, size_t row, size_t* length) const {
+        const Values& values = mValues[i];
+        const uint32_t start = row == 0 ? 0 : values.stringEnds[row - 1] + 1;
+        *length = values.stringEnds[row] - start;
+        return values.strings.data() + start;
+    }
+
+private:
+    // Only the vector matching the type of the column is used.
+    struct Values {
+        std::vector<int32_t> ints;
+        std::vector<int64_t> longs;
+        std::vector<float> floats;
+
+        // The null terminated strings, one after the other, and the offsets of their terminators.
+        std::string strings;
+        std::vector<uint32_t> stringEnds;
+    };
+
+    std::vector<FieldColumn> mFieldColumns;
+
+    std::vector<int32_t> mAtomIds;
+
+    std::vector<int64_t> mElapsedTimestampsNs;
+
+    std::vector<int64_t> mWallClockTimestampsNs;
+
+    // The values of mFieldColumns, in the same order.
+    std::vector<Values> mValues;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
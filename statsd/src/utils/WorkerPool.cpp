@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WorkerPool.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::function;
+using std::lock_guard;
+using std::unique_lock;
+
+WorkerPool::WorkerPool(const size_t threadCount) {
+    mThreads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        mThreads.emplace_back([this] { workerLoop(); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard<std::mutex> lock(mMutex);
+        mStopRequested = true;
+    }
+    mWorkAvailable.notify_all();
+    for (std::thread& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::parallelFor(const size_t count, const function<void(size_t)>& task) {
+    if (mThreads.empty() || count <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        lock_guard<std::mutex> lock(mMutex);
+        mTask = &task;
+        mCount = count;
+        mNextIndex.store(0, std::memory_order_relaxed);
+        mGeneration++;
+    }
+    mWorkAvailable.notify_all();
+
+    runIterations(task, count);
+
+    // Every iteration is claimed. Wait for the workers still running one. Workers waking up
+    // after this see no loop and go back to sleep.
+    unique_lock<std::mutex> lock(mMutex);
+    mWorkDone.wait(lock, [this] { return mActiveWorkers == 0; });
+    mTask = nullptr;
+}
+
+void WorkerPool::workerLoop() {
+    uint64_t lastGeneration = 0;
+    unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mWorkAvailable.wait(lock, [this, lastGeneration] {
+            return mStopRequested || (mTask != nullptr && mGeneration != lastGeneration);
+        });
+        if (mStopRequested) {
+            return;
+        }
+        lastGeneration = mGeneration;
+        const function<void(size_t)>& task = *mTask;
+        const size_t count = mCount;
+        mActiveWorkers++;
+        lock.unlock();
+
+        runIterations(task, count);
+
+        lock.lock();
+        mActiveWorkers--;
+        if (mActiveWorkers == 0) {
+            mWorkDone.notify_one();
+        }
+    }
+}
+
+void WorkerPool::runIterations(const function<void(size_t)>& task, const size_t count) {
+    for (size_t i = mNextIndex.fetch_add(1, std::memory_order_relaxed); i < count;
+         i = mNextIndex.fetch_add(1, std::memory_order_relaxed)) {
+        task(i);
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
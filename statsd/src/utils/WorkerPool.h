@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * A fixed set of threads running the iterations of a loop in parallel.
+ *
+ * The calling thread takes part in the work, so a pool of N threads runs up to N + 1 iterations
+ * at the same time. Worker threads sleep between loops.
+ */
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threadCount);
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    ~WorkerPool();
+
+    /**
+     * Calls task(i) for every i in [0, count), in no particular order, and returns once all of
+     * the calls returned. Everything written by the calls is visible to the caller on return.
+     * Must not be called concurrently or from within a task.
+     */
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    size_t getThreadCount() const {
+        return mThreads.size();
+    }
+
+private:
+    void workerLoop();
+
+    // Runs iterations of the current loop until all of them are claimed.
+    void runIterations(const std::function<void(size_t)>& task, size_t count);
+
+    std::vector<std::thread> mThreads;
+
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mWorkDone;
+
+    // The current loop. Guarded by mMutex. mTask is null when there is no loop running.
+    const std::function<void(size_t)>* mTask = nullptr;
+    size_t mCount = 0;
+    uint64_t mGeneration = 0;
+
+    // Number of worker threads running iterations of the current loop. Guarded by mMutex.
+    size_t mActiveWorkers = 0;
+
+    bool mStopRequested = false;
+
+    // Next iteration of the current loop to be claimed.
+    std::atomic<size_t> mNextIndex{0};
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "src/EncodedFields.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "src/HashableDimensionKey.h"
+#include "tests/statsd_test_util.h"
+
+#ifdef __ANDROID__
+
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const int32_t kTagId = 10;
+
+// An attribution chain of nodeCount nodes, followed by a repeated int field and an int field.
+vector<FieldValue> createValues(int nodeCount) {
+    vector<FieldValue> values;
+    for (int i = 1; i <= nodeCount; i++) {
+        for (int j = 1; j <= 2; j++) {
+            int32_t pos[] = {1, i, j};
+            Field field(kTagId, pos, 2);
+            if (i == nodeCount) {
+                field.decorateLastPos(1);
+            }
+            values.emplace_back(field, Value((int32_t)(1000 * i + j)));
+        }
+    }
+    for (int i = 1; i <= 3; i++) {
+        int32_t pos[] = {2, i, 0};
+        Field field(kTagId, pos, 1);
+        if (i == 3) {
+            field.decorateLastPos(1);
+        }
+        values.emplace_back(field, Value((int32_t)i));
+    }
+    int32_t pos[] = {3, 0, 0};
+    values.emplace_back(Field(kTagId, pos, 0), Value((int32_t)42));
+    return values;
+}
+
+vector<Matcher> createMatchers(int tagId) {
+    FieldMatcher fieldMatcher;
+    fieldMatcher.set_field(tagId);
+    for (const Position position : {Position::FIRST, Position::LAST, Position::ALL}) {
+        FieldMatcher* attribution = fieldMatcher.add_child();
+        attribution->set_field(1);
+        attribution->set_position(position);
+        attribution->add_child()->set_field(1);
+        attribution->add_child()->set_field(2);
+
+        FieldMatcher* repeated = fieldMatcher.add_child();
+        repeated->set_field(2);
+        repeated->set_position(position);
+    }
+    fieldMatcher.add_child()->set_field(3);
+    fieldMatcher.add_child()->set_field(4);
+
+    vector<Matcher> matchers;
+    translateFieldMatcher(fieldMatcher, &matchers);
+    return matchers;
+}
+
+}  // anonymous namespace
+
+TEST(EncodedFieldsTest, TestMatchesLikeFieldMatches) {
+    const vector<Matcher> matchers = createMatchers(kTagId);
+    for (const int nodeCount : {0, 1, 2, 5, 60, 126}) {
+        const vector<FieldValue> values = createValues(nodeCount);
+        EncodedFields fields;
+        ASSERT_TRUE(fields.init(values));
+        EXPECT_EQ(values.size(), fields.size());
+
+        for (const Matcher& matcher : matchers) {
+            uint64_t bitmap[EncodedFields::kBitmapWords];
+            fields.match(matcher, bitmap);
+            for (size_t i = 0; i < EncodedFields::kMaxFields; i++) {
+                const bool expected = i < values.size() && values[i].mField.matches(matcher);
+                EXPECT_EQ(expected, ((bitmap[i / 64] >> (i % 64)) & 1) != 0)
+                        << "value " << i << " of " << values.size() << ", matcher "
+                        << matcher.mMatcher.getField();
+            }
+        }
+    }
+}
+
+TEST(EncodedFieldsTest, TestOtherTag) {
+    const vector<FieldValue> values = createValues(3);
+    EncodedFields fields;
+    ASSERT_TRUE(fields.init(values));
+    for (const Matcher& matcher : createMatchers(kTagId + 1)) {
+        uint64_t bitmap[EncodedFields::kBitmapWords];
+        fields.match(matcher, bitmap);
+        EXPECT_EQ(0u, bitmap[0]);
+    }
+}
+
+TEST(EncodedFieldsTest, TestInitFailures) {
+    EncodedFields fields;
+    EXPECT_FALSE(fields.init({}));
+
+    vector<FieldValue> values = createValues(3);
+    values.push_back(FieldValue(Field(kTagId + 1, getSimpleField(1)), Value((int32_t)1)));
+    EXPECT_FALSE(fields.init(values));
+
+    EXPECT_FALSE(fields.init(createValues(EncodedFields::kMaxFields)));
+}
+
+TEST(EncodedFieldsTest, TestFilterValues) {
+    const vector<Matcher> matchers = createMatchers(kTagId);
+    const vector<FieldValue> values = createValues(8);
+    ASSERT_TRUE(shouldUseEncodedFields(matchers.size(), values.size()));
+
+    // The same key as matching every value against every matcher in order.
+    HashableDimensionKey expectedKey;
+    for (const FieldValue& value : values) {
+        for (const Matcher& matcher : matchers) {
+            if (value.mField.matches(matcher)) {
+                FieldValue output = value;
+                output.mField.setField(value.mField.getField() & matcher.mMask);
+                expectedKey.addValue(output);
+            }
+        }
+    }
+
+    HashableDimensionKey key;
+    EXPECT_TRUE(filterValues(matchers, values, &key));
+    EXPECT_EQ(expectedKey, key);
+    EXPECT_EQ(expectedKey.getValues().size(), key.getValues().size());
+
+    HashableDimensionKey key2;
+    const vector<Matcher> valueMatchers = {matchers[0], matchers.back()};
+    vector<int> valueIndices(valueMatchers.size(), -1);
+    EXPECT_FALSE(filterValues(matchers, valueMatchers, values, key2, valueIndices));
+    EXPECT_EQ(expectedKey, key2);
+    EXPECT_EQ(0, valueIndices[0]);
+    EXPECT_EQ(-1, valueIndices[1]);  // Field 4 is not in the values.
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -142,20 +142,20 @@ TEST(AtomMatcherTest, TestFilter_ALL) {
     EXPECT_EQ((int32_t)0x02010101, output.getValues()[0].mField.getField());
     EXPECT_EQ((int32_t)1111, output.getValues()[0].mValue.int_value);
     EXPECT_EQ((int32_t)0x02010102, output.getValues()[1].mField.getField());
-    EXPECT_EQ("location1", output.getValues()[1].mValue.str_value);
+    EXPECT_EQ("location1", output.getValues()[1].mValue.getString());
 
     EXPECT_EQ((int32_t)0x02010201, output.getValues()[2].mField.getField());
     EXPECT_EQ((int32_t)2222, output.getValues()[2].mValue.int_value);
     EXPECT_EQ((int32_t)0x02010202, output.getValues()[3].mField.getField());
-    EXPECT_EQ("location2", output.getValues()[3].mValue.str_value);
+    EXPECT_EQ("location2", output.getValues()[3].mValue.getString());
 
     EXPECT_EQ((int32_t)0x02010301, output.getValues()[4].mField.getField());
     EXPECT_EQ((int32_t)3333, output.getValues()[4].mValue.int_value);
     EXPECT_EQ((int32_t)0x02010302, output.getValues()[5].mField.getField());
-    EXPECT_EQ("location3", output.getValues()[5].mValue.str_value);
+    EXPECT_EQ("location3", output.getValues()[5].mValue.getString());
 
     EXPECT_EQ((int32_t)0x00020000, output.getValues()[6].mField.getField());
-    EXPECT_EQ("some value", output.getValues()[6].mValue.str_value);
+    EXPECT_EQ("some value", output.getValues()[6].mValue.getString());
 }
 
 TEST(AtomMatcherTest, TestFilter_FIRST) {
@@ -187,9 +187,9 @@ TEST(AtomMatcherTest, TestFilter_FIRST) {
     EXPECT_EQ((int32_t)0x02010101, output.getValues()[0].mField.getField());
     EXPECT_EQ((int32_t)1111, output.getValues()[0].mValue.int_value);
     EXPECT_EQ((int32_t)0x02010102, output.getValues()[1].mField.getField());
-    EXPECT_EQ("location1", output.getValues()[1].mValue.str_value);
+    EXPECT_EQ("location1", output.getValues()[1].mValue.getString());
     EXPECT_EQ((int32_t)0x00020000, output.getValues()[2].mField.getField());
-    EXPECT_EQ("some value", output.getValues()[2].mValue.str_value);
+    EXPECT_EQ("some value", output.getValues()[2].mValue.getString());
 };
 
 TEST(AtomMatcherTest, TestFilterRepeated_FIRST) {
@@ -281,7 +281,7 @@ TEST(AtomMatcherTest, TestFilterWithOneMatcher) {
 
     EXPECT_TRUE(filterValues(matchers[0], event.getValues(), &value));
     EXPECT_EQ((int32_t)0x20000, value.mField.getField());
-    EXPECT_EQ("some value", value.mValue.str_value);
+    EXPECT_EQ("some value", value.mValue.getString());
 }
 
 TEST(AtomMatcherTest, TestFilterWithOneMatcher_PositionFIRST) {
@@ -719,10 +719,10 @@ TEST(AtomMatcherTest, TestSubscriberDimensionWrite) {
     ASSERT_EQ(attributionChainParcel.tupleValue.size(), 2);
     checkAttributionNodeInDimensionsValueParcel(attributionChainParcel.tupleValue[0],
                                                 /*nodeDepthInAttributionChain=*/1,
-                                                value1.int_value, value2.str_value);
+                                                value1.int_value, std::string(value2.getString()));
     checkAttributionNodeInDimensionsValueParcel(attributionChainParcel.tupleValue[1],
                                                 /*nodeDepthInAttributionChain=*/2,
-                                                value3.int_value, value4.str_value);
+                                                value3.int_value, std::string(value4.getString()));
 
     // Check that the float is populated correctly
     StatsDimensionsValueParcel floatParcel = rootParcel.tupleValue[1];
@@ -1318,6 +1318,99 @@ TEST(FieldValueTest, TestShouldKeepSampleByteArray) {
     EXPECT_TRUE(shouldKeepSample(fieldValue2, shardOffset, shardCount));
 }
 
+TEST(FieldValueTest, TestValueInlineString) {
+    const string str(Value::kMaxInlineBytes, 'a');
+    Value value(str);
+    EXPECT_EQ(STRING, value.getType());
+    EXPECT_EQ(str, value.getString());
+    EXPECT_STREQ(str.c_str(), value.getCString());
+    EXPECT_EQ(str.size(), value.getSize());
+
+    // Inline contents are copied.
+    Value copy(value);
+    EXPECT_EQ(value, copy);
+    EXPECT_NE(value.getString().data(), copy.getString().data());
+
+    Value empty("");
+    EXPECT_TRUE(empty.isZero());
+    EXPECT_STREQ("", empty.getCString());
+}
+
+TEST(FieldValueTest, TestValueSharedString) {
+    const string str(Value::kMaxInlineBytes + 1, 'a');
+    Value value(str);
+    EXPECT_EQ(STRING, value.getType());
+    EXPECT_EQ(str, value.getString());
+    EXPECT_STREQ(str.c_str(), value.getCString());
+
+    // Long contents are shared between copies.
+    Value copy(value);
+    EXPECT_EQ(value, copy);
+    EXPECT_EQ(value.getString().data(), copy.getString().data());
+
+    Value assigned;
+    assigned = copy;
+    EXPECT_EQ(value.getString().data(), assigned.getString().data());
+
+    // The remaining copies keep the contents alive.
+    value.setInt(1);
+    copy.setString("short");
+    EXPECT_EQ(str, assigned.getString());
+
+    Value moved(std::move(assigned));
+    EXPECT_EQ(str, moved.getString());
+    EXPECT_EQ(UNKNOWN, assigned.getType());
+}
+
+TEST(FieldValueTest, TestValueAssignment) {
+    const string longStr(40, 'b');
+    Value value(longStr);
+
+    // Self assignment keeps the contents.
+    Value& self = value;
+    value = self;
+    EXPECT_EQ(longStr, value.getString());
+
+    // Setting a value from its own contents.
+    value.setString(value.getString().substr(1));
+    EXPECT_EQ(longStr.substr(1), value.getString());
+
+    value = Value((int64_t)3);
+    EXPECT_EQ(LONG, value.getType());
+    EXPECT_EQ(3, value.long_value);
+
+    value = Value("str");
+    EXPECT_EQ("str", value.getString());
+
+    vector<Value> values;
+    for (int i = 0; i < 20; i++) {
+        values.push_back(Value(longStr + to_string(i)));
+    }
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ(longStr + to_string(i), values[i].getString());
+    }
+}
+
+TEST(FieldValueTest, TestValueStorage) {
+    const vector<uint8_t> shortBytes = {0x00, 0xff, 0x10};
+    const vector<uint8_t> longBytes(30, 0x80);
+    Value shortValue(shortBytes);
+    Value longValue(longBytes);
+
+    EXPECT_EQ(STORAGE, shortValue.getType());
+    EXPECT_EQ(shortBytes, shortValue.getStorage());
+    EXPECT_EQ(shortBytes.size(), shortValue.getStorageSize());
+    EXPECT_EQ(longBytes, longValue.getStorage());
+    EXPECT_EQ(longBytes.size(), longValue.getSize());
+
+    // Bytes compare as unsigned.
+    EXPECT_EQ(shortBytes < longBytes, shortValue < longValue);
+    EXPECT_TRUE(Value(vector<uint8_t>{0x7f}) < Value(vector<uint8_t>{0x80}));
+
+    // Same contents with a different type are not equal.
+    EXPECT_NE(Value(string("\x01")), Value(vector<uint8_t>{0x01}));
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
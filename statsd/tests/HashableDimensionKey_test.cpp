@@ -164,6 +164,92 @@ TEST(HashableDimensionKeyTest, TestHashDimensionDouble) {
               std::hash<HashableDimensionKey>{}(dimKey2));
 }
 
+/**
+ * Test that copies of a key share their values until one of them is modified.
+ */
+TEST(HashableDimensionKeyTest, TestCopyOnWrite) {
+    HashableDimensionKey key;
+    getUidProcessKey(1000, &key);
+    const size_t hash = std::hash<HashableDimensionKey>{}(key);
+
+    HashableDimensionKey copy = key;
+    EXPECT_TRUE(copy.sharesValuesWith(key));
+    EXPECT_EQ(key, copy);
+
+    copy.mutableValue(0)->mValue.setInt(1001);
+    EXPECT_FALSE(copy.sharesValuesWith(key));
+    EXPECT_EQ(1000, key.getValues()[0].mValue.int_value);
+    EXPECT_EQ(1001, copy.getValues()[0].mValue.int_value);
+    EXPECT_NE(key, copy);
+    EXPECT_EQ(hash, std::hash<HashableDimensionKey>{}(key));
+
+    // The cached hash of a modified key is recomputed.
+    HashableDimensionKey expected;
+    getUidProcessKey(1001, &expected);
+    EXPECT_EQ(expected.getHash(), copy.getHash());
+    EXPECT_EQ(expected, copy);
+
+    copy.addValue(key.getValues()[0]);
+    EXPECT_NE(expected, copy);
+    EXPECT_NE(expected.getHash(), copy.getHash());
+}
+
+TEST(HashableDimensionKeyTest, TestPoolIntern) {
+    HashableDimensionKeyPool pool;
+    HashableDimensionKey key1;
+    getUidProcessKey(1000, &key1);
+    HashableDimensionKey key2;
+    getUidProcessKey(1000, &key2);
+    HashableDimensionKey key3;
+    getUidProcessKey(1001, &key3);
+
+    const HashableDimensionKey pooledKey1 = pool.intern(key1);
+    const HashableDimensionKey pooledKey2 = pool.intern(key2);
+    const HashableDimensionKey pooledKey3 = pool.intern(key3);
+    EXPECT_EQ(2u, pool.size());
+    EXPECT_TRUE(pooledKey1.sharesValuesWith(key1));
+    EXPECT_TRUE(pooledKey2.sharesValuesWith(key1));
+    EXPECT_FALSE(pooledKey2.sharesValuesWith(key2));
+    EXPECT_EQ(key2, pooledKey2);
+    EXPECT_EQ(key3, pooledKey3);
+
+    // Keys without values are not pooled.
+    EXPECT_EQ(DEFAULT_DIMENSION_KEY, pool.intern(DEFAULT_DIMENSION_KEY));
+    EXPECT_EQ(2u, pool.size());
+}
+
+TEST(HashableDimensionKeyTest, TestPoolPrune) {
+    HashableDimensionKeyPool pool;
+    HashableDimensionKey heldKey;
+    {
+        HashableDimensionKey key1;
+        getUidProcessKey(1000, &key1);
+        heldKey = pool.intern(key1);
+        HashableDimensionKey key2;
+        getUidProcessKey(1001, &key2);
+        pool.intern(key2);
+    }
+    EXPECT_EQ(2u, pool.size());
+
+    pool.prune();
+    EXPECT_EQ(1u, pool.size());
+
+    HashableDimensionKey key;
+    getUidProcessKey(1000, &key);
+    EXPECT_TRUE(pool.intern(key).sharesValuesWith(heldKey));
+}
+
+TEST(HashableDimensionKeyTest, TestPoolPrunesWhenGrowing) {
+    HashableDimensionKeyPool pool;
+    for (int uid = 0; uid < 1000; uid++) {
+        HashableDimensionKey key;
+        getUidProcessKey(uid, &key);
+        pool.intern(key);
+    }
+    // Unreferenced keys are dropped as the pool grows.
+    EXPECT_LT(pool.size(), 100u);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -1527,12 +1527,12 @@ TEST(AtomMatcherTest, TestStringReplaceRoot) {
     const vector<FieldValue>& fieldValues = transformedEvent->getValues();
     ASSERT_EQ(fieldValues.size(), 7);
     EXPECT_EQ(fieldValues[0].mValue.int_value, 1111);
-    EXPECT_EQ(fieldValues[1].mValue.str_value, "location1");
+    EXPECT_EQ(fieldValues[1].mValue.getString(), "location1");
     EXPECT_EQ(fieldValues[2].mValue.int_value, 2222);
-    EXPECT_EQ(fieldValues[3].mValue.str_value, "location2");
+    EXPECT_EQ(fieldValues[3].mValue.getString(), "location2");
     EXPECT_EQ(fieldValues[4].mValue.int_value, 3333);
-    EXPECT_EQ(fieldValues[5].mValue.str_value, "location3");
-    EXPECT_EQ(fieldValues[6].mValue.str_value, "some value");
+    EXPECT_EQ(fieldValues[5].mValue.getString(), "location3");
+    EXPECT_EQ(fieldValues[6].mValue.getString(), "some value");
 }
 
 TEST(AtomMatcherTest, TestStringReplaceAttributionTagFirst) {
@@ -1564,12 +1564,12 @@ TEST(AtomMatcherTest, TestStringReplaceAttributionTagFirst) {
     const vector<FieldValue>& fieldValues = transformedEvent->getValues();
     ASSERT_EQ(fieldValues.size(), 7);
     EXPECT_EQ(fieldValues[0].mValue.int_value, 1111);
-    EXPECT_EQ(fieldValues[1].mValue.str_value, "location");
+    EXPECT_EQ(fieldValues[1].mValue.getString(), "location");
     EXPECT_EQ(fieldValues[2].mValue.int_value, 2222);
-    EXPECT_EQ(fieldValues[3].mValue.str_value, "location2");
+    EXPECT_EQ(fieldValues[3].mValue.getString(), "location2");
     EXPECT_EQ(fieldValues[4].mValue.int_value, 3333);
-    EXPECT_EQ(fieldValues[5].mValue.str_value, "location3");
-    EXPECT_EQ(fieldValues[6].mValue.str_value, "some value123");
+    EXPECT_EQ(fieldValues[5].mValue.getString(), "location3");
+    EXPECT_EQ(fieldValues[6].mValue.getString(), "some value123");
 }
 
 TEST(AtomMatcherTest, TestStringReplaceAttributionTagLast) {
@@ -1602,12 +1602,12 @@ TEST(AtomMatcherTest, TestStringReplaceAttributionTagLast) {
     const vector<FieldValue>& fieldValues = transformedEvent->getValues();
     ASSERT_EQ(fieldValues.size(), 7);
     EXPECT_EQ(fieldValues[0].mValue.int_value, 1111);
-    EXPECT_EQ(fieldValues[1].mValue.str_value, "location1");
+    EXPECT_EQ(fieldValues[1].mValue.getString(), "location1");
     EXPECT_EQ(fieldValues[2].mValue.int_value, 2222);
-    EXPECT_EQ(fieldValues[3].mValue.str_value, "location2");
+    EXPECT_EQ(fieldValues[3].mValue.getString(), "location2");
     EXPECT_EQ(fieldValues[4].mValue.int_value, 3333);
-    EXPECT_EQ(fieldValues[5].mValue.str_value, "location");
-    EXPECT_EQ(fieldValues[6].mValue.str_value, "some value123");
+    EXPECT_EQ(fieldValues[5].mValue.getString(), "location");
+    EXPECT_EQ(fieldValues[6].mValue.getString(), "some value123");
 }
 
 TEST(AtomMatcherTest, TestStringReplaceAttributionTagAll) {
@@ -1640,12 +1640,12 @@ TEST(AtomMatcherTest, TestStringReplaceAttributionTagAll) {
     const vector<FieldValue>& fieldValues = transformedEvent->getValues();
     ASSERT_EQ(fieldValues.size(), 7);
     EXPECT_EQ(fieldValues[0].mValue.int_value, 1111);
-    EXPECT_EQ(fieldValues[1].mValue.str_value, "location");
+    EXPECT_EQ(fieldValues[1].mValue.getString(), "location");
     EXPECT_EQ(fieldValues[2].mValue.int_value, 2222);
-    EXPECT_EQ(fieldValues[3].mValue.str_value, "location");
+    EXPECT_EQ(fieldValues[3].mValue.getString(), "location");
     EXPECT_EQ(fieldValues[4].mValue.int_value, 3333);
-    EXPECT_EQ(fieldValues[5].mValue.str_value, "location");
-    EXPECT_EQ(fieldValues[6].mValue.str_value, "some value123");
+    EXPECT_EQ(fieldValues[5].mValue.getString(), "location");
+    EXPECT_EQ(fieldValues[6].mValue.getString(), "some value123");
 }
 
 TEST(AtomMatcherTest, TestStringReplaceNestedAllWithMultipleNestedStringFields) {
@@ -1683,13 +1683,13 @@ TEST(AtomMatcherTest, TestStringReplaceNestedAllWithMultipleNestedStringFields)
 
     const vector<FieldValue>& fieldValues = transformedEvent->getValues();
     ASSERT_EQ(fieldValues.size(), 7);
-    EXPECT_EQ(fieldValues[0].mValue.str_value, "abc1");
-    EXPECT_EQ(fieldValues[1].mValue.str_value, "location");
-    EXPECT_EQ(fieldValues[2].mValue.str_value, "xyz2");
-    EXPECT_EQ(fieldValues[3].mValue.str_value, "location");
-    EXPECT_EQ(fieldValues[4].mValue.str_value, "abc3");
-    EXPECT_EQ(fieldValues[5].mValue.str_value, "location");
-    EXPECT_EQ(fieldValues[6].mValue.str_value, "some value123");
+    EXPECT_EQ(fieldValues[0].mValue.getString(), "abc1");
+    EXPECT_EQ(fieldValues[1].mValue.getString(), "location");
+    EXPECT_EQ(fieldValues[2].mValue.getString(), "xyz2");
+    EXPECT_EQ(fieldValues[3].mValue.getString(), "location");
+    EXPECT_EQ(fieldValues[4].mValue.getString(), "abc3");
+    EXPECT_EQ(fieldValues[5].mValue.getString(), "location");
+    EXPECT_EQ(fieldValues[6].mValue.getString(), "some value123");
 }
 
 TEST(AtomMatcherTest, TestStringReplaceRootOnMatchedField) {
@@ -1725,12 +1725,12 @@ TEST(AtomMatcherTest, TestStringReplaceRootOnMatchedField) {
         const vector<FieldValue>& fieldValues = transformedEvent->getValues();
         ASSERT_EQ(fieldValues.size(), 7);
         EXPECT_EQ(fieldValues[0].mValue.int_value, 1111);
-        EXPECT_EQ(fieldValues[1].mValue.str_value, "location1");
+        EXPECT_EQ(fieldValues[1].mValue.getString(), "location1");
         EXPECT_EQ(fieldValues[2].mValue.int_value, 2222);
-        EXPECT_EQ(fieldValues[3].mValue.str_value, "location2");
+        EXPECT_EQ(fieldValues[3].mValue.getString(), "location2");
         EXPECT_EQ(fieldValues[4].mValue.int_value, 3333);
-        EXPECT_EQ(fieldValues[5].mValue.str_value, "location3");
-        EXPECT_EQ(fieldValues[6].mValue.str_value, "bar");
+        EXPECT_EQ(fieldValues[5].mValue.getString(), "location3");
+        EXPECT_EQ(fieldValues[6].mValue.getString(), "bar");
     }
 }
 
@@ -1773,12 +1773,12 @@ TEST(AtomMatcherTest, TestStringReplaceAttributionTagFirstOnMatchedField) {
         const vector<FieldValue>& fieldValues = transformedEvent->getValues();
         ASSERT_EQ(fieldValues.size(), 7);
         EXPECT_EQ(fieldValues[0].mValue.int_value, 1111);
-        EXPECT_EQ(fieldValues[1].mValue.str_value, "bar");
+        EXPECT_EQ(fieldValues[1].mValue.getString(), "bar");
         EXPECT_EQ(fieldValues[2].mValue.int_value, 2222);
-        EXPECT_EQ(fieldValues[3].mValue.str_value, "bar2");
+        EXPECT_EQ(fieldValues[3].mValue.getString(), "bar2");
         EXPECT_EQ(fieldValues[4].mValue.int_value, 3333);
-        EXPECT_EQ(fieldValues[5].mValue.str_value, "bar3");
-        EXPECT_EQ(fieldValues[6].mValue.str_value, "bar123");
+        EXPECT_EQ(fieldValues[5].mValue.getString(), "bar3");
+        EXPECT_EQ(fieldValues[6].mValue.getString(), "bar123");
     }
 }
 
@@ -1821,12 +1821,12 @@ TEST(AtomMatcherTest, TestStringReplaceAttributionTagLastOnMatchedField) {
         const vector<FieldValue>& fieldValues = transformedEvent->getValues();
         ASSERT_EQ(fieldValues.size(), 7);
         EXPECT_EQ(fieldValues[0].mValue.int_value, 1111);
-        EXPECT_EQ(fieldValues[1].mValue.str_value, "bar1");
+        EXPECT_EQ(fieldValues[1].mValue.getString(), "bar1");
         EXPECT_EQ(fieldValues[2].mValue.int_value, 2222);
-        EXPECT_EQ(fieldValues[3].mValue.str_value, "bar2");
+        EXPECT_EQ(fieldValues[3].mValue.getString(), "bar2");
         EXPECT_EQ(fieldValues[4].mValue.int_value, 3333);
-        EXPECT_EQ(fieldValues[5].mValue.str_value, "bar");
-        EXPECT_EQ(fieldValues[6].mValue.str_value, "bar123");
+        EXPECT_EQ(fieldValues[5].mValue.getString(), "bar");
+        EXPECT_EQ(fieldValues[6].mValue.getString(), "bar123");
     }
 }
 
@@ -1869,12 +1869,12 @@ TEST(AtomMatcherTest, TestStringReplaceAttributionTagAnyOnMatchedField) {
         const vector<FieldValue>& fieldValues = transformedEvent->getValues();
         ASSERT_EQ(fieldValues.size(), 7);
         EXPECT_EQ(fieldValues[0].mValue.int_value, 1111);
-        EXPECT_EQ(fieldValues[1].mValue.str_value, "foo");
+        EXPECT_EQ(fieldValues[1].mValue.getString(), "foo");
         EXPECT_EQ(fieldValues[2].mValue.int_value, 2222);
-        EXPECT_EQ(fieldValues[3].mValue.str_value, "bar");
+        EXPECT_EQ(fieldValues[3].mValue.getString(), "bar");
         EXPECT_EQ(fieldValues[4].mValue.int_value, 3333);
-        EXPECT_EQ(fieldValues[5].mValue.str_value, "foo");
-        EXPECT_EQ(fieldValues[6].mValue.str_value, "bar123");
+        EXPECT_EQ(fieldValues[5].mValue.getString(), "foo");
+        EXPECT_EQ(fieldValues[6].mValue.getString(), "bar123");
     }
 }
 
@@ -1928,12 +1928,12 @@ TEST(AtomMatcherTest, TestStringReplaceAttributionTagAnyAndRootOnMatchedFields)
         const vector<FieldValue>& fieldValues = transformedEvent->getValues();
         ASSERT_EQ(fieldValues.size(), 7);
         EXPECT_EQ(fieldValues[0].mValue.int_value, 1111);
-        EXPECT_EQ(fieldValues[1].mValue.str_value, "foo");
+        EXPECT_EQ(fieldValues[1].mValue.getString(), "foo");
         EXPECT_EQ(fieldValues[2].mValue.int_value, 2222);
-        EXPECT_EQ(fieldValues[3].mValue.str_value, "bar");
+        EXPECT_EQ(fieldValues[3].mValue.getString(), "bar");
         EXPECT_EQ(fieldValues[4].mValue.int_value, 3333);
-        EXPECT_EQ(fieldValues[5].mValue.str_value, "foo");
-        EXPECT_EQ(fieldValues[6].mValue.str_value, "blah");
+        EXPECT_EQ(fieldValues[5].mValue.getString(), "foo");
+        EXPECT_EQ(fieldValues[6].mValue.getString(), "blah");
     }
 }
 
@@ -1985,12 +1985,12 @@ TEST(AtomMatcherTest, TestStringReplaceAttributionTagAnyWithAttributionUidValueM
         const vector<FieldValue>& fieldValues = transformedEvent->getValues();
         ASSERT_EQ(fieldValues.size(), 7);
         EXPECT_EQ(fieldValues[0].mValue.int_value, 1111);
-        EXPECT_EQ(fieldValues[1].mValue.str_value, "foo");
+        EXPECT_EQ(fieldValues[1].mValue.getString(), "foo");
         EXPECT_EQ(fieldValues[2].mValue.int_value, 2222);
-        EXPECT_EQ(fieldValues[3].mValue.str_value, "bar");
+        EXPECT_EQ(fieldValues[3].mValue.getString(), "bar");
         EXPECT_EQ(fieldValues[4].mValue.int_value, 3333);
-        EXPECT_EQ(fieldValues[5].mValue.str_value, "foo");
-        EXPECT_EQ(fieldValues[6].mValue.str_value, "bar123");
+        EXPECT_EQ(fieldValues[5].mValue.getString(), "foo");
+        EXPECT_EQ(fieldValues[6].mValue.getString(), "bar123");
     }
 }
 
@@ -2064,6 +2064,102 @@ TEST(AtomMatcherTest, TestStringReplaceNoop) {
     ASSERT_EQ(transformedEvent, nullptr);
 }
 
+TEST(AtomMatcherTest, TestLazilyParsedEvent) {
+    sp<UidMap> uidMap = new UidMap();
+
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, TAG_ID);
+    writeAttribution(statsEvent, {1111, 2222}, {"location1", "location2"});
+    AStatsEvent_writeString(statsEvent, "some value123");
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    ASSERT_TRUE(parseStatsEventToLogEventLazily(statsEvent, &event));
+
+    AtomMatcher matcher = CreateSimpleAtomMatcher("matcher", TAG_ID);
+    FieldValueMatcher* attributionMatcher =
+            matcher.mutable_simple_atom_matcher()->add_field_value_matcher();
+    attributionMatcher->set_field(FIELD_ID_1);
+    attributionMatcher->set_position(Position::ANY);
+    FieldValueMatcher* tagMatcher =
+            attributionMatcher->mutable_matches_tuple()->add_field_value_matcher();
+    tagMatcher->set_field(ATTRIBUTION_TAG_FIELD_ID);
+    tagMatcher->set_eq_string("location2");
+    FieldValueMatcher* fieldMatcher =
+            matcher.mutable_simple_atom_matcher()->add_field_value_matcher();
+    fieldMatcher->set_field(FIELD_ID_2);
+    fieldMatcher->set_eq_wildcard_string("some*");
+
+    EXPECT_TRUE(matchesSimple(uidMap, matcher.simple_atom_matcher(), event).matched);
+    tagMatcher->set_eq_string("location3");
+    EXPECT_FALSE(matchesSimple(uidMap, matcher.simple_atom_matcher(), event).matched);
+
+    // Matching reads the strings without decoding them.
+    EXPECT_EQ("", event.getLazyValues()[3].mValue.getString());
+    EXPECT_EQ("", event.getLazyValues()[4].mValue.getString());
+
+    // String transformations work on a decoded copy of the event.
+    tagMatcher->set_eq_string("location2");
+    StringReplacer* stringReplacer = fieldMatcher->mutable_replace_string();
+    stringReplacer->set_regex(R"([0-9]+$)");
+    stringReplacer->set_replacement("");
+    fieldMatcher->set_eq_string("some value");
+    const auto [hasMatched, transformedEvent] =
+            matchesSimple(uidMap, matcher.simple_atom_matcher(), event);
+    EXPECT_TRUE(hasMatched);
+    ASSERT_NE(transformedEvent, nullptr);
+    EXPECT_EQ("some value", transformedEvent->getValues()[4].mValue.getString());
+    EXPECT_EQ("some value123", event.getValues()[4].mValue.getString());
+}
+
+TEST(AtomMatcherTest, TestSimpleAtomMatcherProgram) {
+    sp<UidMap> uidMap = new UidMap();
+    UidData uidData;
+    *uidData.add_app_info() = createApplicationInfo(/*uid*/ 1111, /*version*/ 1, "v1", "pkg0");
+    uidMap->updateMap(1, uidData);
+
+    AtomMatcher matcher = CreateSimpleAtomMatcher("matcher", TAG_ID);
+    FieldValueMatcher* attributionMatcher =
+            matcher.mutable_simple_atom_matcher()->add_field_value_matcher();
+    attributionMatcher->set_field(FIELD_ID_1);
+    attributionMatcher->set_position(Position::ANY);
+    FieldValueMatcher* uidMatcher =
+            attributionMatcher->mutable_matches_tuple()->add_field_value_matcher();
+    uidMatcher->set_field(ATTRIBUTION_UID_FIELD_ID);
+    uidMatcher->mutable_eq_any_string()->add_str_value("pkg0");
+    uidMatcher->mutable_eq_any_string()->add_str_value("AID_SYSTEM");
+    FieldValueMatcher* nameMatcher =
+            matcher.mutable_simple_atom_matcher()->add_field_value_matcher();
+    nameMatcher->set_field(FIELD_ID_2);
+    // Not sorted, the program sorts the strings for lookups.
+    for (const char* str : {"zeta", "beta", "alpha", "gamma", "delta"}) {
+        nameMatcher->mutable_eq_any_string()->add_str_value(str);
+    }
+
+    const SimpleAtomMatcherProgram program(matcher.simple_atom_matcher());
+    EXPECT_EQ(TAG_ID, program.getAtomId());
+
+    // The program does not depend on the proto it was compiled from.
+    matcher.mutable_simple_atom_matcher()->clear_field_value_matcher();
+
+    const vector<std::tuple<vector<int>, string, bool>> cases = {
+            {{1111}, "alpha", true},
+            {{1111}, "zeta", true},
+            {{1111}, "gamma", true},
+            {{1111}, "epsilon", false},
+            {{2222, 1000}, "delta", true},
+            {{2222}, "delta", false},
+            {{2222, 1111}, "beta", true},
+    };
+    for (const auto& [uids, name, expected] : cases) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        makeAttributionLogEvent(&event, TAG_ID, 0, uids, vector<string>(uids.size(), "tag"), name);
+        EXPECT_EQ(expected, program.match(uidMap, event).matched) << name;
+    }
+
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    makeAttributionLogEvent(&event, TAG_ID + 1, 0, {1111}, {"tag"}, "alpha");
+    EXPECT_FALSE(program.match(uidMap, event).matched);
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
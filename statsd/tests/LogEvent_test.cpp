@@ -300,6 +300,117 @@ TEST(LogEventTestParsing, TestFetchHeaderOnly) {
     ASSERT_EQ(0, logEvent.getValues().size());
 }
 
+namespace {
+
+AStatsEvent* makeWideStatsEvent() {
+    AStatsEvent* event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, 100);
+    writeAttribution(event, {1001, 1002}, {"tag1", "tag2"});
+    AStatsEvent_writeInt32(event, 10);
+    AStatsEvent_writeString(event, "string");
+    AStatsEvent_writeString(event, "");
+    const string bytes = "bytes";
+    AStatsEvent_writeByteArray(event, (uint8_t*)bytes.c_str(), bytes.length());
+    const char* strings[] = {"a", "bc"};
+    AStatsEvent_writeStringArray(event, strings, 2);
+    AStatsEvent_writeInt64(event, 0x123456789);
+    AStatsEvent_addBoolAnnotation(event, ASTATSLOG_ANNOTATION_ID_PRIMARY_FIELD, true);
+    return event;
+}
+
+}  // anonymous namespace
+
+TEST(LogEventTestParsing, TestLazyParsing) {
+    LogEvent eagerEvent(/*uid=*/1000, /*pid=*/1001);
+    ASSERT_TRUE(parseStatsEventToLogEvent(makeWideStatsEvent(), &eagerEvent));
+    LogEvent lazyEvent(/*uid=*/1000, /*pid=*/1001);
+    ASSERT_TRUE(parseStatsEventToLogEventLazily(makeWideStatsEvent(), &lazyEvent));
+
+    EXPECT_FALSE(lazyEvent.isParsedHeaderOnly());
+    EXPECT_EQ(eagerEvent.GetTagId(), lazyEvent.GetTagId());
+    EXPECT_EQ(eagerEvent.size(), lazyEvent.size());
+    EXPECT_EQ(eagerEvent.getNumUidFields(), lazyEvent.getNumUidFields());
+    EXPECT_TRUE(lazyEvent.hasAttributionChain());
+
+    // Fields, types, annotations and numbers are there before anything is decoded.
+    const vector<FieldValue>& eagerValues = eagerEvent.getValues();
+    const vector<FieldValue>& lazyValues = lazyEvent.getLazyValues();
+    ASSERT_EQ(eagerValues.size(), lazyValues.size());
+    for (size_t i = 0; i < lazyValues.size(); i++) {
+        EXPECT_EQ(eagerValues[i].mField, lazyValues[i].mField);
+        EXPECT_EQ(eagerValues[i].mValue.getType(), lazyValues[i].mValue.getType());
+        EXPECT_EQ(eagerValues[i].mAnnotations.toString(), lazyValues[i].mAnnotations.toString());
+        switch (lazyValues[i].mValue.getType()) {
+            case STRING:
+                EXPECT_EQ("", lazyValues[i].mValue.getString());
+                EXPECT_EQ(eagerValues[i].mValue.getString(), lazyEvent.getStringValue(i));
+                break;
+            case STORAGE:
+                EXPECT_TRUE(lazyValues[i].mValue.getStorage().empty());
+                break;
+            default:
+                EXPECT_EQ(eagerValues[i].mValue, lazyValues[i].mValue);
+                break;
+        }
+    }
+
+    // Values are decoded on first use.
+    EXPECT_EQ(eagerValues, lazyEvent.getValues());
+    EXPECT_EQ("string", lazyEvent.getStringValue(5));
+    EXPECT_EQ(eagerEvent.ToString(), lazyEvent.ToString());
+}
+
+TEST(LogEventTestParsing, TestLazyParsingCopy) {
+    LogEvent eagerEvent(/*uid=*/1000, /*pid=*/1001);
+    ASSERT_TRUE(parseStatsEventToLogEvent(makeWideStatsEvent(), &eagerEvent));
+
+    std::unique_ptr<LogEvent> lazyEvent = std::make_unique<LogEvent>(/*uid=*/1000, /*pid=*/1001);
+    ASSERT_TRUE(parseStatsEventToLogEventLazily(makeWideStatsEvent(), lazyEvent.get()));
+    const LogEvent copy(*lazyEvent);
+    lazyEvent.reset();
+
+    EXPECT_EQ("tag2", copy.getStringValue(3));
+    EXPECT_EQ(eagerEvent.getValues(), copy.getValues());
+}
+
+TEST(LogEventTestParsing, TestLazyParsingUpdateNumbers) {
+    LogEvent lazyEvent(/*uid=*/1000, /*pid=*/1001);
+    ASSERT_TRUE(parseStatsEventToLogEventLazily(makeWideStatsEvent(), &lazyEvent));
+
+    // Updating numbers does not need the strings to be decoded.
+    (*lazyEvent.getMutableLazyValues())[0].mValue.setInt(2001);
+    EXPECT_EQ("", lazyEvent.getLazyValues()[1].mValue.getString());
+
+    const vector<FieldValue>& values = lazyEvent.getValues();
+    EXPECT_EQ(2001, values[0].mValue.int_value);
+    EXPECT_EQ("tag1", values[1].mValue.getString());
+    EXPECT_EQ(1002, values[2].mValue.int_value);
+    EXPECT_EQ("tag2", values[3].mValue.getString());
+}
+
+TEST(LogEventTestParsing, TestLazyParsingSetStringValue) {
+    LogEvent lazyEvent(/*uid=*/1000, /*pid=*/1001);
+    ASSERT_TRUE(parseStatsEventToLogEventLazily(makeWideStatsEvent(), &lazyEvent));
+
+    // The copy shares the undecoded strings of the event.
+    LogEvent copy(lazyEvent);
+    copy.setStringValue(3, "tag");
+    copy.setStringValue(5, "a longer string that is not stored inline");
+    EXPECT_EQ("tag", copy.getStringValue(3));
+    EXPECT_EQ("", copy.getLazyValues()[1].mValue.getString());
+    EXPECT_EQ("tag1", copy.getStringValue(1));
+
+    const vector<FieldValue>& values = copy.getValues();
+    EXPECT_EQ("tag1", values[1].mValue.getString());
+    EXPECT_EQ("tag", values[3].mValue.getString());
+    EXPECT_EQ("a longer string that is not stored inline", values[5].mValue.getString());
+    EXPECT_EQ("bc", values[9].mValue.getString());
+
+    // The original event is not modified.
+    EXPECT_EQ("tag2", lazyEvent.getStringValue(3));
+    EXPECT_EQ("string", lazyEvent.getValues()[5].mValue.getString());
+}
+
 TEST_P(LogEventTest, TestStringAndByteArrayParsing) {
     AStatsEvent* event = AStatsEvent_obtain();
     AStatsEvent_setAtomId(event, 100);
@@ -326,14 +437,14 @@ TEST_P(LogEventTest, TestStringAndByteArrayParsing) {
     Field expectedField = getField(100, {1, 1, 1}, 0, {false, false, false});
     EXPECT_EQ(expectedField, stringItem.mField);
     EXPECT_EQ(Type::STRING, stringItem.mValue.getType());
-    EXPECT_EQ(str, stringItem.mValue.str_value);
+    EXPECT_EQ(str, stringItem.mValue.getString());
 
     const FieldValue& storageItem = values[1];
     expectedField = getField(100, {2, 1, 1}, 0, {true, false, false});
     EXPECT_EQ(expectedField, storageItem.mField);
     EXPECT_EQ(Type::STORAGE, storageItem.mValue.getType());
     vector<uint8_t> expectedValue = {'t', 'e', 's', 't'};
-    EXPECT_EQ(expectedValue, storageItem.mValue.storage_value);
+    EXPECT_EQ(expectedValue, storageItem.mValue.getStorage());
 
     AStatsEvent_release(event);
 }
@@ -363,7 +474,7 @@ TEST_P(LogEventTest, TestEmptyString) {
     Field expectedField = getField(100, {1, 1, 1}, 0, {true, false, false});
     EXPECT_EQ(expectedField, item.mField);
     EXPECT_EQ(Type::STRING, item.mValue.getType());
-    EXPECT_EQ(empty, item.mValue.str_value);
+    EXPECT_EQ(empty, item.mValue.getString());
 
     AStatsEvent_release(event);
 }
@@ -393,7 +504,7 @@ TEST_P(LogEventTest, TestByteArrayWithNullCharacter) {
     EXPECT_EQ(expectedField, item.mField);
     EXPECT_EQ(Type::STORAGE, item.mValue.getType());
     vector<uint8_t> expectedValue(message, message + 5);
-    EXPECT_EQ(expectedValue, item.mValue.storage_value);
+    EXPECT_EQ(expectedValue, item.mValue.getStorage());
 
     AStatsEvent_release(event);
 }
@@ -459,7 +570,7 @@ TEST_P(LogEventTest, TestAttributionChain) {
     expectedField = getField(100, {1, 1, 2}, 2, {true, false, true});
     EXPECT_EQ(expectedField, tag1Item.mField);
     EXPECT_EQ(Type::STRING, tag1Item.mValue.getType());
-    EXPECT_EQ(tag1, tag1Item.mValue.str_value);
+    EXPECT_EQ(tag1, tag1Item.mValue.getString());
 
     // Check second attribution nodes
     const FieldValue& uid2Item = values[2];
@@ -472,7 +583,7 @@ TEST_P(LogEventTest, TestAttributionChain) {
     expectedField = getField(100, {1, 2, 2}, 2, {true, true, true});
     EXPECT_EQ(expectedField, tag2Item.mField);
     EXPECT_EQ(Type::STRING, tag2Item.mValue.getType());
-    EXPECT_EQ(tag2, tag2Item.mValue.str_value);
+    EXPECT_EQ(tag2, tag2Item.mValue.getString());
 
     AStatsEvent_release(event);
 }
@@ -609,13 +720,13 @@ TEST_P(LogEventTest, TestArrayParsing) {
     expectedField = getField(100, {5, 1, 1}, 1, {true, false, false});
     EXPECT_EQ(expectedField, stringArrayItem1.mField);
     EXPECT_EQ(Type::STRING, stringArrayItem1.mValue.getType());
-    EXPECT_EQ("str1", stringArrayItem1.mValue.str_value);
+    EXPECT_EQ("str1", stringArrayItem1.mValue.getString());
 
     const FieldValue& stringArrayItem2 = values[9];
     expectedField = getField(100, {5, 2, 1}, 1, {true, true, false});
     EXPECT_EQ(expectedField, stringArrayItem2.mField);
     EXPECT_EQ(Type::STRING, stringArrayItem2.mValue.getType());
-    EXPECT_EQ("str2", stringArrayItem2.mValue.str_value);
+    EXPECT_EQ("str2", stringArrayItem2.mValue.getString());
 }
 
 TEST_P(LogEventTest, TestEmptyStringArray) {
@@ -646,13 +757,13 @@ TEST_P(LogEventTest, TestEmptyStringArray) {
     Field expectedField = getField(100, {1, 1, 1}, 1, {true, false, false});
     EXPECT_EQ(expectedField, stringArrayItem1.mField);
     EXPECT_EQ(Type::STRING, stringArrayItem1.mValue.getType());
-    EXPECT_EQ(empty, stringArrayItem1.mValue.str_value);
+    EXPECT_EQ(empty, stringArrayItem1.mValue.getString());
 
     const FieldValue& stringArrayItem2 = values[1];
     expectedField = getField(100, {1, 2, 1}, 1, {true, true, false});
     EXPECT_EQ(expectedField, stringArrayItem2.mField);
     EXPECT_EQ(Type::STRING, stringArrayItem2.mValue.getType());
-    EXPECT_EQ(empty, stringArrayItem2.mValue.str_value);
+    EXPECT_EQ(empty, stringArrayItem2.mValue.getString());
 
     AStatsEvent_release(event);
 }
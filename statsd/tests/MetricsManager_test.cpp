@@ -387,6 +387,137 @@ TEST_P(MetricsManagerTest_SPlus, TestRestrictedMetricsConfigUpdate) {
     }
 }
 
+TEST(MetricsManagerTest, TestEventScratchStateReset) {
+    sp<UidMap> uidMap;
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> periodicAlarmMonitor;
+
+    StatsdConfig config = buildGoodConfig(kConfigId);
+    config.add_allowed_log_source("AID_ROOT");
+
+    MetricsManager metricsManager(kConfigKey, config, timeBaseSec, timeBaseSec, uidMap,
+                                  pullerManager, anomalyAlarmMonitor, periodicAlarmMonitor);
+    ASSERT_TRUE(metricsManager.isConfigValid());
+
+    const size_t matcherCount = metricsManager.mAllAtomMatchingTrackers.size();
+    const size_t conditionCount = metricsManager.mAllConditionTrackers.size();
+    ASSERT_EQ(3, matcherCount);
+    ASSERT_EQ(1, conditionCount);
+    EXPECT_EQ(matcherCount, metricsManager.mMatcherCache.size());
+    EXPECT_EQ(conditionCount, metricsManager.mConditionCache.size());
+
+
+    auto expectScratchStateReset = [&metricsManager] {
+        for (size_t i = 0; i < metricsManager.mMatcherCache.size(); i++) {
+            EXPECT_EQ(MatchingState::kNotComputed, metricsManager.mMatcherCache[i]);
+            EXPECT_EQ(nullptr, metricsManager.mMatcherTransformations[i]);
+        }
+        for (size_t i = 0; i < metricsManager.mConditionCache.size(); i++) {
+            EXPECT_EQ(ConditionState::kNotEvaluated, metricsManager.mConditionCache[i]);
+            EXPECT_FALSE(metricsManager.mChangedCache[i]);
+            EXPECT_FALSE(metricsManager.mConditionToBeEvaluated[i]);
+            EXPECT_EQ(nullptr, metricsManager.mConditionToTransformedLogEvents[i]);
+        }
+    };
+
+    metricsManager.onLogEvent(*CreateScreenStateChangedEvent(
+            timeBaseSec + 10, android::view::DISPLAY_STATE_ON));
+    expectScratchStateReset();
+    EXPECT_EQ(ConditionState::kTrue,
+              metricsManager.mAllConditionTrackers[0]->getUnSlicedPartConditionState());
+
+    metricsManager.onLogEvent(*CreateScreenStateChangedEvent(
+            timeBaseSec + 20, android::view::DISPLAY_STATE_OFF));
+    expectScratchStateReset();
+    EXPECT_EQ(ConditionState::kFalse,
+              metricsManager.mAllConditionTrackers[0]->getUnSlicedPartConditionState());
+
+    // Scratch state is resized on config update.
+    StatsdConfig newConfig = buildGoodConfig(kConfigId);
+    newConfig.add_allowed_log_source("AID_ROOT");
+    *newConfig.add_atom_matcher() = CreateAcquireWakelockAtomMatcher();
+    metricsManager.updateConfig(newConfig, timeBaseSec, timeBaseSec, anomalyAlarmMonitor,
+                                periodicAlarmMonitor);
+    ASSERT_TRUE(metricsManager.isConfigValid());
+    EXPECT_EQ(4, metricsManager.mMatcherCache.size());
+    EXPECT_EQ(4, metricsManager.mMatcherTransformations.size());
+    EXPECT_EQ(1, metricsManager.mConditionCache.size());
+    EXPECT_EQ(1, metricsManager.mAtomDispatchPlans.count(util::WAKELOCK_STATE_CHANGED));
+    expectScratchStateReset();
+}
+
+TEST(MetricsManagerTest, TestAtomDispatchPlan) {
+    sp<UidMap> uidMap;
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> periodicAlarmMonitor;
+
+    StatsdConfig config = buildGoodConfig(kConfigId);
+    config.add_allowed_log_source("AID_ROOT");
+    AtomMatcher wakelockAcquireMatcher = CreateAcquireWakelockAtomMatcher();
+    *config.add_atom_matcher() = wakelockAcquireMatcher;
+    auto countActivation = config.add_metric_activation();
+    countActivation->set_metric_id(StringToId("Count"));
+    auto countActivationTrigger = countActivation->add_event_activation();
+    countActivationTrigger->set_atom_matcher_id(wakelockAcquireMatcher.id());
+    countActivationTrigger->set_ttl_seconds(100);
+
+    MetricsManager metricsManager(kConfigKey, config, timeBaseSec, timeBaseSec, uidMap,
+                                  pullerManager, anomalyAlarmMonitor, periodicAlarmMonitor);
+    ASSERT_TRUE(metricsManager.isConfigValid());
+    ASSERT_EQ(2, metricsManager.mAtomDispatchPlans.size());
+
+    const int screenOnIndex =
+            metricsManager.mAtomMatchingTrackerMap[StringToId("ScreenTurnedOn")];
+    const int screenOffIndex =
+            metricsManager.mAtomMatchingTrackerMap[StringToId("ScreenTurnedOff")];
+    const int wakelockIndex = metricsManager.mAtomMatchingTrackerMap[wakelockAcquireMatcher.id()];
+    const int countIndex = metricsManager.mMetricProducerMap[StringToId("Count")];
+    const int durationIndex = metricsManager.mMetricProducerMap[StringToId("Duration")];
+
+    // The combination matcher and both of its children are evaluated for screen state events.
+    // Only the ScreenIsOn predicate and the metrics on the screen matchers are reachable.
+    const MetricsManager::AtomDispatchPlan& screenPlan =
+            metricsManager.mAtomDispatchPlans[util::SCREEN_STATE_CHANGED];
+    EXPECT_THAT(screenPlan.rootMatchers, UnorderedElementsAre(0, 1, 2));
+    EXPECT_THAT(screenPlan.matchers, ElementsAre(0, 1, 2));
+    EXPECT_TRUE(screenPlan.activations.empty());
+    EXPECT_TRUE(screenPlan.deactivations.empty());
+    ASSERT_EQ(2, screenPlan.matcherConditions.size());
+    EXPECT_EQ(std::min(screenOnIndex, screenOffIndex), screenPlan.matcherConditions[0].index);
+    EXPECT_THAT(screenPlan.matcherConditions[0].targets, ElementsAre(0));
+    EXPECT_EQ(std::max(screenOnIndex, screenOffIndex), screenPlan.matcherConditions[1].index);
+    EXPECT_THAT(screenPlan.matcherConditions[1].targets, ElementsAre(0));
+    EXPECT_THAT(screenPlan.conditions, ElementsAre(0));
+    ASSERT_EQ(1, screenPlan.conditionMetrics.size());
+    EXPECT_EQ(0, screenPlan.conditionMetrics[0].index);
+    EXPECT_THAT(screenPlan.conditionMetrics[0].targets, ElementsAre(durationIndex));
+    ASSERT_EQ(1, screenPlan.matcherMetrics.size());
+    EXPECT_EQ(screenOnIndex, screenPlan.matcherMetrics[0].index);
+    EXPECT_EQ(4, screenPlan.matcherMetrics[0].targets.size());
+    EXPECT_THAT(screenPlan.matcherMetrics[0].targets, Contains(countIndex));
+
+    // Wakelock events only reach the activation of the count metric.
+    const MetricsManager::AtomDispatchPlan& wakelockPlan =
+            metricsManager.mAtomDispatchPlans[util::WAKELOCK_STATE_CHANGED];
+    EXPECT_THAT(wakelockPlan.rootMatchers, ElementsAre(wakelockIndex));
+    EXPECT_THAT(wakelockPlan.matchers, ElementsAre(wakelockIndex));
+    ASSERT_EQ(1, wakelockPlan.activations.size());
+    EXPECT_EQ(wakelockIndex, wakelockPlan.activations[0].index);
+    EXPECT_THAT(wakelockPlan.activations[0].targets, ElementsAre(countIndex));
+    EXPECT_TRUE(wakelockPlan.deactivations.empty());
+    EXPECT_TRUE(wakelockPlan.matcherConditions.empty());
+    EXPECT_TRUE(wakelockPlan.conditions.empty());
+    EXPECT_TRUE(wakelockPlan.conditionMetrics.empty());
+    EXPECT_TRUE(wakelockPlan.matcherMetrics.empty());
+
+    EXPECT_FALSE(metricsManager.mAllMetricProducers[countIndex]->isActive());
+    metricsManager.onLogEvent(*CreateAcquireWakelockEvent(timeBaseSec + 10, {AID_ROOT}, {"tag"},
+                                                          "wl1"));
+    EXPECT_TRUE(metricsManager.mAllMetricProducers[countIndex]->isActive());
+}
+
 TEST(MetricsManagerTest, TestMaxMetricsMemoryKb) {
     sp<UidMap> uidMap;
     sp<StatsPullerManager> pullerManager = new StatsPullerManager();
@@ -14,6 +14,11 @@
  * limitations under the License.
  */
 #include <gtest/gtest.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
 
 #include "socket/StatsSocketListener.h"
 #include "tests/statsd_test_util.h"
@@ -53,6 +58,50 @@ public:
     }
 };
 
+// Socket messages start with the log header followed by this tag.
+constexpr uint32_t kStatsEventTag = 1937006964;
+
+std::vector<uint8_t> createSocketMessage(int atomId) {
+    AStatsEventWrapper event(atomId);
+    auto [buf, size] = event.getBuffer();
+
+    android_log_header_t header = {};
+    std::vector<uint8_t> message(sizeof(header) + sizeof(kStatsEventTag) + size);
+    memcpy(message.data(), &header, sizeof(header));
+    memcpy(message.data() + sizeof(header), &kStatsEventTag, sizeof(kStatsEventTag));
+    memcpy(message.data() + sizeof(header) + sizeof(kStatsEventTag), buf, size);
+    return message;
+}
+
+class SocketPair final {
+public:
+    SocketPair() {
+        if (socketpair(AF_UNIX, SOCK_DGRAM, 0, mFds) != 0) {
+            mFds[0] = mFds[1] = -1;
+        }
+    }
+
+    ~SocketPair() {
+        close(mFds[0]);
+        close(mFds[1]);
+    }
+
+    int readEnd() const {
+        return mFds[0];
+    }
+
+    int writeEnd() const {
+        return mFds[1];
+    }
+
+    bool send(const std::vector<uint8_t>& message) const {
+        return ::send(mFds[1], message.data(), message.size(), 0) == (ssize_t)message.size();
+    }
+
+private:
+    int mFds[2];
+};
+
 }  //  namespace
 
 void generateAtomLogging(LogEventQueue& queue, const LogEventFilter& filter, int eventCount,
@@ -90,7 +139,7 @@ TEST_P(SocketParseMessageTest, TestProcessMessage) {
 
     int64_t lastEventTs = 0;
     // check content of the queue
-    EXPECT_EQ(kEventCount, mEventQueue.mQueue.size());
+    EXPECT_EQ(kEventCount, mEventQueue.size());
     for (int i = 0; i < kEventCount; i++) {
         auto logEvent = mEventQueue.waitPop();
         EXPECT_TRUE(logEvent->isValid());
@@ -109,7 +158,7 @@ TEST_P(SocketParseMessageTest, TestProcessMessageEmptySetExplicitSet) {
     generateAtomLogging(mEventQueue, mLogEventFilter, kEventCount, kAtomId);
 
     // check content of the queue
-    EXPECT_EQ(kEventCount, mEventQueue.mQueue.size());
+    EXPECT_EQ(kEventCount, mEventQueue.size());
     for (int i = 0; i < kEventCount; i++) {
         auto logEvent = mEventQueue.waitPop();
         EXPECT_TRUE(logEvent->isValid());
@@ -132,7 +181,7 @@ TEST(SocketParseMessageTest, TestProcessMessageFilterCompleteSet) {
     generateAtomLogging(eventQueue, logEventFilter, kEventCount, kAtomId);
 
     // check content of the queue
-    EXPECT_EQ(kEventCount, eventQueue.mQueue.size());
+    EXPECT_EQ(kEventCount, eventQueue.size());
     for (int i = 0; i < kEventCount; i++) {
         auto logEvent = eventQueue.waitPop();
         EXPECT_TRUE(logEvent->isValid());
@@ -156,7 +205,7 @@ TEST(SocketParseMessageTest, TestProcessMessageFilterPartialSet) {
     generateAtomLogging(eventQueue, logEventFilter, kEventCount, kAtomId);
 
     // check content of the queue
-    EXPECT_EQ(kEventCount, eventQueue.mQueue.size());
+    EXPECT_EQ(kEventCount, eventQueue.size());
     for (int i = 0; i < kEventFilteredCount; i++) {
         auto logEvent = eventQueue.waitPop();
         EXPECT_TRUE(logEvent->isValid());
@@ -204,7 +253,7 @@ TEST(SocketParseMessageTest, TestProcessMessageFilterToggle) {
     generateAtomLogging(eventQueue, logEventFilter, kEventCount, kAtomId + kEventCount * 2);
 
     // check content of the queue
-    EXPECT_EQ(kEventCount * 3, eventQueue.mQueue.size());
+    EXPECT_EQ(kEventCount * 3, eventQueue.size());
     // events with ids from kAtomId to kAtomId + kEventFilteredCount should not be skipped
     for (int i = 0; i < kEventFilteredCount; i++) {
         auto logEvent = eventQueue.waitPop();
@@ -249,6 +298,161 @@ TEST(SocketParseMessageTest, TestProcessMessageFilterToggle) {
     }
 }
 
+TEST(SocketReadMessagesTest, TestBatchRead) {
+    // Several full batches and a partial one. Messages are written from another thread so that
+    // the writer never blocks on a full socket buffer.
+    const int eventCount = StatsSocketListener::kMaxMessagesPerRead * 3 + 5;
+    LogEventQueue eventQueue(eventCount);
+    LogEventFilter logEventFilter;
+    SocketPair sockets;
+    ASSERT_GE(sockets.readEnd(), 0);
+
+    std::thread writer([&sockets, eventCount] {
+        for (int i = 0; i < eventCount; i++) {
+            EXPECT_TRUE(sockets.send(createSocketMessage(kAtomId + i)));
+        }
+    });
+
+    auto buffers = std::make_unique<StatsSocketListener::ReadBuffers>();
+    StatsSocketListener::ReadStats stats;
+    while (stats.messageCount < eventCount) {
+        struct pollfd pfd = {sockets.readEnd(), POLLIN, 0};
+        if (poll(&pfd, 1, 5000 /* timeout ms */) <= 0) {
+            ADD_FAILURE() << "Timed out waiting for messages";
+            break;
+        }
+        EXPECT_TRUE(StatsSocketListener::readSocketMessages(sockets.readEnd(), *buffers,
+                                                            eventQueue, logEventFilter, stats));
+    }
+    writer.join();
+
+    EXPECT_EQ(eventCount, stats.messageCount);
+    EXPECT_EQ(eventCount, (int)stats.atomCounts.size());
+    EXPECT_LE(stats.minAtomReadTimeNs, stats.maxAtomReadTimeNs);
+    ASSERT_EQ(eventCount, eventQueue.size());
+    for (int i = 0; i < eventCount; i++) {
+        auto logEvent = eventQueue.waitPop();
+        EXPECT_TRUE(logEvent->isValid());
+        EXPECT_EQ(kAtomId + i, logEvent->GetTagId());
+        // No credentials without SO_PASSCRED.
+        EXPECT_EQ(DEFAULT_OVERFLOWUID, logEvent->GetUid());
+        EXPECT_EQ(1, stats.atomCounts[kAtomId + i]);
+    }
+}
+
+TEST(SocketReadMessagesTest, TestCredentials) {
+    LogEventQueue eventQueue(kEventCount);
+    LogEventFilter logEventFilter;
+    SocketPair sockets;
+    ASSERT_GE(sockets.readEnd(), 0);
+    int on = 1;
+    ASSERT_EQ(0, setsockopt(sockets.readEnd(), SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)));
+
+    ASSERT_TRUE(sockets.send(createSocketMessage(kAtomId)));
+    ASSERT_TRUE(sockets.send(createSocketMessage(kAtomId + 1)));
+
+    auto buffers = std::make_unique<StatsSocketListener::ReadBuffers>();
+    StatsSocketListener::ReadStats stats;
+    EXPECT_TRUE(StatsSocketListener::readSocketMessages(sockets.readEnd(), *buffers, eventQueue,
+                                                        logEventFilter, stats));
+    EXPECT_EQ(2, stats.messageCount);
+    ASSERT_EQ(2, eventQueue.size());
+    for (int i = 0; i < 2; i++) {
+        auto logEvent = eventQueue.waitPop();
+        EXPECT_EQ(kAtomId + i, logEvent->GetTagId());
+        EXPECT_EQ((int32_t)getuid(), logEvent->GetUid());
+        EXPECT_EQ((int32_t)getpid(), logEvent->GetPid());
+    }
+}
+
+TEST(SocketReadMessagesTest, TestDroppedEventsMessage) {
+    LogEventQueue eventQueue(kEventCount);
+    LogEventFilter logEventFilter;
+    SocketPair sockets;
+    ASSERT_GE(sockets.readEnd(), 0);
+
+    android_log_header_t header = {};
+    android_log_event_long_t longEvent = {};
+    longEvent.header.tag = EBUSY;
+    longEvent.payload.type = EVENT_TYPE_LONG;
+    longEvent.payload.data = ((int64_t)kAtomId << 32) | 5 /* dropped count */;
+    std::vector<uint8_t> message(sizeof(header) + sizeof(longEvent));
+    memcpy(message.data(), &header, sizeof(header));
+    memcpy(message.data() + sizeof(header), &longEvent, sizeof(longEvent));
+    ASSERT_TRUE(sockets.send(message));
+    ASSERT_TRUE(sockets.send(createSocketMessage(kAtomId)));
+
+    auto buffers = std::make_unique<StatsSocketListener::ReadBuffers>();
+    StatsSocketListener::ReadStats stats;
+    EXPECT_TRUE(StatsSocketListener::readSocketMessages(sockets.readEnd(), *buffers, eventQueue,
+                                                        logEventFilter, stats));
+
+    // The dropped events message is accounted for, but produces no event.
+    EXPECT_EQ(2, stats.messageCount);
+    EXPECT_EQ(1, stats.atomCounts[-1]);
+    EXPECT_EQ(1, stats.atomCounts[kAtomId]);
+    ASSERT_EQ(1, eventQueue.size());
+    EXPECT_EQ(kAtomId, eventQueue.waitPop()->GetTagId());
+}
+
+TEST(SocketReadMessagesTest, TestMalformedMessage) {
+    LogEventQueue eventQueue(kEventCount);
+    LogEventFilter logEventFilter;
+    SocketPair sockets;
+    ASSERT_GE(sockets.readEnd(), 0);
+
+    ASSERT_TRUE(sockets.send(std::vector<uint8_t>(sizeof(android_log_header_t))));
+
+    auto buffers = std::make_unique<StatsSocketListener::ReadBuffers>();
+    StatsSocketListener::ReadStats stats;
+    EXPECT_FALSE(StatsSocketListener::readSocketMessages(sockets.readEnd(), *buffers, eventQueue,
+                                                         logEventFilter, stats));
+    EXPECT_EQ(0, eventQueue.size());
+}
+
+TEST(SocketReadMessagesTest, TestMalformedMessageInBatch) {
+    LogEventQueue eventQueue(kEventCount);
+    LogEventFilter logEventFilter;
+    SocketPair sockets;
+    ASSERT_GE(sockets.readEnd(), 0);
+
+    ASSERT_TRUE(sockets.send(createSocketMessage(kAtomId)));
+    ASSERT_TRUE(sockets.send(std::vector<uint8_t>(sizeof(android_log_header_t))));
+    ASSERT_TRUE(sockets.send(createSocketMessage(kAtomId + 1)));
+
+    auto buffers = std::make_unique<StatsSocketListener::ReadBuffers>();
+    StatsSocketListener::ReadStats stats;
+    EXPECT_FALSE(StatsSocketListener::readSocketMessages(sockets.readEnd(), *buffers, eventQueue,
+                                                         logEventFilter, stats));
+
+    // Only the malformed datagram is dropped from the batch.
+    EXPECT_EQ(2, stats.messageCount);
+    EXPECT_EQ(1, stats.atomCounts[kAtomId]);
+    EXPECT_EQ(1, stats.atomCounts[kAtomId + 1]);
+    ASSERT_EQ(2, eventQueue.size());
+    EXPECT_EQ(kAtomId, eventQueue.waitPop()->GetTagId());
+    EXPECT_EQ(kAtomId + 1, eventQueue.waitPop()->GetTagId());
+}
+
+TEST(SocketReadMessagesTest, TestEmptyMessage) {
+    LogEventQueue eventQueue(kEventCount);
+    LogEventFilter logEventFilter;
+    SocketPair sockets;
+    ASSERT_GE(sockets.readEnd(), 0);
+
+    ASSERT_TRUE(sockets.send(std::vector<uint8_t>()));
+    ASSERT_TRUE(sockets.send(createSocketMessage(kAtomId)));
+
+    auto buffers = std::make_unique<StatsSocketListener::ReadBuffers>();
+    StatsSocketListener::ReadStats stats;
+    // The empty datagram is skipped without failing the read, which would stop the listener.
+    EXPECT_TRUE(StatsSocketListener::readSocketMessages(sockets.readEnd(), *buffers, eventQueue,
+                                                        logEventFilter, stats));
+    EXPECT_EQ(1, stats.messageCount);
+    ASSERT_EQ(1, eventQueue.size());
+    EXPECT_EQ(kAtomId, eventQueue.waitPop()->GetTagId());
+}
+
 // TODO: tests for setAtomIds() with multiple consumers
 // TODO: use MockLogEventFilter to test different sets from different consumers
 
@@ -71,15 +71,14 @@ public:
 
     MOCK_METHOD(void, onLogEvent, (const LogEvent& event), (override));
 
-    MOCK_METHOD(void, onDumpReport,
+    MOCK_METHOD(DumpReportWriter, takeDumpReport,
                 (const int64_t dumpTimeNs, const int64_t wallClockNs,
                  const bool include_current_partial_bucket, const bool erase_data,
-                 const DumpLatency dumpLatency, std::set<string>* str_set,
-                 android::util::ProtoOutputStream* protoOutput),
+                 const DumpLatency dumpLatency, std::set<string>* str_set),
                 (override));
 };
 
-TEST(StatsLogProcessorTest, TestRateLimitByteSize) {
+TEST(StatsLogProcessorTest, TestCheckByteSizeOnEveryFlush) {
     sp<UidMap> m = new UidMap();
     sp<StatsPullerManager> pullerManager = new StatsPullerManager();
     sp<AlarmMonitor> anomalyAlarmMonitor;
@@ -95,9 +94,8 @@ TEST(StatsLogProcessorTest, TestRateLimitByteSize) {
     MockMetricsManager mockMetricsManager;
 
     ConfigKey key(100, 12345);
-    // Expect only the first flush to trigger a check for byte size since the last two are
-    // rate-limited.
-    EXPECT_CALL(mockMetricsManager, byteSize()).Times(1);
+    // The byte size is cheap to read, so every flush checks it.
+    EXPECT_CALL(mockMetricsManager, byteSize()).Times(3);
     p.flushIfNecessaryLocked(key, mockMetricsManager);
     p.flushIfNecessaryLocked(key, mockMetricsManager);
     p.flushIfNecessaryLocked(key, mockMetricsManager);
@@ -123,7 +121,7 @@ TEST(StatsLogProcessorTest, TestRateLimitBroadcast) {
 
     ConfigKey key(100, 12345);
     EXPECT_CALL(mockMetricsManager, byteSize())
-            .Times(1)
+            .Times(2)
             .WillRepeatedly(
                     ::testing::Return(int(StatsdStats::kDefaultMaxMetricsBytesPerConfig * .95)));
 
@@ -131,11 +129,9 @@ TEST(StatsLogProcessorTest, TestRateLimitBroadcast) {
     p.flushIfNecessaryLocked(key, mockMetricsManager);
     EXPECT_EQ(1, broadcastCount);
 
-    // b/73089712
-    // This next call to flush should not trigger a broadcast.
-    // p.mLastByteSizeTimes.clear();  // Force another check for byte size.
-    // p.flushIfNecessaryLocked(2, key, mockMetricsManager);
-    // EXPECT_EQ(1, broadcastCount);
+    // This next call to flush checks the byte size again, but should not trigger a broadcast.
+    p.flushIfNecessaryLocked(key, mockMetricsManager);
+    EXPECT_EQ(1, broadcastCount);
 }
 
 TEST(StatsLogProcessorTest, TestDropWhenByteSizeTooLarge) {
@@ -211,11 +207,10 @@ public:
     }
 
     MOCK_METHOD(void, onLogEvent, (const LogEvent& event), (override));
-    MOCK_METHOD(void, onDumpReport,
+    MOCK_METHOD(DumpReportWriter, takeDumpReport,
                 (const int64_t dumpTimeNs, const int64_t wallClockNs,
                  const bool include_current_partial_bucket, const bool erase_data,
-                 const DumpLatency dumpLatency, std::set<string>* str_set,
-                 android::util::ProtoOutputStream* protoOutput),
+                 const DumpLatency dumpLatency, std::set<string>* str_set),
                 (override));
     MOCK_METHOD(size_t, byteSize, (), (override));
     MOCK_METHOD(void, flushRestrictedData, (), (override));
@@ -1982,9 +1977,9 @@ TEST(StatsLogProcessorTest_mapIsolatedUidToHostUid, LogHostUidAttributionChain)
     const vector<FieldValue>* actualFieldValues = &logEvent->getValues();
     ASSERT_EQ(6, actualFieldValues->size());
     EXPECT_EQ(hostUid, actualFieldValues->at(0).mValue.int_value);
-    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.str_value);
+    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.getString());
     EXPECT_EQ(200, actualFieldValues->at(2).mValue.int_value);
-    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.str_value);
+    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.getString());
     EXPECT_EQ(field1, actualFieldValues->at(4).mValue.int_value);
     EXPECT_EQ(field2, actualFieldValues->at(5).mValue.int_value);
 }
@@ -2010,9 +2005,9 @@ TEST(StatsLogProcessorTest_mapIsolatedUidToHostUid, LogIsolatedUidAttributionCha
     const vector<FieldValue>* actualFieldValues = &logEvent->getValues();
     ASSERT_EQ(6, actualFieldValues->size());
     EXPECT_EQ(hostUid, actualFieldValues->at(0).mValue.int_value);
-    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.str_value);
+    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.getString());
     EXPECT_EQ(200, actualFieldValues->at(2).mValue.int_value);
-    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.str_value);
+    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.getString());
     EXPECT_EQ(field1, actualFieldValues->at(4).mValue.int_value);
     EXPECT_EQ(field2, actualFieldValues->at(5).mValue.int_value);
 }
@@ -2163,6 +2158,73 @@ TEST(StatsLogProcessorTest, TestDataCorruptedEnum) {
     EXPECT_EQ(output.reports(0).data_corrupted_reason(1), DATA_CORRUPTED_SOCKET_LOSS);
 }
 
+TEST(StatsLogProcessorTest, TestOnLogEventsMatchesOnLogEvent) {
+    StatsdConfig config;
+    auto syncStartMatcher = CreateSyncStartAtomMatcher();
+    *config.add_atom_matcher() = syncStartMatcher;
+    *config.add_atom_matcher() = CreateBatteryStateNoneMatcher();
+    *config.add_atom_matcher() = CreateBatteryStateUsbMatcher();
+    auto deviceUnpluggedPredicate = CreateDeviceUnpluggedPredicate();
+    *config.add_predicate() = deviceUnpluggedPredicate;
+
+    CountMetric* countMetric = config.add_count_metric();
+    countMetric->set_id(StringToId("CountSyncStartWhileOnBattery"));
+    countMetric->set_what(syncStartMatcher.id());
+    countMetric->set_condition(deviceUnpluggedPredicate.id());
+    countMetric->set_bucket(FIVE_MINUTES);
+
+    const int64_t bucketStartTimeNs = 10 * NS_PER_SEC;
+    const int64_t dumpTimeNs = bucketStartTimeNs + 10 * NS_PER_SEC;
+    ConfigKey cfgKey(12345, 98765);
+
+    auto makeEvents = [bucketStartTimeNs] {
+        std::vector<std::unique_ptr<LogEvent>> events;
+        events.push_back(CreateSyncStartEvent(bucketStartTimeNs + 10, {1001}, {"tag"}, "sync1"));
+        events.push_back(CreateBatteryStateChangedEvent(
+                bucketStartTimeNs + 20, BatteryPluggedStateEnum::BATTERY_PLUGGED_NONE));
+        events.push_back(CreateSyncStartEvent(bucketStartTimeNs + 30, {1001}, {"tag"}, "sync1"));
+        events.push_back(CreateSyncStartEvent(bucketStartTimeNs + 40, {1002}, {"tag"}, "sync2"));
+        events.push_back(CreateBatteryStateChangedEvent(
+                bucketStartTimeNs + 50, BatteryPluggedStateEnum::BATTERY_PLUGGED_USB));
+        events.push_back(CreateSyncStartEvent(bucketStartTimeNs + 60, {1001}, {"tag"}, "sync1"));
+        return events;
+    };
+
+    // One event at a time.
+    sp<StatsLogProcessor> serialProcessor =
+            CreateStatsLogProcessor(bucketStartTimeNs, bucketStartTimeNs, config, cfgKey);
+    for (const auto& event : makeEvents()) {
+        serialProcessor->OnLogEvent(event.get());
+    }
+
+    // Whole batch at once.
+    sp<StatsLogProcessor> batchProcessor =
+            CreateStatsLogProcessor(bucketStartTimeNs, bucketStartTimeNs, config, cfgKey);
+    batchProcessor->OnLogEvents(makeEvents());
+
+    ConfigMetricsReportList serialReports;
+    ConfigMetricsReportList batchReports;
+    vector<uint8_t> buffer;
+    serialProcessor->onDumpReport(cfgKey, dumpTimeNs, true, true, ADB_DUMP, FAST, &buffer);
+    ASSERT_TRUE(serialReports.ParseFromArray(&buffer[0], buffer.size()));
+    batchProcessor->onDumpReport(cfgKey, dumpTimeNs, true, true, ADB_DUMP, FAST, &buffer);
+    ASSERT_TRUE(batchReports.ParseFromArray(&buffer[0], buffer.size()));
+
+    ASSERT_EQ(1, serialReports.reports_size());
+    ASSERT_EQ(1, batchReports.reports_size());
+    ASSERT_EQ(1, serialReports.reports(0).metrics_size());
+    ASSERT_EQ(1, batchReports.reports(0).metrics_size());
+    EXPECT_EQ(serialReports.reports(0).metrics(0).SerializeAsString(),
+              batchReports.reports(0).metrics(0).SerializeAsString());
+
+    StatsLogReport::CountMetricDataWrapper countMetrics;
+    sortMetricDataByDimensionsValue(batchReports.reports(0).metrics(0).count_metrics(),
+                                    &countMetrics);
+    ASSERT_EQ(1, countMetrics.data_size());
+    ASSERT_EQ(1, countMetrics.data(0).bucket_info_size());
+    EXPECT_EQ(2, countMetrics.data(0).bucket_info(0).count());
+}
+
 class StatsLogProcessorTestRestricted : public Test {
 protected:
     const ConfigKey mConfigKey = ConfigKey(1, 12345);
@@ -2251,12 +2313,12 @@ TEST_F(StatsLogProcessorTestRestricted, TestRestrictedLogEventPassed) {
     processor->OnLogEvent(event.get());
 }
 
-TEST_F(StatsLogProcessorTestRestricted, RestrictedMetricsManagerOnDumpReportNotCalled) {
+TEST_F(StatsLogProcessorTestRestricted, RestrictedMetricsManagerTakeDumpReportNotCalled) {
     sp<StatsLogProcessor> processor = CreateStatsLogProcessor(
             /*timeBaseNs=*/1, /*currentTimeNs=*/1, makeRestrictedConfig(/*includeMetric=*/true),
             mConfigKey);
     sp<MockRestrictedMetricsManager> metricsManager = new MockRestrictedMetricsManager(mConfigKey);
-    EXPECT_CALL(*metricsManager, onDumpReport).Times(0);
+    EXPECT_CALL(*metricsManager, takeDumpReport).Times(0);
 
     processor->mMetricsManagers[mConfigKey] = metricsManager;
     EXPECT_TRUE(processor->mMetricsManagers[mConfigKey]->hasRestrictedMetricsDelegate());
@@ -2300,11 +2362,13 @@ TEST_F(StatsLogProcessorTestRestricted, RestrictedMetricNotFlushIfNotReachMemory
     processor->flushIfNecessaryLocked(mConfigKey, *metricsManager);
 }
 
-TEST_F(StatsLogProcessorTestRestricted, NonRestrictedMetricsManagerOnDumpReportCalled) {
+TEST_F(StatsLogProcessorTestRestricted, NonRestrictedMetricsManagerTakeDumpReportCalled) {
     sp<StatsLogProcessor> processor = CreateStatsLogProcessor(
             /*timeBaseNs=*/1, /*currentTimeNs=*/1, MakeConfig(/*includeMetric=*/true), mConfigKey);
     sp<MockMetricsManager> metricsManager = new MockMetricsManager(mConfigKey);
-    EXPECT_CALL(*metricsManager, onDumpReport).Times(1);
+    EXPECT_CALL(*metricsManager, takeDumpReport)
+            .Times(1)
+            .WillOnce(Return(MetricsManager::DumpReportWriter([](ProtoOutputStream*) {})));
 
     processor->mMetricsManagers[mConfigKey] = metricsManager;
     EXPECT_FALSE(processor->mMetricsManagers[mConfigKey]->hasRestrictedMetricsDelegate());
@@ -20,6 +20,8 @@
 #include <src/uid_data.pb.h>
 #include <stdio.h>
 
+#include <thread>
+
 #include "StatsLogProcessor.h"
 #include "StatsService.h"
 #include "config/ConfigKey.h"
@@ -331,6 +333,84 @@ TEST(UidMapTest, TestUpdateApp) {
                 UnorderedPointwise(EqPackageInfo(), expectedPackageInfos));
 }
 
+TEST(UidMapTest, TestGetAppUid) {
+    UidMap m;
+    // kApp1 is also installed for a second user.
+    const vector<int32_t> uids = concatenate(kUids, {1001000});
+    const vector<string> apps = concatenate(kApps, {kApp1});
+    const UidData uidData =
+            createUidData(uids, concatenate(kVersions, {4}), concatenate(kVersionStrings, {"v1"}),
+                          apps, concatenate(kInstallers, {""}),
+                          concatenate(kCertificateHashes, {{'a', 'z'}}));
+    m.updateMap(1 /* timestamp */, uidData);
+    EXPECT_THAT(m.getAppUid(kApp1), UnorderedElementsAre(1000, 1001000));
+    EXPECT_THAT(m.getAppUid(kApp2), UnorderedElementsAre(1000));
+    EXPECT_THAT(m.getAppUid(kApp3), UnorderedElementsAre(1500));
+    EXPECT_THAT(m.getAppUid("not.app"), IsEmpty());
+
+    m.removeApp(2, kApp1, 1000);
+    EXPECT_THAT(m.getAppUid(kApp1), UnorderedElementsAre(1001000));
+    EXPECT_THAT(m.getAppNamesFromUid(1000, false /* returnNormalized */),
+                UnorderedElementsAre(kApp2));
+
+    m.updateApp(3, kApp1, 1000, 40, "v40", "", /* certificateHash */ {});
+    m.updateApp(4, kApp3, 1001500, 40, "v40", "", /* certificateHash */ {});
+    EXPECT_THAT(m.getAppUid(kApp1), UnorderedElementsAre(1000, 1001000));
+    EXPECT_THAT(m.getAppUid(kApp3), UnorderedElementsAre(1500, 1001500));
+    EXPECT_THAT(m.getAppNamesFromUid(1001500, false /* returnNormalized */),
+                UnorderedElementsAre(kApp3));
+
+    // A new snapshot replaces the installed apps.
+    m.updateMap(5 /* timestamp */, createUidData({1000}, {4}, {"v1"}, {kApp2}, {""}, {{'b'}}));
+    EXPECT_THAT(m.getAppUid(kApp1), IsEmpty());
+    EXPECT_THAT(m.getAppUid(kApp2), UnorderedElementsAre(1000));
+    EXPECT_THAT(m.getAppUid(kApp3), IsEmpty());
+    EXPECT_THAT(m.getAppNamesFromUid(1001500, false /* returnNormalized */), IsEmpty());
+}
+
+TEST(UidMapTest, TestLookupsDuringUpdates) {
+    UidMap m;
+    m.updateMap(1 /* timestamp */, createUidData(kUids, kVersions, kVersionStrings, kApps,
+                                                 kInstallers, kCertificateHashes));
+
+    // Lookups see either the old or the new state of every update, and never block on it.
+    std::thread writer([&m] {
+        for (int i = 0; i < 1000; i++) {
+            m.updateApp(2 + i, kApp1, 2000, 1, "v1", "", /* certificateHash */ {});
+            m.assignIsolatedUid(99000 + i % 10, 2000);
+            m.removeApp(2 + i, kApp1, 2000);
+            m.removeIsolatedUid(99000 + i % 10);
+        }
+    });
+    for (int i = 0; i < 10000; i++) {
+        ASSERT_TRUE(m.hasApp(1000, kApp1));
+        ASSERT_TRUE(m.hasApp(1500, kApp3));
+        ASSERT_THAT(m.getAppUid(kApp1), Contains(1000));
+        ASSERT_THAT(m.getAppNamesFromUid(1000, false /* returnNormalized */),
+                    UnorderedElementsAre(kApp1, kApp2));
+        const int hostUid = m.getHostUidOrSelf(99000 + i % 10);
+        ASSERT_TRUE(hostUid == 2000 || hostUid == 99000 + i % 10);
+    }
+    writer.join();
+
+    EXPECT_FALSE(m.hasApp(2000, kApp1));
+    EXPECT_THAT(m.getAppUid(kApp1), UnorderedElementsAre(1000));
+    EXPECT_EQ(99001, m.getHostUidOrSelf(99001));
+}
+
+TEST(UidMapTest, TestGetAidName) {
+    ASSERT_NE(UidMap::getAidName(AID_SYSTEM), nullptr);
+    EXPECT_EQ(*UidMap::getAidName(AID_SYSTEM), "AID_SYSTEM");
+    ASSERT_NE(UidMap::getAidName(AID_SHELL), nullptr);
+    EXPECT_EQ(*UidMap::getAidName(AID_SHELL), "AID_SHELL");
+    EXPECT_EQ(UidMap::getAidName(AID_APP_START), nullptr);
+    EXPECT_EQ(UidMap::getAidName(-1), nullptr);
+    for (const auto& [aid, uid] : UidMap::sAidToUidMapping) {
+        ASSERT_NE(UidMap::getAidName(uid), nullptr);
+        EXPECT_EQ(UidMap::sAidToUidMapping.at(*UidMap::getAidName(uid)), uid);
+    }
+}
+
 // Test that uid map returns at least one snapshot even if we already obtained
 // this snapshot from a previous call to getData.
 TEST(UidMapTest, TestOutputIncludesAtLeastOneSnapshot) {
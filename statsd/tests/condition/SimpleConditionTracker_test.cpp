@@ -586,6 +586,94 @@ TEST(SimpleConditionTrackerTest, TestSlicedWithNoOutputDim) {
     EXPECT_EQ(ConditionState::kFalse, conditionCache[0]);
 }
 
+TEST_P(SimpleConditionTrackerTest, TestSlicedPartialLink) {
+    std::vector<sp<ConditionTracker>> allConditions;
+    // Sliced by the first uid and the wake lock name, queried by the uid only.
+    SimplePredicate simplePredicate =
+            getWakeLockHeldCondition(true /*nesting*/, GetParam() /*initialValue*/,
+                                     true /*output slice by uid*/, Position::FIRST);
+    simplePredicate.mutable_dimensions()->add_child()->set_field(2);
+    string conditionName = "WL_HELD_BY_UID_AND_NAME";
+
+    unordered_map<int64_t, int> trackerNameIndexMap;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_ACQUIRE")] = 0;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_RELEASE")] = 1;
+    trackerNameIndexMap[StringToId("RELEASE_ALL")] = 2;
+
+    SimpleConditionTracker conditionTracker(kConfigKey, StringToId(conditionName), protoHash,
+                                            0 /*condition tracker index*/, simplePredicate,
+                                            trackerNameIndexMap);
+
+    std::vector<int> uids1 = {111, 1111, 11111};
+    std::vector<int> uids2 = {222, 2222, 22222};
+    const auto queryKey1 = getWakeLockQueryKey(Position::FIRST, uids1, conditionName);
+    const auto queryKey2 = getWakeLockQueryKey(Position::FIRST, uids2, conditionName);
+    const ConditionState initialValue = GetParam() == SimplePredicate_InitialValue_FALSE
+                                                ? ConditionState::kFalse
+                                                : ConditionState::kUnknown;
+
+    vector<sp<ConditionTracker>> allPredicates;
+    vector<ConditionState> conditionCache(1, ConditionState::kNotEvaluated);
+    vector<uint8_t> changedCache(1, false);
+    auto processEvent = [&](const vector<int>& uids, const string& wl, int acquire,
+                            vector<MatchingState> matcherState) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        makeWakeLockEvent(&event, uids, wl, acquire);
+        conditionCache[0] = ConditionState::kNotEvaluated;
+        changedCache[0] = false;
+        conditionTracker.evaluateCondition(event, matcherState, allPredicates, conditionCache,
+                                           changedCache);
+    };
+    auto query = [&](const ConditionKey& queryKey) {
+        conditionCache[0] = ConditionState::kNotEvaluated;
+        conditionTracker.isConditionMet(queryKey, allPredicates, true /*isPartialLink*/,
+                                        conditionCache);
+        return conditionCache[0];
+    };
+    const vector<MatchingState> start = {MatchingState::kMatched, MatchingState::kNotMatched,
+                                         MatchingState::kNotMatched};
+    const vector<MatchingState> stop = {MatchingState::kNotMatched, MatchingState::kMatched,
+                                        MatchingState::kNotMatched};
+    const vector<MatchingState> stopAll = {MatchingState::kNotMatched, MatchingState::kNotMatched,
+                                           MatchingState::kMatched};
+
+    // The first query indexes the slices already started.
+    processEvent(uids1, "wl1", /*acquire=*/1, start);
+    EXPECT_EQ(ConditionState::kTrue, query(queryKey1));
+    EXPECT_EQ(initialValue, query(queryKey2));
+    // The uid is read at its position in the slices, found once.
+    ASSERT_EQ(1UL, conditionTracker.mPartialLinkIndexes.size());
+    EXPECT_EQ(vector<size_t>{0}, conditionTracker.mPartialLinkIndexes[0].positions);
+
+    // Later slices are indexed as they start and stop.
+    processEvent(uids1, "wl2", /*acquire=*/1, start);
+    processEvent(uids2, "wl1", /*acquire=*/1, start);
+    ASSERT_EQ(3UL, conditionTracker.mSlicedConditionState.size());
+    EXPECT_EQ(ConditionState::kTrue, query(queryKey1));
+    EXPECT_EQ(ConditionState::kTrue, query(queryKey2));
+
+    // uid1 still holds wl2.
+    processEvent(uids1, "wl1", /*acquire=*/0, stop);
+    EXPECT_EQ(ConditionState::kTrue, query(queryKey1));
+
+    processEvent(uids1, "wl2", /*acquire=*/0, stop);
+    EXPECT_EQ(ConditionState::kFalse, query(queryKey1));
+    EXPECT_EQ(ConditionState::kTrue, query(queryKey2));
+
+    // A new start after the stops.
+    processEvent(uids1, "wl1", /*acquire=*/1, start);
+    EXPECT_EQ(ConditionState::kTrue, query(queryKey1));
+
+    processEvent(uids1, "wl1", /*acquire=*/0, stopAll);
+    ASSERT_EQ(0UL, conditionTracker.mSlicedConditionState.size());
+    EXPECT_EQ(ConditionState::kFalse, query(queryKey1));
+    EXPECT_EQ(ConditionState::kFalse, query(queryKey2));
+
+    processEvent(uids2, "wl1", /*acquire=*/1, start);
+    EXPECT_EQ(ConditionState::kFalse, query(queryKey1));
+    EXPECT_EQ(ConditionState::kTrue, query(queryKey2));
+}
+
 TEST_P(SimpleConditionTrackerTest, TestStopAll) {
     std::vector<sp<ConditionTracker>> allConditions;
     for (Position position : {Position::FIRST, Position::LAST}) {
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "src/StatsLogProcessor.h"
+#include "tests/statsd_test_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+#ifdef __ANDROID__
+
+namespace {
+
+const int kConfigCount = 8;
+const int64_t kBucketStartTimeNs = 10 * NS_PER_SEC;
+
+StatsdConfig CreateStatsdConfig() {
+    StatsdConfig config;
+    config.add_allowed_log_source("AID_ROOT");  // LogEvent defaults to UID of root.
+
+    auto syncStartMatcher = CreateSyncStartAtomMatcher();
+    auto screenOnMatcher = CreateScreenTurnedOnAtomMatcher();
+    auto wakelockAcquireMatcher = CreateAcquireWakelockAtomMatcher();
+    *config.add_atom_matcher() = syncStartMatcher;
+    *config.add_atom_matcher() = screenOnMatcher;
+    *config.add_atom_matcher() = CreateScreenTurnedOffAtomMatcher();
+    *config.add_atom_matcher() = CreateBatteryStateNoneMatcher();
+    *config.add_atom_matcher() = CreateBatteryStateUsbMatcher();
+    *config.add_atom_matcher() = wakelockAcquireMatcher;
+
+    auto deviceUnpluggedPredicate = CreateDeviceUnpluggedPredicate();
+    *config.add_predicate() = deviceUnpluggedPredicate;
+    auto screenIsOnPredicate = CreateScreenIsOnPredicate();
+    *config.add_predicate() = screenIsOnPredicate;
+
+    CountMetric* syncCount = config.add_count_metric();
+    *syncCount = createCountMetric("CountSyncStartWhileOnBattery", syncStartMatcher.id(),
+                                   deviceUnpluggedPredicate.id(), {} /* states */);
+    *syncCount->mutable_dimensions_in_what() =
+            CreateAttributionUidDimensions(util::SYNC_STATE_CHANGED, {Position::FIRST});
+
+    *config.add_duration_metric() =
+            createDurationMetric("ScreenOnWhileOnBattery", screenIsOnPredicate.id(),
+                                 deviceUnpluggedPredicate.id(), {} /* states */);
+
+    // Only active for a minute after a wakelock is acquired, sends activation broadcasts.
+    CountMetric* screenOnCount = config.add_count_metric();
+    *screenOnCount = createCountMetric("CountScreenOnAfterWakelock", screenOnMatcher.id(),
+                                       nullopt /* condition */, {} /* states */);
+    auto activation = config.add_metric_activation();
+    activation->set_metric_id(screenOnCount->id());
+    auto eventActivation = activation->add_event_activation();
+    eventActivation->set_atom_matcher_id(wakelockAcquireMatcher.id());
+    eventActivation->set_ttl_seconds(60);
+
+    return config;
+}
+
+std::vector<std::unique_ptr<LogEvent>> CreateEvents() {
+    std::vector<std::unique_ptr<LogEvent>> events;
+    int64_t timeNs = kBucketStartTimeNs;
+    for (int i = 0; i < 200; i++) {
+        timeNs += 5 * NS_PER_SEC;
+        switch (i % 7) {
+            case 0:
+                events.push_back(CreateBatteryStateChangedEvent(
+                        timeNs, i % 2 == 0 ? BatteryPluggedStateEnum::BATTERY_PLUGGED_NONE
+                                           : BatteryPluggedStateEnum::BATTERY_PLUGGED_USB));
+                break;
+            case 1:
+            case 4:
+                events.push_back(CreateScreenStateChangedEvent(
+                        timeNs, i % 2 == 0 ? android::view::DISPLAY_STATE_ON
+                                           : android::view::DISPLAY_STATE_OFF));
+                break;
+            case 2:
+                if (i % 3 == 0) {
+                    events.push_back(
+                            CreateAcquireWakelockEvent(timeNs, {1000 + i % 5}, {"tag"}, "wl"));
+                    break;
+                }
+                [[fallthrough]];
+            default:
+                events.push_back(CreateSyncStartEvent(timeNs, {1000 + i % 5}, {"tag"},
+                                                      "sync" + std::to_string(i)));
+                break;
+        }
+    }
+    return events;
+}
+
+struct ActivationBroadcast {
+    int uid;
+    vector<int64_t> activeConfigs;
+
+    bool operator==(const ActivationBroadcast& that) const {
+        return uid == that.uid && activeConfigs == that.activeConfigs;
+    }
+};
+
+sp<StatsLogProcessor> CreateProcessor(const StatsdConfig& config,
+                                      vector<ActivationBroadcast>* activationBroadcasts) {
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor =
+            new AlarmMonitor(1, [](const shared_ptr<IStatsCompanionService>&, int64_t) {},
+                             [](const shared_ptr<IStatsCompanionService>&) {});
+    sp<AlarmMonitor> periodicAlarmMonitor =
+            new AlarmMonitor(1, [](const shared_ptr<IStatsCompanionService>&, int64_t) {},
+                             [](const shared_ptr<IStatsCompanionService>&) {});
+    sp<StatsLogProcessor> processor = new StatsLogProcessor(
+            new UidMap(), pullerManager, anomalyAlarmMonitor, periodicAlarmMonitor,
+            kBucketStartTimeNs, [](const ConfigKey&) { return true; },
+            [activationBroadcasts](const int& uid, const vector<int64_t>& activeConfigs) {
+                vector<int64_t> sortedConfigs = activeConfigs;
+                std::sort(sortedConfigs.begin(), sortedConfigs.end());
+                activationBroadcasts->push_back({uid, sortedConfigs});
+                return true;
+            },
+            [](const ConfigKey&, const string&, const vector<int64_t>&) {},
+            std::make_shared<LogEventFilter>());
+    for (int i = 0; i < kConfigCount; i++) {
+        // Two uids so that activation broadcasts are grouped per uid.
+        processor->OnConfigUpdated(kBucketStartTimeNs, ConfigKey(1000 + i % 2, i), config);
+    }
+    return processor;
+}
+
+}  // anonymous namespace
+
+TEST(ParallelConfigDispatchE2eTest, TestReportsMatchSerialDispatch) {
+    StatsdConfig config = CreateStatsdConfig();
+
+    vector<ActivationBroadcast> serialBroadcasts;
+    sp<StatsLogProcessor> serialProcessor = CreateProcessor(config, &serialBroadcasts);
+
+    vector<ActivationBroadcast> parallelBroadcasts;
+    sp<StatsLogProcessor> parallelProcessor = CreateProcessor(config, &parallelBroadcasts);
+    parallelProcessor->enableParallelConfigDispatch(3);
+
+    int64_t lastEventTimeNs = 0;
+    for (const auto& event : CreateEvents()) {
+        serialProcessor->OnLogEvent(event.get());
+        lastEventTimeNs = event->GetElapsedTimestampNs();
+    }
+    for (const auto& event : CreateEvents()) {
+        parallelProcessor->OnLogEvent(event.get());
+    }
+
+    EXPECT_FALSE(serialBroadcasts.empty());
+    EXPECT_EQ(serialBroadcasts, parallelBroadcasts);
+
+    const int64_t dumpTimeNs = lastEventTimeNs + NS_PER_SEC;
+    for (int i = 0; i < kConfigCount; i++) {
+        const ConfigKey key(1000 + i % 2, i);
+        ConfigMetricsReportList serialReports;
+        ConfigMetricsReportList parallelReports;
+        vector<uint8_t> buffer;
+        serialProcessor->onDumpReport(key, dumpTimeNs, true, true, ADB_DUMP, FAST, &buffer);
+        ASSERT_TRUE(serialReports.ParseFromArray(&buffer[0], buffer.size()));
+        parallelProcessor->onDumpReport(key, dumpTimeNs, true, true, ADB_DUMP, FAST, &buffer);
+        ASSERT_TRUE(parallelReports.ParseFromArray(&buffer[0], buffer.size()));
+
+        ASSERT_EQ(1, serialReports.reports_size());
+        ASSERT_EQ(1, parallelReports.reports_size());
+        ASSERT_EQ(3, serialReports.reports(0).metrics_size());
+        ASSERT_EQ(serialReports.reports(0).metrics_size(),
+                  parallelReports.reports(0).metrics_size());
+        for (int j = 0; j < serialReports.reports(0).metrics_size(); j++) {
+            EXPECT_TRUE(serialReports.reports(0).metrics(j).has_count_metrics() ||
+                        serialReports.reports(0).metrics(j).has_duration_metrics());
+            EXPECT_EQ(serialReports.reports(0).metrics(j).SerializeAsString(),
+                      parallelReports.reports(0).metrics(j).SerializeAsString());
+        }
+    }
+}
+
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -19,6 +19,11 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include "stats_event.h"
 #include "tests/statsd_test_util.h"
 
@@ -27,6 +32,7 @@ using ::ndk::SharedRefBase;
 using std::make_shared;
 using std::shared_ptr;
 using std::vector;
+using namespace std::chrono_literals;
 
 namespace android {
 namespace os {
@@ -36,10 +42,12 @@ namespace {
 
 int pullTagId1 = 10101;
 int pullTagId2 = 10102;
+vector<int> slowPullTagIds = {10103, 10104, 10105, 10106};
 int uid1 = 9999;
 int uid2 = 8888;
 ConfigKey configKey(50, 12345);
 ConfigKey badConfigKey(60, 54321);
+ConfigKey configKey2(70, 23456);
 int unregisteredUid = 98765;
 int64_t coolDownNs = NS_PER_SEC;
 int64_t timeoutNs = NS_PER_SEC / 2;
@@ -74,6 +82,42 @@ public:
     int32_t mUid;
 };
 
+// Takes pullLatency to pull, and counts the pulls running at the same time.
+class SlowPullAtomCallback : public FakePullAtomCallback {
+public:
+    SlowPullAtomCallback(int32_t uid) : FakePullAtomCallback(uid){};
+    Status onPullAtom(int atomTag,
+                      const shared_ptr<IPullAtomResultReceiver>& resultReceiver) override {
+        const int running = ++mRunning;
+        int maxRunning = mMaxRunning;
+        while (running > maxRunning && !mMaxRunning.compare_exchange_weak(maxRunning, running)) {
+        }
+        std::this_thread::sleep_for(pullLatency);
+        mRunning--;
+        mPullCount++;
+        return FakePullAtomCallback::onPullAtom(atomTag, resultReceiver);
+    }
+    static constexpr std::chrono::milliseconds pullLatency = 100ms;
+    std::atomic<int> mRunning = 0;
+    std::atomic<int> mMaxRunning = 0;
+    std::atomic<int> mPullCount = 0;
+};
+
+// Appends the atom tag it was given, or -1 if the pull failed, to a shared log.
+class FakePullDataReceiver : public PullDataReceiver {
+public:
+    FakePullDataReceiver(vector<int>* log) : mLog(log){};
+    void onDataPulled(const vector<shared_ptr<LogEvent>>& data, PullResult pullResult,
+                      int64_t originalPullTimeNs) override {
+        const bool success = pullResult == PullResult::PULL_RESULT_SUCCESS && data.size() == 1;
+        mLog->push_back(success ? data[0]->GetTagId() : -1);
+    }
+    bool isPullNeeded() const override {
+        return true;
+    }
+    vector<int>* mLog;
+};
+
 class FakePullUidProvider : public PullUidProvider {
 public:
     vector<int32_t> getPullAtomUids(int atomId) override {
@@ -81,6 +125,9 @@ public:
             return {uid2, uid1};
         } else if (atomId == pullTagId2) {
             return {uid2};
+        } else if (std::find(slowPullTagIds.begin(), slowPullTagIds.end(), atomId) !=
+                   slowPullTagIds.end()) {
+            return {uid1};
         }
         return {};
     }
@@ -95,6 +142,37 @@ sp<StatsPullerManager> createPullerManagerAndRegister() {
     pullerManager->RegisterPullAtomCallback(uid1, pullTagId2, coolDownNs, timeoutNs, {}, cb1);
     return pullerManager;
 }
+
+// Pulls every slow atom, the first one for two configs, with threadCount pull threads. Returns the
+// order in which the receivers got their data.
+vector<int> pullSlowAtoms(size_t threadCount, const shared_ptr<SlowPullAtomCallback>& cb,
+                          int64_t* durationNs) {
+    sp<StatsPullerManager> pullerManager = createPullerManagerAndRegister();
+    pullerManager->enableConcurrentPulls(threadCount);
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+    pullerManager->RegisterPullUidProvider(configKey2, uidProvider);
+    for (int tagId : slowPullTagIds) {
+        pullerManager->RegisterPullAtomCallback(uid1, tagId, coolDownNs, timeoutNs, {}, cb);
+    }
+
+    vector<int> log;
+    vector<sp<FakePullDataReceiver>> receivers;
+    const int64_t intervalNs = 60 * NS_PER_SEC;
+    for (int tagId : slowPullTagIds) {
+        receivers.push_back(new FakePullDataReceiver(&log));
+        pullerManager->RegisterReceiver(tagId, configKey, receivers.back(), intervalNs,
+                                        intervalNs);
+    }
+    receivers.push_back(new FakePullDataReceiver(&log));
+    pullerManager->RegisterReceiver(slowPullTagIds[0], configKey2, receivers.back(), intervalNs,
+                                    intervalNs);
+
+    const int64_t startNs = getElapsedRealtimeNs();
+    pullerManager->OnAlarmFired(intervalNs);
+    *durationNs = getElapsedRealtimeNs() - startNs;
+    return log;
+}
 }  // anonymous namespace
 
 TEST(StatsPullerManagerTest, TestPullInvalidUid) {
@@ -145,6 +223,57 @@ TEST(StatsPullerManagerTest, TestPullConfigKeyNoPullerWithUid) {
     EXPECT_FALSE(pullerManager->Pull(pullTagId2, configKey, /*timestamp =*/1, &data));
 }
 
+TEST(StatsPullerManagerTest, TestConcurrentPullsOnAlarm) {
+    const shared_ptr<SlowPullAtomCallback> sequentialCb =
+            SharedRefBase::make<SlowPullAtomCallback>(uid1);
+    int64_t sequentialDurationNs;
+    const vector<int> sequentialLog =
+            pullSlowAtoms(/*threadCount=*/0, sequentialCb, &sequentialDurationNs);
+    ASSERT_EQ(sequentialLog.size(), slowPullTagIds.size() + 1);
+    EXPECT_EQ(sequentialCb->mMaxRunning.load(), 1);
+
+    const size_t threadCount = 2;
+    const shared_ptr<SlowPullAtomCallback> concurrentCb =
+            SharedRefBase::make<SlowPullAtomCallback>(uid1);
+    int64_t concurrentDurationNs;
+    const vector<int> concurrentLog = pullSlowAtoms(threadCount, concurrentCb,
+                                                    &concurrentDurationNs);
+
+    // The receivers get the same data in the same order, the second config being served from the
+    // cache of the first.
+    EXPECT_EQ(concurrentLog, sequentialLog);
+    EXPECT_EQ(std::count(concurrentLog.begin(), concurrentLog.end(), -1), 0);
+    EXPECT_EQ(concurrentCb->mPullCount.load(), (int)slowPullTagIds.size());
+    EXPECT_EQ(sequentialCb->mPullCount.load(), (int)slowPullTagIds.size());
+
+    EXPECT_GT(concurrentCb->mMaxRunning.load(), 1);
+    EXPECT_LE(concurrentCb->mMaxRunning.load(), (int)threadCount + 1);
+    EXPECT_LT(concurrentDurationNs, sequentialDurationNs);
+}
+
+TEST(StatsPullerManagerTest, TestConcurrentPullsOnAlarmWithoutPuller) {
+    sp<StatsPullerManager> pullerManager = createPullerManagerAndRegister();
+    pullerManager->enableConcurrentPulls(/*threadCount=*/2);
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+
+    vector<int> log;
+    sp<FakePullDataReceiver> receiver1 = new FakePullDataReceiver(&log);
+    sp<FakePullDataReceiver> receiver2 = new FakePullDataReceiver(&log);
+    sp<FakePullDataReceiver> receiver3 = new FakePullDataReceiver(&log);
+    pullerManager->RegisterReceiver(pullTagId1, configKey, receiver1, /*nextPullTimeNs=*/1,
+                                    NS_PER_SEC);
+    // No puller registered by uid2 for this atom.
+    pullerManager->RegisterReceiver(pullTagId2, configKey, receiver2, /*nextPullTimeNs=*/1,
+                                    NS_PER_SEC);
+    // No uid provider for this config.
+    pullerManager->RegisterReceiver(pullTagId1, badConfigKey, receiver3, /*nextPullTimeNs=*/1,
+                                    NS_PER_SEC);
+    pullerManager->OnAlarmFired(/*elapsedTimeNs=*/1);
+
+    EXPECT_THAT(log, testing::UnorderedElementsAre(pullTagId1, -1, -1));
+}
+
 }  // namespace statsd
 }  // namespace os
-}  // namespace android
\ No newline at end of file
+}  // namespace android
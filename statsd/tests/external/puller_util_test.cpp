@@ -276,9 +276,9 @@ TEST(PullerUtilTest, MergeNoDimensionAttributionChain) {
     const vector<FieldValue>* actualFieldValues = &data[0]->getValues();
     ASSERT_EQ(6, actualFieldValues->size());
     EXPECT_EQ(hostUid, actualFieldValues->at(0).mValue.int_value);
-    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.str_value);
+    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.getString());
     EXPECT_EQ(400, actualFieldValues->at(2).mValue.int_value);
-    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.str_value);
+    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.getString());
     EXPECT_EQ(hostNonAdditiveData, actualFieldValues->at(4).mValue.int_value);
     EXPECT_EQ(isolatedAdditiveData + hostAdditiveData, actualFieldValues->at(5).mValue.int_value);
 }
@@ -307,18 +307,18 @@ TEST(PullerUtilTest, MergeWithDimensionAttributionChain) {
     const vector<FieldValue>* actualFieldValues = &data[0]->getValues();
     ASSERT_EQ(6, actualFieldValues->size());
     EXPECT_EQ(200, actualFieldValues->at(0).mValue.int_value);
-    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.str_value);
+    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.getString());
     EXPECT_EQ(hostUid, actualFieldValues->at(2).mValue.int_value);
-    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.str_value);
+    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.getString());
     EXPECT_EQ(hostNonAdditiveData, actualFieldValues->at(4).mValue.int_value);
     EXPECT_EQ(hostAdditiveData, actualFieldValues->at(5).mValue.int_value);
 
     actualFieldValues = &data[1]->getValues();
     ASSERT_EQ(6, actualFieldValues->size());
     EXPECT_EQ(200, actualFieldValues->at(0).mValue.int_value);
-    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.str_value);
+    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.getString());
     EXPECT_EQ(hostUid, actualFieldValues->at(2).mValue.int_value);
-    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.str_value);
+    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.getString());
     EXPECT_EQ(isolatedNonAdditiveData, actualFieldValues->at(4).mValue.int_value);
     EXPECT_EQ(hostAdditiveData + isolatedAdditiveData, actualFieldValues->at(5).mValue.int_value);
 }
@@ -343,18 +343,18 @@ TEST(PullerUtilTest, NoMergeHostUidOnlyAttributionChain) {
     const vector<FieldValue>* actualFieldValues = &data[0]->getValues();
     ASSERT_EQ(6, actualFieldValues->size());
     EXPECT_EQ(hostUid, actualFieldValues->at(0).mValue.int_value);
-    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.str_value);
+    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.getString());
     EXPECT_EQ(400, actualFieldValues->at(2).mValue.int_value);
-    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.str_value);
+    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.getString());
     EXPECT_EQ(hostNonAdditiveData, actualFieldValues->at(4).mValue.int_value);
     EXPECT_EQ(hostAdditiveData, actualFieldValues->at(5).mValue.int_value);
 
     actualFieldValues = &data[1]->getValues();
     ASSERT_EQ(6, actualFieldValues->size());
     EXPECT_EQ(hostUid, actualFieldValues->at(0).mValue.int_value);
-    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.str_value);
+    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.getString());
     EXPECT_EQ(400, actualFieldValues->at(2).mValue.int_value);
-    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.str_value);
+    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.getString());
     EXPECT_EQ(isolatedNonAdditiveData, actualFieldValues->at(4).mValue.int_value);
     EXPECT_EQ(isolatedAdditiveData, actualFieldValues->at(5).mValue.int_value);
 }
@@ -380,9 +380,9 @@ TEST(PullerUtilTest, IsolatedUidOnlyAttributionChain) {
     const vector<FieldValue>* actualFieldValues = &data[0]->getValues();
     ASSERT_EQ(6, actualFieldValues->size());
     EXPECT_EQ(hostUid, actualFieldValues->at(0).mValue.int_value);
-    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.str_value);
+    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.getString());
     EXPECT_EQ(400, actualFieldValues->at(2).mValue.int_value);
-    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.str_value);
+    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.getString());
     EXPECT_EQ(hostNonAdditiveData, actualFieldValues->at(4).mValue.int_value);
     EXPECT_EQ(hostAdditiveData, actualFieldValues->at(5).mValue.int_value);
 
@@ -390,9 +390,9 @@ TEST(PullerUtilTest, IsolatedUidOnlyAttributionChain) {
     actualFieldValues = &data[1]->getValues();
     ASSERT_EQ(6, actualFieldValues->size());
     EXPECT_EQ(hostUid, actualFieldValues->at(0).mValue.int_value);
-    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.str_value);
+    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.getString());
     EXPECT_EQ(400, actualFieldValues->at(2).mValue.int_value);
-    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.str_value);
+    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.getString());
     EXPECT_EQ(isolatedNonAdditiveData, actualFieldValues->at(4).mValue.int_value);
     EXPECT_EQ(isolatedAdditiveData, actualFieldValues->at(5).mValue.int_value);
 }
@@ -421,9 +421,9 @@ TEST(PullerUtilTest, MultipleIsolatedUidToOneHostUidAttributionChain) {
     const vector<FieldValue>* actualFieldValues = &data[0]->getValues();
     ASSERT_EQ(6, actualFieldValues->size());
     EXPECT_EQ(hostUid, actualFieldValues->at(0).mValue.int_value);
-    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.str_value);
+    EXPECT_EQ("tag1", actualFieldValues->at(1).mValue.getString());
     EXPECT_EQ(400, actualFieldValues->at(2).mValue.int_value);
-    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.str_value);
+    EXPECT_EQ("tag2", actualFieldValues->at(3).mValue.getString());
     EXPECT_EQ(isolatedNonAdditiveData, actualFieldValues->at(4).mValue.int_value);
     EXPECT_EQ(isolatedAdditiveData + hostAdditiveData + hostAdditiveData,
               actualFieldValues->at(5).mValue.int_value);
@@ -16,6 +16,7 @@
 
 #include <gtest/gtest.h>
 
+#include <thread>
 #include <vector>
 
 #include "gtest_matchers.h"
@@ -40,6 +41,8 @@ namespace {
 
 using namespace testing;
 using PerSubscriptionStats = StatsdStatsReport_SubscriptionStats_PerSubscriptionStats;
+using std::atomic;
+using std::shared_ptr;
 using std::tuple;
 using std::unordered_map;
 using std::vector;
@@ -350,6 +353,74 @@ TEST(StatsdStatsTest, TestSubStats) {
     EXPECT_EQ(1, configReport2.alert_stats(0).alerted_times());
 }
 
+TEST(StatsdStatsTest, TestCachedSubStats) {
+    StatsdStats stats;
+    ConfigKey key(0, 12345);
+    EXPECT_EQ(nullptr, stats.getMatcherMatchedStat(key, StringToId("matcher1")));
+    EXPECT_EQ(nullptr, stats.getMetricDimensionSizeStat(key, StringToId("metric1")));
+
+    stats.noteConfigReceived(key, 2, 3, 4, 5, {}, nullopt);
+    shared_ptr<atomic<int>> matcherStat = stats.getMatcherMatchedStat(key, StringToId("matcher1"));
+    shared_ptr<atomic<int>> metricStat =
+            stats.getMetricDimensionSizeStat(key, StringToId("metric1"));
+    ASSERT_NE(nullptr, matcherStat);
+    ASSERT_NE(nullptr, metricStat);
+    EXPECT_EQ(matcherStat, stats.getMatcherMatchedStat(key, StringToId("matcher1")));
+    // Not reported until updated.
+    stats.getMatcherMatchedStat(key, StringToId("matcher2"));
+
+    const int numThreads = 4;
+    const int numUpdates = 1000;
+    vector<std::thread> threads;
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < numUpdates; j++) {
+                matcherStat->fetch_add(1, std::memory_order_relaxed);
+                StatsdStats::noteMaxValue(*metricStat, i * numUpdates + j);
+                stats.noteAtomLogged(util::SCREEN_STATE_CHANGED, 0, j % 2 == 0);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    stats.noteMatcherMatched(key, StringToId("matcher1"));
+
+    StatsdStatsReport report = getStatsdStatsReport(stats, /* reset stats */ true);
+    ASSERT_EQ(1, report.config_stats_size());
+    const auto& configReport = report.config_stats(0);
+    ASSERT_EQ(1, configReport.matcher_stats_size());
+    EXPECT_EQ(StringToId("matcher1"), configReport.matcher_stats(0).id());
+    EXPECT_EQ(numThreads * numUpdates + 1, configReport.matcher_stats(0).matched_times());
+    ASSERT_EQ(1, configReport.metric_stats_size());
+    EXPECT_EQ(StringToId("metric1"), configReport.metric_stats(0).id());
+    EXPECT_EQ(numThreads * numUpdates - 1, configReport.metric_stats(0).max_tuple_counts());
+    ASSERT_EQ(1, report.atom_stats_size());
+    EXPECT_EQ(util::SCREEN_STATE_CHANGED, report.atom_stats(0).tag());
+    EXPECT_EQ(numThreads * numUpdates, report.atom_stats(0).count());
+    EXPECT_EQ(numThreads * numUpdates / 2, report.atom_stats(0).skip_count());
+
+    // Cached counters stay valid across a reset.
+    matcherStat->fetch_add(1, std::memory_order_relaxed);
+    report = getStatsdStatsReport(stats, /* reset stats */ false);
+    ASSERT_EQ(1, report.config_stats_size());
+    ASSERT_EQ(1, report.config_stats(0).matcher_stats_size());
+    EXPECT_EQ(1, report.config_stats(0).matcher_stats(0).matched_times());
+    EXPECT_EQ(0, report.config_stats(0).metric_stats_size());
+    EXPECT_EQ(0, report.atom_stats_size());
+
+    // A config update creates new stats, the old counters only update the iceboxed stats.
+    stats.noteConfigReceived(key, 2, 3, 4, 5, {}, nullopt);
+    matcherStat->fetch_add(1, std::memory_order_relaxed);
+    report = getStatsdStatsReport(stats, /* reset stats */ false);
+    ASSERT_EQ(2, report.config_stats_size());
+    EXPECT_TRUE(report.config_stats(0).has_deletion_time_sec());
+    ASSERT_EQ(1, report.config_stats(0).matcher_stats_size());
+    EXPECT_EQ(2, report.config_stats(0).matcher_stats(0).matched_times());
+    EXPECT_EQ(0, report.config_stats(1).matcher_stats_size());
+    EXPECT_NE(matcherStat, stats.getMatcherMatchedStat(key, StringToId("matcher1")));
+}
+
 TEST(StatsdStatsTest, TestAtomLog) {
     StatsdStats stats;
     time_t now = time(nullptr);
@@ -976,6 +1047,19 @@ TEST(StatsdStatsTest, TestSubscriptionPullThreadWakeup) {
     EXPECT_EQ(subscriptionStats.pull_thread_wakeup_count(), 1);
 }
 
+TEST(StatsdStatsTest, TestSubscriptionAtomDropped) {
+    StatsdStats stats;
+
+    stats.noteSubscriptionAtomDropped();
+    stats.noteSubscriptionAtomDropped();
+
+    StatsdStatsReport report = getStatsdStatsReport(stats, /* reset stats */ true);
+    EXPECT_EQ(report.subscription_stats().dropped_atom_count(), 2);
+
+    report = getStatsdStatsReport(stats, /* reset stats */ false);
+    EXPECT_FALSE(report.subscription_stats().has_dropped_atom_count());
+}
+
 TEST(StatsdStatsTest, TestSubscriptionStartedMaxActiveSubscriptions) {
     StatsdStats stats;
 
@@ -196,6 +196,129 @@ TEST(LogEventQueue_test, TestQueueMaxSize) {
     }
 }
 
+TEST(LogEventQueue_test, TestWaitPopN) {
+    LogEventQueue queue(50);
+    int64_t eventTimeNs = 100;
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(queue.push(makeLogEvent(eventTimeNs + i)).success);
+    }
+    EXPECT_EQ(10u, queue.size());
+
+    std::vector<std::unique_ptr<LogEvent>> events;
+    EXPECT_EQ(4u, queue.waitPopN(events, 4));
+    EXPECT_EQ(6u, queue.size());
+    EXPECT_EQ(6u, queue.waitPopN(events, 100));
+    EXPECT_EQ(0u, queue.size());
+
+    ASSERT_EQ(10u, events.size());
+    for (int i = 0; i < 10; i++) {
+        // All events are in right order.
+        EXPECT_EQ(eventTimeNs + i, events[i]->GetElapsedTimestampNs());
+    }
+}
+
+TEST(LogEventQueue_test, TestOverflowReportsOldestTimestamp) {
+    LogEventQueue queue(3);
+    int64_t eventTimeNs = 100;
+    for (int i = 0; i < 3; i++) {
+        LogEventQueue::Result result = queue.push(makeLogEvent(eventTimeNs + i));
+        EXPECT_TRUE(result.success);
+        EXPECT_EQ(i + 1, result.size);
+    }
+
+    LogEventQueue::Result result = queue.push(makeLogEvent(eventTimeNs + 3));
+    EXPECT_FALSE(result.success);
+    EXPECT_EQ(eventTimeNs, result.oldestTimestampNs);
+
+    EXPECT_EQ(eventTimeNs, queue.waitPop()->GetElapsedTimestampNs());
+    result = queue.push(makeLogEvent(eventTimeNs + 4));
+    EXPECT_TRUE(result.success);
+    EXPECT_EQ(3, result.size);
+
+    result = queue.push(makeLogEvent(eventTimeNs + 5));
+    EXPECT_FALSE(result.success);
+    EXPECT_EQ(eventTimeNs + 1, result.oldestTimestampNs);
+}
+
+TEST(LogEventQueue_test, TestPushBatch) {
+    LogEventQueue queue(5);
+    int64_t eventTimeNs = 100;
+    std::vector<std::unique_ptr<LogEvent>> events;
+    for (int i = 0; i < 3; i++) {
+        events.push_back(makeLogEvent(eventTimeNs + i));
+    }
+    LogEventQueue::BatchResult result = queue.pushBatch(events);
+    EXPECT_EQ(3u, result.count);
+    EXPECT_EQ(3, result.size);
+    EXPECT_EQ(eventTimeNs + 2, result.lastTimestampNs);
+
+    // Only the front of the batch fits, the rest is left in the vector.
+    events.clear();
+    for (int i = 3; i < 7; i++) {
+        events.push_back(makeLogEvent(eventTimeNs + i));
+    }
+    result = queue.pushBatch(events);
+    EXPECT_EQ(2u, result.count);
+    EXPECT_EQ(5, result.size);
+    EXPECT_EQ(eventTimeNs + 4, result.lastTimestampNs);
+    EXPECT_EQ(eventTimeNs, result.oldestTimestampNs);
+    ASSERT_EQ(4u, events.size());
+    EXPECT_EQ(nullptr, events[0]);
+    EXPECT_EQ(nullptr, events[1]);
+    EXPECT_EQ(eventTimeNs + 5, events[2]->GetElapsedTimestampNs());
+    EXPECT_EQ(eventTimeNs + 6, events[3]->GetElapsedTimestampNs());
+
+    // Nothing fits in a full queue.
+    events.erase(events.begin(), events.begin() + 2);
+    result = queue.pushBatch(events);
+    EXPECT_EQ(0u, result.count);
+    EXPECT_EQ(5, result.size);
+    EXPECT_EQ(eventTimeNs, result.oldestTimestampNs);
+    EXPECT_EQ(2u, events.size());
+
+    // All events are in right order.
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(eventTimeNs + i, queue.waitPop()->GetElapsedTimestampNs());
+    }
+    EXPECT_EQ(0u, queue.size());
+}
+
+TEST(LogEventQueue_test, TestMultipleProducers) {
+    constexpr int kProducerCount = 4;
+    constexpr int kEventsPerProducer = 200;
+    LogEventQueue queue(kProducerCount * kEventsPerProducer);
+
+    std::vector<std::thread> writers;
+    for (int p = 0; p < kProducerCount; p++) {
+        writers.emplace_back([&queue, p] {
+            for (int i = 0; i < kEventsPerProducer; i++) {
+                EXPECT_TRUE(queue.push(makeLogEvent(p * kEventsPerProducer + i)).success);
+            }
+        });
+    }
+
+    std::thread reader([&queue] {
+        std::vector<int64_t> lastSeen(kProducerCount, -1);
+        std::vector<std::unique_ptr<LogEvent>> events;
+        while (events.size() < kProducerCount * kEventsPerProducer) {
+            queue.waitPopN(events, 16);
+        }
+        for (const auto& event : events) {
+            const int64_t timestampNs = event->GetElapsedTimestampNs();
+            const int producer = timestampNs / kEventsPerProducer;
+            // Events from one producer are in right order.
+            EXPECT_LT(lastSeen[producer], timestampNs);
+            lastSeen[producer] = timestampNs;
+        }
+    });
+
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    reader.join();
+    EXPECT_EQ(0u, queue.size());
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
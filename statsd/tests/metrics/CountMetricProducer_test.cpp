@@ -28,6 +28,8 @@
 
 using namespace testing;
 using android::sp;
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_MESSAGE;
 using std::set;
 using std::unordered_map;
 using std::vector;
@@ -549,6 +551,138 @@ TEST(CountMetricProducerTest, TestOneWeekTimeUnit) {
     EXPECT_EQ(fiveWeeksOneDayNs, countProducer.getCurrentBucketEndTimeNs());
 }
 
+TEST(CountMetricProducerTest, TestTakeDumpReport) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+    int64_t bucket2StartTimeNs = bucketStartTimeNs + bucketSizeNs;
+    int64_t bucket3StartTimeNs = bucketStartTimeNs + 2 * bucketSizeNs;
+    int tagId = 1;
+
+    CountMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    sp<MockConfigMetadataProvider> provider = makeMockConfigMetadataProvider(/*enabled=*/false);
+    CountMetricProducer countProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, bucketStartTimeNs, bucketStartTimeNs,
+                                      provider);
+
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event1, bucketStartTimeNs + 1, tagId);
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event2, bucketStartTimeNs + 2, tagId);
+    countProducer.onMatchedLogEvent(1 /*log matcher index*/, event1);
+    countProducer.onMatchedLogEvent(1 /*log matcher index*/, event2);
+
+    // Taking the report without erasing it keeps the buckets.
+    MetricProducer::DumpReportWriter keptWriter =
+            countProducer.takeDumpReport(bucket2StartTimeNs + 1, false /*include partial bucket*/,
+                                         false /*erase data*/, FAST, nullptr /*str_set*/);
+    ASSERT_EQ(1UL, countProducer.mPastBuckets.size());
+
+    // Taking the report with erasing hands the buckets over to the writer.
+    MetricProducer::DumpReportWriter writer =
+            countProducer.takeDumpReport(bucket2StartTimeNs + 1, false /*include partial bucket*/,
+                                         true /*erase data*/, FAST, nullptr /*str_set*/);
+    EXPECT_TRUE(countProducer.mPastBuckets.empty());
+
+    // The events after the report was taken are not in it.
+    LogEvent event3(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event3, bucket2StartTimeNs + 2, tagId);
+    countProducer.onMatchedLogEvent(1 /*log matcher index*/, event3);
+    countProducer.flushIfNeededLocked(bucket3StartTimeNs + 1);
+    ASSERT_EQ(1UL, countProducer.mPastBuckets.size());
+
+    for (const MetricProducer::DumpReportWriter& dumpReportWriter : {keptWriter, writer}) {
+        ProtoOutputStream output;
+        dumpReportWriter(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | 1 /*metrics*/, &output);
+        ConfigMetricsReport report;
+        outputStreamToProto(&output, &report);
+        ASSERT_EQ(1, report.metrics_size());
+        const StatsLogReport& metricReport = report.metrics(0);
+        EXPECT_EQ(1, metricReport.metric_id());
+        ASSERT_EQ(1, metricReport.count_metrics().data_size());
+        const CountMetricData& data = metricReport.count_metrics().data(0);
+        ASSERT_EQ(1, data.bucket_info_size());
+        EXPECT_EQ(0, data.bucket_info(0).bucket_num());
+        EXPECT_EQ(2, data.bucket_info(0).count());
+    }
+
+    // The writer gives the same report as onDumpReport.
+    ProtoOutputStream takenOutput;
+    countProducer.takeDumpReport(bucket3StartTimeNs + 1, true /*include partial bucket*/,
+                                 false /*erase data*/, FAST, nullptr /*str_set*/)(
+            FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | 1 /*metrics*/, &takenOutput);
+    ProtoOutputStream dumpedOutput;
+    uint64_t token = dumpedOutput.start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | 1);
+    countProducer.onDumpReport(bucket3StartTimeNs + 1, true /*include partial bucket*/,
+                               false /*erase data*/, FAST, nullptr /*str_set*/, &dumpedOutput);
+    dumpedOutput.end(token);
+    vector<uint8_t> takenBytes;
+    takenOutput.serializeToVector(&takenBytes);
+    vector<uint8_t> dumpedBytes;
+    dumpedOutput.serializeToVector(&dumpedBytes);
+    EXPECT_EQ(dumpedBytes, takenBytes);
+}
+
+TEST(CountMetricProducerTest, TestRunningByteSize) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+    int tagId = 1;
+
+    CountMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    sp<MockConfigMetadataProvider> provider = makeMockConfigMetadataProvider(/*enabled=*/false);
+    CountMetricProducer countProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, bucketStartTimeNs, bucketStartTimeNs,
+                                      provider);
+
+    // The size that byteSize() used to compute by walking the past buckets.
+    auto pastBucketsSize = [&countProducer]() {
+        size_t totalSize = 0;
+        for (const auto& pair : countProducer.mPastBuckets) {
+            totalSize += pair.second.size() * countProducer.kBucketSize;
+        }
+        return totalSize;
+    };
+    // Logs an event in the given bucket and flushes it.
+    auto logAndFlush = [&](int bucketNum) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        makeLogEvent(&event, bucketStartTimeNs + bucketNum * bucketSizeNs + 1, tagId);
+        countProducer.onMatchedLogEvent(1 /*log matcher index*/, event);
+        countProducer.flushIfNeededLocked(bucketStartTimeNs + (bucketNum + 1) * bucketSizeNs + 1);
+    };
+
+    logAndFlush(0);
+    logAndFlush(1);
+    ASSERT_EQ(2UL, countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(pastBucketsSize(), countProducer.byteSize());
+
+    countProducer.dropData(bucketStartTimeNs + 2 * bucketSizeNs + 2);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), countProducer.byteSize());
+
+    logAndFlush(2);
+    EXPECT_EQ(pastBucketsSize(), countProducer.byteSize());
+
+    countProducer.clearPastBuckets(bucketStartTimeNs + 3 * bucketSizeNs + 2);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), countProducer.byteSize());
+
+    logAndFlush(3);
+    EXPECT_EQ(pastBucketsSize(), countProducer.byteSize());
+
+    countProducer.takeDumpReport(bucketStartTimeNs + 4 * bucketSizeNs + 2,
+                                 true /*include partial bucket*/, true /*erase data*/, FAST,
+                                 nullptr /*str_set*/);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), countProducer.byteSize());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -1022,6 +1022,151 @@ TEST(GaugeMetricProducerTest, TestPullDimensionalSampling) {
                              {bucketStartTimeNs + 10, bucketStartTimeNs + 20});
 }
 
+TEST(GaugeMetricProducerTest, TestTakeDumpReport) {
+    GaugeMetric metric;
+    metric.set_id(metricId);
+    metric.set_bucket(ONE_MINUTE);
+    metric.mutable_gauge_fields_filter()->set_include_all(true);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<EventMatcherWizard> eventMatcherWizard =
+            createEventMatcherWizard(tagId, logEventMatcherIndex);
+    sp<MockConfigMetadataProvider> provider = makeMockConfigMetadataProvider(/*enabled=*/false);
+
+    GaugeMetricProducer gaugeProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, logEventMatcherIndex, eventMatcherWizard,
+                                      -1 /* -1 means no pulling */, -1, tagId, bucketStartTimeNs,
+                                      bucketStartTimeNs, pullerManager, provider);
+    gaugeProducer.prepareFirstBucket();
+
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    CreateTwoValueLogEvent(&event1, tagId, bucketStartTimeNs + 10, 1, 10);
+    gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, event1);
+
+    // Taking the report without erasing it keeps the buckets.
+    MetricProducer::DumpReportWriter keptWriter =
+            gaugeProducer.takeDumpReport(bucket2StartTimeNs + 1, false /*include partial bucket*/,
+                                         false /*erase data*/, FAST, nullptr /*str_set*/);
+    ASSERT_EQ(1UL, gaugeProducer.mPastBuckets.size());
+
+    // Taking the report with erasing hands the buckets over to the writer.
+    MetricProducer::DumpReportWriter writer =
+            gaugeProducer.takeDumpReport(bucket2StartTimeNs + 1, false /*include partial bucket*/,
+                                         true /*erase data*/, FAST, nullptr /*str_set*/);
+    EXPECT_TRUE(gaugeProducer.mPastBuckets.empty());
+
+    // The events after the report was taken are not in it.
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    CreateTwoValueLogEvent(&event2, tagId, bucket2StartTimeNs + 10, 2, 20);
+    gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, event2);
+    gaugeProducer.flushIfNeededLocked(bucket3StartTimeNs + 1);
+    ASSERT_EQ(1UL, gaugeProducer.mPastBuckets.size());
+
+    vector<uint8_t> keptBytes;
+    for (const MetricProducer::DumpReportWriter& dumpReportWriter : {keptWriter, writer}) {
+        ProtoOutputStream output;
+        dumpReportWriter(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | 1 /*metrics*/, &output);
+        ConfigMetricsReport report;
+        outputStreamToProto(&output, &report);
+        ASSERT_EQ(1, report.metrics_size());
+        StatsLogReport metricReport = report.metrics(0);
+        EXPECT_EQ(metricId, metricReport.metric_id());
+        backfillAggregatedAtoms(&metricReport);
+        ASSERT_EQ(1, metricReport.gauge_metrics().data_size());
+        const GaugeMetricData& data = metricReport.gauge_metrics().data(0);
+        ASSERT_EQ(1, data.bucket_info_size());
+        EXPECT_EQ(0, data.bucket_info(0).bucket_num());
+        ASSERT_EQ(1, data.bucket_info(0).elapsed_timestamp_nanos_size());
+        EXPECT_EQ(bucketStartTimeNs + 10, data.bucket_info(0).elapsed_timestamp_nanos(0));
+
+        // Both writers give the same report.
+        vector<uint8_t> bytes;
+        output.serializeToVector(&bytes);
+        if (keptBytes.empty()) {
+            keptBytes = bytes;
+        } else {
+            EXPECT_EQ(keptBytes, bytes);
+        }
+    }
+}
+
+TEST(GaugeMetricProducerTest, TestRunningByteSize) {
+    GaugeMetric metric;
+    metric.set_id(metricId);
+    metric.set_bucket(ONE_MINUTE);
+    metric.mutable_gauge_fields_filter()->set_include_all(true);
+    metric.set_sampling_type(GaugeMetric::FIRST_N_SAMPLES);
+    metric.set_max_num_gauge_atoms_per_bucket(10);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<EventMatcherWizard> eventMatcherWizard =
+            createEventMatcherWizard(tagId, logEventMatcherIndex);
+    sp<MockConfigMetadataProvider> provider = makeMockConfigMetadataProvider(/*enabled=*/false);
+
+    GaugeMetricProducer gaugeProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, logEventMatcherIndex, eventMatcherWizard,
+                                      -1 /* -1 means no pulling */, -1, tagId, bucketStartTimeNs,
+                                      bucketStartTimeNs, pullerManager, provider);
+    gaugeProducer.prepareFirstBucket();
+
+    // The size that byteSize() used to compute by walking the past buckets.
+    auto pastBucketsSize = [&gaugeProducer]() {
+        size_t totalSize = 0;
+        for (const auto& pair : gaugeProducer.mPastBuckets) {
+            for (const auto& bucket : pair.second) {
+                for (const auto& [atomDimensionKey, elapsedTimestampsNs] :
+                     bucket.mAggregatedAtoms) {
+                    totalSize += sizeof(FieldValue) *
+                                 atomDimensionKey.getAtomFieldValues().getValues().size();
+                    totalSize += sizeof(int64_t) * elapsedTimestampsNs.size();
+                }
+            }
+        }
+        return totalSize;
+    };
+    // Logs the same atom twice and another one once in the given bucket, and flushes it.
+    auto logAndFlush = [&](int bucketNum) {
+        const int64_t bucketTimeNs = bucketStartTimeNs + bucketNum * bucketSizeNs;
+        LogEvent event1(/*uid=*/0, /*pid=*/0);
+        CreateTwoValueLogEvent(&event1, tagId, bucketTimeNs + 10, 1, 10);
+        gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, event1);
+        LogEvent event2(/*uid=*/0, /*pid=*/0);
+        CreateTwoValueLogEvent(&event2, tagId, bucketTimeNs + 20, 1, 10);
+        gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, event2);
+        LogEvent event3(/*uid=*/0, /*pid=*/0);
+        CreateTwoValueLogEvent(&event3, tagId, bucketTimeNs + 30, bucketNum, 20);
+        gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, event3);
+        gaugeProducer.flushIfNeededLocked(bucketTimeNs + bucketSizeNs + 1);
+    };
+
+    logAndFlush(0);
+    logAndFlush(1);
+    ASSERT_EQ(2UL, gaugeProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(pastBucketsSize(), gaugeProducer.byteSize());
+
+    gaugeProducer.dropData(bucket3StartTimeNs + 2);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), gaugeProducer.byteSize());
+
+    logAndFlush(2);
+    EXPECT_EQ(pastBucketsSize(), gaugeProducer.byteSize());
+
+    gaugeProducer.clearPastBuckets(bucket4StartTimeNs + 2);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), gaugeProducer.byteSize());
+
+    logAndFlush(3);
+    EXPECT_EQ(pastBucketsSize(), gaugeProducer.byteSize());
+
+    gaugeProducer.takeDumpReport(bucket4StartTimeNs + bucketSizeNs + 2,
+                                 true /*include partial bucket*/, true /*erase data*/, FAST,
+                                 nullptr /*str_set*/);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), gaugeProducer.byteSize());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
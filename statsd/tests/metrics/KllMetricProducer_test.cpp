@@ -461,6 +461,62 @@ TEST(KllMetricProducerTest, TestByteSize) {
     EXPECT_EQ(expectedSize, kllProducer->byteSize());
 }
 
+TEST(KllMetricProducerTest, TestRunningByteSize) {
+    const KllMetric& metric = KllMetricProducerTestHelper::createMetric();
+    sp<KllMetricProducer> kllProducer =
+            KllMetricProducerTestHelper::createKllProducerNoConditions(metric);
+
+    // The size that byteSize() used to compute by walking the past buckets.
+    auto pastBucketsSize = [&kllProducer]() {
+        size_t totalSize = 0;
+        for (const auto& [_, buckets] : kllProducer->mPastBuckets) {
+            totalSize += buckets.size() * kllProducer->kBucketSize;
+            for (const auto& bucket : buckets) {
+                totalSize += bucket.aggIndex.size() * sizeof(int);
+                if (!bucket.aggregates.empty()) {
+                    totalSize += bucket.aggregates.size() * sizeof(int64_t) *
+                                 bucket.aggregates[0]->num_stored_values();
+                }
+            }
+        }
+        return totalSize;
+    };
+    // Logs one more event than the bucket number in the given bucket, and flushes it.
+    auto logAndFlush = [&kllProducer](int bucketNum) {
+        const int64_t bucketTimeNs = bucketStartTimeNs + bucketNum * bucketSizeNs;
+        for (int i = 0; i <= bucketNum; i++) {
+            LogEvent event(/*uid=*/0, /*pid=*/0);
+            CreateRepeatedValueLogEvent(&event, atomId, bucketTimeNs + 10 + i, 10 * (i + 1));
+            kllProducer->onMatchedLogEvent(1 /*log matcher index*/, event);
+        }
+        kllProducer->flushIfNeededLocked(bucketTimeNs + bucketSizeNs + 1);
+    };
+
+    logAndFlush(0);
+    logAndFlush(1);
+    ASSERT_EQ(2UL, kllProducer->mPastBuckets.begin()->second.size());
+    EXPECT_EQ(pastBucketsSize(), kllProducer->byteSize());
+
+    kllProducer->dropData(bucket3StartTimeNs + 2);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), kllProducer->byteSize());
+
+    logAndFlush(2);
+    EXPECT_EQ(pastBucketsSize(), kllProducer->byteSize());
+
+    kllProducer->clearPastBuckets(bucket4StartTimeNs + 2);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), kllProducer->byteSize());
+
+    logAndFlush(3);
+    EXPECT_EQ(pastBucketsSize(), kllProducer->byteSize());
+
+    kllProducer->takeDumpReport(bucket5StartTimeNs + 2, true /*include partial bucket*/,
+                                true /*erase data*/, FAST, nullptr /*str_set*/);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), kllProducer->byteSize());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -7967,6 +7967,111 @@ TEST(NumericValueMetricProducerTest, TestMultipleAggTypesPushed) {
     }
 }
 
+TEST(NumericValueMetricProducerTest, TestTakeDumpReport) {
+    ValueMetric metric = NumericValueMetricProducerTestHelper::createMetric();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<NumericValueMetricProducer> valueProducer =
+            NumericValueMetricProducerTestHelper::createValueProducerNoConditions(
+                    pullerManager, metric, /*pullAtomId=*/-1);
+
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    CreateRepeatedValueLogEvent(&event1, tagId, bucketStartTimeNs + 10, 10);
+    valueProducer->onMatchedLogEvent(1 /*log matcher index*/, event1);
+
+    // Taking the report without erasing it keeps the buckets.
+    MetricProducer::DumpReportWriter keptWriter =
+            valueProducer->takeDumpReport(bucket2StartTimeNs + 1, false /*include partial bucket*/,
+                                          false /*erase data*/, FAST, nullptr /*str_set*/);
+    ASSERT_EQ(1UL, valueProducer->mPastBuckets.size());
+
+    // Taking the report with erasing hands the buckets over to the writer.
+    MetricProducer::DumpReportWriter writer =
+            valueProducer->takeDumpReport(bucket2StartTimeNs + 1, false /*include partial bucket*/,
+                                          true /*erase data*/, FAST, nullptr /*str_set*/);
+    EXPECT_TRUE(valueProducer->mPastBuckets.empty());
+
+    // The events after the report was taken are not in it.
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    CreateRepeatedValueLogEvent(&event2, tagId, bucket2StartTimeNs + 10, 20);
+    valueProducer->onMatchedLogEvent(1 /*log matcher index*/, event2);
+    valueProducer->flushIfNeededLocked(bucket3StartTimeNs + 1);
+    ASSERT_EQ(1UL, valueProducer->mPastBuckets.size());
+
+    vector<uint8_t> keptBytes;
+    for (const MetricProducer::DumpReportWriter& dumpReportWriter : {keptWriter, writer}) {
+        ProtoOutputStream output;
+        dumpReportWriter(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | 1 /*metrics*/, &output);
+        ConfigMetricsReport report;
+        outputStreamToProto(&output, &report);
+        ASSERT_EQ(1, report.metrics_size());
+        const StatsLogReport& metricReport = report.metrics(0);
+        EXPECT_EQ(metricId, metricReport.metric_id());
+        ASSERT_EQ(1, metricReport.value_metrics().data_size());
+        const ValueMetricData& data = metricReport.value_metrics().data(0);
+        ASSERT_EQ(1, data.bucket_info_size());
+        EXPECT_EQ(0, data.bucket_info(0).bucket_num());
+        EXPECT_EQ(10, data.bucket_info(0).values(0).value_long());
+
+        // Both writers give the same report.
+        vector<uint8_t> bytes;
+        output.serializeToVector(&bytes);
+        if (keptBytes.empty()) {
+            keptBytes = bytes;
+        } else {
+            EXPECT_EQ(keptBytes, bytes);
+        }
+    }
+}
+
+TEST(NumericValueMetricProducerTest, TestRunningByteSize) {
+    ValueMetric metric = NumericValueMetricProducerTestHelper::createMetric();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<NumericValueMetricProducer> valueProducer =
+            NumericValueMetricProducerTestHelper::createValueProducerNoConditions(
+                    pullerManager, metric, /*pullAtomId=*/-1);
+
+    // The size that byteSize() used to compute by walking the past buckets.
+    auto pastBucketsSize = [&valueProducer]() {
+        size_t totalSize = 0;
+        for (const auto& [_, buckets] : valueProducer->mPastBuckets) {
+            totalSize += buckets.size() * valueProducer->kBucketSize;
+        }
+        return totalSize;
+    };
+    // Logs an event in the given bucket and flushes it.
+    auto logAndFlush = [&valueProducer](int bucketNum) {
+        const int64_t bucketTimeNs = bucketStartTimeNs + bucketNum * bucketSizeNs;
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        CreateRepeatedValueLogEvent(&event, tagId, bucketTimeNs + 10, 10 * (bucketNum + 1));
+        valueProducer->onMatchedLogEvent(1 /*log matcher index*/, event);
+        valueProducer->flushIfNeededLocked(bucketTimeNs + bucketSizeNs + 1);
+    };
+
+    logAndFlush(0);
+    logAndFlush(1);
+    ASSERT_EQ(2UL, valueProducer->mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(pastBucketsSize(), valueProducer->byteSize());
+
+    valueProducer->dropData(bucket3StartTimeNs + 2);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), valueProducer->byteSize());
+
+    logAndFlush(2);
+    EXPECT_EQ(pastBucketsSize(), valueProducer->byteSize());
+
+    valueProducer->clearPastBuckets(bucket4StartTimeNs + 2);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), valueProducer->byteSize());
+
+    logAndFlush(3);
+    EXPECT_EQ(pastBucketsSize(), valueProducer->byteSize());
+
+    valueProducer->takeDumpReport(bucket5StartTimeNs + 2, true /*include partial bucket*/,
+                                  true /*erase data*/, FAST, nullptr /*str_set*/);
+    EXPECT_EQ(0UL, pastBucketsSize());
+    EXPECT_EQ(pastBucketsSize(), valueProducer->byteSize());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -127,6 +127,43 @@ TEST_F(RestrictedEventMetricProducerTest, TestOnMatchedLogEventMultipleFields) {
                                          "field_1", "field_2", "field_3"));
 }
 
+TEST_F(RestrictedEventMetricProducerTest, TestOnMatchedLogEventDifferentFields) {
+    EventMetric metric;
+    metric.set_id(metricId1);
+    sp<MockConfigMetadataProvider> provider = makeMockConfigMetadataProvider(/*enabled=*/false);
+    RestrictedEventMetricProducer producer(configKey, metric,
+                                           /*conditionIndex=*/-1,
+                                           /*initialConditionCache=*/{}, new ConditionWizard(),
+                                           /*protoHash=*/0x1234567890,
+                                           /*startTimeNs=*/0, provider);
+    std::unique_ptr<LogEvent> event1 = CreateRestrictedLogEvent(/*atomTag=*/123, /*timestampNs=*/1);
+
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, 123);
+    AStatsEvent_addInt32Annotation(statsEvent, ASTATSLOG_ANNOTATION_ID_RESTRICTION_CATEGORY,
+                                   ASTATSLOG_RESTRICTION_CATEGORY_DIAGNOSTIC);
+    AStatsEvent_overwriteTimestamp(statsEvent, 3);
+    AStatsEvent_writeString(statsEvent, "111");
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    parseStatsEventToLogEvent(statsEvent, &event2);
+
+    // event2 does not fit the table of event1, and is dropped.
+    producer.onMatchedLogEvent(/*matcherIndex=*/1, *event1);
+    producer.onMatchedLogEvent(/*matcherIndex=*/1, event2);
+    producer.flushRestrictedData();
+
+    stringstream query;
+    query << "SELECT * FROM metric_" << metricId1;
+    string err;
+    vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    vector<vector<string>> rows;
+    EXPECT_TRUE(dbutils::query(configKey, query.str(), rows, columnTypes, columnNames, err));
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(/*elapsedTimestampNs=*/rows[0][1], to_string(event1->GetElapsedTimestampNs()));
+    EXPECT_EQ(/*field1=*/rows[0][3], "10");
+}
+
 TEST_F(RestrictedEventMetricProducerTest, TestOnMatchedLogEventWithCondition) {
     EventMetric metric;
     metric.set_id(metricId1);
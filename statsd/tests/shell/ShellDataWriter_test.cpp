@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "src/shell/ShellDataWriter.h"
+
+#include <android-base/file.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "src/shell/shell_data.pb.h"
+#include "src/stats_log_util.h"
+
+#ifdef __ANDROID__
+
+using android::base::ReadFully;
+using android::base::unique_fd;
+using android::util::ProtoOutputStream;
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const int FIELD_ID_SHELL_DATA__ELAPSED_TIMESTAMP_NANOS = 2;
+
+// Writes a ShellData with the given timestamps to proto.
+void writeTimestamps(ProtoOutputStream* proto, const vector<int64_t>& timestamps) {
+    proto->clear();
+    for (int64_t timestamp : timestamps) {
+        proto->write(util::FIELD_TYPE_INT64 | util::FIELD_COUNT_REPEATED |
+                             FIELD_ID_SHELL_DATA__ELAPSED_TIMESTAMP_NANOS,
+                     (long long)timestamp);
+    }
+}
+
+// Reads a frame and returns its timestamps, or nullopt for a heartbeat.
+optional<vector<int64_t>> readFrame(int fd) {
+    size_t dataSize;
+    EXPECT_TRUE(ReadFully(fd, &dataSize, sizeof(dataSize)));
+    if (dataSize == 0) {
+        return nullopt;
+    }
+    vector<uint8_t> data(dataSize);
+    EXPECT_TRUE(ReadFully(fd, data.data(), dataSize));
+    ShellData shellData;
+    EXPECT_TRUE(shellData.ParseFromArray(data.data(), dataSize));
+    return vector<int64_t>(shellData.elapsed_timestamp_nanos().begin(),
+                           shellData.elapsed_timestamp_nanos().end());
+}
+
+class ShellDataWriterTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        int fds[2];
+        ASSERT_EQ(0, pipe2(fds, O_CLOEXEC));
+        mReadFd.reset(fds[0]);
+        mWriter = make_unique<ShellDataWriter>(unique_fd(fds[1]), getElapsedRealtimeMillis());
+    }
+
+    unique_fd mReadFd;
+    unique_ptr<ShellDataWriter> mWriter;
+    ProtoOutputStream mProto;
+};
+
+}  // anonymous namespace
+
+TEST_F(ShellDataWriterTest, TestAppendsAreBatched) {
+    writeTimestamps(&mProto, {1});
+    EXPECT_TRUE(mWriter->append(mProto));
+    writeTimestamps(&mProto, {2, 3});
+    EXPECT_TRUE(mWriter->append(mProto));
+
+    // Both appends are written as one frame once the batch delay has elapsed.
+    EXPECT_EQ(vector<int64_t>({1, 2, 3}), readFrame(mReadFd.get()));
+    EXPECT_TRUE(mWriter->isAlive());
+}
+
+TEST_F(ShellDataWriterTest, TestFullBatchIsWritten) {
+    vector<int64_t> timestamps;
+    for (int i = 0; i < 2000; i++) {
+        timestamps.push_back(i);
+    }
+    writeTimestamps(&mProto, timestamps);
+    ASSERT_GE(mProto.size(), ShellDataWriter::kBatchBytes);
+
+    const int64_t startMs = getElapsedRealtimeMillis();
+    EXPECT_TRUE(mWriter->append(mProto));
+    EXPECT_EQ(timestamps, readFrame(mReadFd.get()));
+    EXPECT_LT(getElapsedRealtimeMillis() - startMs, ShellDataWriter::kMaxBatchDelayMs * 10);
+}
+
+TEST_F(ShellDataWriterTest, TestHeartbeat) {
+    const int64_t lastWriteMs = mWriter->getLastWriteMs();
+    mWriter->requestHeartbeat();
+    EXPECT_EQ(nullopt, readFrame(mReadFd.get()));
+
+    // Buffered data replaces the heartbeat.
+    writeTimestamps(&mProto, {1});
+    EXPECT_TRUE(mWriter->append(mProto));
+    mWriter->requestHeartbeat();
+    EXPECT_EQ(vector<int64_t>({1}), readFrame(mReadFd.get()));
+    EXPECT_GE(mWriter->getLastWriteMs(), lastWriteMs);
+}
+
+TEST_F(ShellDataWriterTest, TestOverflow) {
+    // Fill the pipe so that the writer thread blocks, then the ring buffer.
+    vector<int64_t> timestamps(ShellDataWriter::kBatchBytes, 1);
+    writeTimestamps(&mProto, timestamps);
+    int appendCount = 0;
+    while (mWriter->append(mProto)) {
+        appendCount++;
+        ASSERT_LT(appendCount, 1000);
+    }
+    EXPECT_GT(appendCount, 0);
+    EXPECT_TRUE(mWriter->isAlive());
+
+    // Reading the data makes room for more.
+    ASSERT_NE(nullopt, readFrame(mReadFd.get()));
+    bool appended = false;
+    for (int i = 0; i < 100 && !appended; i++) {
+        appended = mWriter->append(mProto);
+        if (!appended) {
+            this_thread::sleep_for(10ms);
+            vector<uint8_t> data(ShellDataWriter::kBatchBytes);
+            read(mReadFd.get(), data.data(), data.size());
+        }
+    }
+    EXPECT_TRUE(appended);
+}
+
+TEST_F(ShellDataWriterTest, TestClosedReader) {
+    // As in statsd, writes to the closed pipe fail with EPIPE.
+    signal(SIGPIPE, SIG_IGN);
+    mReadFd.reset();
+    writeTimestamps(&mProto, {1});
+    EXPECT_TRUE(mWriter->append(mProto));
+    mWriter->requestHeartbeat();
+    for (int i = 0; i < 100 && mWriter->isAlive(); i++) {
+        this_thread::sleep_for(10ms);
+    }
+    EXPECT_FALSE(mWriter->isAlive());
+}
+
+TEST_F(ShellDataWriterTest, TestDestructorDoesNotBlock) {
+    vector<int64_t> timestamps(ShellDataWriter::kBatchBytes, 1);
+    writeTimestamps(&mProto, timestamps);
+    while (mWriter->append(mProto)) {
+    }
+
+    // The reader neither reads nor closes the pipe.
+    mWriter.reset();
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -15,6 +15,7 @@
 #include "src/shell/ShellSubscriber.h"
 
 #include <aidl/android/os/StatsSubscriptionCallbackReason.h>
+#include <android-base/file.h>
 #include <gtest/gtest.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -57,6 +58,7 @@ using testing::NiceMock;
 using testing::Return;
 using testing::SaveArg;
 using testing::SetArgPointee;
+using testing::SizeIs;
 using testing::StrictMock;
 
 namespace android {
@@ -147,7 +149,7 @@ static ShellData readData(int fd) {
     }
     // Read that much data in proto binary format.
     vector<uint8_t> dataBuffer(dataSize);
-    EXPECT_EQ((int)dataSize, read(fd, dataBuffer.data(), dataSize));
+    EXPECT_TRUE(android::base::ReadFully(fd, dataBuffer.data(), dataSize));
 
     // Make sure the received bytes can be parsed to an atom.
     ShellData receivedAtom;
@@ -155,6 +157,31 @@ static ShellData readData(int fd) {
     return receivedAtom;
 }
 
+// Utility to split ShellData protos into one ShellData per atom.
+static vector<ShellData> splitAtoms(const vector<ShellData>& shellDatas) {
+    vector<ShellData> atoms;
+    for (const ShellData& shellData : shellDatas) {
+        for (int i = 0; i < shellData.atom_size(); i++) {
+            ShellData& atom = atoms.emplace_back();
+            *atom.add_atom() = shellData.atom(i);
+            atom.add_elapsed_timestamp_nanos(shellData.elapsed_timestamp_nanos(i));
+        }
+    }
+    return atoms;
+}
+
+// Utility to read atomCount atoms, which statsd may batch in any number of ShellData protos.
+static vector<ShellData> readAtoms(int fd, size_t atomCount) {
+    vector<ShellData> atoms;
+    while (atoms.size() < atomCount) {
+        for (ShellData& atom : splitAtoms({readData(fd)})) {
+            atoms.push_back(std::move(atom));
+        }
+    }
+    EXPECT_EQ(atomCount, atoms.size());
+    return atoms;
+}
+
 void runShellTest(ShellSubscription config, sp<MockUidMap> uidMap,
                   sp<MockStatsPullerManager> pullerManager,
                   const vector<std::shared_ptr<LogEvent>>& pushedEvents,
@@ -189,13 +216,11 @@ void runShellTest(ShellSubscription config, sp<MockUidMap> uidMap,
         shellManager->onLogEvent(*event);
     }
 
+    const vector<ShellData> expectedAtoms = splitAtoms(expectedData);
     for (int i = 0; i < numClients; i++) {
-        vector<ShellData> actualData;
-        for (int j = 1; j <= expectedData.size(); j++) {
-            actualData.push_back(readData(fds_datas[i][0]));
-        }
+        vector<ShellData> actualAtoms = readAtoms(fds_datas[i][0], expectedAtoms.size());
 
-        EXPECT_THAT(expectedData, UnorderedPointwise(EqShellData(), actualData));
+        EXPECT_THAT(expectedAtoms, UnorderedPointwise(EqShellData(), actualAtoms));
     }
 
     // Not closing fds_datas[i][0] because this causes writes within ShellSubscriberClient to hang
@@ -933,14 +958,15 @@ TEST(ShellSubscriberTest, testDifferentConfigs) {
     }
 
     // Validate Config 1
-    ShellData actual1 = readData(fds_datas[0][0]);
+    vector<ShellData> actualAtoms = readAtoms(fds_datas[0][0], 2);
+    ShellData actual1 = actualAtoms[0];
     ShellData expected1;
     expected1.add_atom()->mutable_screen_state_changed()->set_state(
             ::android::view::DisplayStateEnum::DISPLAY_STATE_ON);
     expected1.add_elapsed_timestamp_nanos(pushedList[0]->GetElapsedTimestampNs());
     EXPECT_THAT(expected1, EqShellData(actual1));
 
-    ShellData actual2 = readData(fds_datas[0][0]);
+    ShellData actual2 = actualAtoms[1];
     ShellData expected2;
     expected2.add_atom()->mutable_screen_state_changed()->set_state(
             ::android::view::DisplayStateEnum::DISPLAY_STATE_OFF);
@@ -948,14 +974,15 @@ TEST(ShellSubscriberTest, testDifferentConfigs) {
     EXPECT_THAT(expected2, EqShellData(actual2));
 
     // Validate Config 2, repeating the process
-    ShellData actual3 = readData(fds_datas[1][0]);
+    actualAtoms = readAtoms(fds_datas[1][0], 2);
+    ShellData actual3 = actualAtoms[0];
     ShellData expected3;
     expected3.add_atom()->mutable_plugged_state_changed()->set_state(
             BatteryPluggedStateEnum::BATTERY_PLUGGED_USB);
     expected3.add_elapsed_timestamp_nanos(pushedList[2]->GetElapsedTimestampNs());
     EXPECT_THAT(expected3, EqShellData(actual3));
 
-    ShellData actual4 = readData(fds_datas[1][0]);
+    ShellData actual4 = actualAtoms[1];
     ShellData expected4;
     expected4.add_atom()->mutable_plugged_state_changed()->set_state(
             BatteryPluggedStateEnum::BATTERY_PLUGGED_NONE);
@@ -987,6 +1014,51 @@ TEST(ShellSubscriberTest, testPushedSubscriptionRestrictedEvent) {
     TRACE_CALL(runShellTest, config, uidMap, pullerManager, pushedList, expectedData, kNumClients);
 }
 
+TEST(ShellSubscriberTest, testSlowReaderDoesNotBlockEvents) {
+    sp<MockUidMap> uidMap = new NaggyMock<MockUidMap>();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<ShellSubscriber> shellManager =
+            new ShellSubscriber(uidMap, pullerManager, std::make_shared<LogEventFilter>());
+
+    ShellSubscription config;
+    config.add_pushed()->set_atom_id(SCREEN_STATE_CHANGED);
+    const vector<uint8_t> buffer = protoToBytes(config);
+    const size_t bufferSize = buffer.size();
+
+    int fds_config[2];
+    ASSERT_EQ(0, pipe2(fds_config, O_CLOEXEC));
+    int fds_data[2];
+    ASSERT_EQ(0, pipe2(fds_data, O_CLOEXEC));
+    write(fds_config[1], &bufferSize, sizeof(bufferSize));
+    write(fds_config[1], buffer.data(), bufferSize);
+    close(fds_config[1]);
+    ASSERT_TRUE(shellManager->startNewSubscription(fds_config[0], fds_data[1],
+                                                   /*timeoutSec=*/-1));
+    close(fds_config[0]);
+    close(fds_data[1]);
+
+    const int32_t droppedAtomCount =
+            getStatsdStatsReport(/*resetStats=*/false).subscription_stats().dropped_atom_count();
+
+    // Nothing is read from fds_data[0]. More events than fit in the pipe and in the buffer of
+    // the subscription must neither block nor end the subscription.
+    std::unique_ptr<LogEvent> event = CreateScreenStateChangedEvent(
+            1000 /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    const int eventCount = 50000;
+    for (int i = 0; i < eventCount; i++) {
+        shellManager->onLogEvent(*event);
+    }
+
+    EXPECT_GT(getStatsdStatsReport(/*resetStats=*/false).subscription_stats().dropped_atom_count(),
+              droppedAtomCount);
+
+    // The subscription is still active: the atoms that were kept are delivered.
+    EXPECT_THAT(readAtoms(fds_data[0], 1), SizeIs(1));
+
+    shellManager.clear();
+    close(fds_data[0]);
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
@@ -736,6 +736,19 @@ bool parseStatsEventToLogEvent(AStatsEvent* statsEvent, LogEvent* logEvent) {
     return result;
 }
 
+bool parseStatsEventToLogEventLazily(AStatsEvent* statsEvent, LogEvent* logEvent) {
+    AStatsEvent_build(statsEvent);
+
+    size_t size;
+    uint8_t* buf = AStatsEvent_getBuffer(statsEvent, &size);
+    const LogEvent::BodyBufferInfo bodyInfo = logEvent->parseHeader(buf, size);
+    const bool result = logEvent->isValid() && logEvent->parseBodyLazy(bodyInfo);
+
+    AStatsEvent_release(statsEvent);
+
+    return result;
+}
+
 void CreateTwoValueLogEvent(LogEvent* logEvent, int atomId, int64_t eventTimeNs, int32_t value1,
                             int32_t value2) {
     AStatsEvent* statsEvent = AStatsEvent_obtain();
@@ -381,6 +381,9 @@ void writeAttribution(AStatsEvent* statsEvent, const vector<int>& attributionUid
 // Builds statsEvent to get buffer that is parsed into logEvent then releases statsEvent.
 bool parseStatsEventToLogEvent(AStatsEvent* statsEvent, LogEvent* logEvent);
 
+// Same as parseStatsEventToLogEvent() but parses the body with LogEvent::parseBodyLazy().
+bool parseStatsEventToLogEventLazily(AStatsEvent* statsEvent, LogEvent* logEvent);
+
 shared_ptr<LogEvent> CreateTwoValueLogEvent(int atomId, int64_t eventTimeNs, int32_t value1,
                                             int32_t value2);
 
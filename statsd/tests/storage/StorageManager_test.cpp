@@ -203,6 +203,31 @@ TEST(StorageManagerTest, AppendConfigReportTest4) {
     clearLocalHistoryTestFiles();
 }
 
+TEST(StorageManagerTest, TrimToFitDeletesOutdatedWrittenFiles) {
+    const int64_t nowSec = getWallClockSec();
+    const string content = "content";
+
+    // Deleted by the trimming that follows the write.
+    const string outdatedFile = StorageManager::getDataFileName(
+            nowSec - StatsdStats::kMaxAgeSecond - 100, 1066, 2);
+    StorageManager::writeFile(outdatedFile.c_str(), content.data(), content.size());
+    EXPECT_FALSE(fileExist(outdatedFile));
+
+    // Too old to be kept as a local history only.
+    const string file = StorageManager::getDataFileName(
+            nowSec - StatsdStats::kMaxLocalHistoryAgeSecond - 100, 1066, 2);
+    StorageManager::writeFile(file.c_str(), content.data(), content.size());
+    EXPECT_TRUE(fileExist(file));
+
+    ProtoOutputStream out;
+    StorageManager::appendConfigMetricsReport(ConfigKey(1066, 2), &out, false /*erase?*/,
+                                              false /*isAdb?*/);
+    EXPECT_TRUE(fileExist(file + "_history"));
+
+    StorageManager::trimToFit("/data/misc/stats-data");
+    EXPECT_FALSE(fileExist(file + "_history"));
+}
+
 TEST(StorageManagerTest, TrainInfoReadWrite32To64BitTest) {
     InstallTrainInfo trainInfo;
     trainInfo.trainVersionCode = 12345;
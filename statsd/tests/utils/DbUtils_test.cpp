@@ -270,6 +270,92 @@ TEST_F(DbUtilsTest, TestInsertTwoEventsEnforceTtl) {
                 ElementsAre("atomId", "elapsedTimestampNs", "wallTimestampNs", "field_1"));
 }
 
+TEST_F(DbUtilsTest, TestInsertLargeBatch) {
+    int64_t eventElapsedTimeNs = 10000000000;
+    const int eventCount = 5000;
+
+    // More bound parameters in total than a single sqlite statement accepts.
+    vector<LogEvent> events;
+    for (int i = 0; i < eventCount; i++) {
+        AStatsEvent* statsEvent = makeAStatsEvent(tagId, eventElapsedTimeNs + i);
+        AStatsEvent_writeInt32(statsEvent, i);
+        AStatsEvent_writeInt64(statsEvent, i);
+        AStatsEvent_writeString(statsEvent, "111");
+        events.push_back(makeLogEvent(statsEvent));
+    }
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, events[0]));
+    string err;
+    EXPECT_TRUE(insert(key, metricId, events, err));
+    EXPECT_TRUE(insert(key, metricId, events, err));
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<std::vector<std::string>> rows;
+    string zSql = "SELECT COUNT(*), SUM(field_1) FROM metric_111";
+    EXPECT_TRUE(query(key, zSql, rows, columnTypes, columnNames, err));
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_THAT(rows[0], ElementsAre(to_string(2 * eventCount),
+                                     to_string(eventCount * (eventCount - 1))));
+}
+
+TEST_F(DbUtilsTest, TestInsertUsesWal) {
+    AStatsEvent* statsEvent = makeAStatsEvent(tagId, 10000000000);
+    AStatsEvent_writeString(statsEvent, "111");
+    LogEvent logEvent = makeLogEvent(statsEvent);
+    vector<LogEvent> events{logEvent};
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, logEvent));
+    string err;
+    EXPECT_TRUE(insert(key, metricId, events, err));
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<std::vector<std::string>> rows;
+    EXPECT_TRUE(query(key, "PRAGMA journal_mode", rows, columnTypes, columnNames, err));
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_THAT(rows[0], ElementsAre("wal"));
+}
+
+TEST_F(DbUtilsTest, TestDeleteDbClosesConnection) {
+    int64_t eventElapsedTimeNs = 10000000000;
+
+    AStatsEvent* statsEvent1 = makeAStatsEvent(tagId, eventElapsedTimeNs + 10);
+    AStatsEvent_writeString(statsEvent1, "111");
+    LogEvent logEvent1 = makeLogEvent(statsEvent1);
+    vector<LogEvent> events1{logEvent1};
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, logEvent1));
+    string err;
+    EXPECT_TRUE(insert(key, metricId, events1, err));
+
+    const string dbName = getDbName(key);
+    EXPECT_TRUE(StorageManager::hasFile((dbName + "-wal").c_str()));
+    deleteDb(key);
+    EXPECT_FALSE(StorageManager::hasFile(dbName.c_str()));
+    EXPECT_FALSE(StorageManager::hasFile((dbName + "-wal").c_str()));
+    EXPECT_FALSE(StorageManager::hasFile((dbName + "-shm").c_str()));
+
+    // A new db is created with a different schema for the same metric.
+    AStatsEvent* statsEvent2 = makeAStatsEvent(tagId, eventElapsedTimeNs + 20);
+    AStatsEvent_writeInt32(statsEvent2, 222);
+    LogEvent logEvent2 = makeLogEvent(statsEvent2);
+    vector<LogEvent> events2{logEvent2};
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, logEvent2));
+    EXPECT_TRUE(insert(key, metricId, events2, err));
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<std::vector<std::string>> rows;
+    string zSql = "SELECT * FROM metric_111 ORDER BY elapsedTimestampNs";
+    EXPECT_TRUE(query(key, zSql, rows, columnTypes, columnNames, err));
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_THAT(rows[0], ElementsAre("1", to_string(eventElapsedTimeNs + 20), _, "222"));
+    EXPECT_THAT(columnTypes,
+                ElementsAre(SQLITE_INTEGER, SQLITE_INTEGER, SQLITE_INTEGER, SQLITE_INTEGER));
+}
+
 TEST_F(DbUtilsTest, TestMaliciousQuery) {
     int64_t eventElapsedTimeNs = 10000000000;
 
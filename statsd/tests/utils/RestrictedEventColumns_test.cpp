@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/RestrictedEventColumns.h"
+
+#include <gtest/gtest.h>
+
+#include "tests/statsd_test_util.h"
+
+#ifdef __ANDROID__
+
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const int32_t tagId = 1;
+
+// An event with a long, an attribution chain, a float, a byte array and a string.
+LogEvent makeLogEvent(int64_t timestampNs, int64_t longValue, float floatValue,
+                      const string& stringValue) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, tagId);
+    AStatsEvent_overwriteTimestamp(statsEvent, timestampNs);
+    AStatsEvent_writeInt64(statsEvent, longValue);
+    const uint32_t uids[] = {1000, 1001};
+    const char* tags[] = {"tag1", "tag2"};
+    AStatsEvent_writeAttributionChain(statsEvent, uids, tags, 2);
+    AStatsEvent_writeFloat(statsEvent, floatValue);
+    const uint8_t bytes[] = {1, 2, 3};
+    AStatsEvent_writeByteArray(statsEvent, bytes, sizeof(bytes));
+    AStatsEvent_writeString(statsEvent, stringValue.c_str());
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    parseStatsEventToLogEvent(statsEvent, &event);
+    return event;
+}
+
+}  // anonymous namespace
+
+TEST(RestrictedEventColumnsTest, TestGetFieldColumns) {
+    const LogEvent event = makeLogEvent(10, 20, 1.5, "str");
+    const vector<RestrictedEventColumns::FieldColumn> expected = {
+            {1, LONG}, {3, FLOAT}, {5, STRING}};
+    EXPECT_EQ(expected, RestrictedEventColumns::getFieldColumns(event));
+}
+
+TEST(RestrictedEventColumnsTest, TestAppend) {
+    RestrictedEventColumns columns;
+    EXPECT_TRUE(columns.empty());
+    EXPECT_EQ(0, columns.getByteSize());
+
+    const LogEvent event1 = makeLogEvent(10, 20, 1.5, "str1");
+    const LogEvent event2 = makeLogEvent(30, 40, 2.5, "");
+    ASSERT_TRUE(columns.append(event1));
+    ASSERT_TRUE(columns.append(event2));
+    ASSERT_EQ(2, columns.size());
+    EXPECT_EQ(RestrictedEventColumns::getFieldColumns(event1), columns.getFieldColumns());
+
+    EXPECT_EQ(tagId, columns.getAtomId(0));
+    EXPECT_EQ(10, columns.getElapsedTimestampNs(0));
+    EXPECT_EQ(event1.GetLogdTimestampNs(), columns.getWallClockTimestampNs(0));
+    EXPECT_EQ(20, columns.getLong(0, 0));
+    EXPECT_EQ(1.5, columns.getFloat(1, 0));
+    size_t length;
+    EXPECT_STREQ("str1", columns.getString(2, 0, &length));
+    EXPECT_EQ(4, length);
+
+    EXPECT_EQ(30, columns.getElapsedTimestampNs(1));
+    EXPECT_EQ(40, columns.getLong(0, 1));
+    EXPECT_EQ(2.5, columns.getFloat(1, 1));
+    EXPECT_STREQ("", columns.getString(2, 1, &length));
+    EXPECT_EQ(0, length);
+
+    // Far less than copies of the events.
+    EXPECT_GT(columns.getByteSize(), 0);
+    EXPECT_LT(columns.getByteSize(), 2 * sizeof(LogEvent));
+}
+
+TEST(RestrictedEventColumnsTest, TestAppendDifferentFields) {
+    RestrictedEventColumns columns;
+    ASSERT_TRUE(columns.append(makeLogEvent(10, 20, 1.5, "str1")));
+    const size_t byteSize = columns.getByteSize();
+
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, tagId);
+    AStatsEvent_writeInt32(statsEvent, 20);
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    parseStatsEventToLogEvent(statsEvent, &event);
+    EXPECT_FALSE(columns.append(event));
+    EXPECT_EQ(1, columns.size());
+    EXPECT_EQ(byteSize, columns.getByteSize());
+
+    // The next events may have other fields once the columns are cleared.
+    columns.clear();
+    EXPECT_TRUE(columns.empty());
+    EXPECT_TRUE(columns.append(event));
+    EXPECT_EQ(RestrictedEventColumns::getFieldColumns(event), columns.getFieldColumns());
+    EXPECT_EQ(20, columns.getInt(0, 0));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/WorkerPool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+#ifdef __ANDROID__
+
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+TEST(WorkerPoolTest, TestEveryIterationRunsOnce) {
+    WorkerPool pool(3);
+    EXPECT_EQ(3u, pool.getThreadCount());
+
+    vector<int> runCounts(1000, 0);
+    pool.parallelFor(runCounts.size(), [&runCounts](size_t i) { runCounts[i]++; });
+
+    for (size_t i = 0; i < runCounts.size(); i++) {
+        EXPECT_EQ(1, runCounts[i]) << "iteration " << i;
+    }
+}
+
+TEST(WorkerPoolTest, TestRepeatedLoops) {
+    WorkerPool pool(4);
+    vector<int64_t> values(37, 0);
+    for (int loop = 0; loop < 500; loop++) {
+        pool.parallelFor(values.size(), [&values, loop](size_t i) { values[i] += loop + i; });
+    }
+
+    // Writes made by the workers must be visible on return of every loop.
+    const int64_t loopSum = 499 * 500 / 2;
+    for (size_t i = 0; i < values.size(); i++) {
+        EXPECT_EQ(loopSum + 500 * (int64_t)i, values[i]);
+    }
+}
+
+TEST(WorkerPoolTest, TestSmallLoops) {
+    WorkerPool pool(2);
+    atomic<int> calls(0);
+    pool.parallelFor(0, [&calls](size_t) { calls++; });
+    EXPECT_EQ(0, calls.load());
+
+    pool.parallelFor(1, [&calls](size_t i) {
+        EXPECT_EQ(0u, i);
+        calls++;
+    });
+    EXPECT_EQ(1, calls.load());
+}
+
+TEST(WorkerPoolTest, TestNoThreads) {
+    WorkerPool pool(0);
+    EXPECT_EQ(0u, pool.getThreadCount());
+
+    vector<size_t> order;
+    pool.parallelFor(5, [&order](size_t i) { order.push_back(i); });
+    EXPECT_EQ(vector<size_t>({0, 1, 2, 3, 4}), order);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif